@@ -16,18 +16,33 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include "kmsbasehub.h"
 #include "kmsagnosticcaps.h"
 #include "kms-core-marshal.h"
 #include "kmshubport.h"
+#include "kmsrefstruct.h"
 
 #define PLUGIN_NAME "basehub"
 
-#define KMS_BASE_HUB_LOCK(hub) \
-  (g_rec_mutex_lock (&(hub)->priv->mutex))
+#define KMS_BASE_HUB_PORTS_READ_LOCK(hub) \
+  (g_rw_lock_reader_lock (&(hub)->priv->ports_lock))
+
+#define KMS_BASE_HUB_PORTS_READ_UNLOCK(hub) \
+  (g_rw_lock_reader_unlock (&(hub)->priv->ports_lock))
+
+#define KMS_BASE_HUB_PORTS_WRITE_LOCK(hub) \
+  (g_rw_lock_writer_lock (&(hub)->priv->ports_lock))
 
-#define KMS_BASE_HUB_UNLOCK(hub) \
-  (g_rec_mutex_unlock (&(hub)->priv->mutex))
+#define KMS_BASE_HUB_PORTS_WRITE_UNLOCK(hub) \
+  (g_rw_lock_writer_unlock (&(hub)->priv->ports_lock))
+
+#define KMS_BASE_HUB_PORT_LOCK(port_data) \
+  (g_rec_mutex_lock (&(port_data)->mutex))
+
+#define KMS_BASE_HUB_PORT_UNLOCK(port_data) \
+  (g_rec_mutex_unlock (&(port_data)->mutex))
 
 GST_DEBUG_CATEGORY_STATIC (kms_base_hub_debug_category);
 #define GST_CAT_DEFAULT kms_base_hub_debug_category
@@ -48,8 +63,6 @@ GST_DEBUG_CATEGORY_STATIC (kms_base_hub_debug_category);
 #define VIDEO_SINK_PAD_NAME VIDEO_SINK_PAD_PREFIX "%u"
 #define AUDIO_SRC_PAD_NAME AUDIO_SRC_PAD_PREFIX "%u"
 #define VIDEO_SRC_PAD_NAME VIDEO_SRC_PAD_PREFIX "%u"
-#define LENGTH_VIDEO_SRC_PAD_PREFIX 10  //sizeof("video_src_")
-#define LENGTH_AUDIO_SRC_PAD_PREFIX 10  //sizeof("audio_src_")
 
 static GstStaticPadTemplate audio_sink_factory =
 GST_STATIC_PAD_TEMPLATE (AUDIO_SINK_PAD_NAME,
@@ -90,16 +103,26 @@ static guint kms_base_hub_signals[LAST_SIGNAL] = { 0 };
 
 struct _KmsBaseHubPrivate
 {
+  /* Port table: readers (pad-added, link) only take the lock for lookup */
   GHashTable *ports;
-  GRecMutex mutex;
+  GRWLock ports_lock;
   gint port_count;
   gint pad_added_id;
 };
 
+typedef enum
+{
+  KMS_BASE_HUB_PORT_STATE_HANDLED,
+  KMS_BASE_HUB_PORT_STATE_UNHANDLED
+} KmsBaseHubPortState;
+
 typedef struct _KmsBaseHubPortData KmsBaseHubPortData;
 
 struct _KmsBaseHubPortData
 {
+  KmsRefStruct ref;
+  GRecMutex mutex;
+  KmsBaseHubPortState state;
   KmsBaseHub *hub;
   GstElement *port;
   gulong signal_id;
@@ -108,6 +131,12 @@ struct _KmsBaseHubPortData
   GstPad *video_sink_target;
 };
 
+#define KMS_BASE_HUB_PORT_DATA_REF(data) \
+  ((KmsBaseHubPortData *) kms_ref_struct_ref (KMS_REF_STRUCT_CAST (data)))
+
+#define KMS_BASE_HUB_PORT_DATA_UNREF(data) \
+  (kms_ref_struct_unref (KMS_REF_STRUCT_CAST (data)))
+
 /* class initialization */
 
 G_DEFINE_TYPE_WITH_CODE (KmsBaseHub, kms_base_hub,
@@ -141,11 +170,28 @@ end:
   return gst_ghost_pad_set_target (GST_GHOST_PAD (gp), target);
 }
 
+static void
+kms_base_hub_port_data_destroy (gpointer data)
+{
+  KmsBaseHubPortData *port_data = (KmsBaseHubPortData *) data;
+
+  g_clear_object (&port_data->audio_sink_target);
+  g_clear_object (&port_data->video_sink_target);
+
+  g_clear_object (&port_data->port);
+  g_rec_mutex_clear (&port_data->mutex);
+  g_slice_free (KmsBaseHubPortData, data);
+}
+
 static KmsBaseHubPortData *
 kms_base_hub_port_data_create (KmsBaseHub * hub, GstElement * port, gint id)
 {
   KmsBaseHubPortData *data = g_slice_new0 (KmsBaseHubPortData);
 
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (data),
+      kms_base_hub_port_data_destroy);
+  g_rec_mutex_init (&data->mutex);
+  data->state = KMS_BASE_HUB_PORT_STATE_HANDLED;
   data->hub = hub;
   data->port = g_object_ref (port);
   data->id = id;
@@ -154,20 +200,40 @@ kms_base_hub_port_data_create (KmsBaseHub * hub, GstElement * port, gint id)
 }
 
 static void
-kms_base_hub_port_data_destroy (gpointer data)
+kms_base_hub_port_data_unref (gpointer data)
 {
-  KmsBaseHubPortData *port_data = (KmsBaseHubPortData *) data;
+  KMS_BASE_HUB_PORT_DATA_UNREF (data);
+}
+
+/* Returns a new reference to the port data or NULL. Callers must check the */
+/* port state while holding the port lock, it may have been unhandled since */
+static KmsBaseHubPortData *
+kms_base_hub_get_port_data (KmsBaseHub * hub, gint id)
+{
+  KmsBaseHubPortData *port_data;
+
+  KMS_BASE_HUB_PORTS_READ_LOCK (hub);
+
+  port_data = g_hash_table_lookup (hub->priv->ports, GINT_TO_POINTER (id));
+  if (port_data != NULL) {
+    KMS_BASE_HUB_PORT_DATA_REF (port_data);
+  }
+
+  KMS_BASE_HUB_PORTS_READ_UNLOCK (hub);
+
+  return port_data;
+}
+
+/* Must be called with the port lock held */
+static void
+kms_base_hub_port_data_set_unhandled (KmsBaseHubPortData * port_data)
+{
+  port_data->state = KMS_BASE_HUB_PORT_STATE_UNHANDLED;
 
   if (port_data->signal_id != 0) {
     g_signal_handler_disconnect (port_data->port, port_data->signal_id);
     port_data->signal_id = 0;
   }
-
-  g_clear_object (&port_data->audio_sink_target);
-  g_clear_object (&port_data->video_sink_target);
-
-  g_clear_object (&port_data->port);
-  g_slice_free (KmsBaseHubPortData, data);
 }
 
 gboolean
@@ -256,12 +322,6 @@ kms_base_hub_unlink_audio_sink (KmsBaseHub * hub, gint id)
       (hub, id);
 }
 
-static void
-release_gint (gpointer data)
-{
-  g_slice_free (gint, data);
-}
-
 static gboolean
 kms_base_hub_unlink_pad (KmsBaseHub * hub, const gchar * gp_name)
 {
@@ -517,11 +577,16 @@ kms_base_hub_link_sink_pad (KmsBaseHub * hub, gint id,
     return FALSE;
   }
 
-  KMS_BASE_HUB_LOCK (hub);
-
-  port_data = g_hash_table_lookup (hub->priv->ports, &id);
+  port_data = kms_base_hub_get_port_data (hub, id);
 
   if (port_data == NULL) {
+    g_object_unref (target);
+    return FALSE;
+  }
+
+  KMS_BASE_HUB_PORT_LOCK (port_data);
+
+  if (port_data->state != KMS_BASE_HUB_PORT_STATE_HANDLED) {
     ret = FALSE;
     goto end;
   }
@@ -556,7 +621,8 @@ kms_base_hub_link_sink_pad (KmsBaseHub * hub, gint id,
 
 end:
 
-  KMS_BASE_HUB_UNLOCK (hub);
+  KMS_BASE_HUB_PORT_UNLOCK (port_data);
+  KMS_BASE_HUB_PORT_DATA_UNREF (port_data);
 
   g_object_unref (target);
 
@@ -633,35 +699,69 @@ kms_base_hub_unhandle_port (KmsBaseHub * hub, gint id)
 
   GST_DEBUG_OBJECT (hub, "Unhandle port %" G_GINT32_FORMAT, id);
 
-  KMS_BASE_HUB_LOCK (hub);
+  /* Only the table removal is done under the hub lock, pads are */
+  /* released holding just this port's lock */
+  KMS_BASE_HUB_PORTS_WRITE_LOCK (hub);
+
+  port_data = g_hash_table_lookup (hub->priv->ports, GINT_TO_POINTER (id));
+  if (port_data != NULL) {
+    /* Stealing transfers the table reference to us */
+    g_hash_table_steal (hub->priv->ports, GINT_TO_POINTER (id));
+  }
 
-  port_data = (KmsBaseHubPortData *) g_hash_table_lookup (hub->priv->ports,
-      &id);
+  KMS_BASE_HUB_PORTS_WRITE_UNLOCK (hub);
 
   if (port_data == NULL) {
-    goto end;
+    return;
   }
 
-  GST_DEBUG ("Removing element: %" GST_PTR_FORMAT, port_data->port);
+  KMS_BASE_HUB_PORT_LOCK (port_data);
 
-  kms_hub_port_unhandled (KMS_HUB_PORT (port_data->port));
-  kms_base_hub_remove_port_pads (hub, id);
+  if (port_data->state == KMS_BASE_HUB_PORT_STATE_HANDLED) {
+    GST_DEBUG ("Removing element: %" GST_PTR_FORMAT, port_data->port);
 
-  g_hash_table_remove (hub->priv->ports, &id);
+    kms_base_hub_port_data_set_unhandled (port_data);
+    kms_hub_port_unhandled (KMS_HUB_PORT (port_data->port));
+    kms_base_hub_remove_port_pads (hub, id);
+  }
 
-end:
-  KMS_BASE_HUB_UNLOCK (hub);
+  KMS_BASE_HUB_PORT_UNLOCK (port_data);
+  KMS_BASE_HUB_PORT_DATA_UNREF (port_data);
 }
 
-static gint *
+static gint
 kms_base_hub_generate_port_id (KmsBaseHub * hub)
 {
-  gint *id;
+  return g_atomic_int_add (&hub->priv->port_count, 1);
+}
 
-  id = g_slice_new (gint);
-  *id = g_atomic_int_add (&hub->priv->port_count, 1);
+static void
+kms_base_hub_link_port_src (KmsBaseHub * hub, GstPad * pad,
+    const gchar * pad_prefix, const gchar * port_sink_name)
+{
+  KmsBaseHubPortData *port_data;
+  const gchar *pad_name;
+  gint id;
 
-  return id;
+  pad_name = GST_OBJECT_NAME (pad);
+  id = (gint) g_ascii_strtoll (pad_name + strlen (pad_prefix), NULL, 10);
+
+  port_data = kms_base_hub_get_port_data (hub, id);
+
+  if (port_data == NULL) {
+    GST_WARNING_OBJECT (hub, "No port %d for pad %" GST_PTR_FORMAT, id, pad);
+    return;
+  }
+
+  KMS_BASE_HUB_PORT_LOCK (port_data);
+
+  if (port_data->state == KMS_BASE_HUB_PORT_STATE_HANDLED) {
+    gst_element_link_pads (GST_ELEMENT (hub), pad_name, port_data->port,
+        port_sink_name);
+  }
+
+  KMS_BASE_HUB_PORT_UNLOCK (port_data);
+  KMS_BASE_HUB_PORT_DATA_UNREF (port_data);
 }
 
 static void
@@ -671,33 +771,13 @@ hub_pad_added (KmsBaseHub * hub, GstPad * pad, gpointer data)
     return;
   }
 
-  KMS_BASE_HUB_LOCK (hub);
-
   if (g_str_has_prefix (GST_OBJECT_NAME (pad), VIDEO_SRC_PAD_PREFIX)) {
-    KmsBaseHubPortData *port;
-    gint64 id;
-    const gchar *pad_name;
-
-    pad_name = GST_OBJECT_NAME (pad);
-    id = g_ascii_strtoll (pad_name + LENGTH_VIDEO_SRC_PAD_PREFIX, NULL, 10);
-    port = g_hash_table_lookup (hub->priv->ports, &id);
-
-    gst_element_link_pads (GST_ELEMENT (hub), GST_OBJECT_NAME (pad),
-        port->port, "hub_video_sink");
+    kms_base_hub_link_port_src (hub, pad, VIDEO_SRC_PAD_PREFIX,
+        HUB_VIDEO_SINK_PAD);
   } else if (g_str_has_prefix (GST_OBJECT_NAME (pad), AUDIO_SRC_PAD_PREFIX)) {
-    KmsBaseHubPortData *port;
-    gint64 id;
-    const gchar *pad_name;
-
-    pad_name = GST_OBJECT_NAME (pad);
-    id = g_ascii_strtoll (pad_name + LENGTH_AUDIO_SRC_PAD_PREFIX, NULL, 10);
-    port = g_hash_table_lookup (hub->priv->ports, &id);
-
-    gst_element_link_pads (GST_ELEMENT (hub), GST_OBJECT_NAME (pad),
-        port->port, "hub_audio_sink");
+    kms_base_hub_link_port_src (hub, pad, AUDIO_SRC_PAD_PREFIX,
+        HUB_AUDIO_SINK_PAD);
   }
-
-  KMS_BASE_HUB_UNLOCK (hub);
 }
 
 static void
@@ -709,7 +789,11 @@ endpoint_pad_added (GstElement * endpoint, GstPad * pad,
     return;
   }
 
-  KMS_BASE_HUB_LOCK (port_data->hub);
+  KMS_BASE_HUB_PORT_LOCK (port_data);
+
+  if (port_data->state != KMS_BASE_HUB_PORT_STATE_HANDLED) {
+    goto end;
+  }
 
   if (port_data->video_sink_target != NULL
       && g_strstr_len (GST_OBJECT_NAME (pad), -1, "video")) {
@@ -723,7 +807,7 @@ endpoint_pad_added (GstElement * endpoint, GstPad * pad,
     kms_base_hub_create_and_link_ghost_pad (port_data->hub, pad, gp_name,
         VIDEO_SINK_PAD_NAME, port_data->video_sink_target);
     g_free (gp_name);
-  } else if (port_data->video_sink_target != NULL
+  } else if (port_data->audio_sink_target != NULL
       && g_strstr_len (GST_OBJECT_NAME (pad), -1, "audio")) {
     gchar *gp_name = g_strdup_printf (AUDIO_SINK_PAD_PREFIX "%d",
         port_data->id);
@@ -737,14 +821,15 @@ endpoint_pad_added (GstElement * endpoint, GstPad * pad,
     g_free (gp_name);
   }
 
-  KMS_BASE_HUB_UNLOCK (port_data->hub);
+end:
+  KMS_BASE_HUB_PORT_UNLOCK (port_data);
 }
 
 static gint
 kms_base_hub_handle_port (KmsBaseHub * hub, GstElement * hub_port)
 {
   KmsBaseHubPortData *port_data;
-  gint *id;
+  gint id;
 
   if (!KMS_IS_HUB_PORT (hub_port)) {
     GST_INFO_OBJECT (hub, "Invalid HubPort: %" GST_PTR_FORMAT, hub_port);
@@ -762,29 +847,44 @@ kms_base_hub_handle_port (KmsBaseHub * hub, GstElement * hub_port)
 
   id = kms_base_hub_generate_port_id (hub);
 
-  GST_DEBUG_OBJECT (hub, "Adding new port %d", *id);
-  port_data = kms_base_hub_port_data_create (hub, hub_port, *id);
+  GST_DEBUG_OBJECT (hub, "Adding new port %d", id);
+  port_data = kms_base_hub_port_data_create (hub, hub_port, id);
 
-  port_data->signal_id = g_signal_connect (G_OBJECT (hub_port),
-      "pad-added", G_CALLBACK (endpoint_pad_added), port_data);
+  port_data->signal_id = g_signal_connect_data (G_OBJECT (hub_port),
+      "pad-added", G_CALLBACK (endpoint_pad_added),
+      KMS_BASE_HUB_PORT_DATA_REF (port_data),
+      (GClosureNotify) kms_base_hub_port_data_unref, 0);
 
-  KMS_BASE_HUB_LOCK (hub);
-  g_hash_table_insert (hub->priv->ports, id, port_data);
-  KMS_BASE_HUB_UNLOCK (hub);
+  KMS_BASE_HUB_PORTS_WRITE_LOCK (hub);
+  g_hash_table_insert (hub->priv->ports, GINT_TO_POINTER (id), port_data);
+  KMS_BASE_HUB_PORTS_WRITE_UNLOCK (hub);
 
-  return *id;
+  return id;
 }
 
 static void
 kms_base_hub_dispose (GObject * object)
 {
   KmsBaseHub *self = KMS_BASE_HUB (object);
+  GList *ports, *l;
 
   GST_DEBUG_OBJECT (self, "dispose");
 
-  KMS_BASE_HUB_LOCK (self);
-  g_hash_table_remove_all (self->priv->ports);
-  KMS_BASE_HUB_UNLOCK (self);
+  KMS_BASE_HUB_PORTS_WRITE_LOCK (self);
+  /* Stealing transfers the table references to the list */
+  ports = g_hash_table_get_values (self->priv->ports);
+  g_hash_table_steal_all (self->priv->ports);
+  KMS_BASE_HUB_PORTS_WRITE_UNLOCK (self);
+
+  for (l = ports; l != NULL; l = l->next) {
+    KmsBaseHubPortData *port_data = l->data;
+
+    KMS_BASE_HUB_PORT_LOCK (port_data);
+    kms_base_hub_port_data_set_unhandled (port_data);
+    KMS_BASE_HUB_PORT_UNLOCK (port_data);
+  }
+
+  g_list_free_full (ports, kms_base_hub_port_data_unref);
 
   G_OBJECT_CLASS (kms_base_hub_parent_class)->dispose (object);
 }
@@ -796,7 +896,7 @@ kms_base_hub_finalize (GObject * object)
 
   GST_DEBUG_OBJECT (self, "finalize");
 
-  g_rec_mutex_clear (&self->priv->mutex);
+  g_rw_lock_clear (&self->priv->ports_lock);
 
   if (self->priv->ports != NULL) {
     g_hash_table_unref (self->priv->ports);
@@ -873,11 +973,11 @@ kms_base_hub_init (KmsBaseHub * self)
 {
   self->priv = KMS_BASE_HUB_GET_PRIVATE (self);
 
-  g_rec_mutex_init (&self->priv->mutex);
+  g_rw_lock_init (&self->priv->ports_lock);
 
   self->priv->port_count = 0;
-  self->priv->ports = g_hash_table_new_full (g_int_hash, g_int_equal,
-      release_gint, kms_base_hub_port_data_destroy);
+  self->priv->ports = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, kms_base_hub_port_data_unref);
 
   self->priv->pad_added_id = g_signal_connect (G_OBJECT (self),
       "pad-added", G_CALLBACK (hub_pad_added), NULL);
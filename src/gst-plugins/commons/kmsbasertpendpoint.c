@@ -20,6 +20,7 @@
 
 #include <uuid/uuid.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "kms-core-enumtypes.h"
 #include "kms-core-marshal.h"
@@ -27,12 +28,19 @@
 #include "sdpagent/kmssdprtpavpfmediahandler.h"
 #include "kmsremb.h"
 #include "kmsrefstruct.h"
+#include "kmsjitterbuffercontrol.h"
+#include "kmsbundledemux.h"
+#include "kmsfactorycache.h"
 
 #include <gst/rtp/gstrtpdefs.h>
 #include <gst/rtp/gstrtpbuffer.h>
 #include <gst/video/video-event.h>
 #include "kmsbufferlacentymeta.h"
 #include "kmsstats.h"
+#include "kmsvp8layermeta.h"
+#include "kmsptcapstable.h"
+#include "kmsudpbatchconnection.h"
+#include "kmsrtppayloader.h"
 
 #define PLUGIN_NAME "base_rtp_endpoint"
 
@@ -55,20 +63,18 @@ G_DEFINE_TYPE_WITH_CODE (KmsBaseRtpEndpoint, kms_base_rtp_endpoint,
   )                                               \
 )
 
-#define RTCP_DEMUX_PEER "rtcp-demux-peer"
 
 #define RTP_HDR_EXT_ABS_SEND_TIME_URI "http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time"
-#define RTP_HDR_EXT_ABS_SEND_TIME_SIZE 3
 #define RTP_HDR_EXT_ABS_SEND_TIME_ID 3  /* TODO: do it dynamic when needed */
 
 #define JB_INITIAL_LATENCY 0
-#define JB_READY_LATENCY 1500
 
 typedef struct _KmsSSRCStats KmsSSRCStats;
 struct _KmsSSRCStats
 {
   guint ssrc;
   GstElement *jitter_buffer;
+  KmsJitterBufferControl *jb_control;
 };
 
 typedef struct _KmsRTPSessionStats KmsRTPSessionStats;
@@ -105,6 +111,7 @@ struct _KmsBaseRtpEndpointPrivate
   gboolean rtcp_remb;
 
   GHashTable *conns;
+  KmsBundleDemux *bundle_demux;
 
   GstElement *audio_payloader;
   GstElement *video_payloader;
@@ -125,6 +132,10 @@ struct _KmsBaseRtpEndpointPrivate
   guint min_video_send_bw;
   guint max_video_send_bw;
 
+  /* Jitter buffer latency bounds (ms) */
+  guint jb_min_latency;
+  guint jb_max_latency;
+
   /* REMB */
   GstStructure *remb_params;
   KmsRembLocal *rl;
@@ -132,6 +143,9 @@ struct _KmsBaseRtpEndpointPrivate
 
   /* RTP statistics */
   KmsBaseRTPStats stats;
+
+  /* PT -> GstCaps for the negotiated SDP */
+  KmsPtCapsTable *pt_caps;
 };
 
 /* Signals and args */
@@ -154,6 +168,10 @@ static guint obj_signals[LAST_SIGNAL] = { 0 };
 #define MIN_VIDEO_RECV_BW_DEFAULT 0
 #define MIN_VIDEO_SEND_BW_DEFAULT 100
 #define MAX_VIDEO_SEND_BW_DEFAULT 500
+/* Both bounds default to the former fixed latency, so adaptation is only */
+/* enabled for endpoints that lower the minimum */
+#define JB_MIN_LATENCY_DEFAULT 1500
+#define JB_MAX_LATENCY_DEFAULT 1500
 
 enum
 {
@@ -168,6 +186,8 @@ enum
   PROP_CONNECTION_STATE,
   PROP_MEDIA_STATE,
   PROP_REMB_PARAMS,
+  PROP_JB_MIN_LATENCY,
+  PROP_JB_MAX_LATENCY,
   PROP_LAST
 };
 
@@ -242,13 +262,15 @@ connect_payloader_data_new (KmsBaseRtpEndpoint * self, GstElement * payloader,
 }
 
 static KmsSSRCStats *
-ssrc_stats_new (guint ssrc, GstElement * jitter_buffer)
+ssrc_stats_new (guint ssrc, GstElement * jitter_buffer,
+    KmsJitterBufferControl * jb_control)
 {
   KmsSSRCStats *stats;
 
   stats = g_slice_new0 (KmsSSRCStats);
 
   stats->jitter_buffer = gst_object_ref (jitter_buffer);
+  stats->jb_control = kms_jitter_buffer_control_ref (jb_control);
   stats->ssrc = ssrc;
 
   return stats;
@@ -258,6 +280,7 @@ static void
 ssrc_stats_destroy (KmsSSRCStats * stats)
 {
   g_clear_object (&stats->jitter_buffer);
+  kms_jitter_buffer_control_unref (stats->jb_control);
   g_slice_free (KmsSSRCStats, stats);
 }
 
@@ -312,7 +335,7 @@ media_has_remb (const GstSDPMedia * media)
   for (a = 0;; a++) {
     const gchar *attr;
 
-    attr = gst_sdp_media_get_attribute_val_n (media, RTCP_FB, a);
+    attr = sdp_utils_get_attr_map_value_n (media, RTCP_FB, payload, a);
     if (attr == NULL) {
       break;
     }
@@ -338,7 +361,7 @@ media_has_rtcp_nack (const GstSDPMedia * media)
   for (a = 0;; a++) {
     const gchar *attr;
 
-    attr = gst_sdp_media_get_attribute_val_n (media, RTCP_FB, a);
+    attr = sdp_utils_get_attr_map_value_n (media, RTCP_FB, payload, a);
     if (attr == NULL) {
       break;
     }
@@ -380,20 +403,25 @@ kms_base_rtp_endpoint_is_video_rtcp_nack (KmsBaseRtpEndpoint * self)
 
 /* Connection management begin */
 
+/* Plain RTP/RTCP over UDP, read and written in batches with */
+/* recvmmsg/sendmmsg. Subclasses can provide their own transport */
 static KmsIRtpConnection *
 kms_base_rtp_endpoint_create_connection_default (KmsBaseRtpEndpoint * self,
     SdpMediaConfig * mconf, const gchar * name)
 {
-  KmsBaseRtpEndpointClass *klass =
-      KMS_BASE_RTP_ENDPOINT_CLASS (G_OBJECT_GET_CLASS (self));
+  KmsUdpBatchConnection *conn;
+  gboolean use_ipv6;
 
-  if (klass->create_connection ==
-      kms_base_rtp_endpoint_create_connection_default) {
-    GST_WARNING_OBJECT (self, "%s does not reimplement 'create_connection'",
-        G_OBJECT_CLASS_NAME (klass));
+  g_object_get (self, "use-ipv6", &use_ipv6, NULL);
+
+  conn = kms_udp_batch_connection_new (use_ipv6 ? "::" : "0.0.0.0", 0, 0,
+      FALSE);
+  if (conn == NULL) {
+    GST_WARNING_OBJECT (self, "Cannot create UDP connection '%s'", name);
+    return NULL;
   }
 
-  return NULL;
+  return KMS_I_RTP_CONNECTION (conn);
 }
 
 static KmsIRtcpMuxConnection *
@@ -575,6 +603,10 @@ kms_base_rtp_endpoint_create_connection (KmsBaseRtpEndpoint * self,
     }
   }
 
+  if (conn == NULL) {
+    goto end;
+  }
+
   g_hash_table_insert (self->priv->conns, g_strdup (name), conn);
 
   kms_base_rtp_endpoint_set_connection_stats (self, conn);
@@ -729,6 +761,32 @@ kms_base_rtp_endpoint_configure_rtp_media (KmsBaseRtpEndpoint * self,
   return TRUE;
 }
 
+static void
+kms_base_rtp_endpoint_set_udp_batch_local_info (KmsBaseRtpEndpoint * self,
+    KmsUdpBatchConnection * conn, SdpMediaConfig * mconf)
+{
+  GstSDPMedia *media = kms_sdp_media_config_get_sdp_media (mconf);
+  guint16 rtp_port, rtcp_port;
+
+  if (gst_sdp_media_get_port (media) == 0) {
+    /* Rejected media */
+    return;
+  }
+
+  rtp_port = kms_udp_batch_connection_get_rtp_port (conn);
+  rtcp_port = kms_udp_batch_connection_get_rtcp_port (conn);
+
+  gst_sdp_media_set_port_info (media, rtp_port, 1);
+
+  /* RTCP is expected on the next port unless told otherwise (RFC 3605) */
+  if (rtcp_port != rtp_port + 1) {
+    gchar *str = g_strdup_printf ("%u", rtcp_port);
+
+    gst_sdp_media_add_attribute (media, "rtcp", str);
+    g_free (str);
+  }
+}
+
 static gboolean
 kms_base_rtp_endpoint_configure_media (KmsBaseSdpEndpoint *
     base_sdp_endpoint, SdpMediaConfig * mconf)
@@ -741,11 +799,161 @@ kms_base_rtp_endpoint_configure_media (KmsBaseSdpEndpoint *
     return FALSE;
   }
 
+  if (KMS_IS_UDP_BATCH_CONNECTION (conn)) {
+    kms_base_rtp_endpoint_set_udp_batch_local_info (self,
+        KMS_UDP_BATCH_CONNECTION (conn), mconf);
+  }
+
   return kms_base_rtp_endpoint_configure_rtp_media (self, mconf);
 }
 
 /* Configure media SDP end */
 
+/* Payload type caps begin */
+static const gchar *
+get_caps_codec_name (const gchar * codec_name)
+{
+  if (g_ascii_strcasecmp (OPUS_ENCONDING_NAME, codec_name) == 0) {
+    return "X-GST-OPUS-DRAFT-SPITTKA-00";
+  }
+  if (g_ascii_strcasecmp (VP8_ENCONDING_NAME, codec_name) == 0) {
+    return "VP8-DRAFT-IETF-01";
+  }
+
+  return codec_name;
+}
+
+static GstCaps *
+kms_base_rtp_endpoint_get_caps_from_rtpmap (const gchar * media,
+    const gchar * pt, const gchar * rtpmap)
+{
+  GstCaps *caps = NULL;
+  gchar **tokens;
+
+  if (rtpmap == NULL) {
+    GST_WARNING ("rtpmap is NULL for media '%s'", media);
+    return NULL;
+  }
+
+  tokens = g_strsplit (rtpmap, "/", 3);
+
+  if (tokens[0] == NULL || tokens[1] == NULL) {
+    goto end;
+  }
+
+  caps = gst_caps_new_simple ("application/x-rtp",
+      "media", G_TYPE_STRING, media,
+      "payload", G_TYPE_INT, atoi (pt),
+      "clock-rate", G_TYPE_INT, atoi (tokens[1]),
+      "encoding-name", G_TYPE_STRING, get_caps_codec_name (tokens[0]), NULL);
+
+end:
+  g_strfreev (tokens);
+
+  return caps;
+}
+
+static void
+complete_caps_with_fb (GstCaps * caps, SdpMediaIndex * index,
+    const gchar * payload)
+{
+  gboolean fir, pli;
+  guint a;
+
+  fir = pli = FALSE;
+
+  for (a = 0;; a++) {
+    const gchar *attr;
+
+    attr = sdp_utils_media_index_get_attr_map_value (index, RTCP_FB, payload,
+        a);
+    if (attr == NULL) {
+      break;
+    }
+
+    if (rtcp_fb_attr_check_type (attr, payload, RTCP_FB_FIR)) {
+      fir = TRUE;
+      continue;
+    }
+
+    if (rtcp_fb_attr_check_type (attr, payload, RTCP_FB_PLI)) {
+      pli = TRUE;
+      continue;
+    }
+  }
+
+  if (fir) {
+    gst_caps_set_simple (caps, "rtcp-fb-ccm-fir", G_TYPE_BOOLEAN, fir, NULL);
+  }
+  if (pli) {
+    gst_caps_set_simple (caps, "rtcp-fb-nack-pli", G_TYPE_BOOLEAN, pli, NULL);
+  }
+}
+
+static GHashTable *
+kms_base_rtp_endpoint_create_pt_caps (SdpMessageContext * negotiated_ctx)
+{
+  GHashTable *pt_caps;
+  const GSList *item;
+
+  pt_caps = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      (GDestroyNotify) gst_caps_unref);
+
+  item = kms_sdp_message_context_get_medias (negotiated_ctx);
+  for (; item != NULL; item = g_slist_next (item)) {
+    SdpMediaConfig *mconf = item->data;
+    GstSDPMedia *media = kms_sdp_media_config_get_sdp_media (mconf);
+    const gchar *media_str = gst_sdp_media_get_media (media);
+    SdpMediaIndex *index;
+    guint j, f_len;
+
+    index = sdp_utils_media_index_new (media);
+
+    f_len = gst_sdp_media_formats_len (media);
+    for (j = 0; j < f_len; j++) {
+      const gchar *payload = gst_sdp_media_get_format (media, j);
+      gpointer key = GUINT_TO_POINTER (atoi (payload));
+      const gchar *rtpmap;
+      GstCaps *caps;
+
+      /* First media using this payload type wins */
+      if (g_hash_table_contains (pt_caps, key)) {
+        continue;
+      }
+
+      rtpmap = sdp_utils_media_index_get_rtpmap (index, payload);
+      caps =
+          kms_base_rtp_endpoint_get_caps_from_rtpmap (media_str, payload,
+          rtpmap);
+
+      if (caps != NULL) {
+        complete_caps_with_fb (caps, index, payload);
+        g_hash_table_insert (pt_caps, key, caps);
+      }
+    }
+
+    sdp_utils_media_index_free (index);
+  }
+
+  return pt_caps;
+}
+
+static void
+kms_base_rtp_endpoint_update_pt_caps (KmsBaseRtpEndpoint * self,
+    SdpMessageContext * negotiated_ctx)
+{
+  GHashTable *pt_caps;
+
+  pt_caps = kms_base_rtp_endpoint_create_pt_caps (negotiated_ctx);
+
+  GST_DEBUG_OBJECT (self, "Caps table created for %u payload types",
+      g_hash_table_size (pt_caps));
+
+  kms_pt_caps_table_set (self->priv->pt_caps, pt_caps);
+}
+
+/* Payload type caps end */
+
 /* Start Transport Send begin */
 
 static void
@@ -792,60 +1000,11 @@ kms_base_rtp_endpoint_create_remb_managers (KmsBaseRtpEndpoint * self)
   GST_DEBUG_OBJECT (self, "REMB managers added");
 }
 
-static gboolean
-ssrcs_are_mapped (GstElement * ssrcdemux,
-    guint32 local_ssrc, guint32 remote_ssrc)
-{
-  GstElement *rtcpdemux =
-      g_object_get_data (G_OBJECT (ssrcdemux), RTCP_DEMUX_PEER);
-  guint local_ssrc_pair;
-
-  g_signal_emit_by_name (rtcpdemux, "get-local-rr-ssrc-pair", remote_ssrc,
-      &local_ssrc_pair);
-
-  return ((local_ssrc != 0) && (local_ssrc_pair == local_ssrc));
-}
-
-static void
-rtp_ssrc_demux_new_ssrc_pad (GstElement * ssrcdemux, guint ssrc, GstPad * pad,
-    KmsBaseRtpEndpoint * self)
-{
-  const gchar *rtp_pad_name = GST_OBJECT_NAME (pad);
-  gchar *rtcp_pad_name;
-  GstElement *rtpbin = self->priv->rtpbin;
-
-  GST_DEBUG_OBJECT (self, "pad: %" GST_PTR_FORMAT " ssrc: %" G_GUINT32_FORMAT,
-      pad, ssrc);
-  rtcp_pad_name = g_strconcat ("rtcp_", rtp_pad_name, NULL);
-
-  KMS_ELEMENT_LOCK (self);
-
-  if ((self->priv->remote_audio_ssrc == ssrc) ||
-      ssrcs_are_mapped (ssrcdemux, self->priv->local_audio_ssrc, ssrc)) {
-    gst_element_link_pads (ssrcdemux, rtp_pad_name, rtpbin,
-        AUDIO_RTPBIN_RECV_RTP_SINK);
-    gst_element_link_pads (ssrcdemux, rtcp_pad_name, rtpbin,
-        AUDIO_RTPBIN_RECV_RTCP_SINK);
-  } else if (self->priv->remote_video_ssrc == ssrc
-      || ssrcs_are_mapped (ssrcdemux, self->priv->local_video_ssrc, ssrc)) {
-    gst_element_link_pads (ssrcdemux, rtp_pad_name, rtpbin,
-        VIDEO_RTPBIN_RECV_RTP_SINK);
-    gst_element_link_pads (ssrcdemux, rtcp_pad_name, rtpbin,
-        VIDEO_RTPBIN_RECV_RTCP_SINK);
-  }
-
-  KMS_ELEMENT_UNLOCK (self);
-
-  g_free (rtcp_pad_name);
-}
-
 static void
 kms_base_rtp_endpoint_add_bundle_connection (KmsBaseRtpEndpoint * self,
     KmsIRtpConnection * conn, gboolean active)
 {
   gboolean added;
-  GstElement *ssrcdemux;
-  GstElement *rtcpdemux;        /* FIXME: Useful for local and remote ssrcs mapping */
   GstPad *src, *sink;
 
   if (self->priv->audio_added || self->priv->video_added) {
@@ -858,116 +1017,82 @@ kms_base_rtp_endpoint_add_bundle_connection (KmsBaseRtpEndpoint * self,
     kms_i_rtp_connection_add (conn, GST_BIN (self), active);
   }
 
-  ssrcdemux = gst_element_factory_make ("rtpssrcdemux", NULL);
-  rtcpdemux = gst_element_factory_make ("rtcpdemux", NULL);
-
-  g_object_set_data_full (G_OBJECT (ssrcdemux), RTCP_DEMUX_PEER,
-      g_object_ref (rtcpdemux), g_object_unref);
-  g_signal_connect (ssrcdemux, "new-ssrc-pad",
-      G_CALLBACK (rtp_ssrc_demux_new_ssrc_pad), self);
+  self->priv->bundle_demux = kms_bundle_demux_new (GST_BIN (self));
 
   kms_i_rtp_connection_sink_sync_state_with_parent (conn);
-  gst_bin_add_many (GST_BIN (self), ssrcdemux, rtcpdemux, NULL);
 
   /* RTP */
   src = kms_i_rtp_connection_request_rtp_src (conn);
-  sink = gst_element_get_static_pad (ssrcdemux, "sink");
+  sink = kms_bundle_demux_get_rtp_sink (self->priv->bundle_demux);
   gst_pad_link (src, sink);
   g_object_unref (src);
   g_object_unref (sink);
 
   /* RTCP */
   src = kms_i_rtp_connection_request_rtcp_src (conn);
-  sink = gst_element_get_static_pad (rtcpdemux, "sink");
+  sink = kms_bundle_demux_get_rtcp_sink (self->priv->bundle_demux);
   gst_pad_link (src, sink);
   g_object_unref (src);
   g_object_unref (sink);
-  gst_element_link_pads (rtcpdemux, "rtcp_src", ssrcdemux, "rtcp_sink");
 
-  gst_element_sync_state_with_parent_target_state (ssrcdemux);
-  gst_element_sync_state_with_parent_target_state (rtcpdemux);
+  kms_bundle_demux_sync_state_with_parent (self->priv->bundle_demux);
 
   kms_i_rtp_connection_src_sync_state_with_parent (conn);
 }
 
-static void
-kms_base_rtp_endpoint_write_rtp_hdr_ext (GstPad * pad, GstBuffer * buffer,
-    gint id)
-{
-  GstRTPBuffer rtp = { NULL, };
-  guint8 *data;
-  GstClockTime current_time, ms;
-  guint value;
-
-  if (!gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp)) {
-    GST_WARNING_OBJECT (pad, "Can not map RTP buffer for writting");
-    return;
-  }
-
-  current_time = kms_utils_get_time_nsecs ();
-  ms = current_time / 1000000;
-  value = (((ms << 18) / 1000) & 0x00ffffff);
-
-  data = g_malloc0 (RTP_HDR_EXT_ABS_SEND_TIME_SIZE);
-  data[0] = (guint8) (value >> 16);
-  data[1] = (guint8) (value >> 8);
-  data[2] = (guint8) (value);
-
-  /* TODO: check if header exists and in this case replace the value */
-  if (!gst_rtp_buffer_add_extension_onebyte_header (&rtp,
-          id, data, RTP_HDR_EXT_ABS_SEND_TIME_SIZE)) {
-    GST_WARNING_OBJECT (pad, "RTP hdrext abs-send-time not added");
-  }
-
-  g_free (data);
-  gst_rtp_buffer_unmap (&rtp);
-}
-
-typedef struct _HdrExtData
-{
-  GstPad *pad;
-  gint abs_send_time_id;
-} HdrExtData;
-
 static gboolean
-kms_base_rtp_endpoint_write_rtp_hdr_ext_bufflist (GstBuffer ** buf, guint idx,
-    HdrExtData * data)
+kms_base_rtp_endpoint_add_bundle_ssrc (guint ssrc, gpointer user_data)
 {
-  *buf = gst_buffer_make_writable (*buf);
-  kms_base_rtp_endpoint_write_rtp_hdr_ext (data->pad, *buf,
-      data->abs_send_time_id);
+  gpointer *data = user_data;
+
+  kms_bundle_demux_add_ssrc (data[0], ssrc, GPOINTER_TO_UINT (data[1]));
 
   return TRUE;
 }
 
-static GstPadProbeReturn
-kms_base_rtp_endpoint_write_rtp_hdr_ext_probe (GstPad * pad,
-    GstPadProbeInfo * info, gpointer gp)
+static void
+kms_base_rtp_endpoint_route_bundle_session (KmsBaseRtpEndpoint * self,
+    const gchar * rtp_session, GstSDPMedia * remote_media)
 {
-  gint id = GPOINTER_TO_INT (gp);
-
-  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
-    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstElement *rtpbin = self->priv->rtpbin;
+  GstPad *rtp_sink, *rtcp_sink;
+  guint session, local_ssrc;
+  gpointer data[2];
+  gchar *str;
 
-    buffer = gst_buffer_make_writable (buffer);
-    kms_base_rtp_endpoint_write_rtp_hdr_ext (pad, buffer, id);
-    GST_PAD_PROBE_INFO_DATA (info) = buffer;
-  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
-    GstBufferList *bufflist = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
-    HdrExtData data;
+  session = atoi (rtp_session);
 
-    data.pad = pad;
-    data.abs_send_time_id = id;
+  /* Local SSRCs are written under the element lock while building SDPs */
+  KMS_ELEMENT_LOCK (self);
+  local_ssrc = (session == AUDIO_RTP_SESSION) ?
+      self->priv->local_audio_ssrc : self->priv->local_video_ssrc;
+  KMS_ELEMENT_UNLOCK (self);
 
-    bufflist = gst_buffer_list_make_writable (bufflist);
-    gst_buffer_list_foreach (bufflist,
-        (GstBufferListFunc) kms_base_rtp_endpoint_write_rtp_hdr_ext_bufflist,
-        &data);
+  str = g_strdup_printf ("%s%s", RTPBIN_RECV_RTP_SINK, rtp_session);
+  rtp_sink = gst_element_get_static_pad (rtpbin, str);
+  if (!rtp_sink) {
+    rtp_sink = gst_element_get_request_pad (rtpbin, str);
+  }
+  g_free (str);
 
-    GST_PAD_PROBE_INFO_DATA (info) = bufflist;
+  str = g_strdup_printf ("%s%s", RTPBIN_RECV_RTCP_SINK, rtp_session);
+  rtcp_sink = gst_element_get_static_pad (rtpbin, str);
+  if (!rtcp_sink) {
+    rtcp_sink = gst_element_get_request_pad (rtpbin, str);
   }
+  g_free (str);
+
+  kms_bundle_demux_add_session (self->priv->bundle_demux, session, rtp_sink,
+      rtcp_sink, local_ssrc);
+
+  g_object_unref (rtp_sink);
+  g_object_unref (rtcp_sink);
 
-  return GST_PAD_PROBE_OK;
+  /* Pre-link every SSRC announced for this media */
+  data[0] = self->priv->bundle_demux;
+  data[1] = GUINT_TO_POINTER (session);
+  sdp_utils_media_for_each_ssrc (remote_media,
+      kms_base_rtp_endpoint_add_bundle_ssrc, data);
 }
 
 static void
@@ -987,10 +1112,7 @@ kms_base_rtp_endpoint_add_connection_sink (KmsBaseRtpEndpoint * self,
     GST_DEBUG_OBJECT (self,
         "Add probe for abs-send-time management (id: %d, %" GST_PTR_FORMAT ").",
         abs_send_time_id, src);
-    gst_pad_add_probe (src,
-        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
-        kms_base_rtp_endpoint_write_rtp_hdr_ext_probe,
-        GINT_TO_POINTER (abs_send_time_id), NULL);
+    kms_utils_add_abs_send_time_probe (src, abs_send_time_id);
   }
 
   g_object_unref (src);
@@ -1118,7 +1240,8 @@ get_abs_send_time_id (SdpMediaConfig * mconf)
 
 static gboolean
 kms_base_rtp_endpoint_add_connection_for_session (KmsBaseRtpEndpoint * self,
-    const gchar * rtp_session, SdpMediaConfig * mconf, gboolean active)
+    const gchar * rtp_session, SdpMediaConfig * mconf,
+    GstSDPMedia * remote_media, gboolean active)
 {
   KmsIRtpConnection *conn;
   SdpMediaGroup *group = kms_sdp_media_config_get_group (mconf);
@@ -1133,6 +1256,8 @@ kms_base_rtp_endpoint_add_connection_for_session (KmsBaseRtpEndpoint * self,
 
   if (group != NULL) {          /* bundle */
     kms_base_rtp_endpoint_add_bundle_connection (self, conn, active);
+    kms_base_rtp_endpoint_route_bundle_session (self, rtp_session,
+        remote_media);
     kms_base_rtp_endpoint_add_connection_sink (self, conn, rtp_session,
         abs_send_time_id);
   } else if (kms_sdp_media_config_is_rtcp_mux (mconf)) {
@@ -1225,7 +1350,7 @@ kms_base_rtp_endpoint_configure_connection (KmsBaseRtpEndpoint * self,
   active = sdp_utils_media_is_active (neg_media, offerer);
 
   added = kms_base_rtp_endpoint_add_connection_for_session (self,
-      rtp_session_str, neg_mconf, active);
+      rtp_session_str, neg_mconf, remote_media, active);
 
   if (g_strcmp0 (rtp_session_str, AUDIO_RTP_SESSION_STR) == 0) {
     self->priv->audio_added = added;
@@ -1302,6 +1427,42 @@ kms_base_rtp_endpoint_check_conn_status (KmsBaseRtpEndpoint * self)
   kms_base_rtp_endpoint_update_conn_state (self);
 }
 
+static void
+kms_base_rtp_endpoint_set_udp_batch_remote_info (KmsBaseRtpEndpoint * self,
+    SdpMediaConfig * neg_mconf, const GstSDPMessage * remote_sdp,
+    const GstSDPMedia * remote_media)
+{
+  const GstSDPConnection *sdp_conn;
+  KmsIRtpConnection *conn;
+  const gchar *rtcp;
+  guint rtp_port;
+  gint rtcp_port;
+
+  conn = kms_base_rtp_endpoint_get_connection (self, neg_mconf);
+  if (conn == NULL || !KMS_IS_UDP_BATCH_CONNECTION (conn)) {
+    return;
+  }
+
+  if (gst_sdp_media_connections_len (remote_media) > 0) {
+    sdp_conn = gst_sdp_media_get_connection (remote_media, 0);
+  } else {
+    sdp_conn = gst_sdp_message_get_connection (remote_sdp);
+  }
+
+  if (sdp_conn == NULL || sdp_conn->address == NULL) {
+    GST_WARNING_OBJECT (self, "No remote address for media %d",
+        kms_sdp_media_config_get_id (neg_mconf));
+    return;
+  }
+
+  rtp_port = gst_sdp_media_get_port (remote_media);
+  rtcp = gst_sdp_media_get_attribute_val (remote_media, "rtcp");
+  rtcp_port = rtcp != NULL ? atoi (rtcp) : rtp_port + 1;
+
+  kms_udp_batch_connection_set_remote_info (KMS_UDP_BATCH_CONNECTION (conn),
+      sdp_conn->address, rtp_port, rtcp_port);
+}
+
 static void
 kms_base_rtp_endpoint_start_transport_send (KmsBaseSdpEndpoint *
     base_sdp_endpoint, gboolean offerer)
@@ -1314,6 +1475,7 @@ kms_base_rtp_endpoint_start_transport_send (KmsBaseSdpEndpoint *
   GSList *item = kms_sdp_message_context_get_medias (neg_ctx);
   GSList *remote_media_list = kms_sdp_message_context_get_medias (remote_ctx);
 
+  kms_base_rtp_endpoint_update_pt_caps (self, neg_ctx);
   kms_base_rtp_endpoint_check_conn_status (self);
 
   for (; item != NULL; item = g_slist_next (item)) {
@@ -1336,7 +1498,12 @@ kms_base_rtp_endpoint_start_transport_send (KmsBaseSdpEndpoint *
             remote_mconf, offerer)) {
       GST_WARNING_OBJECT (self, "Cannot configure connection for media %d.",
           mid);
+      continue;
     }
+
+    kms_base_rtp_endpoint_set_udp_batch_remote_info (self, neg_mconf,
+        kms_sdp_message_context_get_sdp_message (remote_ctx),
+        kms_sdp_media_config_get_sdp_media (remote_mconf));
   }
 }
 
@@ -1374,112 +1541,16 @@ kms_base_rtp_endpoint_request_local_key_frame (KmsBaseRtpEndpoint * self)
 
 /* Connect input elements begin */
 /* Payloading configuration begin */
-static const gchar *
-get_caps_codec_name (const gchar * codec_name)
-{
-  if (g_ascii_strcasecmp (OPUS_ENCONDING_NAME, codec_name) == 0) {
-    return "X-GST-OPUS-DRAFT-SPITTKA-00";
-  }
-  if (g_ascii_strcasecmp (VP8_ENCONDING_NAME, codec_name) == 0) {
-    return "VP8-DRAFT-IETF-01";
-  }
-
-  return codec_name;
-}
-
-static GstCaps *
-kms_base_rtp_endpoint_get_caps_from_rtpmap (const gchar * media,
-    const gchar * pt, const gchar * rtpmap)
-{
-  GstCaps *caps = NULL;
-  gchar **tokens;
-
-  if (rtpmap == NULL) {
-    GST_WARNING ("rtpmap is NULL for media '%s'", media);
-    return NULL;
-  }
-
-  tokens = g_strsplit (rtpmap, "/", 3);
-
-  if (tokens[0] == NULL || tokens[1] == NULL) {
-    goto end;
-  }
-
-  caps = gst_caps_new_simple ("application/x-rtp",
-      "media", G_TYPE_STRING, media,
-      "payload", G_TYPE_INT, atoi (pt),
-      "clock-rate", G_TYPE_INT, atoi (tokens[1]),
-      "encoding-name", G_TYPE_STRING, get_caps_codec_name (tokens[0]), NULL);
-
-end:
-  g_strfreev (tokens);
-
-  return caps;
-}
-
-static GstElement *
-gst_base_rtp_get_payloader_for_caps (GstCaps * caps)
-{
-  GstElementFactory *factory;
-  GstElement *payloader = NULL;
-  GList *payloader_list, *filtered_list;
-  GParamSpec *pspec;
-
-  payloader_list =
-      gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_PAYLOADER,
-      GST_RANK_NONE);
-  filtered_list =
-      gst_element_factory_list_filter (payloader_list, caps, GST_PAD_SRC,
-      FALSE);
-
-  if (filtered_list == NULL) {
-    goto end;
-  }
-
-  factory = GST_ELEMENT_FACTORY (filtered_list->data);
-  if (factory == NULL) {
-    goto end;
-  }
-
-  payloader = gst_element_factory_create (factory, NULL);
-
-  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (payloader), "pt");
-  if (pspec != NULL && G_PARAM_SPEC_VALUE_TYPE (pspec) == G_TYPE_UINT) {
-    GstStructure *st = gst_caps_get_structure (caps, 0);
-    gint payload;
-
-    if (gst_structure_get_int (st, "payload", &payload)) {
-      g_object_set (payloader, "pt", payload, NULL);
-    }
-  }
-
-  pspec =
-      g_object_class_find_property (G_OBJECT_GET_CLASS (payloader),
-      "config-interval");
-  if (pspec != NULL && G_PARAM_SPEC_VALUE_TYPE (pspec) == G_TYPE_UINT) {
-    g_object_set (payloader, "config-interval", 1, NULL);
-  }
-
-end:
-  gst_plugin_feature_list_free (filtered_list);
-  gst_plugin_feature_list_free (payloader_list);
-
-  return payloader;
-}
-
 static GstElement *
 gst_base_rtp_get_depayloader_for_caps (GstCaps * caps)
 {
   GstElementFactory *factory;
   GstElement *depayloader = NULL;
-  GList *payloader_list, *filtered_list, *l;
+  GList *filtered_list, *l;
 
-  payloader_list =
-      gst_element_factory_list_get_elements
-      (GST_ELEMENT_FACTORY_TYPE_DEPAYLOADER, GST_RANK_NONE);
   filtered_list =
-      gst_element_factory_list_filter (payloader_list, caps, GST_PAD_SINK,
-      FALSE);
+      kms_factory_cache_filter (GST_ELEMENT_FACTORY_TYPE_DEPAYLOADER, caps,
+      GST_PAD_SINK);
 
   if (filtered_list == NULL) {
     goto end;
@@ -1506,7 +1577,6 @@ gst_base_rtp_get_depayloader_for_caps (GstCaps * caps)
 
 end:
   gst_plugin_feature_list_free (filtered_list);
-  gst_plugin_feature_list_free (payloader_list);
 
   return depayloader;
 }
@@ -1609,15 +1679,20 @@ kms_base_rtp_endpoint_set_media_payloader (KmsBaseRtpEndpoint * self,
   const gchar *rtpbin_pad_name;
   KmsElementPadType type;
   gboolean *connected_flag;
+  SdpMediaIndex *index;
+
+  index = sdp_utils_media_index_new (media);
 
   f_len = gst_sdp_media_formats_len (media);
   for (j = 0; j < f_len && caps == NULL; j++) {
     const gchar *pt = gst_sdp_media_get_format (media, j);
-    const gchar *rtpmap = sdp_utils_sdp_media_get_rtpmap (media, pt);
+    const gchar *rtpmap = sdp_utils_media_index_get_rtpmap (index, pt);
 
     caps = kms_base_rtp_endpoint_get_caps_from_rtpmap (media_str, pt, rtpmap);
   }
 
+  sdp_utils_media_index_free (index);
+
   if (caps == NULL) {
     GST_WARNING_OBJECT (self, "Caps not found for media '%s'", media_str);
     return;
@@ -1625,7 +1700,7 @@ kms_base_rtp_endpoint_set_media_payloader (KmsBaseRtpEndpoint * self,
 
   GST_DEBUG_OBJECT (self, "Found caps: %" GST_PTR_FORMAT, caps);
 
-  payloader = gst_base_rtp_get_payloader_for_caps (caps);
+  payloader = kms_rtp_payloader_new_for_caps (caps);
   gst_caps_unref (caps);
 
   if (payloader == NULL) {
@@ -1694,85 +1769,10 @@ kms_base_rtp_endpoint_connect_input_elements (KmsBaseSdpEndpoint *
 
 /* Connect input elements end */
 
-static void
-complete_caps_with_fb (GstCaps * caps, const GstSDPMedia * media,
-    const gchar * payload)
-{
-  gboolean fir, pli;
-  guint a;
-
-  fir = pli = FALSE;
-
-  for (a = 0;; a++) {
-    const gchar *attr;
-
-    attr = gst_sdp_media_get_attribute_val_n (media, RTCP_FB, a);
-    if (attr == NULL) {
-      break;
-    }
-
-    if (rtcp_fb_attr_check_type (attr, payload, RTCP_FB_FIR)) {
-      fir = TRUE;
-      continue;
-    }
-
-    if (rtcp_fb_attr_check_type (attr, payload, RTCP_FB_PLI)) {
-      pli = TRUE;
-      continue;
-    }
-  }
-
-  if (fir) {
-    gst_caps_set_simple (caps, "rtcp-fb-ccm-fir", G_TYPE_BOOLEAN, fir, NULL);
-  }
-  if (pli) {
-    gst_caps_set_simple (caps, "rtcp-fb-nack-pli", G_TYPE_BOOLEAN, pli, NULL);
-  }
-}
-
 static GstCaps *
 kms_base_rtp_endpoint_get_caps_for_pt (KmsBaseRtpEndpoint * self, guint pt)
 {
-  KmsBaseSdpEndpoint *base_endpoint = KMS_BASE_SDP_ENDPOINT (self);
-  SdpMessageContext *negotiated_ctx;
-  const GSList *item;
-
-  negotiated_ctx = kms_base_sdp_endpoint_get_negotiated_sdp_ctx (base_endpoint);
-  if (negotiated_ctx == NULL) {
-    GST_WARNING_OBJECT (self, "Negotiation ctx not set");
-    return NULL;
-  }
-
-  item = kms_sdp_message_context_get_medias (negotiated_ctx);
-  for (; item != NULL; item = g_slist_next (item)) {
-    SdpMediaConfig *mconf = item->data;
-    GstSDPMedia *media = kms_sdp_media_config_get_sdp_media (mconf);
-    const gchar *media_str = gst_sdp_media_get_media (media);
-    const gchar *rtpmap;
-    guint j, f_len;
-
-    f_len = gst_sdp_media_formats_len (media);
-    for (j = 0; j < f_len; j++) {
-      GstCaps *caps;
-      const gchar *payload = gst_sdp_media_get_format (media, j);
-
-      if (atoi (payload) != pt) {
-        continue;
-      }
-
-      rtpmap = sdp_utils_sdp_media_get_rtpmap (media, payload);
-      caps =
-          kms_base_rtp_endpoint_get_caps_from_rtpmap (media_str, payload,
-          rtpmap);
-
-      if (caps != NULL) {
-        complete_caps_with_fb (caps, media, payload);
-        return caps;
-      }
-    }
-  }
-
-  return NULL;
+  return kms_pt_caps_table_get_caps (self->priv->pt_caps, pt);
 }
 
 static GstCaps *
@@ -1822,12 +1822,38 @@ kms_base_rtp_endpoint_update_stats (KmsBaseRtpEndpoint * self,
   g_mutex_unlock (&self->priv->stats.mutex);
 }
 
+static gboolean
+kms_base_rtp_endpoint_caps_are_vp8 (GstCaps * caps)
+{
+  const gchar *encoding_name;
+  GstStructure *st;
+
+  if (caps == NULL || gst_caps_get_size (caps) == 0) {
+    return FALSE;
+  }
+
+  st = gst_caps_get_structure (caps, 0);
+  encoding_name = gst_structure_get_string (st, "encoding-name");
+
+  return encoding_name != NULL &&
+      g_ascii_strncasecmp (encoding_name, VP8_ENCONDING_NAME,
+      strlen (VP8_ENCONDING_NAME)) == 0;
+}
+
+/* Keep the temporal layer of each frame once the descriptor is gone */
+static void
+kms_base_rtp_endpoint_tag_vp8_layers (KmsBaseRtpEndpoint * self,
+    GstElement * depayloader)
+{
+  kms_vp8_layer_meta_watch_depayloader (depayloader);
+}
+
 static void
 kms_base_rtp_endpoint_rtpbin_pad_added (GstElement * rtpbin, GstPad * pad,
     KmsBaseRtpEndpoint * self)
 {
   GstElement *agnostic, *depayloader;
-  gboolean added = TRUE;
+  gboolean added = TRUE, vp8;
   KmsMediaType media;
   GstCaps *caps;
 
@@ -1855,11 +1881,17 @@ kms_base_rtp_endpoint_rtpbin_pad_added (GstElement * rtpbin, GstPad * pad,
       " with caps %" GST_PTR_FORMAT, pad, agnostic, caps);
 
   depayloader = gst_base_rtp_get_depayloader_for_caps (caps);
+  vp8 = kms_base_rtp_endpoint_caps_are_vp8 (caps);
   gst_caps_unref (caps);
 
   if (depayloader != NULL) {
     GST_DEBUG_OBJECT (self, "Found depayloader %" GST_PTR_FORMAT, depayloader);
     kms_base_rtp_endpoint_update_stats (self, depayloader, media);
+
+    if (vp8) {
+      kms_base_rtp_endpoint_tag_vp8_layers (self, depayloader);
+    }
+
     gst_bin_add (GST_BIN (self), depayloader);
     gst_element_link_pads (depayloader, "src", agnostic, "sink");
     gst_element_link_pads (rtpbin, GST_OBJECT_NAME (pad), depayloader, "sink");
@@ -1885,15 +1917,21 @@ end:
   }
 }
 
-static GstPadProbeReturn
-kms_base_rtp_endpoint_change_latency_probe (GstPad * pad,
-    GstPadProbeInfo * info, gpointer gp)
+/* Must be called with the element lock held. Min and max are set */
+/* independently, so they are only validated as a pair here, making */
+/* the result independent of the order the properties are set in    */
+static void
+kms_base_rtp_endpoint_get_jitter_buffer_bounds (KmsBaseRtpEndpoint * self,
+    guint * min_latency, guint * max_latency)
 {
-  GstElement *jitterbuffer = GST_PAD_PARENT (pad);
-
-  g_object_set (jitterbuffer, "latency", JB_READY_LATENCY, NULL);
+  *min_latency = self->priv->jb_min_latency;
+  *max_latency = self->priv->jb_max_latency;
 
-  return GST_PAD_PROBE_REMOVE;
+  if (*max_latency < *min_latency) {
+    GST_WARNING_OBJECT (self, "Jitter buffer max latency %u lower than min "
+        "latency %u, using min", *max_latency, *min_latency);
+    *max_latency = *min_latency;
+  }
 }
 
 static void
@@ -1901,18 +1939,30 @@ kms_base_rtp_endpoint_rtpbin_new_jitterbuffer (GstElement * rtpbin,
     GstElement * jitterbuffer,
     guint session, guint ssrc, KmsBaseRtpEndpoint * self)
 {
+  KmsJitterBufferControl *jb_control;
   KmsRTPSessionStats *rtp_stats;
   KmsSSRCStats *ssrc_stats;
-  GstPad *src_pad;
+  gboolean rtcp_nack = FALSE;
+  guint min_latency, max_latency;
 
   g_object_set (jitterbuffer, "mode", 4 /* synced */ ,
       "latency", JB_INITIAL_LATENCY, NULL);
 
-  src_pad = gst_element_get_static_pad (jitterbuffer, "src");
-  gst_pad_add_probe (src_pad,
-      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
-      kms_base_rtp_endpoint_change_latency_probe, NULL, NULL);
-  g_object_unref (src_pad);
+  if (session == VIDEO_RTP_SESSION) {
+    rtcp_nack = kms_base_rtp_endpoint_is_video_rtcp_nack (self);
+
+    g_object_set (jitterbuffer, "do-lost", TRUE,
+        "do-retransmission", rtcp_nack, "rtx-next-seqnum", FALSE, NULL);
+  }
+
+  KMS_ELEMENT_LOCK (self);
+  kms_base_rtp_endpoint_get_jitter_buffer_bounds (self, &min_latency,
+      &max_latency);
+  KMS_ELEMENT_UNLOCK (self);
+
+  /* Latency stays at JB_INITIAL_LATENCY until the first buffer arrives */
+  jb_control = kms_jitter_buffer_control_new (jitterbuffer, min_latency,
+      max_latency, rtcp_nack);
 
   g_mutex_lock (&self->priv->stats.mutex);
 
@@ -1921,7 +1971,7 @@ kms_base_rtp_endpoint_rtpbin_new_jitterbuffer (GstElement * rtpbin,
       GUINT_TO_POINTER (session));
 
   if (rtp_stats != NULL) {
-    ssrc_stats = ssrc_stats_new (ssrc, jitterbuffer);
+    ssrc_stats = ssrc_stats_new (ssrc, jitterbuffer, jb_control);
     rtp_stats->ssrcs = g_slist_prepend (rtp_stats->ssrcs, ssrc_stats);
   } else {
     GST_ERROR_OBJECT (self, "Session %u exists for SSRC %u", session, ssrc);
@@ -1929,12 +1979,32 @@ kms_base_rtp_endpoint_rtpbin_new_jitterbuffer (GstElement * rtpbin,
 
   g_mutex_unlock (&self->priv->stats.mutex);
 
-  if (session == VIDEO_RTP_SESSION) {
-    gboolean rtcp_nack = kms_base_rtp_endpoint_is_video_rtcp_nack (self);
+  kms_jitter_buffer_control_unref (jb_control);
+}
 
-    g_object_set (jitterbuffer, "do-lost", TRUE,
-        "do-retransmission", rtcp_nack, "rtx-next-seqnum", FALSE, NULL);
+static void
+kms_base_rtp_endpoint_update_jitter_buffer_bounds (KmsBaseRtpEndpoint * self,
+    guint min_latency, guint max_latency)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_mutex_lock (&self->priv->stats.mutex);
+
+  g_hash_table_iter_init (&iter, self->priv->stats.rtp_stats);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    KmsRTPSessionStats *rtp_stats = value;
+    GSList *e;
+
+    for (e = rtp_stats->ssrcs; e != NULL; e = e->next) {
+      KmsSSRCStats *ssrc_stats = e->data;
+
+      kms_jitter_buffer_control_set_bounds (ssrc_stats->jb_control,
+          min_latency, max_latency);
+    }
   }
+
+  g_mutex_unlock (&self->priv->stats.mutex);
 }
 
 static void
@@ -1974,12 +2044,12 @@ kms_base_rtp_endpoint_stop_signal (KmsBaseRtpEndpoint * self, guint session,
 
 static void
 ssrc_stats_add_jitter_stats (GstStructure * ssrc_stats,
-    GstElement * jitter_buffer)
+    KmsSSRCStats * stats)
 {
   GstStructure *jitter_stats;
   guint percent, latency;
 
-  g_object_get (jitter_buffer, "percent", &percent, "latency", &latency,
+  g_object_get (stats->jitter_buffer, "percent", &percent, "latency", &latency,
       "stats", &jitter_stats, NULL);
 
   if (jitter_stats == NULL)
@@ -1987,7 +2057,8 @@ ssrc_stats_add_jitter_stats (GstStructure * ssrc_stats,
 
   /* Append adition fields to the stats */
   gst_structure_set (jitter_stats, "latency", G_TYPE_UINT, latency, "percent",
-      G_TYPE_UINT, percent, NULL);
+      G_TYPE_UINT, percent, "target-latency", G_TYPE_UINT,
+      kms_jitter_buffer_control_get_target_latency (stats->jb_control), NULL);
 
   /* Append jitter buffer stats to the ssrc stats */
   gst_structure_set (ssrc_stats, "jitter-buffer", GST_TYPE_STRUCTURE,
@@ -1996,8 +2067,8 @@ ssrc_stats_add_jitter_stats (GstStructure * ssrc_stats,
   gst_structure_free (jitter_stats);
 }
 
-static GstElement *
-rtp_session_stats_get_jitter_buffer (KmsRTPSessionStats * rtp_stats, guint ssrc)
+static KmsSSRCStats *
+rtp_session_stats_get_ssrc_stats (KmsRTPSessionStats * rtp_stats, guint ssrc)
 {
   GSList *e;
 
@@ -2005,7 +2076,7 @@ rtp_session_stats_get_jitter_buffer (KmsRTPSessionStats * rtp_stats, guint ssrc)
     KmsSSRCStats *ssrc_stats = e->data;
 
     if (ssrc_stats->ssrc == ssrc)
-      return ssrc_stats->jitter_buffer;
+      return ssrc_stats;
   }
 
   return NULL;
@@ -2092,7 +2163,7 @@ append_rtp_session_stats (gpointer * session, KmsRTPSessionStats * rtp_stats,
   g_object_get (rtp_stats->rtp_session, "sources", &arr, NULL);
 
   for (i = 0; i < arr->n_values; i++) {
-    GstElement *jitter_buffer;
+    KmsSSRCStats *jb_stats;
     GstStructure *ssrc_stats;
     gboolean internal;
     GObject *source;
@@ -2137,10 +2208,10 @@ append_rtp_session_stats (gpointer * session, KmsRTPSessionStats * rtp_stats,
 
     gst_structure_set (ssrc_stats, "id", G_TYPE_STRING, id, NULL);
 
-    jitter_buffer = rtp_session_stats_get_jitter_buffer (rtp_stats, ssrc);
+    jb_stats = rtp_session_stats_get_ssrc_stats (rtp_stats, ssrc);
 
-    if (jitter_buffer != NULL) {
-      ssrc_stats_add_jitter_stats (ssrc_stats, jitter_buffer);
+    if (jb_stats != NULL) {
+      ssrc_stats_add_jitter_stats (ssrc_stats, jb_stats);
     }
 
     gst_structure_set (session_stats, name, GST_TYPE_STRUCTURE, ssrc_stats,
@@ -2267,6 +2338,26 @@ kms_base_rtp_endpoint_set_property (GObject * object, guint property_id,
       self->priv->max_video_send_bw = v;
       break;
     }
+    case PROP_JB_MIN_LATENCY:{
+      guint min_latency, max_latency;
+
+      self->priv->jb_min_latency = g_value_get_uint (value);
+      kms_base_rtp_endpoint_get_jitter_buffer_bounds (self, &min_latency,
+          &max_latency);
+      kms_base_rtp_endpoint_update_jitter_buffer_bounds (self, min_latency,
+          max_latency);
+      break;
+    }
+    case PROP_JB_MAX_LATENCY:{
+      guint min_latency, max_latency;
+
+      self->priv->jb_max_latency = g_value_get_uint (value);
+      kms_base_rtp_endpoint_get_jitter_buffer_bounds (self, &min_latency,
+          &max_latency);
+      kms_base_rtp_endpoint_update_jitter_buffer_bounds (self, min_latency,
+          max_latency);
+      break;
+    }
     case PROP_REMB_PARAMS:
       if (self->priv->rl != NULL) {
         GstStructure *params = g_value_get_boxed (value);
@@ -2320,6 +2411,12 @@ kms_bse_rtp_endpoint_get_property (GObject * object, guint property_id,
     case PROP_MAX_VIDEO_SEND_BW:
       g_value_set_uint (value, self->priv->max_video_send_bw);
       break;
+    case PROP_JB_MIN_LATENCY:
+      g_value_set_uint (value, self->priv->jb_min_latency);
+      break;
+    case PROP_JB_MAX_LATENCY:
+      g_value_set_uint (value, self->priv->jb_max_latency);
+      break;
     case PROP_CONNECTION_STATE:
       g_value_set_enum (value, self->priv->conn_state);
       break;
@@ -2421,6 +2518,12 @@ kms_base_rtp_endpoint_finalize (GObject * gobject)
 
   g_hash_table_destroy (self->priv->conns);
 
+  if (self->priv->bundle_demux != NULL) {
+    kms_bundle_demux_unref (self->priv->bundle_demux);
+  }
+
+  kms_pt_caps_table_free (self->priv->pt_caps);
+
   G_OBJECT_CLASS (kms_base_rtp_endpoint_parent_class)->finalize (gobject);
 }
 
@@ -2665,6 +2768,21 @@ kms_base_rtp_endpoint_class_init (KmsBaseRtpEndpointClass * klass)
           0, G_MAXUINT32, MAX_VIDEO_SEND_BW_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (object_class, PROP_JB_MIN_LATENCY,
+      g_param_spec_uint ("jitter-buffer-min-latency",
+          "Minimum jitter buffer latency",
+          "Lower bound for the adaptive jitter buffer latency. Unit: ms",
+          0, G_MAXUINT32, JB_MIN_LATENCY_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_JB_MAX_LATENCY,
+      g_param_spec_uint ("jitter-buffer-max-latency",
+          "Maximum jitter buffer latency",
+          "Upper bound for the adaptive jitter buffer latency, raised to the "
+          "minimum when lower. Unit: ms",
+          0, G_MAXUINT32, JB_MAX_LATENCY_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (object_class, PROP_REMB_PARAMS,
       g_param_spec_boxed ("remb-params", "remb params",
           "Set parameters for REMB algorithm",
@@ -2897,6 +3015,9 @@ kms_base_rtp_endpoint_init (KmsBaseRtpEndpoint * self)
   self->priv->min_video_recv_bw = MIN_VIDEO_RECV_BW_DEFAULT;
   self->priv->min_video_send_bw = MIN_VIDEO_SEND_BW_DEFAULT;
   self->priv->max_video_send_bw = MAX_VIDEO_SEND_BW_DEFAULT;
+  self->priv->jb_min_latency = JB_MIN_LATENCY_DEFAULT;
+  self->priv->jb_max_latency = JB_MAX_LATENCY_DEFAULT;
+  self->priv->pt_caps = kms_pt_caps_table_new ();
 
   self->priv->rtpbin = gst_element_factory_make ("rtpbin", NULL);
 
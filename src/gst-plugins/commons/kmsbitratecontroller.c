@@ -0,0 +1,341 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "kmsbitratecontroller.h"
+#include "kmsrefstruct.h"
+
+#define GST_CAT_DEFAULT kms_bitrate_controller_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsbitratecontroller"
+
+#define KMS_BITRATE_CONTROLLER_LOCK(controller) \
+  (g_mutex_lock (&(controller)->mutex))
+#define KMS_BITRATE_CONTROLLER_UNLOCK(controller) \
+  (g_mutex_unlock (&(controller)->mutex))
+
+#define KMS_BITRATE_CONTROLLER_APPLY_LOCK(controller) \
+  (g_mutex_lock (&(controller)->apply_mutex))
+#define KMS_BITRATE_CONTROLLER_APPLY_UNLOCK(controller) \
+  (g_mutex_unlock (&(controller)->apply_mutex))
+
+struct _KmsBitrateController
+{
+  KmsRefStruct ref;
+  GMutex mutex;
+  /* Serializes the callbacks, taken before mutex */
+  GMutex apply_mutex;
+
+  guint up_threshold;
+  guint down_threshold;
+  guint up_ramp;
+  guint down_ramp;
+  GstClockTime min_interval;
+
+  guint target;
+  guint applied;
+  guint notified;
+  GstClockTime last_update;
+
+  guint64 targets;
+  guint64 increases;
+  guint64 decreases;
+  guint64 below_threshold;
+  guint64 rate_limited;
+  guint64 ramped;
+
+  KmsBitrateControllerCallback cb;
+  gpointer user_data;
+  GDestroyNotify destroy;
+};
+
+static void
+kms_bitrate_controller_destroy_user_data (KmsBitrateController * controller)
+{
+  if (controller->destroy != NULL && controller->user_data != NULL) {
+    controller->destroy (controller->user_data);
+  }
+
+  controller->cb = NULL;
+  controller->user_data = NULL;
+  controller->destroy = NULL;
+}
+
+static void
+kms_bitrate_controller_destroy (KmsBitrateController * controller)
+{
+  kms_bitrate_controller_destroy_user_data (controller);
+  g_mutex_clear (&controller->mutex);
+  g_mutex_clear (&controller->apply_mutex);
+
+  g_slice_free (KmsBitrateController, controller);
+}
+
+KmsBitrateController *
+kms_bitrate_controller_ref (KmsBitrateController * controller)
+{
+  return (KmsBitrateController *)
+      kms_ref_struct_ref (KMS_REF_STRUCT_CAST (controller));
+}
+
+void
+kms_bitrate_controller_unref (KmsBitrateController * controller)
+{
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (controller));
+}
+
+KmsBitrateController *
+kms_bitrate_controller_new (guint initial_bitrate)
+{
+  KmsBitrateController *controller;
+
+  controller = g_slice_new0 (KmsBitrateController);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (controller),
+      (GDestroyNotify) kms_bitrate_controller_destroy);
+
+  g_mutex_init (&controller->mutex);
+  g_mutex_init (&controller->apply_mutex);
+  controller->up_threshold = KMS_BITRATE_CONTROLLER_DEFAULT_UP_THRESHOLD;
+  controller->down_threshold = KMS_BITRATE_CONTROLLER_DEFAULT_DOWN_THRESHOLD;
+  controller->up_ramp = KMS_BITRATE_CONTROLLER_DEFAULT_UP_RAMP;
+  controller->down_ramp = KMS_BITRATE_CONTROLLER_DEFAULT_DOWN_RAMP;
+  controller->min_interval =
+      KMS_BITRATE_CONTROLLER_DEFAULT_MIN_INTERVAL * GST_MSECOND;
+  controller->applied = initial_bitrate;
+  controller->notified = initial_bitrate;
+  controller->target = initial_bitrate;
+  controller->last_update = GST_CLOCK_TIME_NONE;
+
+  return controller;
+}
+
+void
+kms_bitrate_controller_set_callback (KmsBitrateController * controller,
+    KmsBitrateControllerCallback cb, gpointer user_data, GDestroyNotify destroy)
+{
+  KMS_BITRATE_CONTROLLER_LOCK (controller);
+
+  kms_bitrate_controller_destroy_user_data (controller);
+  controller->cb = cb;
+  controller->user_data = user_data;
+  controller->destroy = destroy;
+
+  KMS_BITRATE_CONTROLLER_UNLOCK (controller);
+}
+
+void
+kms_bitrate_controller_set_thresholds (KmsBitrateController * controller,
+    guint up, guint down)
+{
+  KMS_BITRATE_CONTROLLER_LOCK (controller);
+  controller->up_threshold = up;
+  controller->down_threshold = down;
+  KMS_BITRATE_CONTROLLER_UNLOCK (controller);
+}
+
+void
+kms_bitrate_controller_set_ramps (KmsBitrateController * controller,
+    guint up, guint down)
+{
+  KMS_BITRATE_CONTROLLER_LOCK (controller);
+  controller->up_ramp = up;
+  controller->down_ramp = down;
+  KMS_BITRATE_CONTROLLER_UNLOCK (controller);
+}
+
+void
+kms_bitrate_controller_set_min_interval (KmsBitrateController * controller,
+    GstClockTime interval)
+{
+  KMS_BITRATE_CONTROLLER_LOCK (controller);
+  controller->min_interval = interval;
+  KMS_BITRATE_CONTROLLER_UNLOCK (controller);
+}
+
+/* Must be called with the lock held. Returns the bitrate to notify or 0 */
+static guint
+kms_bitrate_controller_evaluate (KmsBitrateController * controller,
+    GstClockTime now, gboolean new_target)
+{
+  gboolean up;
+  guint64 delta, max_step;
+  guint threshold, ramp;
+
+  if (controller->target == 0 || controller->target == controller->applied) {
+    return 0;
+  }
+
+  if (controller->applied == 0) {
+    /* Nothing to be relative to, take the first target as it is */
+    controller->applied = controller->target;
+    controller->last_update = now;
+    return controller->applied;
+  }
+
+  up = controller->target > controller->applied;
+  delta = up ? controller->target - controller->applied :
+      controller->applied - controller->target;
+  threshold = up ? controller->up_threshold : controller->down_threshold;
+  ramp = up ? controller->up_ramp : controller->down_ramp;
+
+  if (delta * 100 < (guint64) controller->applied * threshold) {
+    if (new_target) {
+      controller->below_threshold++;
+    }
+    return 0;
+  }
+
+  /* Only increases are spaced, congestion must be answered at once */
+  if (up && GST_CLOCK_TIME_IS_VALID (controller->last_update) &&
+      now < controller->last_update + controller->min_interval) {
+    if (new_target) {
+      controller->rate_limited++;
+    }
+    return 0;
+  }
+
+  max_step = (guint64) controller->applied * ramp / 100;
+  if (ramp > 0 && delta > max_step) {
+    delta = MAX (max_step, 1);
+    controller->ramped++;
+  }
+
+  if (up) {
+    controller->applied += delta;
+    controller->increases++;
+  } else {
+    controller->applied -= delta;
+    controller->decreases++;
+  }
+
+  controller->last_update = now;
+
+  GST_DEBUG ("Bitrate %u (target %u)", controller->applied,
+      controller->target);
+
+  return controller->applied;
+}
+
+static void
+kms_bitrate_controller_update (KmsBitrateController * controller,
+    GstClockTime now, gboolean new_target)
+{
+  KmsBitrateControllerCallback cb;
+  gpointer user_data;
+  guint bitrate;
+
+  bitrate = kms_bitrate_controller_evaluate (controller, now, new_target);
+
+  KMS_BITRATE_CONTROLLER_UNLOCK (controller);
+
+  if (bitrate == 0) {
+    return;
+  }
+
+  KMS_BITRATE_CONTROLLER_APPLY_LOCK (controller);
+  KMS_BITRATE_CONTROLLER_LOCK (controller);
+
+  /* Another thread may have evaluated a newer bitrate in between, always */
+  /* notify the latest one so a stale value never lands after it */
+  bitrate = controller->applied;
+  if (bitrate == controller->notified) {
+    bitrate = 0;
+  }
+  controller->notified = controller->applied;
+  cb = controller->cb;
+  user_data = controller->user_data;
+
+  KMS_BITRATE_CONTROLLER_UNLOCK (controller);
+
+  if (bitrate != 0 && cb != NULL) {
+    cb (controller, bitrate, user_data);
+  }
+
+  KMS_BITRATE_CONTROLLER_APPLY_UNLOCK (controller);
+}
+
+void
+kms_bitrate_controller_set_target (KmsBitrateController * controller,
+    guint target, GstClockTime now)
+{
+  KMS_BITRATE_CONTROLLER_LOCK (controller);
+
+  controller->target = target;
+  controller->targets++;
+
+  /* Unlocks */
+  kms_bitrate_controller_update (controller, now, TRUE);
+}
+
+void
+kms_bitrate_controller_tick (KmsBitrateController * controller,
+    GstClockTime now)
+{
+  KMS_BITRATE_CONTROLLER_LOCK (controller);
+
+  if (controller->target == controller->applied) {
+    KMS_BITRATE_CONTROLLER_UNLOCK (controller);
+    return;
+  }
+
+  /* Unlocks */
+  kms_bitrate_controller_update (controller, now, FALSE);
+}
+
+guint
+kms_bitrate_controller_get_bitrate (KmsBitrateController * controller)
+{
+  guint bitrate;
+
+  KMS_BITRATE_CONTROLLER_LOCK (controller);
+  bitrate = controller->applied;
+  KMS_BITRATE_CONTROLLER_UNLOCK (controller);
+
+  return bitrate;
+}
+
+GstStructure *
+kms_bitrate_controller_get_stats (KmsBitrateController * controller)
+{
+  GstStructure *stats;
+
+  KMS_BITRATE_CONTROLLER_LOCK (controller);
+
+  stats = gst_structure_new (KMS_BITRATE_CONTROLLER_STATS_NAME,
+      "target", G_TYPE_UINT, controller->target,
+      "bitrate", G_TYPE_UINT, controller->applied,
+      "targets", G_TYPE_UINT64, controller->targets,
+      "increases", G_TYPE_UINT64, controller->increases,
+      "decreases", G_TYPE_UINT64, controller->decreases,
+      "below-threshold", G_TYPE_UINT64, controller->below_threshold,
+      "rate-limited", G_TYPE_UINT64, controller->rate_limited,
+      "ramped", G_TYPE_UINT64, controller->ramped, NULL);
+
+  KMS_BITRATE_CONTROLLER_UNLOCK (controller);
+
+  return stats;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
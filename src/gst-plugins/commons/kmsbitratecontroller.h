@@ -0,0 +1,75 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_BITRATE_CONTROLLER_H__
+#define __KMS_BITRATE_CONTROLLER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _KmsBitrateController KmsBitrateController;
+
+typedef void (*KmsBitrateControllerCallback) (KmsBitrateController *
+    controller, guint bitrate, gpointer user_data);
+
+#define KMS_BITRATE_CONTROLLER_STATS_NAME "bitrate-controller"
+
+#define KMS_BITRATE_CONTROLLER_DEFAULT_UP_THRESHOLD 10 /* % */
+#define KMS_BITRATE_CONTROLLER_DEFAULT_DOWN_THRESHOLD 5 /* % */
+#define KMS_BITRATE_CONTROLLER_DEFAULT_UP_RAMP 10 /* % */
+#define KMS_BITRATE_CONTROLLER_DEFAULT_DOWN_RAMP 0 /* % */
+#define KMS_BITRATE_CONTROLLER_DEFAULT_MIN_INTERVAL 500 /* ms */
+
+/* Decides which target bitrates (e.g. REMB minimums) reach an encoder.
+ * Changes smaller than the step threshold of their direction are ignored,
+ * increases are spaced at least by the minimum interval since the previous
+ * update, while decreases are applied as soon as they arrive, and every
+ * update moves at most the ramp percentage of its direction towards the
+ * target. A target that could not be reached yet is retried on every tick. */
+KmsBitrateController * kms_bitrate_controller_new (guint initial_bitrate);
+
+KmsBitrateController * kms_bitrate_controller_ref (
+    KmsBitrateController * controller);
+void kms_bitrate_controller_unref (KmsBitrateController * controller);
+
+/* Callbacks are never run concurrently and always carry the latest applied
+ * bitrate, in the order it was applied. The callback must not call back into
+ * the controller */
+void kms_bitrate_controller_set_callback (KmsBitrateController * controller,
+    KmsBitrateControllerCallback cb, gpointer user_data,
+    GDestroyNotify destroy);
+
+/* Thresholds and ramps are percentages of the applied bitrate, a ramp of 0
+ * jumps straight to the target */
+void kms_bitrate_controller_set_thresholds (KmsBitrateController * controller,
+    guint up, guint down);
+void kms_bitrate_controller_set_ramps (KmsBitrateController * controller,
+    guint up, guint down);
+void kms_bitrate_controller_set_min_interval (KmsBitrateController * controller,
+    GstClockTime interval);
+
+void kms_bitrate_controller_set_target (KmsBitrateController * controller,
+    guint target, GstClockTime now);
+void kms_bitrate_controller_tick (KmsBitrateController * controller,
+    GstClockTime now);
+
+guint kms_bitrate_controller_get_bitrate (KmsBitrateController * controller);
+GstStructure * kms_bitrate_controller_get_stats (
+    KmsBitrateController * controller);
+
+G_END_DECLS
+
+#endif /* __KMS_BITRATE_CONTROLLER_H__ */
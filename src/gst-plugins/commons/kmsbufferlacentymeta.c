@@ -93,8 +93,14 @@ kms_buffer_add_buffer_latency_meta (GstBuffer * buffer, GstClockTime ts,
 
   g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
 
-  meta = (KmsBufferLatencyMeta *) gst_buffer_add_meta (buffer,
-      KMS_BUFFER_LATENCY_META_INFO, NULL);
+  /* Only the most recent meta is ever read, so reuse it in place instead */
+  /* of stacking one more meta that every later copy would carry along */
+  meta = kms_buffer_get_buffer_latency_meta (buffer);
+
+  if (meta == NULL) {
+    meta = (KmsBufferLatencyMeta *) gst_buffer_add_meta (buffer,
+        KMS_BUFFER_LATENCY_META_INFO, NULL);
+  }
 
   meta->ts = ts;
   meta->valid = valid;
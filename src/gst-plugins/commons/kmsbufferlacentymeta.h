@@ -28,9 +28,12 @@ typedef struct _KmsBufferLatencyMeta KmsBufferLatencyMeta;
  * KmsBufferLatencyMeta:
  * @meta: the parent type
  * @ts: The time stamp
+ * @type: The media type of the buffer
+ * @valid: Whether the latency must be computed for this buffer
  *
  * Buffer metadata for measuring buffer latency since the buffer is generated
- * until it is processed by a sink.
+ * until it is processed by a sink. A buffer carries at most one of these,
+ * adding it again just updates the existing values.
  */
 struct _KmsBufferLatencyMeta {
   GstMeta       meta;
@@ -0,0 +1,398 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "kmsbundledemux.h"
+#include "kmsrefstruct.h"
+#include "kmsutils.h"
+
+#define GST_CAT_DEFAULT kms_bundle_demux_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsbundledemux"
+
+#define FUNNEL_SINK_TEMPLATE "sink_%u"
+
+#define KMS_BUNDLE_DEMUX_LOCK(demux) \
+  (g_mutex_lock (&(demux)->mutex))
+#define KMS_BUNDLE_DEMUX_UNLOCK(demux) \
+  (g_mutex_unlock (&(demux)->mutex))
+
+typedef struct _KmsBundleSession
+{
+  GstElement *rtp_funnel;
+  GstElement *rtcp_funnel;
+  guint32 local_ssrc;
+} KmsBundleSession;
+
+typedef struct _KmsBundleRoute
+{
+  guint session;
+  GstPad *rtp_sink;
+  GstPad *rtcp_sink;
+} KmsBundleRoute;
+
+struct _KmsBundleDemux
+{
+  KmsRefStruct ref;
+  GMutex mutex;
+
+  GstBin *bin;
+  GstElement *ssrcdemux;
+  GstElement *rtcpdemux;
+
+  GHashTable *sessions;         /* session -> KmsBundleSession */
+  GHashTable *routes;           /* ssrc -> KmsBundleRoute */
+};
+
+static void
+kms_bundle_session_destroy (KmsBundleSession * session)
+{
+  g_slice_free (KmsBundleSession, session);
+}
+
+static KmsBundleRoute *
+kms_bundle_route_new (guint session)
+{
+  KmsBundleRoute *route;
+
+  route = g_slice_new0 (KmsBundleRoute);
+  route->session = session;
+
+  return route;
+}
+
+static void
+kms_bundle_route_destroy (KmsBundleRoute * route)
+{
+  g_clear_object (&route->rtp_sink);
+  g_clear_object (&route->rtcp_sink);
+  g_slice_free (KmsBundleRoute, route);
+}
+
+static void
+kms_bundle_demux_destroy (KmsBundleDemux * demux)
+{
+  g_hash_table_destroy (demux->routes);
+  g_hash_table_destroy (demux->sessions);
+  g_mutex_clear (&demux->mutex);
+
+  g_slice_free (KmsBundleDemux, demux);
+}
+
+KmsBundleDemux *
+kms_bundle_demux_ref (KmsBundleDemux * demux)
+{
+  return (KmsBundleDemux *) kms_ref_struct_ref (KMS_REF_STRUCT_CAST (demux));
+}
+
+void
+kms_bundle_demux_unref (KmsBundleDemux * demux)
+{
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (demux));
+}
+
+/* Must be called with the demux lock held */
+static gboolean
+kms_bundle_demux_request_route_pads (KmsBundleDemux * demux,
+    KmsBundleRoute * route)
+{
+  KmsBundleSession *session;
+
+  session = g_hash_table_lookup (demux->sessions,
+      GUINT_TO_POINTER (route->session));
+
+  if (session == NULL) {
+    return FALSE;
+  }
+
+  /* Unlinked pads are reused when rtpssrcdemux recreates a removed SSRC */
+  if (route->rtp_sink == NULL || gst_pad_is_linked (route->rtp_sink)) {
+    g_clear_object (&route->rtp_sink);
+    route->rtp_sink = gst_element_get_request_pad (session->rtp_funnel,
+        FUNNEL_SINK_TEMPLATE);
+  }
+
+  if (route->rtcp_sink == NULL || gst_pad_is_linked (route->rtcp_sink)) {
+    g_clear_object (&route->rtcp_sink);
+    route->rtcp_sink = gst_element_get_request_pad (session->rtcp_funnel,
+        FUNNEL_SINK_TEMPLATE);
+  }
+
+  return route->rtp_sink != NULL && route->rtcp_sink != NULL;
+}
+
+/* Must be called with the demux lock held */
+static void
+kms_bundle_demux_release_route_pads (KmsBundleDemux * demux,
+    KmsBundleRoute * route)
+{
+  KmsBundleSession *session;
+
+  session = g_hash_table_lookup (demux->sessions,
+      GUINT_TO_POINTER (route->session));
+
+  if (session == NULL) {
+    return;
+  }
+
+  if (route->rtp_sink != NULL && !gst_pad_is_linked (route->rtp_sink)) {
+    gst_element_release_request_pad (session->rtp_funnel, route->rtp_sink);
+  }
+
+  if (route->rtcp_sink != NULL && !gst_pad_is_linked (route->rtcp_sink)) {
+    gst_element_release_request_pad (session->rtcp_funnel, route->rtcp_sink);
+  }
+}
+
+/* Must be called with the demux lock held */
+static KmsBundleRoute *
+kms_bundle_demux_resolve_route (KmsBundleDemux * demux, guint32 ssrc)
+{
+  KmsBundleRoute *route;
+  GHashTableIter iter;
+  gpointer key, value;
+  guint local_ssrc_pair;
+
+  route = g_hash_table_lookup (demux->routes, GUINT_TO_POINTER (ssrc));
+
+  if (route != NULL) {
+    return route;
+  }
+
+  /* Not announced in the SDP, check if it is reporting one of our SSRCs */
+  g_signal_emit_by_name (demux->rtcpdemux, "get-local-rr-ssrc-pair", ssrc,
+      &local_ssrc_pair);
+
+  g_hash_table_iter_init (&iter, demux->sessions);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    KmsBundleSession *session = value;
+
+    if (session->local_ssrc != 0 && session->local_ssrc == local_ssrc_pair) {
+      route = kms_bundle_route_new (GPOINTER_TO_UINT (key));
+      g_hash_table_insert (demux->routes, GUINT_TO_POINTER (ssrc), route);
+
+      return route;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+kms_bundle_demux_new_ssrc_pad (GstElement * ssrcdemux, guint ssrc,
+    GstPad * pad, KmsBundleDemux * demux)
+{
+  KmsBundleRoute *route;
+  GstPad *rtcp_pad;
+  gchar *rtcp_pad_name;
+
+  GST_DEBUG_OBJECT (ssrcdemux, "pad: %" GST_PTR_FORMAT " ssrc: %"
+      G_GUINT32_FORMAT, pad, ssrc);
+
+  rtcp_pad_name = g_strconcat ("rtcp_", GST_OBJECT_NAME (pad), NULL);
+  rtcp_pad = gst_element_get_static_pad (ssrcdemux, rtcp_pad_name);
+  g_free (rtcp_pad_name);
+
+  KMS_BUNDLE_DEMUX_LOCK (demux);
+
+  route = kms_bundle_demux_resolve_route (demux, ssrc);
+
+  if (route == NULL) {
+    GST_DEBUG_OBJECT (ssrcdemux, "No session for SSRC %" G_GUINT32_FORMAT,
+        ssrc);
+    goto end;
+  }
+
+  if (!kms_bundle_demux_request_route_pads (demux, route)) {
+    GST_WARNING_OBJECT (ssrcdemux, "Session %u not available for SSRC %"
+        G_GUINT32_FORMAT, route->session, ssrc);
+    goto end;
+  }
+
+  if (GST_PAD_LINK_FAILED (gst_pad_link (pad, route->rtp_sink))) {
+    GST_ERROR_OBJECT (ssrcdemux, "Cannot link RTP for SSRC %" G_GUINT32_FORMAT,
+        ssrc);
+  }
+
+  if (rtcp_pad != NULL
+      && GST_PAD_LINK_FAILED (gst_pad_link (rtcp_pad, route->rtcp_sink))) {
+    GST_ERROR_OBJECT (ssrcdemux, "Cannot link RTCP for SSRC %"
+        G_GUINT32_FORMAT, ssrc);
+  }
+
+end:
+  KMS_BUNDLE_DEMUX_UNLOCK (demux);
+
+  if (rtcp_pad != NULL) {
+    g_object_unref (rtcp_pad);
+  }
+}
+
+KmsBundleDemux *
+kms_bundle_demux_new (GstBin * bin)
+{
+  KmsBundleDemux *demux;
+
+  g_return_val_if_fail (GST_IS_BIN (bin), NULL);
+
+  demux = g_slice_new0 (KmsBundleDemux);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (demux),
+      (GDestroyNotify) kms_bundle_demux_destroy);
+
+  g_mutex_init (&demux->mutex);
+  demux->sessions = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) kms_bundle_session_destroy);
+  demux->routes = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) kms_bundle_route_destroy);
+
+  /* Elements are owned by the bin, the demux lives as long as ssrcdemux */
+  demux->bin = bin;
+  demux->ssrcdemux = gst_element_factory_make ("rtpssrcdemux", NULL);
+  demux->rtcpdemux = gst_element_factory_make ("rtcpdemux", NULL);
+
+  g_signal_connect_data (demux->ssrcdemux, "new-ssrc-pad",
+      G_CALLBACK (kms_bundle_demux_new_ssrc_pad), kms_bundle_demux_ref (demux),
+      (GClosureNotify) kms_bundle_demux_unref, 0);
+
+  gst_bin_add_many (bin, demux->ssrcdemux, demux->rtcpdemux, NULL);
+  gst_element_link_pads (demux->rtcpdemux, "rtcp_src", demux->ssrcdemux,
+      "rtcp_sink");
+
+  return demux;
+}
+
+GstPad *
+kms_bundle_demux_get_rtp_sink (KmsBundleDemux * demux)
+{
+  return gst_element_get_static_pad (demux->ssrcdemux, "sink");
+}
+
+GstPad *
+kms_bundle_demux_get_rtcp_sink (KmsBundleDemux * demux)
+{
+  return gst_element_get_static_pad (demux->rtcpdemux, "sink");
+}
+
+static GstElement *
+kms_bundle_demux_create_funnel (KmsBundleDemux * demux, GstPad * peer)
+{
+  GstElement *funnel = gst_element_factory_make ("funnel", NULL);
+  GstPad *src;
+
+  gst_bin_add (demux->bin, funnel);
+
+  src = gst_element_get_static_pad (funnel, "src");
+  if (GST_PAD_LINK_FAILED (gst_pad_link (src, peer))) {
+    GST_ERROR ("Cannot link %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, funnel,
+        peer);
+  }
+  g_object_unref (src);
+
+  gst_element_sync_state_with_parent_target_state (funnel);
+
+  return funnel;
+}
+
+gboolean
+kms_bundle_demux_add_session (KmsBundleDemux * demux, guint session_id,
+    GstPad * rtp_sink, GstPad * rtcp_sink, guint32 local_ssrc)
+{
+  KmsBundleSession *session;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_return_val_if_fail (demux != NULL, FALSE);
+
+  KMS_BUNDLE_DEMUX_LOCK (demux);
+
+  session = g_hash_table_lookup (demux->sessions,
+      GUINT_TO_POINTER (session_id));
+
+  if (session != NULL) {
+    session->local_ssrc = local_ssrc;
+    KMS_BUNDLE_DEMUX_UNLOCK (demux);
+    return TRUE;
+  }
+
+  session = g_slice_new0 (KmsBundleSession);
+  session->local_ssrc = local_ssrc;
+  session->rtp_funnel = kms_bundle_demux_create_funnel (demux, rtp_sink);
+  session->rtcp_funnel = kms_bundle_demux_create_funnel (demux, rtcp_sink);
+  g_hash_table_insert (demux->sessions, GUINT_TO_POINTER (session_id),
+      session);
+
+  /* SSRCs announced before their session can be routed now */
+  g_hash_table_iter_init (&iter, demux->routes);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    KmsBundleRoute *route = value;
+
+    if (route->session == session_id) {
+      kms_bundle_demux_request_route_pads (demux, route);
+    }
+  }
+
+  KMS_BUNDLE_DEMUX_UNLOCK (demux);
+
+  return TRUE;
+}
+
+void
+kms_bundle_demux_add_ssrc (KmsBundleDemux * demux, guint32 ssrc,
+    guint session)
+{
+  KmsBundleRoute *route;
+
+  g_return_if_fail (demux != NULL);
+
+  if (ssrc == 0) {
+    return;
+  }
+
+  KMS_BUNDLE_DEMUX_LOCK (demux);
+
+  route = g_hash_table_lookup (demux->routes, GUINT_TO_POINTER (ssrc));
+
+  if (route != NULL && route->session != session) {
+    GST_WARNING ("SSRC %" G_GUINT32_FORMAT " moved from session %u to %u",
+        ssrc, route->session, session);
+    kms_bundle_demux_release_route_pads (demux, route);
+    g_hash_table_remove (demux->routes, GUINT_TO_POINTER (ssrc));
+    route = NULL;
+  }
+
+  if (route == NULL) {
+    route = kms_bundle_route_new (session);
+    g_hash_table_insert (demux->routes, GUINT_TO_POINTER (ssrc), route);
+  }
+
+  kms_bundle_demux_request_route_pads (demux, route);
+
+  KMS_BUNDLE_DEMUX_UNLOCK (demux);
+}
+
+void
+kms_bundle_demux_sync_state_with_parent (KmsBundleDemux * demux)
+{
+  gst_element_sync_state_with_parent_target_state (demux->ssrcdemux);
+  gst_element_sync_state_with_parent_target_state (demux->rtcpdemux);
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
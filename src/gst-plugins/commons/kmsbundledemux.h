@@ -0,0 +1,46 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_BUNDLE_DEMUX_H__
+#define __KMS_BUNDLE_DEMUX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _KmsBundleDemux KmsBundleDemux;
+
+/* Splits a BUNDLE transport into RTP sessions. Each session is fed through
+ * a funnel linked once to the session sinks, and SSRCs known from the SDP
+ * get their funnel pads requested beforehand, so a new SSRC only costs a
+ * hash table lookup and a pad link. */
+KmsBundleDemux * kms_bundle_demux_new (GstBin * bin);
+
+KmsBundleDemux * kms_bundle_demux_ref (KmsBundleDemux * demux);
+void kms_bundle_demux_unref (KmsBundleDemux * demux);
+
+GstPad * kms_bundle_demux_get_rtp_sink (KmsBundleDemux * demux);
+GstPad * kms_bundle_demux_get_rtcp_sink (KmsBundleDemux * demux);
+
+gboolean kms_bundle_demux_add_session (KmsBundleDemux * demux, guint session,
+    GstPad * rtp_sink, GstPad * rtcp_sink, guint32 local_ssrc);
+void kms_bundle_demux_add_ssrc (KmsBundleDemux * demux, guint32 ssrc,
+    guint session);
+
+void kms_bundle_demux_sync_state_with_parent (KmsBundleDemux * demux);
+
+G_END_DECLS
+
+#endif /* __KMS_BUNDLE_DEMUX_H__ */
@@ -17,6 +17,7 @@
 #endif
 
 #include <gst/gst.h>
+#include <string.h>
 
 #include "kms-core-enumtypes.h"
 #include "kms-core-marshal.h"
@@ -24,10 +25,15 @@
 #include "kmsagnosticcaps.h"
 #include "kmsstats.h"
 #include "kmsutils.h"
+#include "kmselementpool.h"
+#include "kmskeyframearbiter.h"
+#include "kmsbitratecontroller.h"
 
 #define PLUGIN_NAME "kmselement"
 #define DEFAULT_ACCEPT_EOS TRUE
 #define DEFAULT_BITRATE_ "default-bitrate"
+#define DEFAULT_KEY_FRAME_REQUEST_WINDOW 1000   /* ms */
+#define GOP_CACHE_SIZE_ "gop-cache-size"
 
 GST_DEBUG_CATEGORY_STATIC (kms_element_debug_category);
 #define GST_CAT_DEFAULT kms_element_debug_category
@@ -89,6 +95,10 @@ struct _KmsElementPrivate
 
   gint target_bitrate;
 
+  /* Key frame requests from every video output */
+  KmsKeyFrameArbiter *kf_arbiter;
+  guint gop_cache_size;
+
   /* Statistics */
   KmsElementStats stats;
 };
@@ -113,6 +123,8 @@ enum
   PROP_VIDEO_CAPS,
   PROP_TARGET_BITRATE,
   PROP_MEDIA_STATS,
+  PROP_KEY_FRAME_REQUEST_WINDOW,
+  PROP_GOP_CACHE_SIZE,
   PROP_LAST
 };
 
@@ -342,7 +354,7 @@ kms_element_get_audio_agnosticbin (KmsElement * self)
   }
 
   self->priv->audio_agnosticbin =
-      gst_element_factory_make ("agnosticbin", NULL);
+      kms_element_pool_acquire ("agnosticbin");
 
   gst_bin_add (GST_BIN (self), self->priv->audio_agnosticbin);
   gst_element_sync_state_with_parent (self->priv->audio_agnosticbin);
@@ -356,6 +368,8 @@ kms_element_get_audio_agnosticbin (KmsElement * self)
 GstElement *
 kms_element_get_video_agnosticbin (KmsElement * self)
 {
+  GstPad *sink;
+
   GST_DEBUG_OBJECT (self, "Video agnostic requested");
   KMS_ELEMENT_LOCK (self);
   if (self->priv->video_agnosticbin != NULL) {
@@ -364,7 +378,14 @@ kms_element_get_video_agnosticbin (KmsElement * self)
   }
 
   self->priv->video_agnosticbin =
-      gst_element_factory_make ("agnosticbin", NULL);
+      kms_element_pool_acquire ("agnosticbin");
+
+  sink = gst_element_get_static_pad (self->priv->video_agnosticbin, "sink");
+  kms_key_frame_arbiter_watch_pad (self->priv->kf_arbiter, sink);
+  g_object_unref (sink);
+
+  g_object_set (self->priv->video_agnosticbin, GOP_CACHE_SIZE_,
+      self->priv->gop_cache_size, NULL);
 
   gst_bin_add (GST_BIN (self), self->priv->video_agnosticbin);
   gst_element_sync_state_with_parent (self->priv->video_agnosticbin);
@@ -726,6 +747,19 @@ kms_element_set_property (GObject * object, guint property_id,
       KMS_ELEMENT_UNLOCK (self);
       break;
     }
+    case PROP_KEY_FRAME_REQUEST_WINDOW:
+      kms_key_frame_arbiter_set_window (self->priv->kf_arbiter,
+          g_value_get_uint (value) * GST_MSECOND);
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      KMS_ELEMENT_LOCK (self);
+      self->priv->gop_cache_size = g_value_get_uint (value);
+      if (self->priv->video_agnosticbin != NULL) {
+        g_object_set (self->priv->video_agnosticbin, GOP_CACHE_SIZE_,
+            self->priv->gop_cache_size, NULL);
+      }
+      KMS_ELEMENT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -762,6 +796,16 @@ kms_element_get_property (GObject * object, guint property_id,
       g_value_set_boolean (value, self->priv->stats_enabled);
       KMS_ELEMENT_UNLOCK (self);
       break;
+    case PROP_KEY_FRAME_REQUEST_WINDOW:
+      g_value_set_uint (value,
+          kms_key_frame_arbiter_get_window (self->priv->kf_arbiter) /
+          GST_MSECOND);
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      KMS_ELEMENT_LOCK (self);
+      g_value_set_uint (value, self->priv->gop_cache_size);
+      KMS_ELEMENT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -783,6 +827,7 @@ kms_element_finalize (GObject * object)
   GST_DEBUG_OBJECT (object, "finalize");
 
   kms_element_destroy_stats (element);
+  kms_key_frame_arbiter_unref (element->priv->kf_arbiter);
 
   /* free resources allocated by this object */
   g_hash_table_unref (element->priv->pendingpads);
@@ -924,6 +969,138 @@ kms_element_release_requested_srcpad_action (KmsElement * self,
   return released;
 }
 
+/* Only these inner elements export counters summed in the element stats */
+static const gchar *stats_factories[] = { "agnosticbin", "bufferinjector",
+  NULL
+};
+
+typedef struct _KmsChildrenStats
+{
+  guint64 injected_buffers;
+  guint64 bitrate_increases;
+  guint64 bitrate_decreases;
+  guint64 bitrate_below_threshold;
+  guint64 bitrate_rate_limited;
+  guint64 bitrate_ramped;
+} KmsChildrenStats;
+
+static guint64
+kms_element_get_stat (const GstStructure * stats, const gchar * field)
+{
+  guint64 value;
+
+  return gst_structure_get_uint64 (stats, field, &value) ? value : 0;
+}
+
+/* Adds up the counters of a child stats structure, bitrate controller */
+/* counters are found in nested structures                             */
+static void
+kms_element_add_child_stats (KmsChildrenStats * totals,
+    const GstStructure * stats)
+{
+  gint i, n;
+
+  totals->injected_buffers += kms_element_get_stat (stats, "injected-buffers");
+
+  n = gst_structure_n_fields (stats);
+
+  for (i = 0; i < n; i++) {
+    const GstStructure *controller;
+    const GValue *nested;
+
+    nested = gst_structure_get_value (stats,
+        gst_structure_nth_field_name (stats, i));
+
+    if (!GST_VALUE_HOLDS_STRUCTURE (nested)) {
+      continue;
+    }
+
+    controller = gst_value_get_structure (nested);
+
+    if (!gst_structure_has_name (controller,
+            KMS_BITRATE_CONTROLLER_STATS_NAME)) {
+      continue;
+    }
+
+    totals->bitrate_increases += kms_element_get_stat (controller,
+        "increases");
+    totals->bitrate_decreases += kms_element_get_stat (controller,
+        "decreases");
+    totals->bitrate_below_threshold += kms_element_get_stat (controller,
+        "below-threshold");
+    totals->bitrate_rate_limited += kms_element_get_stat (controller,
+        "rate-limited");
+    totals->bitrate_ramped += kms_element_get_stat (controller, "ramped");
+  }
+}
+
+static gboolean
+kms_element_child_has_stats (GstElement * element)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *name;
+  gint i;
+
+  if (factory == NULL) {
+    return FALSE;
+  }
+
+  name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory));
+
+  for (i = 0; stats_factories[i] != NULL; i++) {
+    if (g_strcmp0 (name, stats_factories[i]) == 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Adds up the counters of the inner elements walking them only once */
+static void
+kms_element_sum_children_stats (KmsElement * self, KmsChildrenStats * totals)
+{
+  GValue item = G_VALUE_INIT;
+  gboolean done = FALSE;
+  GstIterator *it;
+
+  memset (totals, 0, sizeof (KmsChildrenStats));
+
+  it = gst_bin_iterate_recurse (GST_BIN (self));
+
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstElement *element = g_value_get_object (&item);
+        GstStructure *stats = NULL;
+
+        if (kms_element_child_has_stats (element)) {
+          g_object_get (element, "stats", &stats, NULL);
+        }
+
+        if (stats != NULL) {
+          kms_element_add_child_stats (totals, stats);
+          gst_structure_free (stats);
+        }
+
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        gst_iterator_resync (it);
+        memset (totals, 0, sizeof (KmsChildrenStats));
+        break;
+      case GST_ITERATOR_ERROR:
+      case GST_ITERATOR_DONE:
+        done = TRUE;
+        break;
+    }
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+}
+
 static GstStructure *
 kms_element_stats_impl (KmsElement * self, gchar * selector)
 {
@@ -932,7 +1109,9 @@ kms_element_stats_impl (KmsElement * self, gchar * selector)
   stats = gst_structure_new_empty ("stats");
 
   if (self->priv->stats_enabled) {
+    KmsChildrenStats children;
     GstStructure *e_stats;
+    guint64 requested, forwarded;
 
     /* Video and audio latencies are measured in nano seconds. They */
     /* are such an small values so there is no harm in casting them */
@@ -943,6 +1122,25 @@ kms_element_stats_impl (KmsElement * self, gchar * selector)
         "input-audio-latency", G_TYPE_UINT64, (guint64) self->priv->stats.ai,
         NULL);
 
+    /* Key frames requested by outputs and actually sent to the source */
+    kms_key_frame_arbiter_get_counters (self->priv->kf_arbiter, &requested,
+        &forwarded);
+    gst_structure_set (e_stats, "requested-key-frames", G_TYPE_UINT64,
+        requested, "forwarded-key-frames", G_TYPE_UINT64, forwarded, NULL);
+
+    kms_element_sum_children_stats (self, &children);
+
+    /* Frames repeated by buffer injectors to fill input gaps and */
+    /* decisions taken by the bitrate controllers of the encoders */
+    gst_structure_set (e_stats,
+        "injected-buffers", G_TYPE_UINT64, children.injected_buffers,
+        "bitrate-increases", G_TYPE_UINT64, children.bitrate_increases,
+        "bitrate-decreases", G_TYPE_UINT64, children.bitrate_decreases,
+        "bitrate-below-threshold", G_TYPE_UINT64,
+        children.bitrate_below_threshold,
+        "bitrate-rate-limited", G_TYPE_UINT64, children.bitrate_rate_limited,
+        "bitrate-ramped", G_TYPE_UINT64, children.bitrate_ramped, NULL);
+
     gst_structure_set (stats, KMS_MEDIA_ELEMENT_FIELD, GST_TYPE_STRUCTURE,
         e_stats, NULL);
 
@@ -1029,6 +1227,20 @@ kms_element_class_init (KmsElementClass * klass)
           "Indicates wheter this element is collecting stats or not",
           FALSE, G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
 
+  g_object_class_install_property (gobject_class,
+      PROP_KEY_FRAME_REQUEST_WINDOW,
+      g_param_spec_uint ("key-frame-request-window",
+          "Key frame request window",
+          "Time (ms) during which key frame requests from all outputs are "
+          "coalesced into a single one while no key frame is received",
+          0, G_MAXUINT, DEFAULT_KEY_FRAME_REQUEST_WINDOW, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_GOP_CACHE_SIZE,
+      g_param_spec_uint (GOP_CACHE_SIZE_, "GOP cache size",
+          "Maximum buffers of the last video GOP kept to start new outputs "
+          "without requesting a key frame (0 disables the cache)",
+          0, G_MAXUINT, 0, G_PARAM_READWRITE));
+
   klass->sink_query = GST_DEBUG_FUNCPTR (kms_element_sink_query_default);
   klass->collect_media_stats =
       GST_DEBUG_FUNCPTR (kms_element_collect_media_stats_impl);
@@ -1085,6 +1297,9 @@ kms_element_init (KmsElement * element)
   element->priv->video_pad_count = 0;
   element->priv->audio_agnosticbin = NULL;
   element->priv->video_agnosticbin = NULL;
+  element->priv->kf_arbiter =
+      kms_key_frame_arbiter_new (DEFAULT_KEY_FRAME_REQUEST_WINDOW *
+      GST_MSECOND);
 
   element->priv->pendingpads = g_hash_table_new_full (g_str_hash, g_str_equal,
       g_free, (GDestroyNotify) destroy_pendingpads);
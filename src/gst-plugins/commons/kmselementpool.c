@@ -0,0 +1,287 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "kmselementpool.h"
+
+#define GST_CAT_DEFAULT kms_element_pool_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmselementpool"
+
+typedef struct _KmsElementPoolEntry
+{
+  gchar *factory_name;
+  guint size;
+  guint building;
+  GQueue idle;
+
+  guint64 hits;
+  guint64 misses;
+  guint64 built;
+  GstClockTime acquire_time;
+  GstClockTime build_time;
+} KmsElementPoolEntry;
+
+typedef struct _KmsElementPool
+{
+  GMutex mutex;
+  GHashTable *entries;          /* factory name -> KmsElementPoolEntry */
+  GThreadPool *builders;
+} KmsElementPool;
+
+static void
+kms_element_pool_entry_destroy (KmsElementPoolEntry * entry)
+{
+  g_queue_foreach (&entry->idle, (GFunc) gst_object_unref, NULL);
+  g_queue_clear (&entry->idle);
+  g_free (entry->factory_name);
+
+  g_slice_free (KmsElementPoolEntry, entry);
+}
+
+static KmsElementPool *kms_element_pool_get (void);
+
+static void
+kms_element_pool_fill (gchar * factory_name, gpointer user_data)
+{
+  KmsElementPool *pool = kms_element_pool_get ();
+  KmsElementPoolEntry *entry;
+
+  g_mutex_lock (&pool->mutex);
+
+  entry = g_hash_table_lookup (pool->entries, factory_name);
+
+  while (entry != NULL && entry->idle.length + entry->building < entry->size) {
+    GstElement *element;
+    GstClockTime start;
+
+    entry->building++;
+    g_mutex_unlock (&pool->mutex);
+
+    start = gst_util_get_timestamp ();
+    element = gst_element_factory_make (factory_name, NULL);
+
+    g_mutex_lock (&pool->mutex);
+    entry->building--;
+
+    if (element == NULL) {
+      GST_ERROR ("Cannot create element '%s' for the pool", factory_name);
+      break;
+    }
+
+    entry->build_time += gst_util_get_timestamp () - start;
+    entry->built++;
+    g_queue_push_tail (&entry->idle, gst_object_ref_sink (element));
+  }
+
+  g_mutex_unlock (&pool->mutex);
+
+  g_free (factory_name);
+}
+
+static gpointer
+kms_element_pool_init (gpointer data)
+{
+  KmsElementPool *pool = g_slice_new0 (KmsElementPool);
+
+  g_mutex_init (&pool->mutex);
+  pool->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) kms_element_pool_entry_destroy);
+
+  /* A single builder keeps the background work away from media threads */
+  pool->builders = g_thread_pool_new ((GFunc) kms_element_pool_fill, NULL, 1,
+      FALSE, NULL);
+
+  return pool;
+}
+
+static KmsElementPool *
+kms_element_pool_get (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  return g_once (&once, kms_element_pool_init, NULL);
+}
+
+/* Must be called with the pool mutex held */
+static KmsElementPoolEntry *
+kms_element_pool_get_entry (KmsElementPool * pool, const gchar * factory_name)
+{
+  KmsElementPoolEntry *entry;
+
+  entry = g_hash_table_lookup (pool->entries, factory_name);
+
+  if (entry == NULL) {
+    entry = g_slice_new0 (KmsElementPoolEntry);
+    entry->factory_name = g_strdup (factory_name);
+    g_queue_init (&entry->idle);
+    g_hash_table_insert (pool->entries, entry->factory_name, entry);
+  }
+
+  return entry;
+}
+
+/* Must be called with the pool mutex held */
+static void
+kms_element_pool_schedule_fill (KmsElementPool * pool,
+    KmsElementPoolEntry * entry)
+{
+  if (entry->idle.length + entry->building >= entry->size) {
+    return;
+  }
+
+  g_thread_pool_push (pool->builders, g_strdup (entry->factory_name), NULL);
+}
+
+void
+kms_element_pool_set_size (const gchar * factory_name, guint size)
+{
+  KmsElementPool *pool = kms_element_pool_get ();
+  KmsElementPoolEntry *entry;
+
+  g_return_if_fail (factory_name != NULL);
+
+  g_mutex_lock (&pool->mutex);
+
+  entry = kms_element_pool_get_entry (pool, factory_name);
+
+  if (entry->size != size) {
+    GST_INFO ("Pool size for '%s' set to %u", factory_name, size);
+    entry->size = size;
+  }
+
+  while (entry->idle.length > size) {
+    gst_object_unref (g_queue_pop_tail (&entry->idle));
+  }
+
+  kms_element_pool_schedule_fill (pool, entry);
+
+  g_mutex_unlock (&pool->mutex);
+}
+
+/* Elements are never given back to the pool, so any configuration or
+ * negotiated state of a previous user cannot leak into the next one. This
+ * check guards that invariant: only untouched elements are handed out. */
+static gboolean
+kms_element_pool_is_pristine (GstElement * element)
+{
+  return GST_OBJECT_PARENT (element) == NULL &&
+      GST_STATE (element) == GST_STATE_NULL &&
+      GST_STATE_PENDING (element) == GST_STATE_VOID_PENDING &&
+      GST_OBJECT_REFCOUNT_VALUE (element) == 1;
+}
+
+GstElement *
+kms_element_pool_acquire (const gchar * factory_name)
+{
+  KmsElementPool *pool = kms_element_pool_get ();
+  KmsElementPoolEntry *entry;
+  GstElement *element;
+  GstClockTime start;
+
+  g_return_val_if_fail (factory_name != NULL, NULL);
+
+  start = gst_util_get_timestamp ();
+
+  g_mutex_lock (&pool->mutex);
+
+  entry = g_hash_table_lookup (pool->entries, factory_name);
+
+  if (entry == NULL || entry->size == 0) {
+    g_mutex_unlock (&pool->mutex);
+
+    return gst_element_factory_make (factory_name, NULL);
+  }
+
+  element = g_queue_pop_head (&entry->idle);
+
+  if (element != NULL && !kms_element_pool_is_pristine (element)) {
+    GST_WARNING ("Discarding used '%s' found in the pool", factory_name);
+    gst_object_unref (element);
+    element = NULL;
+  }
+
+  if (element != NULL) {
+    entry->hits++;
+  } else {
+    entry->misses++;
+  }
+
+  kms_element_pool_schedule_fill (pool, entry);
+
+  g_mutex_unlock (&pool->mutex);
+
+  if (element != NULL) {
+    /* Hand it out as gst_element_factory_make would do */
+    g_object_force_floating (G_OBJECT (element));
+  } else {
+    GST_DEBUG ("No idle '%s' in the pool", factory_name);
+    element = gst_element_factory_make (factory_name, NULL);
+  }
+
+  g_mutex_lock (&pool->mutex);
+  entry->acquire_time += gst_util_get_timestamp () - start;
+  g_mutex_unlock (&pool->mutex);
+
+  return element;
+}
+
+GstStructure *
+kms_element_pool_get_stats (void)
+{
+  KmsElementPool *pool = kms_element_pool_get ();
+  GstStructure *stats;
+  GHashTableIter iter;
+  gpointer value;
+
+  stats = gst_structure_new_empty ("element-pool-stats");
+
+  g_mutex_lock (&pool->mutex);
+
+  g_hash_table_iter_init (&iter, pool->entries);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    KmsElementPoolEntry *entry = value;
+    guint64 requests = entry->hits + entry->misses;
+    GstStructure *entry_stats;
+
+    entry_stats = gst_structure_new (entry->factory_name,
+        "size", G_TYPE_UINT, entry->size,
+        "idle", G_TYPE_UINT, entry->idle.length,
+        "hits", G_TYPE_UINT64, entry->hits,
+        "misses", G_TYPE_UINT64, entry->misses,
+        "hit-rate", G_TYPE_DOUBLE,
+        requests > 0 ? (gdouble) entry->hits / requests : 0.0,
+        "avg-acquire-time", G_TYPE_UINT64,
+        requests > 0 ? entry->acquire_time / requests : 0,
+        "avg-build-time", G_TYPE_UINT64,
+        entry->built > 0 ? entry->build_time / entry->built : 0, NULL);
+
+    gst_structure_set (stats, entry->factory_name, GST_TYPE_STRUCTURE,
+        entry_stats, NULL);
+    gst_structure_free (entry_stats);
+  }
+
+  g_mutex_unlock (&pool->mutex);
+
+  return stats;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
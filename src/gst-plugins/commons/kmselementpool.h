@@ -0,0 +1,39 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_ELEMENT_POOL_H__
+#define __KMS_ELEMENT_POOL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Process-wide pools of idle elements built in the background. Pooled
+ * elements are created in NULL state and are never reused once handed out:
+ * there is no release call, each acquisition schedules a fresh replacement
+ * instead, so properties set by a user never reach the next one. */
+void kms_element_pool_set_size (const gchar * factory_name, guint size);
+
+/* Returns a floating element like gst_element_factory_make, taken from the
+ * pool when there is an idle one */
+GstElement * kms_element_pool_acquire (const gchar * factory_name);
+
+/* One structure field per factory with hits, misses, idle elements and
+ * average acquire and build times (ns) */
+GstStructure * kms_element_pool_get_stats (void);
+
+G_END_DECLS
+
+#endif /* __KMS_ELEMENT_POOL_H__ */
@@ -0,0 +1,274 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "kmsfactorycache.h"
+
+#define GST_CAT_DEFAULT kms_factory_cache_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsfactorycache"
+
+/* Only these fields take part in factory matching, per-stream values such */
+/* as ssrc, clock-base or seqnum-base would give every stream its own entry */
+static const gchar *stable_fields[] = {
+  "media", "encoding-name", "clock-rate", "format", "stream-format",
+  "alignment", "mpegversion", "layer", NULL
+};
+
+typedef struct _KmsFactoryCache
+{
+  GMutex mutex;
+  GHashTable *elements;         /* type -> GList of factories */
+  GHashTable *filtered;         /* key string -> GList of factories */
+  GQueue keys;                  /* keys of filtered, oldest first */
+} KmsFactoryCache;
+
+static void
+kms_factory_cache_list_free (gpointer list)
+{
+  gst_plugin_feature_list_free (list);
+}
+
+static void
+kms_factory_cache_registry_changed (GstRegistry * registry, gpointer object,
+    KmsFactoryCache * cache)
+{
+  GST_DEBUG ("Registry changed, dropping cached factories");
+
+  g_mutex_lock (&cache->mutex);
+  g_hash_table_remove_all (cache->elements);
+  g_hash_table_remove_all (cache->filtered);
+  g_queue_clear (&cache->keys);
+  g_mutex_unlock (&cache->mutex);
+}
+
+static gpointer
+kms_factory_cache_init (gpointer data)
+{
+  KmsFactoryCache *cache = g_slice_new0 (KmsFactoryCache);
+  GstRegistry *registry = gst_registry_get ();
+
+  g_mutex_init (&cache->mutex);
+  g_queue_init (&cache->keys);
+  cache->elements = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+      g_free, kms_factory_cache_list_free);
+  cache->filtered = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      kms_factory_cache_list_free);
+
+  g_signal_connect (registry, "feature-added",
+      G_CALLBACK (kms_factory_cache_registry_changed), cache);
+  g_signal_connect (registry, "plugin-added",
+      G_CALLBACK (kms_factory_cache_registry_changed), cache);
+
+  return cache;
+}
+
+static KmsFactoryCache *
+kms_factory_cache_get (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  return g_once (&once, kms_factory_cache_init, NULL);
+}
+
+static GList *
+kms_factory_cache_create_elements (GstElementFactoryListType type)
+{
+  GList *list, *l;
+
+  list = gst_element_factory_list_get_elements (type, GST_RANK_NONE);
+
+  /* HACK: Augment the openh264 rank */
+  for (l = list; l != NULL; l = l->next) {
+    GstElementFactory *factory = GST_ELEMENT_FACTORY (l->data);
+
+    if (g_str_has_prefix (GST_OBJECT_NAME (factory), "openh264")) {
+      list = g_list_remove (list, factory);
+      list = g_list_prepend (list, factory);
+      break;
+    }
+  }
+
+  return list;
+}
+
+/* Must be called with the cache mutex held */
+static GList *
+kms_factory_cache_lookup_elements (KmsFactoryCache * cache,
+    GstElementFactoryListType type)
+{
+  gpointer list;
+
+  if (g_hash_table_lookup_extended (cache->elements, &type, NULL, &list)) {
+    return list;
+  }
+
+  list = kms_factory_cache_create_elements (type);
+  g_hash_table_insert (cache->elements, g_memdup (&type, sizeof (type)),
+      list);
+
+  return list;
+}
+
+GList *
+kms_factory_cache_get_elements (GstElementFactoryListType type)
+{
+  KmsFactoryCache *cache = kms_factory_cache_get ();
+  GList *list;
+
+  g_mutex_lock (&cache->mutex);
+  list = gst_plugin_feature_list_copy (kms_factory_cache_lookup_elements
+      (cache, type));
+  g_mutex_unlock (&cache->mutex);
+
+  return list;
+}
+
+static GstCaps *
+kms_factory_cache_create_stable_caps (const GstCaps * caps)
+{
+  GstCaps *stable;
+  guint i, j;
+
+  if (gst_caps_is_any (caps)) {
+    return gst_caps_copy (caps);
+  }
+
+  stable = gst_caps_new_empty ();
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    GstStructure *st = gst_caps_get_structure (caps, i);
+    GstCapsFeatures *features = gst_caps_get_features (caps, i);
+    GstStructure *copy;
+
+    copy = gst_structure_new_empty (gst_structure_get_name (st));
+
+    for (j = 0; stable_fields[j] != NULL; j++) {
+      const GValue *value = gst_structure_get_value (st, stable_fields[j]);
+
+      if (value != NULL) {
+        gst_structure_set_value (copy, stable_fields[j], value);
+      }
+    }
+
+    gst_caps_append_structure_full (stable, copy,
+        features != NULL ? gst_caps_features_copy (features) : NULL);
+  }
+
+  return gst_caps_normalize (stable);
+}
+
+static gchar *
+kms_factory_cache_create_key (GstElementFactoryListType type,
+    const GstCaps * caps, GstPadDirection direction)
+{
+  gchar *caps_str, *key;
+
+  caps_str = gst_caps_to_string (caps);
+  key = g_strdup_printf ("%" G_GUINT64_FORMAT "/%d/%s", type, direction,
+      caps_str);
+  g_free (caps_str);
+
+  return key;
+}
+
+/* Must be called with the cache mutex held */
+static void
+kms_factory_cache_insert_filtered (KmsFactoryCache * cache, gchar * key,
+    GList * list)
+{
+  while (g_queue_get_length (&cache->keys) >= KMS_FACTORY_CACHE_MAX_FILTERED) {
+    gchar *oldest = g_queue_pop_head (&cache->keys);
+
+    GST_DEBUG ("Evicting %s", oldest);
+    /* Frees oldest */
+    g_hash_table_remove (cache->filtered, oldest);
+  }
+
+  /* The table takes the key, the queue only references it */
+  g_hash_table_insert (cache->filtered, key, list);
+  g_queue_push_tail (&cache->keys, key);
+}
+
+GList *
+kms_factory_cache_filter (GstElementFactoryListType type,
+    const GstCaps * caps, GstPadDirection direction)
+{
+  KmsFactoryCache *cache = kms_factory_cache_get ();
+  GList *list, *elements;
+  GstCaps *stable;
+  gpointer value;
+  gchar *key;
+
+  g_return_val_if_fail (GST_IS_CAPS (caps), NULL);
+
+  /* Results are computed from the stable caps so that they only depend on */
+  /* the key they are stored under */
+  stable = kms_factory_cache_create_stable_caps (caps);
+  key = kms_factory_cache_create_key (type, stable, direction);
+
+  g_mutex_lock (&cache->mutex);
+
+  if (g_hash_table_lookup_extended (cache->filtered, key, NULL, &value)) {
+    list = gst_plugin_feature_list_copy (value);
+    g_mutex_unlock (&cache->mutex);
+    gst_caps_unref (stable);
+    g_free (key);
+
+    return list;
+  }
+
+  elements = kms_factory_cache_lookup_elements (cache, type);
+  list = gst_element_factory_list_filter (elements, stable, direction, FALSE);
+
+  GST_DEBUG ("Caching %u factories for %s", g_list_length (list), key);
+
+  /* Empty results are cached too */
+  kms_factory_cache_insert_filtered (cache, key, list);
+  list = gst_plugin_feature_list_copy (list);
+
+  g_mutex_unlock (&cache->mutex);
+  gst_caps_unref (stable);
+
+  return list;
+}
+
+guint
+kms_factory_cache_get_size (void)
+{
+  KmsFactoryCache *cache = kms_factory_cache_get ();
+  guint size;
+
+  g_mutex_lock (&cache->mutex);
+  size = g_hash_table_size (cache->filtered);
+  g_mutex_unlock (&cache->mutex);
+
+  return size;
+}
+
+void
+kms_factory_cache_clear (void)
+{
+  kms_factory_cache_registry_changed (gst_registry_get (), NULL,
+      kms_factory_cache_get ());
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
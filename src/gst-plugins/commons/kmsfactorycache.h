@@ -0,0 +1,43 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_FACTORY_CACHE_H__
+#define __KMS_FACTORY_CACHE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_FACTORY_CACHE_MAX_FILTERED 256
+
+/* Process-wide cache of element factory lookups. Results are kept per
+ * (factory type, stable caps, direction), where stable caps only keep the
+ * media type and format fields (media, encoding-name, clock-rate...), so
+ * streams differing in ssrc or sequence bases share an entry. At most
+ * KMS_FACTORY_CACHE_MAX_FILTERED results are kept, oldest evicted first, and
+ * all are dropped whenever a feature or a plugin is added to the registry.
+ * Returned lists must be freed with gst_plugin_feature_list_free. */
+GList * kms_factory_cache_get_elements (GstElementFactoryListType type);
+GList * kms_factory_cache_filter (GstElementFactoryListType type,
+    const GstCaps * caps, GstPadDirection direction);
+
+/* Number of filtered lookups currently cached */
+guint kms_factory_cache_get_size (void);
+
+void kms_factory_cache_clear (void);
+
+G_END_DECLS
+
+#endif /* __KMS_FACTORY_CACHE_H__ */
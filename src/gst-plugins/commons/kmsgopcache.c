@@ -0,0 +1,257 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "kmsgopcache.h"
+#include "kmsrefstruct.h"
+#include "kmsutils.h"
+
+#define GST_CAT_DEFAULT kms_gop_cache_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsgopcache"
+
+#define KMS_GOP_CACHE_LOCK(cache) \
+  (g_mutex_lock (&(cache)->mutex))
+#define KMS_GOP_CACHE_UNLOCK(cache) \
+  (g_mutex_unlock (&(cache)->mutex))
+
+struct _KmsGopCache
+{
+  KmsRefStruct ref;
+  GMutex mutex;
+
+  guint max_buffers;
+  GQueue buffers;               /* key frame followed by its deltas */
+  gboolean valid;
+};
+
+typedef struct _KmsGopPriming
+{
+  KmsGopCache *cache;
+  gboolean done;
+} KmsGopPriming;
+
+/* Must be called with the cache lock held */
+static void
+kms_gop_cache_clear (KmsGopCache * cache)
+{
+  GstBuffer *buffer;
+
+  while ((buffer = g_queue_pop_head (&cache->buffers)) != NULL) {
+    gst_buffer_unref (buffer);
+  }
+
+  cache->valid = FALSE;
+}
+
+static void
+kms_gop_cache_destroy (KmsGopCache * cache)
+{
+  kms_gop_cache_clear (cache);
+  g_mutex_clear (&cache->mutex);
+
+  g_slice_free (KmsGopCache, cache);
+}
+
+KmsGopCache *
+kms_gop_cache_ref (KmsGopCache * cache)
+{
+  return (KmsGopCache *) kms_ref_struct_ref (KMS_REF_STRUCT_CAST (cache));
+}
+
+void
+kms_gop_cache_unref (KmsGopCache * cache)
+{
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (cache));
+}
+
+KmsGopCache *
+kms_gop_cache_new (guint max_buffers)
+{
+  KmsGopCache *cache;
+
+  cache = g_slice_new0 (KmsGopCache);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (cache),
+      (GDestroyNotify) kms_gop_cache_destroy);
+
+  g_mutex_init (&cache->mutex);
+  g_queue_init (&cache->buffers);
+  cache->max_buffers = max_buffers;
+
+  return cache;
+}
+
+gboolean
+kms_gop_cache_has_key_frame (KmsGopCache * cache)
+{
+  gboolean valid;
+
+  KMS_GOP_CACHE_LOCK (cache);
+  valid = cache->valid;
+  KMS_GOP_CACHE_UNLOCK (cache);
+
+  return valid;
+}
+
+static void
+kms_gop_cache_store (KmsGopCache * cache, GstBuffer * buffer)
+{
+  KMS_GOP_CACHE_LOCK (cache);
+
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    kms_gop_cache_clear (cache);
+    cache->valid = TRUE;
+  } else if (!cache->valid) {
+    goto end;
+  } else if (g_queue_get_length (&cache->buffers) >= cache->max_buffers) {
+    GST_DEBUG ("GOP longer than %u buffers, not caching until next key frame",
+        cache->max_buffers);
+    kms_gop_cache_clear (cache);
+    goto end;
+  }
+
+  g_queue_push_tail (&cache->buffers, gst_buffer_ref (buffer));
+
+end:
+  KMS_GOP_CACHE_UNLOCK (cache);
+}
+
+static GstPadProbeReturn
+kms_gop_cache_watch_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsGopCache *cache = user_data;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    kms_gop_cache_store (cache, GST_PAD_PROBE_INFO_BUFFER (info));
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_BOTH) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    /* Cached buffers do not belong to the new stream */
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS ||
+        GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+      KMS_GOP_CACHE_LOCK (cache);
+      kms_gop_cache_clear (cache);
+      KMS_GOP_CACHE_UNLOCK (cache);
+    }
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+void
+kms_gop_cache_watch_pad (KmsGopCache * cache, GstPad * pad)
+{
+  g_return_if_fail (GST_IS_PAD (pad));
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      kms_gop_cache_watch_probe, kms_gop_cache_ref (cache),
+      (GDestroyNotify) kms_gop_cache_unref);
+}
+
+static void
+kms_gop_priming_destroy (KmsGopPriming * priming)
+{
+  kms_gop_cache_unref (priming->cache);
+
+  g_slice_free (KmsGopPriming, priming);
+}
+
+static GstPadProbeReturn
+kms_gop_cache_prime_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsGopPriming *priming = user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GQueue pending = G_QUEUE_INIT;
+  GstBuffer *cached;
+  GList *l;
+
+  if (priming->done) {
+    /* Cached buffers sent from this probe */
+    return GST_PAD_PROBE_OK;
+  }
+
+  priming->done = TRUE;
+
+  KMS_GOP_CACHE_LOCK (priming->cache);
+
+  if (priming->cache->valid) {
+    for (l = priming->cache->buffers.head; l != NULL; l = l->next) {
+      /* Current buffer was cached before reaching this pad */
+      if (l->data != buffer) {
+        g_queue_push_tail (&pending, gst_buffer_ref (l->data));
+      }
+    }
+  }
+
+  KMS_GOP_CACHE_UNLOCK (priming->cache);
+
+  if (g_queue_is_empty (&pending)) {
+    if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+      GST_DEBUG_OBJECT (pad, "No GOP cached, waiting for a key frame");
+      kms_utils_drop_until_keyframe (pad, TRUE);
+      return GST_PAD_PROBE_DROP;
+    }
+
+    return GST_PAD_PROBE_REMOVE;
+  }
+
+  GST_DEBUG_OBJECT (pad, "Priming with %u cached buffers", pending.length);
+
+  while ((cached = g_queue_pop_head (&pending)) != NULL) {
+    GstFlowReturn ret;
+
+    if (GST_PAD_IS_SRC (pad)) {
+      ret = gst_pad_push (pad, cached);
+    } else {
+      ret = gst_pad_chain (pad, cached);
+    }
+
+    if (ret != GST_FLOW_OK) {
+      GST_DEBUG_OBJECT (pad, "Priming stopped: %s", gst_flow_get_name (ret));
+      g_queue_foreach (&pending, (GFunc) gst_buffer_unref, NULL);
+      g_queue_clear (&pending);
+    }
+  }
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+void
+kms_gop_cache_prime_pad (KmsGopCache * cache, GstPad * pad)
+{
+  KmsGopPriming *priming;
+
+  g_return_if_fail (GST_IS_PAD (pad));
+
+  priming = g_slice_new0 (KmsGopPriming);
+  priming->cache = kms_gop_cache_ref (cache);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, kms_gop_cache_prime_probe,
+      priming, (GDestroyNotify) kms_gop_priming_destroy);
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
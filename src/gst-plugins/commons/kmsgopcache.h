@@ -0,0 +1,45 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_GOP_CACHE_H__
+#define __KMS_GOP_CACHE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _KmsGopCache KmsGopCache;
+
+/* Keeps the last key frame seen on a pad and the delta frames after it, up
+ * to @max_buffers. Longer GOPs invalidate the cache until the next key frame.
+ */
+KmsGopCache * kms_gop_cache_new (guint max_buffers);
+
+KmsGopCache * kms_gop_cache_ref (KmsGopCache * cache);
+void kms_gop_cache_unref (KmsGopCache * cache);
+
+/* Stores buffers flowing downstream through @pad */
+void kms_gop_cache_watch_pad (KmsGopCache * cache, GstPad * pad);
+
+gboolean kms_gop_cache_has_key_frame (KmsGopCache * cache);
+
+/* Before the first buffer goes through @pad, the cached GOP is sent on it so
+ * that the stream starts with a key frame without requesting a new one. If
+ * there is no valid GOP by then, buffers are dropped until a key frame. */
+void kms_gop_cache_prime_pad (KmsGopCache * cache, GstPad * pad);
+
+G_END_DECLS
+
+#endif /* __KMS_GOP_CACHE_H__ */
@@ -0,0 +1,388 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "kmsjitterbuffercontrol.h"
+#include "kmsrefstruct.h"
+
+#include <gst/rtp/gstrtpbuffer.h>
+
+#define GST_CAT_DEFAULT kms_jitter_buffer_control_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsjitterbuffercontrol"
+
+#define UPDATE_INTERVAL GST_SECOND
+
+/* Latency needed to absorb the measured jitter */
+#define JITTER_FACTOR 4
+
+/* Losses below this ratio do not make room for retransmissions */
+#define LOSS_THRESHOLD 0.005
+#define LOSS_SMOOTHING 0.25
+
+/* Latency grows at once but shrinks by 1/DECAY_DIVISOR of the gap on each
+ * update, so a single quiet interval does not undo a burst. */
+#define DECAY_DIVISOR 4
+
+/* Changing the latency makes the pipeline recompute it, avoid small steps */
+#define MIN_LATENCY_STEP 10
+
+#define KMS_JITTER_BUFFER_CONTROL_LOCK(control) \
+  (g_mutex_lock (&(control)->mutex))
+#define KMS_JITTER_BUFFER_CONTROL_UNLOCK(control) \
+  (g_mutex_unlock (&(control)->mutex))
+
+struct _KmsJitterBufferControl
+{
+  KmsRefStruct ref;
+
+  /* Bounds are only read and written together so that min <= max holds */
+  GMutex mutex;
+  guint min_latency;
+  guint max_latency;
+
+  gint target_latency;
+  gboolean rtx;
+
+  /* Next fields are only accessed from the jitterbuffer streaming thread */
+  gboolean started;
+  guint clock_rate;
+  gboolean have_transit;
+  gint32 last_transit;
+  guint32 jitter;               /* RFC 3550 interarrival jitter, scaled by 16 */
+  gboolean have_seq;
+  guint16 last_seq;
+  guint32 expected;
+  guint32 received;
+  gdouble loss;
+  GstClockTime last_update;
+};
+
+static void
+kms_jitter_buffer_control_destroy (KmsJitterBufferControl * control)
+{
+  g_mutex_clear (&control->mutex);
+  g_slice_free (KmsJitterBufferControl, control);
+}
+
+KmsJitterBufferControl *
+kms_jitter_buffer_control_ref (KmsJitterBufferControl * control)
+{
+  return (KmsJitterBufferControl *)
+      kms_ref_struct_ref (KMS_REF_STRUCT_CAST (control));
+}
+
+void
+kms_jitter_buffer_control_unref (KmsJitterBufferControl * control)
+{
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (control));
+}
+
+void
+kms_jitter_buffer_control_set_bounds (KmsJitterBufferControl * control,
+    guint min_latency, guint max_latency)
+{
+  g_return_if_fail (control != NULL);
+
+  if (max_latency < min_latency) {
+    GST_WARNING ("Max latency %u lower than min latency %u, using min",
+        max_latency, min_latency);
+    max_latency = min_latency;
+  }
+
+  KMS_JITTER_BUFFER_CONTROL_LOCK (control);
+  control->min_latency = min_latency;
+  control->max_latency = max_latency;
+  KMS_JITTER_BUFFER_CONTROL_UNLOCK (control);
+}
+
+static void
+kms_jitter_buffer_control_get_bounds (KmsJitterBufferControl * control,
+    guint * min_latency, guint * max_latency)
+{
+  KMS_JITTER_BUFFER_CONTROL_LOCK (control);
+  *min_latency = control->min_latency;
+  *max_latency = control->max_latency;
+  KMS_JITTER_BUFFER_CONTROL_UNLOCK (control);
+}
+
+guint
+kms_jitter_buffer_control_get_target_latency (KmsJitterBufferControl *
+    control)
+{
+  g_return_val_if_fail (control != NULL, 0);
+
+  return g_atomic_int_get (&control->target_latency);
+}
+
+static GstClockTime
+kms_jitter_buffer_control_get_rtt (GstElement * jitterbuffer)
+{
+  GstStructure *stats = NULL;
+  guint64 rtt = 0;
+
+  g_object_get (jitterbuffer, "stats", &stats, NULL);
+
+  if (stats == NULL) {
+    return 0;
+  }
+
+  if (!gst_structure_get_uint64 (stats, "rtx-rtt", &rtt)) {
+    rtt = 0;
+  }
+
+  gst_structure_free (stats);
+
+  return rtt;
+}
+
+static guint
+kms_jitter_buffer_control_compute_target (KmsJitterBufferControl * control,
+    GstElement * jitterbuffer)
+{
+  guint64 target = 0;
+  guint min_latency, max_latency;
+
+  if (control->clock_rate > 0) {
+    target = gst_util_uint64_scale_int (JITTER_FACTOR * (control->jitter >> 4),
+        1000, control->clock_rate);
+  }
+
+  if (control->rtx && control->loss > LOSS_THRESHOLD) {
+    GstClockTime rtt = kms_jitter_buffer_control_get_rtt (jitterbuffer);
+
+    /* Leave room for at least one retransmission to arrive */
+    target += (3 * rtt / 2) / GST_MSECOND;
+  }
+
+  kms_jitter_buffer_control_get_bounds (control, &min_latency, &max_latency);
+
+  return CLAMP (target, min_latency, max_latency);
+}
+
+static void
+kms_jitter_buffer_control_update (KmsJitterBufferControl * control,
+    GstElement * jitterbuffer)
+{
+  guint current, target, step;
+
+  if (control->expected > 0) {
+    gdouble fraction = 0.0;
+
+    if (control->expected > control->received) {
+      fraction = (gdouble) (control->expected - control->received) /
+          control->expected;
+    }
+
+    control->loss += LOSS_SMOOTHING * (fraction - control->loss);
+  }
+
+  control->expected = control->received = 0;
+
+  current = g_atomic_int_get (&control->target_latency);
+  target = kms_jitter_buffer_control_compute_target (control, jitterbuffer);
+
+  if (target < current) {
+    target = current - (current - target + DECAY_DIVISOR - 1) / DECAY_DIVISOR;
+  }
+
+  step = MAX (MIN_LATENCY_STEP, current / 10);
+
+  if ((target > current ? target - current : current - target) < step) {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (jitterbuffer, "Latency %u -> %u ms (jitter: %u, loss: %f)",
+      current, target, control->jitter >> 4, control->loss);
+
+  g_atomic_int_set (&control->target_latency, target);
+  g_object_set (jitterbuffer, "latency", target, NULL);
+}
+
+static void
+kms_jitter_buffer_control_process_buffer (KmsJitterBufferControl * control,
+    GstBuffer * buffer, GstClockTime now)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  guint32 rtptime, arrival;
+  gint32 transit, d;
+  guint16 seq, delta;
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp)) {
+    return;
+  }
+
+  seq = gst_rtp_buffer_get_seq (&rtp);
+  rtptime = gst_rtp_buffer_get_timestamp (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  control->received++;
+
+  if (control->have_seq) {
+    delta = seq - control->last_seq;
+    if (delta > 0 && delta < G_MAXINT16) {
+      control->expected += delta;
+      control->last_seq = seq;
+    }
+  } else {
+    control->expected++;
+    control->last_seq = seq;
+    control->have_seq = TRUE;
+  }
+
+  if (control->clock_rate == 0) {
+    return;
+  }
+
+  arrival = gst_util_uint64_scale_int (now, control->clock_rate, GST_SECOND);
+  transit = (gint32) (arrival - rtptime);
+
+  if (control->have_transit) {
+    d = ABS (transit - control->last_transit);
+    control->jitter += d - ((control->jitter + 8) >> 4);
+  }
+
+  control->last_transit = transit;
+  control->have_transit = TRUE;
+}
+
+static gboolean
+kms_jitter_buffer_control_process_list_item (GstBuffer ** buffer, guint idx,
+    gpointer data)
+{
+  gpointer *args = data;
+
+  kms_jitter_buffer_control_process_buffer (args[0], *buffer,
+      *(GstClockTime *) args[1]);
+
+  return TRUE;
+}
+
+static void
+kms_jitter_buffer_control_process_caps (KmsJitterBufferControl * control,
+    GstCaps * caps)
+{
+  const GstStructure *st;
+  gint clock_rate;
+
+  if (gst_caps_get_size (caps) == 0) {
+    return;
+  }
+
+  st = gst_caps_get_structure (caps, 0);
+
+  if (gst_structure_get_int (st, "clock-rate", &clock_rate) && clock_rate > 0
+      && (guint) clock_rate != control->clock_rate) {
+    control->clock_rate = clock_rate;
+    control->have_transit = FALSE;
+    control->jitter = 0;
+  }
+}
+
+static GstPadProbeReturn
+kms_jitter_buffer_control_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer data)
+{
+  KmsJitterBufferControl *control = data;
+  GstElement *jitterbuffer = GST_PAD_PARENT (pad);
+  GstClockTime now;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      kms_jitter_buffer_control_process_caps (control, caps);
+    }
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (jitterbuffer == NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  now = g_get_monotonic_time () * GST_USECOND;
+
+  if (!control->started) {
+    guint latency, max_latency;
+
+    kms_jitter_buffer_control_get_bounds (control, &latency, &max_latency);
+    control->started = TRUE;
+    control->last_update = now;
+    g_atomic_int_set (&control->target_latency, latency);
+    g_object_set (jitterbuffer, "latency", latency, NULL);
+  }
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    kms_jitter_buffer_control_process_buffer (control,
+        GST_PAD_PROBE_INFO_BUFFER (info), now);
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    gpointer args[] = { control, &now };
+
+    gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+        kms_jitter_buffer_control_process_list_item, args);
+  }
+
+  if (now - control->last_update >= UPDATE_INTERVAL) {
+    control->last_update = now;
+    kms_jitter_buffer_control_update (control, jitterbuffer);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+KmsJitterBufferControl *
+kms_jitter_buffer_control_new (GstElement * jitterbuffer, guint min_latency,
+    guint max_latency, gboolean rtx)
+{
+  KmsJitterBufferControl *control;
+  GstPad *sink_pad;
+
+  g_return_val_if_fail (GST_IS_ELEMENT (jitterbuffer), NULL);
+
+  control = g_slice_new0 (KmsJitterBufferControl);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (control),
+      (GDestroyNotify) kms_jitter_buffer_control_destroy);
+
+  g_mutex_init (&control->mutex);
+  control->rtx = rtx;
+  kms_jitter_buffer_control_set_bounds (control, min_latency, max_latency);
+
+  sink_pad = gst_element_get_static_pad (jitterbuffer, "sink");
+  if (sink_pad == NULL) {
+    GST_WARNING_OBJECT (jitterbuffer, "No sink pad, latency is not adapted");
+    return control;
+  }
+
+  gst_pad_add_probe (sink_pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, kms_jitter_buffer_control_probe,
+      kms_jitter_buffer_control_ref (control),
+      (GDestroyNotify) kms_jitter_buffer_control_unref);
+  g_object_unref (sink_pad);
+
+  return control;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,44 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_JITTER_BUFFER_CONTROL_H__
+#define __KMS_JITTER_BUFFER_CONTROL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _KmsJitterBufferControl KmsJitterBufferControl;
+
+/* Attaches an adaptive latency policy to a rtpjitterbuffer. Latency is sized
+ * from the measured interarrival jitter plus, when retransmissions are
+ * enabled and losses are observed, the round trip time, and it is always
+ * kept between min_latency and max_latency (milliseconds). */
+KmsJitterBufferControl * kms_jitter_buffer_control_new (
+    GstElement * jitterbuffer, guint min_latency, guint max_latency,
+    gboolean rtx);
+
+KmsJitterBufferControl * kms_jitter_buffer_control_ref (
+    KmsJitterBufferControl * control);
+void kms_jitter_buffer_control_unref (KmsJitterBufferControl * control);
+
+void kms_jitter_buffer_control_set_bounds (KmsJitterBufferControl * control,
+    guint min_latency, guint max_latency);
+guint kms_jitter_buffer_control_get_target_latency (
+    KmsJitterBufferControl * control);
+
+G_END_DECLS
+
+#endif /* __KMS_JITTER_BUFFER_CONTROL_H__ */
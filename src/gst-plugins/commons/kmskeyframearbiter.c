@@ -0,0 +1,206 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/video/video-event.h>
+
+#include "kmskeyframearbiter.h"
+#include "kmsrefstruct.h"
+#include "kmsutils.h"
+
+#define GST_CAT_DEFAULT kms_key_frame_arbiter_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmskeyframearbiter"
+
+#define KMS_KEY_FRAME_ARBITER_LOCK(arbiter) \
+  (g_mutex_lock (&(arbiter)->mutex))
+#define KMS_KEY_FRAME_ARBITER_UNLOCK(arbiter) \
+  (g_mutex_unlock (&(arbiter)->mutex))
+
+struct _KmsKeyFrameArbiter
+{
+  KmsRefStruct ref;
+  GMutex mutex;
+
+  GstClockTime window;
+  gboolean pending;             /* a request was forwarded, no key frame yet */
+  GstClockTime last_forwarded;
+
+  guint64 requested;
+  guint64 forwarded;
+};
+
+static void
+kms_key_frame_arbiter_destroy (KmsKeyFrameArbiter * arbiter)
+{
+  g_mutex_clear (&arbiter->mutex);
+
+  g_slice_free (KmsKeyFrameArbiter, arbiter);
+}
+
+KmsKeyFrameArbiter *
+kms_key_frame_arbiter_ref (KmsKeyFrameArbiter * arbiter)
+{
+  return (KmsKeyFrameArbiter *)
+      kms_ref_struct_ref (KMS_REF_STRUCT_CAST (arbiter));
+}
+
+void
+kms_key_frame_arbiter_unref (KmsKeyFrameArbiter * arbiter)
+{
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (arbiter));
+}
+
+KmsKeyFrameArbiter *
+kms_key_frame_arbiter_new (GstClockTime window)
+{
+  KmsKeyFrameArbiter *arbiter;
+
+  arbiter = g_slice_new0 (KmsKeyFrameArbiter);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (arbiter),
+      (GDestroyNotify) kms_key_frame_arbiter_destroy);
+
+  g_mutex_init (&arbiter->mutex);
+  arbiter->window = window;
+  arbiter->last_forwarded = GST_CLOCK_TIME_NONE;
+
+  return arbiter;
+}
+
+void
+kms_key_frame_arbiter_set_window (KmsKeyFrameArbiter * arbiter,
+    GstClockTime window)
+{
+  KMS_KEY_FRAME_ARBITER_LOCK (arbiter);
+  arbiter->window = window;
+  KMS_KEY_FRAME_ARBITER_UNLOCK (arbiter);
+}
+
+GstClockTime
+kms_key_frame_arbiter_get_window (KmsKeyFrameArbiter * arbiter)
+{
+  GstClockTime window;
+
+  KMS_KEY_FRAME_ARBITER_LOCK (arbiter);
+  window = arbiter->window;
+  KMS_KEY_FRAME_ARBITER_UNLOCK (arbiter);
+
+  return window;
+}
+
+void
+kms_key_frame_arbiter_get_counters (KmsKeyFrameArbiter * arbiter,
+    guint64 * requested, guint64 * forwarded)
+{
+  KMS_KEY_FRAME_ARBITER_LOCK (arbiter);
+
+  if (requested != NULL) {
+    *requested = arbiter->requested;
+  }
+
+  if (forwarded != NULL) {
+    *forwarded = arbiter->forwarded;
+  }
+
+  KMS_KEY_FRAME_ARBITER_UNLOCK (arbiter);
+}
+
+static gboolean
+kms_key_frame_arbiter_check_request (KmsKeyFrameArbiter * arbiter)
+{
+  GstClockTime now = kms_utils_get_time_nsecs ();
+  gboolean forward;
+
+  KMS_KEY_FRAME_ARBITER_LOCK (arbiter);
+
+  arbiter->requested++;
+
+  /* A lost request or key frame must not block requests forever */
+  forward = !arbiter->pending ||
+      !GST_CLOCK_TIME_IS_VALID (arbiter->last_forwarded) ||
+      arbiter->last_forwarded + arbiter->window <= now;
+
+  if (forward) {
+    arbiter->pending = TRUE;
+    arbiter->last_forwarded = now;
+    arbiter->forwarded++;
+  }
+
+  KMS_KEY_FRAME_ARBITER_UNLOCK (arbiter);
+
+  return forward;
+}
+
+static GstPadProbeReturn
+kms_key_frame_arbiter_event_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsKeyFrameArbiter *arbiter = user_data;
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+  if (!gst_video_event_is_force_key_unit (event)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (kms_key_frame_arbiter_check_request (arbiter)) {
+    GST_TRACE_OBJECT (pad, "Forwarding key frame request");
+    return GST_PAD_PROBE_OK;
+  } else {
+    GST_TRACE_OBJECT (pad, "Coalescing key frame request");
+    return GST_PAD_PROBE_DROP;
+  }
+}
+
+static GstPadProbeReturn
+kms_key_frame_arbiter_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsKeyFrameArbiter *arbiter = user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  KMS_KEY_FRAME_ARBITER_LOCK (arbiter);
+  arbiter->pending = FALSE;
+  KMS_KEY_FRAME_ARBITER_UNLOCK (arbiter);
+
+  return GST_PAD_PROBE_OK;
+}
+
+void
+kms_key_frame_arbiter_watch_pad (KmsKeyFrameArbiter * arbiter, GstPad * pad)
+{
+  g_return_if_fail (GST_IS_PAD (pad));
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+      kms_key_frame_arbiter_event_probe, kms_key_frame_arbiter_ref (arbiter),
+      (GDestroyNotify) kms_key_frame_arbiter_unref);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      kms_key_frame_arbiter_buffer_probe, kms_key_frame_arbiter_ref (arbiter),
+      (GDestroyNotify) kms_key_frame_arbiter_unref);
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,46 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_KEY_FRAME_ARBITER_H__
+#define __KMS_KEY_FRAME_ARBITER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _KmsKeyFrameArbiter KmsKeyFrameArbiter;
+
+/* Coalesces upstream key frame requests coming from every branch fed by a
+ * publisher. Once a request is forwarded, further requests are dropped until
+ * a key frame goes through the watched pads or the window expires. */
+KmsKeyFrameArbiter * kms_key_frame_arbiter_new (GstClockTime window);
+
+KmsKeyFrameArbiter * kms_key_frame_arbiter_ref (KmsKeyFrameArbiter * arbiter);
+void kms_key_frame_arbiter_unref (KmsKeyFrameArbiter * arbiter);
+
+void kms_key_frame_arbiter_set_window (KmsKeyFrameArbiter * arbiter,
+    GstClockTime window);
+GstClockTime kms_key_frame_arbiter_get_window (KmsKeyFrameArbiter * arbiter);
+
+/* Requests are expected upstream and key frames downstream on @pad */
+void kms_key_frame_arbiter_watch_pad (KmsKeyFrameArbiter * arbiter,
+    GstPad * pad);
+
+void kms_key_frame_arbiter_get_counters (KmsKeyFrameArbiter * arbiter,
+    guint64 * requested, guint64 * forwarded);
+
+G_END_DECLS
+
+#endif /* __KMS_KEY_FRAME_ARBITER_H__ */
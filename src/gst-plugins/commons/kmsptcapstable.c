@@ -0,0 +1,106 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "kmsptcapstable.h"
+
+#define GST_CAT_DEFAULT kms_pt_caps_table_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsptcapstable"
+
+struct _KmsPtCapsTable
+{
+  GMutex mutex;
+  GHashTable *pt_caps;
+};
+
+KmsPtCapsTable *
+kms_pt_caps_table_new (void)
+{
+  KmsPtCapsTable *table;
+
+  table = g_slice_new0 (KmsPtCapsTable);
+  g_mutex_init (&table->mutex);
+
+  return table;
+}
+
+void
+kms_pt_caps_table_free (KmsPtCapsTable * table)
+{
+  if (table->pt_caps != NULL) {
+    g_hash_table_unref (table->pt_caps);
+  }
+
+  g_mutex_clear (&table->mutex);
+  g_slice_free (KmsPtCapsTable, table);
+}
+
+void
+kms_pt_caps_table_set (KmsPtCapsTable * table, GHashTable * pt_caps)
+{
+  GHashTable *old;
+
+  GST_DEBUG ("Caps table set for %u payload types",
+      g_hash_table_size (pt_caps));
+
+  g_mutex_lock (&table->mutex);
+  old = table->pt_caps;
+  table->pt_caps = pt_caps;
+  g_mutex_unlock (&table->mutex);
+
+  if (old != NULL) {
+    /* Freed here or by the last reader still holding it */
+    g_hash_table_unref (old);
+  }
+}
+
+GstCaps *
+kms_pt_caps_table_get_caps (KmsPtCapsTable * table, guint pt)
+{
+  GHashTable *pt_caps = NULL;
+  GstCaps *caps;
+
+  g_mutex_lock (&table->mutex);
+  if (table->pt_caps != NULL) {
+    pt_caps = g_hash_table_ref (table->pt_caps);
+  }
+  g_mutex_unlock (&table->mutex);
+
+  if (pt_caps == NULL) {
+    GST_WARNING ("Negotiation ctx not set");
+    return NULL;
+  }
+
+  caps = g_hash_table_lookup (pt_caps, GUINT_TO_POINTER (pt));
+  if (caps != NULL) {
+    gst_caps_ref (caps);
+  }
+
+  g_hash_table_unref (pt_caps);
+
+  return caps;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,41 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_PT_CAPS_TABLE_H__
+#define __KMS_PT_CAPS_TABLE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _KmsPtCapsTable KmsPtCapsTable;
+
+/* Holds the payload type -> GstCaps map of the current negotiation. Maps are
+ * never modified once published: readers take a reference under a short lock
+ * and renegotiation swaps in a new one, so lookups from streaming threads
+ * never see a half built map and old maps are freed by their last reader. */
+KmsPtCapsTable * kms_pt_caps_table_new (void);
+void kms_pt_caps_table_free (KmsPtCapsTable * table);
+
+/* Takes ownership of @pt_caps, a map of GUINT_TO_POINTER (pt) -> GstCaps */
+void kms_pt_caps_table_set (KmsPtCapsTable * table, GHashTable * pt_caps);
+
+/* Returns a new reference to the caps of @pt or NULL if it was not
+ * negotiated */
+GstCaps * kms_pt_caps_table_get_caps (KmsPtCapsTable * table, guint pt);
+
+G_END_DECLS
+
+#endif /* __KMS_PT_CAPS_TABLE_H__ */
@@ -0,0 +1,92 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "kmsrtppayloader.h"
+#include "kmsfactorycache.h"
+
+#define GST_CAT_DEFAULT kms_rtp_payloader_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsrtppayloader"
+
+GstElement *
+kms_rtp_payloader_new_for_caps (GstCaps * caps)
+{
+  GstElementFactory *factory;
+  GstElement *payloader = NULL;
+  GList *filtered_list;
+  GParamSpec *pspec;
+
+  g_return_val_if_fail (GST_IS_CAPS (caps), NULL);
+
+  filtered_list =
+      kms_factory_cache_filter (GST_ELEMENT_FACTORY_TYPE_PAYLOADER, caps,
+      GST_PAD_SRC);
+
+  if (filtered_list == NULL) {
+    goto end;
+  }
+
+  factory = GST_ELEMENT_FACTORY (filtered_list->data);
+  if (factory == NULL) {
+    goto end;
+  }
+
+  payloader = gst_element_factory_create (factory, NULL);
+
+  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (payloader), "pt");
+  if (pspec != NULL && G_PARAM_SPEC_VALUE_TYPE (pspec) == G_TYPE_UINT) {
+    GstStructure *st = gst_caps_get_structure (caps, 0);
+    gint payload;
+
+    if (gst_structure_get_int (st, "payload", &payload)) {
+      g_object_set (payloader, "pt", payload, NULL);
+    }
+  }
+
+  pspec =
+      g_object_class_find_property (G_OBJECT_GET_CLASS (payloader),
+      "config-interval");
+  if (pspec != NULL && G_PARAM_SPEC_VALUE_TYPE (pspec) == G_TYPE_UINT) {
+    g_object_set (payloader, "config-interval", 1, NULL);
+  }
+
+  /* Push whole frames as buffer lists down to rtpbin */
+  pspec =
+      g_object_class_find_property (G_OBJECT_GET_CLASS (payloader),
+      "buffer-list");
+  if (pspec != NULL && G_PARAM_SPEC_VALUE_TYPE (pspec) == G_TYPE_BOOLEAN) {
+    g_object_set (payloader, "buffer-list", TRUE, NULL);
+  }
+
+  GST_DEBUG ("Created %" GST_PTR_FORMAT " for %" GST_PTR_FORMAT, payloader,
+      caps);
+
+end:
+  gst_plugin_feature_list_free (filtered_list);
+
+  return payloader;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
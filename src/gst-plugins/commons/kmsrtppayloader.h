@@ -0,0 +1,41 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_RTP_PAYLOADER_H__
+#define __KMS_RTP_PAYLOADER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Creates the payloader used to send @caps (application/x-rtp) or NULL if
+ * there is none. The payload type is taken from the caps, parameter sets are
+ * repeated every second and, to let whole frames travel down to rtpbin and
+ * the connection as a single GstBufferList, payloaders exposing a
+ * "buffer-list" property get it enabled.
+ *
+ * Which payloaders take the list path:
+ *  - rtpvp8pay pushes every frame as one list on its own.
+ *  - rtph264pay pushes the fragments of a NAL unit split in FU-A packets as
+ *    one list, NAL units fitting in a packet go one by one.
+ *  - Payloaders with a "buffer-list" property push a list per frame once it
+ *    is enabled here.
+ *  - Other payloaders, audio ones included, push single buffers: a frame
+ *    fits in one packet, so there is nothing to batch. */
+GstElement * kms_rtp_payloader_new_for_caps (GstCaps * caps);
+
+G_END_DECLS
+
+#endif /* __KMS_RTP_PAYLOADER_H__ */
@@ -14,6 +14,48 @@
  */
 
 #include "kmsserializablemeta.h"
+#include "kmsrefstruct.h"
+
+struct _KmsSerializablePayload
+{
+  KmsRefStruct ref;
+
+  GstStructure *data;
+};
+
+static void
+kms_serializable_payload_destroy (KmsSerializablePayload * payload)
+{
+  if (payload->data != NULL) {
+    gst_structure_set_parent_refcount (payload->data, NULL);
+    gst_structure_free (payload->data);
+  }
+
+  g_slice_free (KmsSerializablePayload, payload);
+}
+
+static KmsSerializablePayload *
+kms_serializable_payload_new (GstStructure * data)
+{
+  KmsSerializablePayload *payload;
+
+  payload = g_slice_new0 (KmsSerializablePayload);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (payload),
+      (GDestroyNotify) kms_serializable_payload_destroy);
+
+  /* Tie the structure to the payload refcount, it stops being writable */
+  /* as soon as the payload is shared by more than one buffer */
+  if (data != NULL &&
+      gst_structure_set_parent_refcount (data, &payload->ref._count)) {
+    payload->data = data;
+  } else if (data != NULL) {
+    GST_WARNING ("Structure already has a parent, attaching a copy");
+    payload->data = gst_structure_copy (data);
+    gst_structure_set_parent_refcount (payload->data, &payload->ref._count);
+  }
+
+  return payload;
+}
 
 GType
 kms_serializable_meta_api_get_type (void)
@@ -36,27 +78,36 @@ kms_serializable_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
   KmsSerializableMeta *smeta = (KmsSerializableMeta *) meta;
 
   smeta->data = NULL;
+  smeta->payload = NULL;
 
   return TRUE;
 }
 
+static void
+kms_serializable_meta_set_payload (KmsSerializableMeta * smeta,
+    KmsSerializablePayload * payload)
+{
+  smeta->payload = payload;
+  smeta->data = payload->data;
+}
+
 static gboolean
 kms_serializable_meta_transform (GstBuffer * transbuf, GstMeta * meta,
     GstBuffer * buffer, GQuark type, gpointer data)
 {
-  KmsSerializableMeta *smeta;
+  KmsSerializableMeta *smeta, *tmeta;
 
   if (GST_META_TRANSFORM_IS_COPY (type)) {
-    GstStructure *copy = NULL;
-
     smeta = (KmsSerializableMeta *) meta;
 
-    if (smeta->data != NULL) {
-      copy = gst_structure_copy (smeta->data);
-    }
+    GST_DEBUG ("share serializable metadata");
+    tmeta = (KmsSerializableMeta *) gst_buffer_add_meta (transbuf,
+        KMS_SERIALIZABLE_META_INFO, NULL);
 
-    GST_DEBUG ("copy serializable metadata");
-    kms_buffer_add_serializable_meta (transbuf, copy);
+    if (smeta->payload != NULL) {
+      kms_ref_struct_ref (KMS_REF_STRUCT_CAST (smeta->payload));
+      kms_serializable_meta_set_payload (tmeta, smeta->payload);
+    }
   }
 
   return TRUE;
@@ -67,9 +118,12 @@ kms_serializable_meta_free (GstMeta * meta, GstBuffer * buffer)
 {
   KmsSerializableMeta *smeta = (KmsSerializableMeta *) meta;
 
-  if (smeta->data != NULL) {
-    gst_structure_free (smeta->data);
+  if (smeta->payload != NULL) {
+    kms_ref_struct_unref (KMS_REF_STRUCT_CAST (smeta->payload));
   }
+
+  smeta->payload = NULL;
+  smeta->data = NULL;
 }
 
 const GstMetaInfo *
@@ -101,7 +155,8 @@ kms_buffer_add_serializable_meta (GstBuffer * buffer, GstStructure * data)
   meta = (KmsSerializableMeta *) gst_buffer_add_meta (buffer,
       KMS_SERIALIZABLE_META_INFO, NULL);
 
-  meta->data = data;
+  kms_serializable_meta_set_payload (meta,
+      kms_serializable_payload_new (data));
 
   return meta;
 }
@@ -23,19 +23,23 @@
 G_BEGIN_DECLS
 
 typedef struct _KmsSerializableMeta KmsSerializableMeta;
+typedef struct _KmsSerializablePayload KmsSerializablePayload;
 
 /**
  * KmsSerializableMeta:
  * @meta: the parent type
- * @ts: The time stamp
+ * @data: the serialized information, read only
+ * @payload: refcounted holder of @data, shared among buffer copies
  *
  * Metadata for sending aditional information that can be passed over network
- * with the buffer
+ * with the buffer. Copying a buffer only adds a reference to the payload, so
+ * @data must be considered immutable once it is attached to a buffer.
  */
 struct _KmsSerializableMeta {
   GstMeta       meta;
 
   GstStructure *data;
+  KmsSerializablePayload *payload;
 };
 
 GType kms_serializable_meta_api_get_type (void);
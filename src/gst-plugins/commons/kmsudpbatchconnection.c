@@ -0,0 +1,377 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <unistd.h>
+
+#include "kmsudpbatchconnection.h"
+#include "kmsudpsocket.h"
+
+#define GST_DEFAULT_NAME "kmsudpbatchconnection"
+#define GST_CAT_DEFAULT kms_udp_batch_connection_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define KMS_UDP_BATCH_CONNECTION_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (                     \
+    (obj),                                          \
+    KMS_TYPE_UDP_BATCH_CONNECTION,                  \
+    KmsUdpBatchConnectionPrivate                    \
+  )                                                 \
+)
+
+#define UDP_BATCH_SRC_FACTORY "udpbatchsrc"
+#define UDP_BATCH_SINK_FACTORY "udpbatchsink"
+
+enum
+{
+  PROP_0,
+  PROP_CONNECTED,
+  PROP_ADDED
+};
+
+struct _KmsUdpBatchConnectionPrivate
+{
+  gint rtp_fd;
+  gint rtcp_fd;
+  guint16 rtp_port;
+  guint16 rtcp_port;
+
+  GstElement *rtp_src;
+  GstElement *rtp_sink;
+  GstElement *rtcp_src;
+  GstElement *rtcp_sink;
+
+  gboolean connected;
+  gboolean added;
+};
+
+static void
+kms_udp_batch_connection_interface_init (KmsIRtpConnectionInterface * iface);
+
+G_DEFINE_TYPE_WITH_CODE (KmsUdpBatchConnection, kms_udp_batch_connection,
+    G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (KMS_TYPE_I_RTP_CONNECTION,
+        kms_udp_batch_connection_interface_init)
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+        GST_DEFAULT_NAME));
+
+static void
+kms_udp_batch_connection_add (KmsIRtpConnection * base_rtp_conn, GstBin * bin,
+    gboolean active)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (base_rtp_conn);
+  KmsUdpBatchConnectionPrivate *priv = self->priv;
+
+  gst_bin_add_many (bin, priv->rtp_src, priv->rtp_sink, priv->rtcp_src,
+      priv->rtcp_sink, NULL);
+}
+
+static void
+kms_udp_batch_connection_src_sync_state_with_parent (KmsIRtpConnection *
+    base_rtp_conn)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (base_rtp_conn);
+
+  gst_element_sync_state_with_parent (self->priv->rtp_src);
+  gst_element_sync_state_with_parent (self->priv->rtcp_src);
+}
+
+static void
+kms_udp_batch_connection_sink_sync_state_with_parent (KmsIRtpConnection *
+    base_rtp_conn)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (base_rtp_conn);
+
+  gst_element_sync_state_with_parent (self->priv->rtp_sink);
+  gst_element_sync_state_with_parent (self->priv->rtcp_sink);
+}
+
+static GstPad *
+kms_udp_batch_connection_request_rtp_sink (KmsIRtpConnection * base_rtp_conn)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (base_rtp_conn);
+
+  return gst_element_get_static_pad (self->priv->rtp_sink, "sink");
+}
+
+static GstPad *
+kms_udp_batch_connection_request_rtp_src (KmsIRtpConnection * base_rtp_conn)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (base_rtp_conn);
+
+  return gst_element_get_static_pad (self->priv->rtp_src, "src");
+}
+
+static GstPad *
+kms_udp_batch_connection_request_rtcp_sink (KmsIRtpConnection * base_rtp_conn)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (base_rtp_conn);
+
+  return gst_element_get_static_pad (self->priv->rtcp_sink, "sink");
+}
+
+static GstPad *
+kms_udp_batch_connection_request_rtcp_src (KmsIRtpConnection * base_rtp_conn)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (base_rtp_conn);
+
+  return gst_element_get_static_pad (self->priv->rtcp_src, "src");
+}
+
+guint16
+kms_udp_batch_connection_get_rtp_port (KmsUdpBatchConnection * conn)
+{
+  g_return_val_if_fail (KMS_IS_UDP_BATCH_CONNECTION (conn), 0);
+
+  return conn->priv->rtp_port;
+}
+
+guint16
+kms_udp_batch_connection_get_rtcp_port (KmsUdpBatchConnection * conn)
+{
+  g_return_val_if_fail (KMS_IS_UDP_BATCH_CONNECTION (conn), 0);
+
+  return conn->priv->rtcp_port;
+}
+
+void
+kms_udp_batch_connection_set_remote_info (KmsUdpBatchConnection * conn,
+    const gchar * host, gint rtp_port, gint rtcp_port)
+{
+  g_return_if_fail (KMS_IS_UDP_BATCH_CONNECTION (conn));
+
+  GST_INFO_OBJECT (conn, "Remote info: %s (RTP %d, RTCP %d)", host, rtp_port,
+      rtcp_port);
+
+  g_object_set (conn->priv->rtp_sink, "host", host, "port", rtp_port, NULL);
+  g_object_set (conn->priv->rtcp_sink, "host", host, "port", rtcp_port, NULL);
+
+  kms_i_rtp_connection_connected_signal (KMS_I_RTP_CONNECTION (conn));
+}
+
+static void
+kms_udp_batch_connection_close_sockets (KmsUdpBatchConnection * self)
+{
+  if (self->priv->rtp_fd >= 0) {
+    close (self->priv->rtp_fd);
+    self->priv->rtp_fd = -1;
+  }
+
+  if (self->priv->rtcp_fd >= 0) {
+    close (self->priv->rtcp_fd);
+    self->priv->rtcp_fd = -1;
+  }
+}
+
+static gboolean
+kms_udp_batch_connection_bind_sockets (KmsUdpBatchConnection * self,
+    const gchar * address, guint16 min_port, guint16 max_port,
+    gboolean reuse_port)
+{
+  KmsUdpBatchConnectionPrivate *priv = self->priv;
+  guint port;
+
+  if (min_port == 0) {
+    priv->rtp_port = priv->rtcp_port = 0;
+    priv->rtp_fd =
+        kms_udp_socket_new_bound (address, &priv->rtp_port, reuse_port);
+    priv->rtcp_fd =
+        kms_udp_socket_new_bound (address, &priv->rtcp_port, reuse_port);
+
+    return priv->rtp_fd >= 0 && priv->rtcp_fd >= 0;
+  }
+
+  /* RTP on even ports, RTCP on the next one */
+  for (port = GST_ROUND_UP_2 (min_port); port < max_port; port += 2) {
+    priv->rtp_port = port;
+    priv->rtcp_port = port + 1;
+
+    priv->rtp_fd =
+        kms_udp_socket_new_bound (address, &priv->rtp_port, reuse_port);
+    if (priv->rtp_fd < 0) {
+      continue;
+    }
+
+    priv->rtcp_fd =
+        kms_udp_socket_new_bound (address, &priv->rtcp_port, reuse_port);
+    if (priv->rtcp_fd >= 0) {
+      return TRUE;
+    }
+
+    kms_udp_batch_connection_close_sockets (self);
+  }
+
+  return FALSE;
+}
+
+static GstElement *
+kms_udp_batch_connection_create_element (const gchar * factory, gint fd)
+{
+  GstElement *element = gst_element_factory_make (factory, NULL);
+
+  if (element != NULL) {
+    g_object_set (element, "socket-fd", fd, NULL);
+  }
+
+  return element;
+}
+
+KmsUdpBatchConnection *
+kms_udp_batch_connection_new (const gchar * address, guint16 min_port,
+    guint16 max_port, gboolean reuse_port)
+{
+  KmsUdpBatchConnection *conn;
+  KmsUdpBatchConnectionPrivate *priv;
+
+  conn = g_object_new (KMS_TYPE_UDP_BATCH_CONNECTION, NULL);
+  priv = conn->priv;
+
+  if (!kms_udp_batch_connection_bind_sockets (conn, address, min_port,
+          max_port, reuse_port)) {
+    GST_ERROR_OBJECT (conn, "Cannot bind sockets on %s [%u, %u]", address,
+        min_port, max_port);
+    g_object_unref (conn);
+    return NULL;
+  }
+
+  /* Both directions use the same socket, so the remote peer sees */
+  /* packets coming from the port it sends to (symmetric RTP) */
+  priv->rtp_src = kms_udp_batch_connection_create_element
+      (UDP_BATCH_SRC_FACTORY, priv->rtp_fd);
+  priv->rtp_sink = kms_udp_batch_connection_create_element
+      (UDP_BATCH_SINK_FACTORY, priv->rtp_fd);
+  priv->rtcp_src = kms_udp_batch_connection_create_element
+      (UDP_BATCH_SRC_FACTORY, priv->rtcp_fd);
+  priv->rtcp_sink = kms_udp_batch_connection_create_element
+      (UDP_BATCH_SINK_FACTORY, priv->rtcp_fd);
+
+  if (priv->rtp_src == NULL || priv->rtp_sink == NULL ||
+      priv->rtcp_src == NULL || priv->rtcp_sink == NULL) {
+    GST_ERROR_OBJECT (conn, "Cannot create UDP batch elements");
+    g_object_unref (conn);
+    return NULL;
+  }
+
+  /* Elements are only added to a bin on add, hold them meanwhile */
+  gst_object_ref_sink (priv->rtp_src);
+  gst_object_ref_sink (priv->rtp_sink);
+  gst_object_ref_sink (priv->rtcp_src);
+  gst_object_ref_sink (priv->rtcp_sink);
+
+  GST_DEBUG_OBJECT (conn, "Bound to %s RTP %u, RTCP %u", address,
+      priv->rtp_port, priv->rtcp_port);
+
+  return conn;
+}
+
+static void
+kms_udp_batch_connection_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (object);
+
+  switch (property_id) {
+    case PROP_CONNECTED:
+      g_value_set_boolean (value, self->priv->connected);
+      break;
+    case PROP_ADDED:
+      g_value_set_boolean (value, self->priv->added);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_udp_batch_connection_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (object);
+
+  switch (property_id) {
+    case PROP_CONNECTED:
+      self->priv->connected = g_value_get_boolean (value);
+      break;
+    case PROP_ADDED:
+      self->priv->added = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_udp_batch_connection_finalize (GObject * object)
+{
+  KmsUdpBatchConnection *self = KMS_UDP_BATCH_CONNECTION (object);
+  KmsUdpBatchConnectionPrivate *priv = self->priv;
+
+  GST_DEBUG_OBJECT (self, "finalize");
+
+  g_clear_object (&priv->rtp_src);
+  g_clear_object (&priv->rtp_sink);
+  g_clear_object (&priv->rtcp_src);
+  g_clear_object (&priv->rtcp_sink);
+
+  /* Elements work on their own duplicates of the descriptors */
+  kms_udp_batch_connection_close_sockets (self);
+
+  /* chain up */
+  G_OBJECT_CLASS (kms_udp_batch_connection_parent_class)->finalize (object);
+}
+
+static void
+kms_udp_batch_connection_init (KmsUdpBatchConnection * self)
+{
+  self->priv = KMS_UDP_BATCH_CONNECTION_GET_PRIVATE (self);
+
+  self->priv->rtp_fd = -1;
+  self->priv->rtcp_fd = -1;
+}
+
+static void
+kms_udp_batch_connection_class_init (KmsUdpBatchConnectionClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = kms_udp_batch_connection_finalize;
+  gobject_class->get_property = kms_udp_batch_connection_get_property;
+  gobject_class->set_property = kms_udp_batch_connection_set_property;
+
+  g_object_class_override_property (gobject_class, PROP_CONNECTED,
+      "connected");
+  g_object_class_override_property (gobject_class, PROP_ADDED, "added");
+
+  g_type_class_add_private (klass, sizeof (KmsUdpBatchConnectionPrivate));
+}
+
+static void
+kms_udp_batch_connection_interface_init (KmsIRtpConnectionInterface * iface)
+{
+  iface->add = kms_udp_batch_connection_add;
+  iface->src_sync_state_with_parent =
+      kms_udp_batch_connection_src_sync_state_with_parent;
+  iface->sink_sync_state_with_parent =
+      kms_udp_batch_connection_sink_sync_state_with_parent;
+  iface->request_rtp_sink = kms_udp_batch_connection_request_rtp_sink;
+  iface->request_rtp_src = kms_udp_batch_connection_request_rtp_src;
+  iface->request_rtcp_sink = kms_udp_batch_connection_request_rtcp_sink;
+  iface->request_rtcp_src = kms_udp_batch_connection_request_rtcp_src;
+}
@@ -0,0 +1,66 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_UDP_BATCH_CONNECTION_H__
+#define __KMS_UDP_BATCH_CONNECTION_H__
+
+#include "kmsirtpconnection.h"
+
+G_BEGIN_DECLS
+
+#define KMS_TYPE_UDP_BATCH_CONNECTION \
+  (kms_udp_batch_connection_get_type())
+#define KMS_UDP_BATCH_CONNECTION(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_UDP_BATCH_CONNECTION,KmsUdpBatchConnection))
+#define KMS_UDP_BATCH_CONNECTION_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_UDP_BATCH_CONNECTION,KmsUdpBatchConnectionClass))
+#define KMS_IS_UDP_BATCH_CONNECTION(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_UDP_BATCH_CONNECTION))
+#define KMS_IS_UDP_BATCH_CONNECTION_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_UDP_BATCH_CONNECTION))
+#define KMS_UDP_BATCH_CONNECTION_CAST(obj) ((KmsUdpBatchConnection*)(obj))
+
+typedef struct _KmsUdpBatchConnection KmsUdpBatchConnection;
+typedef struct _KmsUdpBatchConnectionClass KmsUdpBatchConnectionClass;
+typedef struct _KmsUdpBatchConnectionPrivate KmsUdpBatchConnectionPrivate;
+
+struct _KmsUdpBatchConnection
+{
+  GObject parent;
+
+  KmsUdpBatchConnectionPrivate *priv;
+};
+
+struct _KmsUdpBatchConnectionClass
+{
+  GObjectClass parent_class;
+};
+
+GType kms_udp_batch_connection_get_type (void);
+
+/* RTP and RTCP sockets are bound to consecutive ports in [min_port, */
+/* max_port], or to any free ports if min_port is 0. With reuse_port */
+/* several connections (or processes) can share the ports */
+KmsUdpBatchConnection *kms_udp_batch_connection_new (const gchar * address,
+    guint16 min_port, guint16 max_port, gboolean reuse_port);
+
+guint16 kms_udp_batch_connection_get_rtp_port (KmsUdpBatchConnection * conn);
+guint16 kms_udp_batch_connection_get_rtcp_port (KmsUdpBatchConnection * conn);
+
+void kms_udp_batch_connection_set_remote_info (KmsUdpBatchConnection * conn,
+    const gchar * host, gint rtp_port, gint rtcp_port);
+
+G_END_DECLS
+#endif /* __KMS_UDP_BATCH_CONNECTION_H__ */
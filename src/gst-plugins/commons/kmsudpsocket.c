@@ -0,0 +1,149 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "kmsudpsocket.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+#define GST_CAT_DEFAULT kms_udp_socket_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsudpsocket"
+
+gboolean
+kms_udp_socket_resolve (const gchar * host, guint16 port, gboolean passive,
+    struct sockaddr_storage * addr, socklen_t * addrlen)
+{
+  struct addrinfo hints, *res;
+  gchar service[6];
+  gint err;
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags = AI_NUMERICSERV | (passive ? AI_PASSIVE : 0);
+
+  g_snprintf (service, sizeof (service), "%u", port);
+
+  err = getaddrinfo (host, service, &hints, &res);
+  if (err != 0) {
+    GST_WARNING ("Cannot resolve %s: %s", host, gai_strerror (err));
+    return FALSE;
+  }
+
+  memcpy (addr, res->ai_addr, res->ai_addrlen);
+  *addrlen = res->ai_addrlen;
+  freeaddrinfo (res);
+
+  return TRUE;
+}
+
+gint
+kms_udp_socket_new_for_family (gint family)
+{
+  gint fd;
+
+  fd = socket (family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    GST_WARNING ("Cannot create socket: %s", g_strerror (errno));
+  }
+
+  return fd;
+}
+
+gint
+kms_udp_socket_new_bound (const gchar * address, guint16 * port,
+    gboolean reuse_port)
+{
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+  gint fd;
+
+  if (!kms_udp_socket_resolve (address, *port, TRUE, &addr, &addrlen)) {
+    return -1;
+  }
+
+  fd = kms_udp_socket_new_for_family (addr.ss_family);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (reuse_port) {
+#ifdef SO_REUSEPORT
+    gint on = 1;
+
+    /* Lets several sockets share the port, the kernel spreads */
+    /* incoming flows among them */
+    if (setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof (on)) < 0) {
+      GST_WARNING ("Cannot set SO_REUSEPORT: %s", g_strerror (errno));
+    }
+#else
+    GST_WARNING ("SO_REUSEPORT is not supported");
+#endif
+  }
+
+  if (bind (fd, (struct sockaddr *) &addr, addrlen) < 0) {
+    GST_DEBUG ("Cannot bind to %s:%u: %s", address, *port, g_strerror (errno));
+    close (fd);
+    return -1;
+  }
+
+  addrlen = sizeof (addr);
+  if (getsockname (fd, (struct sockaddr *) &addr, &addrlen) < 0) {
+    GST_WARNING ("Cannot get bound address: %s", g_strerror (errno));
+    close (fd);
+    return -1;
+  }
+
+  if (addr.ss_family == AF_INET6) {
+    *port = ntohs (((struct sockaddr_in6 *) &addr)->sin6_port);
+  } else {
+    *port = ntohs (((struct sockaddr_in *) &addr)->sin_port);
+  }
+
+  return fd;
+}
+
+gboolean
+kms_udp_socket_set_buffer_sizes (gint fd, gint rcvbuf, gint sndbuf)
+{
+  gboolean ret = TRUE;
+
+  if (rcvbuf > 0 && setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+          sizeof (rcvbuf)) < 0) {
+    GST_WARNING ("Cannot set receive buffer size: %s", g_strerror (errno));
+    ret = FALSE;
+  }
+
+  if (sndbuf > 0 && setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+          sizeof (sndbuf)) < 0) {
+    GST_WARNING ("Cannot set send buffer size: %s", g_strerror (errno));
+    ret = FALSE;
+  }
+
+  return ret;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,35 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_UDP_SOCKET_H__
+#define __KMS_UDP_SOCKET_H__
+
+#include <gst/gst.h>
+#include <sys/socket.h>
+
+G_BEGIN_DECLS
+
+gboolean kms_udp_socket_resolve (const gchar * host, guint16 port,
+    gboolean passive, struct sockaddr_storage * addr, socklen_t * addrlen);
+
+gint kms_udp_socket_new_bound (const gchar * address, guint16 * port,
+    gboolean reuse_port);
+gint kms_udp_socket_new_for_family (gint family);
+
+gboolean kms_udp_socket_set_buffer_sizes (gint fd, gint rcvbuf, gint sndbuf);
+
+G_END_DECLS
+
+#endif /* __KMS_UDP_SOCKET_H__ */
@@ -16,6 +16,8 @@
 #include "kmsutils.h"
 #include "kmsagnosticcaps.h"
 #include <gst/video/video-event.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <string.h>
 
 #define GST_CAT_DEFAULT kmsutils
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -96,35 +98,117 @@ static GstStaticCaps static_audio_caps =
 GST_STATIC_CAPS (KMS_AGNOSTIC_AUDIO_CAPS);
 static GstStaticCaps static_video_caps =
 GST_STATIC_CAPS (KMS_AGNOSTIC_VIDEO_CAPS);
+static GstStaticCaps static_raw_caps = GST_STATIC_CAPS (KMS_AGNOSTIC_RAW_CAPS);
+
+typedef enum
+{
+  CAPS_CLASS_AUDIO = 1 << 0,
+  CAPS_CLASS_VIDEO = 1 << 1,
+  CAPS_CLASS_RAW = 1 << 2,
+} CapsClass;
+
+/* Media name quark -> CapsClass, built once and read only afterwards */
+static GHashTable *caps_classes;
+
+static void
+caps_classes_add (GHashTable * table, GstStaticCaps * static_caps,
+    CapsClass class)
+{
+  GstCaps *caps = gst_static_caps_get (static_caps);
+  guint i;
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    GQuark name =
+        gst_structure_get_name_id (gst_caps_get_structure (caps, i));
+    guint current =
+        GPOINTER_TO_UINT (g_hash_table_lookup (table, GUINT_TO_POINTER (name)));
+
+    g_hash_table_insert (table, GUINT_TO_POINTER (name),
+        GUINT_TO_POINTER (current | class));
+  }
+
+  gst_caps_unref (caps);
+}
+
+static guint
+caps_structure_get_class (const GstStructure * st)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    GHashTable *table = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    caps_classes_add (table, &static_audio_caps, CAPS_CLASS_AUDIO);
+    caps_classes_add (table, &static_video_caps, CAPS_CLASS_VIDEO);
+    caps_classes_add (table, &static_raw_caps, CAPS_CLASS_RAW);
+    caps_classes = table;
+
+    g_once_init_leave (&init, 1);
+  }
+
+  return GPOINTER_TO_UINT (g_hash_table_lookup (caps_classes,
+          GUINT_TO_POINTER (gst_structure_get_name_id (st))));
+}
 
 static gboolean
-caps_can_intersect_with_static (const GstCaps * caps,
-    GstStaticCaps * static_caps)
+caps_have_class (const GstCaps * caps, CapsClass class)
 {
-  GstCaps *aux;
-  gboolean ret;
+  guint i;
 
   if (caps == NULL) {
     return FALSE;
   }
 
-  aux = gst_static_caps_get (static_caps);
-  ret = gst_caps_can_intersect (caps, aux);
-  gst_caps_unref (aux);
+  if (gst_caps_is_any (caps)) {
+    return TRUE;
+  }
 
-  return ret;
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    if (caps_structure_get_class (gst_caps_get_structure (caps, i)) & class) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
 }
 
 gboolean
 kms_utils_caps_are_audio (const GstCaps * caps)
 {
-  return caps_can_intersect_with_static (caps, &static_audio_caps);
+  return caps_have_class (caps, CAPS_CLASS_AUDIO);
 }
 
 gboolean
 kms_utils_caps_are_video (const GstCaps * caps)
 {
-  return caps_can_intersect_with_static (caps, &static_video_caps);
+  return caps_have_class (caps, CAPS_CLASS_VIDEO);
+}
+
+gboolean
+kms_utils_caps_are_raw (const GstCaps * caps)
+{
+  guint i;
+
+  if (caps == NULL || gst_caps_is_any (caps)) {
+    return FALSE;
+  }
+
+  /* Every structure must be plain system memory raw audio or video */
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    GstCapsFeatures *features = gst_caps_get_features (caps, i);
+
+    if (!(caps_structure_get_class (gst_caps_get_structure (caps, i)) &
+            CAPS_CLASS_RAW)) {
+      return FALSE;
+    }
+
+    if (features != NULL && !gst_caps_features_is_equal (features,
+            GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
 }
 
 /* Caps end */
@@ -187,18 +271,6 @@ set_dropping (GstPad * pad, gboolean dropping)
       GINT_TO_POINTER (dropping));
 }
 
-static gboolean
-is_raw_caps (GstCaps * caps)
-{
-  gboolean ret;
-  GstCaps *raw_caps = gst_caps_from_string (KMS_AGNOSTIC_RAW_CAPS);
-
-  ret = gst_caps_is_always_compatible (caps, raw_caps);
-
-  gst_caps_unref (raw_caps);
-  return ret;
-}
-
 static void
 send_force_key_unit_event (GstPad * pad, gboolean all_headers)
 {
@@ -213,7 +285,7 @@ send_force_key_unit_event (GstPad * pad, gboolean all_headers)
     return;
   }
 
-  if (is_raw_caps (caps)) {
+  if (kms_utils_caps_are_raw (caps)) {
     goto end;
   }
 
@@ -633,7 +705,7 @@ remb_event_manager_set_min (RembEventManager * manager, guint min)
     manager->remb_min = min;
 
     if (manager->callback) {
-      // TODO: Think about having a threshold to not notify in excess
+      /* Consumers filter these through a KmsBitrateController */
       manager->callback (manager, manager->remb_min, manager->user_data);
     }
   }
@@ -813,6 +885,110 @@ kms_utils_get_time_nsecs ()
 
 /* time end */
 
+/* RTP header extensions begin */
+
+#define ABS_SEND_TIME_SIZE 3
+
+guint32
+kms_utils_get_abs_send_time (GstClockTime time)
+{
+  GstClockTime ms;
+
+  ms = time / GST_MSECOND;
+
+  /* 6.18 fixed point seconds */
+  return (((ms << 18) / 1000) & 0x00ffffff);
+}
+
+static void
+write_abs_send_time (GstPad * pad, GstBuffer * buffer, gint id,
+    guint32 abs_send_time)
+{
+  GstRTPBuffer rtp = { NULL, };
+  guint8 data[ABS_SEND_TIME_SIZE];
+  gpointer ext_data;
+  guint ext_size;
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp)) {
+    GST_WARNING_OBJECT (pad, "Can not map RTP buffer for writting");
+    return;
+  }
+
+  data[0] = (guint8) (abs_send_time >> 16);
+  data[1] = (guint8) (abs_send_time >> 8);
+  data[2] = (guint8) (abs_send_time);
+
+  if (gst_rtp_buffer_get_extension_onebyte_header (&rtp, id, 0, &ext_data,
+          &ext_size) && ext_size == ABS_SEND_TIME_SIZE) {
+    /* Already stamped (i.e. retransmission), just update the value */
+    memcpy (ext_data, data, ABS_SEND_TIME_SIZE);
+  } else if (!gst_rtp_buffer_add_extension_onebyte_header (&rtp,
+          id, data, ABS_SEND_TIME_SIZE)) {
+    GST_WARNING_OBJECT (pad, "RTP hdrext abs-send-time not added");
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+}
+
+typedef struct _AbsSendTimeData
+{
+  GstPad *pad;
+  gint id;
+  guint32 abs_send_time;
+} AbsSendTimeData;
+
+static gboolean
+write_abs_send_time_bufflist (GstBuffer ** buf, guint idx,
+    AbsSendTimeData * data)
+{
+  *buf = gst_buffer_make_writable (*buf);
+  write_abs_send_time (data->pad, *buf, data->id, data->abs_send_time);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+write_abs_send_time_probe (GstPad * pad, GstPadProbeInfo * info, gpointer gp)
+{
+  gint id = GPOINTER_TO_INT (gp);
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    buffer = gst_buffer_make_writable (buffer);
+    write_abs_send_time (pad, buffer, id,
+        kms_utils_get_abs_send_time (kms_utils_get_time_nsecs ()));
+    GST_PAD_PROBE_INFO_DATA (info) = buffer;
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *bufflist = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    AbsSendTimeData data;
+
+    /* All packets in a list leave together, so they share the send time */
+    data.pad = pad;
+    data.id = id;
+    data.abs_send_time =
+        kms_utils_get_abs_send_time (kms_utils_get_time_nsecs ());
+
+    bufflist = gst_buffer_list_make_writable (bufflist);
+    gst_buffer_list_foreach (bufflist,
+        (GstBufferListFunc) write_abs_send_time_bufflist, &data);
+
+    GST_PAD_PROBE_INFO_DATA (info) = bufflist;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+gulong
+kms_utils_add_abs_send_time_probe (GstPad * pad, gint id)
+{
+  return gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      write_abs_send_time_probe, GINT_TO_POINTER (id), NULL);
+}
+
+/* RTP header extensions end */
+
 static void init_debug (void) __attribute__ ((constructor));
 
 static void
@@ -32,6 +32,7 @@ gboolean gst_element_sync_state_with_parent_target_state (GstElement * element);
 /* Caps */
 gboolean kms_utils_caps_are_audio (const GstCaps * caps);
 gboolean kms_utils_caps_are_video (const GstCaps * caps);
+gboolean kms_utils_caps_are_raw (const GstCaps * caps);
 
 GstElement * kms_utils_create_convert_for_caps (const GstCaps * caps);
 GstElement * kms_utils_create_mediator_element (const GstCaps * caps);
@@ -60,6 +61,10 @@ void kms_utils_remb_event_manager_set_callback (RembEventManager * manager, Remb
 /* time */
 GstClockTime kms_utils_get_time_nsecs ();
 
+/* RTP header extensions */
+guint32 kms_utils_get_abs_send_time (GstClockTime time);
+gulong kms_utils_add_abs_send_time_probe (GstPad * pad, gint id);
+
 /* Type destroying */
 #define KMS_UTILS_DESTROY_H(type) void kms_utils_destroy_##type (type * data);
 KMS_UTILS_DESTROY_H (guint64)
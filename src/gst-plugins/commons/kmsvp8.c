@@ -0,0 +1,156 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "kmsvp8.h"
+
+#include <string.h>
+
+#define KEY_FRAME_START_CODE_0 0x9d
+#define KEY_FRAME_START_CODE_1 0x01
+#define KEY_FRAME_START_CODE_2 0x2a
+
+#define FRAME_TAG_SIZE 3
+
+gboolean
+kms_vp8_parse_frame_header (const guint8 * data, gsize size,
+    KmsVp8FrameHeader * header)
+{
+  guint32 tag;
+
+  g_return_val_if_fail (header != NULL, FALSE);
+
+  memset (header, 0, sizeof (KmsVp8FrameHeader));
+
+  if (data == NULL || size < FRAME_TAG_SIZE) {
+    return FALSE;
+  }
+
+  tag = data[0] | (data[1] << 8) | (data[2] << 16);
+
+  header->key_frame = !(tag & 0x01);
+  header->version = (tag >> 1) & 0x07;
+  header->show_frame = (tag >> 4) & 0x01;
+  header->first_part_size = (tag >> 5) & 0x7ffff;
+
+  if (!header->key_frame) {
+    return TRUE;
+  }
+
+  if (size < KMS_VP8_FRAME_HEADER_SIZE) {
+    return FALSE;
+  }
+
+  if (data[3] != KEY_FRAME_START_CODE_0 || data[4] != KEY_FRAME_START_CODE_1
+      || data[5] != KEY_FRAME_START_CODE_2) {
+    return FALSE;
+  }
+
+  header->width = (data[6] | (data[7] << 8)) & 0x3fff;
+  header->horiz_scale = data[7] >> 6;
+  header->height = (data[8] | (data[9] << 8)) & 0x3fff;
+  header->vert_scale = data[9] >> 6;
+
+  return header->width != 0 && header->height != 0;
+}
+
+gboolean
+kms_vp8_parse_payload_descriptor (const guint8 * data, gsize size,
+    KmsVp8PayloadDescriptor * descriptor)
+{
+  guint offset = 0;
+  guint8 ext;
+
+  g_return_val_if_fail (descriptor != NULL, FALSE);
+
+  memset (descriptor, 0, sizeof (KmsVp8PayloadDescriptor));
+
+  if (data == NULL || size < 1) {
+    return FALSE;
+  }
+
+  descriptor->non_reference = (data[0] >> 5) & 0x01;
+  descriptor->start_of_partition = (data[0] >> 4) & 0x01;
+  descriptor->partition_index = data[0] & 0x07;
+
+  offset++;
+
+  if (!(data[0] & 0x80)) {
+    /* No extension octet */
+    goto end;
+  }
+
+  if (offset >= size) {
+    return FALSE;
+  }
+
+  ext = data[offset++];
+
+  if (ext & 0x80) {
+    if (offset >= size) {
+      return FALSE;
+    }
+
+    descriptor->has_picture_id = TRUE;
+    descriptor->picture_id_offset = offset;
+
+    if (data[offset] & 0x80) {
+      if (offset + 1 >= size) {
+        return FALSE;
+      }
+
+      descriptor->long_picture_id = TRUE;
+      descriptor->picture_id = ((data[offset] & 0x7f) << 8) | data[offset + 1];
+      offset += 2;
+    } else {
+      descriptor->picture_id = data[offset] & 0x7f;
+      offset++;
+    }
+  }
+
+  if (ext & 0x40) {
+    if (offset >= size) {
+      return FALSE;
+    }
+
+    descriptor->has_tl0picidx = TRUE;
+    descriptor->tl0picidx_offset = offset;
+    descriptor->tl0picidx = data[offset++];
+  }
+
+  if (ext & 0x30) {
+    if (offset >= size) {
+      return FALSE;
+    }
+
+    if (ext & 0x20) {
+      descriptor->has_tid = TRUE;
+      descriptor->tid = data[offset] >> 6;
+      descriptor->layer_sync = (data[offset] >> 5) & 0x01;
+    }
+
+    if (ext & 0x10) {
+      descriptor->has_keyidx = TRUE;
+      descriptor->keyidx = data[offset] & 0x1f;
+    }
+
+    offset++;
+  }
+
+end:
+  descriptor->size = offset;
+
+  /* Descriptor must be followed by some payload */
+  return offset < size;
+}
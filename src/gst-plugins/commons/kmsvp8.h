@@ -0,0 +1,75 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_VP8_H__
+#define __KMS_VP8_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Frame tag plus the key frame start code and dimensions (RFC 6386 9.1) */
+#define KMS_VP8_FRAME_HEADER_SIZE 10
+
+typedef struct _KmsVp8FrameHeader KmsVp8FrameHeader;
+typedef struct _KmsVp8PayloadDescriptor KmsVp8PayloadDescriptor;
+
+struct _KmsVp8FrameHeader
+{
+  gboolean key_frame;
+  guint8 version;
+  gboolean show_frame;
+  guint32 first_part_size;
+
+  /* Only filled in for key frames */
+  guint16 width;
+  guint16 height;
+  guint8 horiz_scale;
+  guint8 vert_scale;
+};
+
+/* RFC 7741 section 4.2 */
+struct _KmsVp8PayloadDescriptor
+{
+  gboolean non_reference;
+  gboolean start_of_partition;
+  guint8 partition_index;
+
+  gboolean has_picture_id;
+  gboolean long_picture_id;
+  guint16 picture_id;
+  guint picture_id_offset;
+
+  gboolean has_tl0picidx;
+  guint8 tl0picidx;
+  guint tl0picidx_offset;
+
+  gboolean has_tid;
+  guint8 tid;
+  gboolean layer_sync;
+
+  gboolean has_keyidx;
+  guint8 keyidx;
+
+  guint size;
+};
+
+gboolean kms_vp8_parse_frame_header (const guint8 * data, gsize size,
+    KmsVp8FrameHeader * header);
+gboolean kms_vp8_parse_payload_descriptor (const guint8 * data, gsize size,
+    KmsVp8PayloadDescriptor * descriptor);
+
+G_END_DECLS
+#endif /* __KMS_VP8_H__ */
@@ -0,0 +1,293 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "kmsvp8layerfilter.h"
+#include "kmsvp8layermeta.h"
+#include "kmsrefstruct.h"
+#include "kmsutils.h"
+
+#define GST_CAT_DEFAULT kms_vp8_layer_filter_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsvp8layerfilter"
+
+#define KMS_VP8_LAYER_FILTER_LOCK(filter) \
+  (g_mutex_lock (&(filter)->mutex))
+#define KMS_VP8_LAYER_FILTER_UNLOCK(filter) \
+  (g_mutex_unlock (&(filter)->mutex))
+
+#define TOP_LAYER (KMS_VP8_MAX_TEMPORAL_LAYERS - 1)
+
+struct _KmsVp8LayerFilter
+{
+  KmsRefStruct ref;
+  GMutex mutex;
+
+  gboolean layered;             /* frames with layer meta were seen */
+  guint budget;                 /* bps, 0 while no REMB was received */
+
+  GstClockTime window;
+  GstClockTime window_start;
+  guint64 window_bytes[KMS_VP8_MAX_TEMPORAL_LAYERS];
+  guint64 rates[KMS_VP8_MAX_TEMPORAL_LAYERS];   /* bps, 0 if unknown */
+
+  guint target;
+  guint current;
+
+  guint64 forwarded;
+  guint64 dropped;
+};
+
+static void
+kms_vp8_layer_filter_destroy (KmsVp8LayerFilter * filter)
+{
+  g_mutex_clear (&filter->mutex);
+
+  g_slice_free (KmsVp8LayerFilter, filter);
+}
+
+KmsVp8LayerFilter *
+kms_vp8_layer_filter_ref (KmsVp8LayerFilter * filter)
+{
+  return (KmsVp8LayerFilter *)
+      kms_ref_struct_ref (KMS_REF_STRUCT_CAST (filter));
+}
+
+void
+kms_vp8_layer_filter_unref (KmsVp8LayerFilter * filter)
+{
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (filter));
+}
+
+KmsVp8LayerFilter *
+kms_vp8_layer_filter_new (GstClockTime window)
+{
+  KmsVp8LayerFilter *filter;
+
+  filter = g_slice_new0 (KmsVp8LayerFilter);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (filter),
+      (GDestroyNotify) kms_vp8_layer_filter_destroy);
+
+  g_mutex_init (&filter->mutex);
+  filter->window = window;
+  filter->window_start = GST_CLOCK_TIME_NONE;
+  filter->target = TOP_LAYER;
+  filter->current = TOP_LAYER;
+
+  return filter;
+}
+
+/* Must be called with the filter lock held */
+static void
+kms_vp8_layer_filter_update_target (KmsVp8LayerFilter * filter)
+{
+  guint64 rate = 0;
+  guint target = 0, i;
+
+  if (filter->budget == 0) {
+    filter->target = TOP_LAYER;
+    goto end;
+  }
+
+  /* Base layer is always forwarded, even if it exceeds the budget */
+  for (i = 0; i < KMS_VP8_MAX_TEMPORAL_LAYERS; i++) {
+    rate += filter->rates[i];
+
+    if (i > 0 && rate > filter->budget) {
+      break;
+    }
+
+    target = i;
+  }
+
+  filter->target = target;
+
+end:
+  if (filter->target < filter->current) {
+    /* Higher layers are never referenced by lower ones, drop at once */
+    filter->current = filter->target;
+  }
+
+  GST_TRACE ("Budget %u bps, target layer %u, current layer %u",
+      filter->budget, filter->target, filter->current);
+}
+
+/* Must be called with the filter lock held */
+static void
+kms_vp8_layer_filter_account (KmsVp8LayerFilter * filter, GstBuffer * buffer,
+    guint tid)
+{
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+  GstClockTime elapsed;
+  guint i;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts)) {
+    return;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (filter->window_start)
+      || pts < filter->window_start) {
+    filter->window_start = pts;
+    memset (filter->window_bytes, 0, sizeof (filter->window_bytes));
+  }
+
+  elapsed = pts - filter->window_start;
+
+  if (elapsed >= filter->window && elapsed > 0) {
+    for (i = 0; i < KMS_VP8_MAX_TEMPORAL_LAYERS; i++) {
+      filter->rates[i] = gst_util_uint64_scale (filter->window_bytes[i] * 8,
+          GST_SECOND, elapsed);
+      filter->window_bytes[i] = 0;
+    }
+
+    filter->window_start = pts;
+    kms_vp8_layer_filter_update_target (filter);
+  }
+
+  filter->window_bytes[tid] += gst_buffer_get_size (buffer);
+}
+
+static GstPadProbeReturn
+kms_vp8_layer_filter_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsVp8LayerFilter *filter = user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  KmsVp8LayerMeta *meta;
+  gboolean drop;
+  guint tid;
+
+  meta = kms_buffer_get_vp8_layer_meta (buffer);
+
+  if (meta == NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  tid = MIN (meta->tid, TOP_LAYER);
+
+  KMS_VP8_LAYER_FILTER_LOCK (filter);
+
+  filter->layered = TRUE;
+  kms_vp8_layer_filter_account (filter, buffer, tid);
+
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    filter->current = filter->target;
+  } else if (tid > filter->current && tid <= filter->target
+      && meta->layer_sync) {
+    /* Switching up is only possible on frames that depend on the base layer */
+    GST_DEBUG_OBJECT (pad, "Switching to layer %u", tid);
+    filter->current = tid;
+  }
+
+  drop = tid > filter->current;
+
+  if (drop) {
+    filter->dropped++;
+  } else {
+    filter->forwarded++;
+  }
+
+  KMS_VP8_LAYER_FILTER_UNLOCK (filter);
+
+  return drop ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+kms_vp8_layer_filter_remb_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsVp8LayerFilter *filter = user_data;
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+  GstPadProbeReturn ret = GST_PAD_PROBE_OK;
+  guint bitrate, ssrc;
+
+  if (!kms_utils_remb_event_upstream_parse (event, &bitrate, &ssrc)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  KMS_VP8_LAYER_FILTER_LOCK (filter);
+
+  filter->budget = bitrate;
+  kms_vp8_layer_filter_update_target (filter);
+
+  if (filter->layered && filter->rates[0] > 0
+      && bitrate >= filter->rates[0]) {
+    /* Dropping layers is enough for this output to adapt by itself, the */
+    /* publisher must not be limited by it                               */
+    ret = GST_PAD_PROBE_DROP;
+  } else {
+    /* Not even the base layer fits, only the publisher can lower it */
+    GST_DEBUG_OBJECT (pad, "Forwarding REMB of %u bps upstream", bitrate);
+  }
+
+  KMS_VP8_LAYER_FILTER_UNLOCK (filter);
+
+  return ret;
+}
+
+void
+kms_vp8_layer_filter_watch_pad (KmsVp8LayerFilter * filter, GstPad * pad)
+{
+  g_return_if_fail (GST_IS_PAD (pad));
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      kms_vp8_layer_filter_buffer_probe, kms_vp8_layer_filter_ref (filter),
+      (GDestroyNotify) kms_vp8_layer_filter_unref);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+      kms_vp8_layer_filter_remb_probe, kms_vp8_layer_filter_ref (filter),
+      (GDestroyNotify) kms_vp8_layer_filter_unref);
+}
+
+guint
+kms_vp8_layer_filter_get_layer (KmsVp8LayerFilter * filter)
+{
+  guint layer;
+
+  KMS_VP8_LAYER_FILTER_LOCK (filter);
+  layer = filter->current;
+  KMS_VP8_LAYER_FILTER_UNLOCK (filter);
+
+  return layer;
+}
+
+void
+kms_vp8_layer_filter_get_counters (KmsVp8LayerFilter * filter,
+    guint64 * forwarded, guint64 * dropped)
+{
+  KMS_VP8_LAYER_FILTER_LOCK (filter);
+
+  if (forwarded != NULL) {
+    *forwarded = filter->forwarded;
+  }
+
+  if (dropped != NULL) {
+    *dropped = filter->dropped;
+  }
+
+  KMS_VP8_LAYER_FILTER_UNLOCK (filter);
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,47 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_VP8_LAYER_FILTER_H__
+#define __KMS_VP8_LAYER_FILTER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_VP8_MAX_TEMPORAL_LAYERS 4
+
+typedef struct _KmsVp8LayerFilter KmsVp8LayerFilter;
+
+/* Forwards the VP8 temporal layers that fit in the REMB budget received on
+ * a single output. Layer rates are measured over @window of stream time from
+ * the frames carrying a KmsVp8LayerMeta; frames without it always pass.
+ * REMB events are only propagated upstream when the budget is below the
+ * base layer rate, as dropping layers cannot adapt the output then. */
+KmsVp8LayerFilter * kms_vp8_layer_filter_new (GstClockTime window);
+
+KmsVp8LayerFilter * kms_vp8_layer_filter_ref (KmsVp8LayerFilter * filter);
+void kms_vp8_layer_filter_unref (KmsVp8LayerFilter * filter);
+
+/* Frames are expected downstream and REMB events upstream on @pad */
+void kms_vp8_layer_filter_watch_pad (KmsVp8LayerFilter * filter,
+    GstPad * pad);
+
+guint kms_vp8_layer_filter_get_layer (KmsVp8LayerFilter * filter);
+void kms_vp8_layer_filter_get_counters (KmsVp8LayerFilter * filter,
+    guint64 * forwarded, guint64 * dropped);
+
+G_END_DECLS
+
+#endif /* __KMS_VP8_LAYER_FILTER_H__ */
@@ -0,0 +1,197 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "kmsvp8layermeta.h"
+#include "kmsvp8.h"
+
+#include <gst/rtp/gstrtpbuffer.h>
+
+GType
+kms_vp8_layer_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("KmsVp8LayerMetaAPI", tags);
+
+    g_once_init_leave (&type, _type);
+  }
+
+  return type;
+}
+
+static gboolean
+kms_vp8_layer_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  KmsVp8LayerMeta *lmeta = (KmsVp8LayerMeta *) meta;
+
+  lmeta->tid = 0;
+  lmeta->layer_sync = FALSE;
+  lmeta->tl0picidx = 0;
+
+  return TRUE;
+}
+
+static gboolean
+kms_vp8_layer_meta_transform (GstBuffer * transbuf, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  KmsVp8LayerMeta *lmeta;
+
+  /* we always copy no matter what transform */
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    lmeta = (KmsVp8LayerMeta *) meta;
+
+    kms_buffer_add_vp8_layer_meta (transbuf, lmeta->tid, lmeta->layer_sync,
+        lmeta->tl0picidx);
+  }
+
+  return TRUE;
+}
+
+static void
+kms_vp8_layer_meta_free (GstMeta * meta, GstBuffer * buffer)
+{
+  /* Nothing to do */
+}
+
+const GstMetaInfo *
+kms_vp8_layer_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter (&meta_info)) {
+    const GstMetaInfo *mi = gst_meta_register (KMS_VP8_LAYER_META_API_TYPE,
+        "KmsVp8LayerMeta",
+        sizeof (KmsVp8LayerMeta),
+        kms_vp8_layer_meta_init,
+        kms_vp8_layer_meta_free,
+        kms_vp8_layer_meta_transform);
+
+    g_once_init_leave (&meta_info, mi);
+  }
+
+  return meta_info;
+}
+
+KmsVp8LayerMeta *
+kms_buffer_add_vp8_layer_meta (GstBuffer * buffer, guint8 tid,
+    gboolean layer_sync, guint8 tl0picidx)
+{
+  KmsVp8LayerMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  meta = (KmsVp8LayerMeta *) gst_buffer_add_meta (buffer,
+      KMS_VP8_LAYER_META_INFO, NULL);
+
+  meta->tid = tid;
+  meta->layer_sync = layer_sync;
+  meta->tl0picidx = tl0picidx;
+
+  return meta;
+}
+
+/* Descriptor of the frame being depayloaded. Both probes run on the */
+/* depayloader streaming thread, so it needs no locking.              */
+typedef struct _KmsVp8LayerTag
+{
+  gboolean valid;
+  guint8 tid;
+  gboolean layer_sync;
+  guint8 tl0picidx;
+} KmsVp8LayerTag;
+
+static void
+kms_vp8_layer_tag_destroy (KmsVp8LayerTag * tag)
+{
+  g_slice_free (KmsVp8LayerTag, tag);
+}
+
+static GstPadProbeReturn
+kms_vp8_layer_meta_rtp_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsVp8LayerTag *tag = user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  KmsVp8PayloadDescriptor desc;
+  gboolean parsed;
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  parsed = kms_vp8_parse_payload_descriptor (gst_rtp_buffer_get_payload (&rtp),
+      gst_rtp_buffer_get_payload_len (&rtp), &desc);
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  if (!parsed || !desc.start_of_partition || desc.partition_index != 0) {
+    /* Only the first packet of a frame describes it */
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* Streams not using temporal scalability carry no TID */
+  tag->valid = desc.has_tid;
+  tag->tid = desc.tid;
+  tag->layer_sync = desc.layer_sync;
+  tag->tl0picidx = desc.tl0picidx;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+kms_vp8_layer_meta_frame_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsVp8LayerTag *tag = user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (!tag->valid || kms_buffer_get_vp8_layer_meta (buffer) != NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  buffer = gst_buffer_make_writable (buffer);
+  kms_buffer_add_vp8_layer_meta (buffer, tag->tid, tag->layer_sync,
+      tag->tl0picidx);
+  GST_PAD_PROBE_INFO_DATA (info) = buffer;
+
+  return GST_PAD_PROBE_OK;
+}
+
+void
+kms_vp8_layer_meta_watch_depayloader (GstElement * depayloader)
+{
+  KmsVp8LayerTag *tag;
+  GstPad *pad;
+
+  g_return_if_fail (GST_IS_ELEMENT (depayloader));
+
+  tag = g_slice_new0 (KmsVp8LayerTag);
+  g_object_set_data_full (G_OBJECT (depayloader), "kms-vp8-layer-tag", tag,
+      (GDestroyNotify) kms_vp8_layer_tag_destroy);
+
+  pad = gst_element_get_static_pad (depayloader, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      kms_vp8_layer_meta_rtp_probe, tag, NULL);
+  g_object_unref (pad);
+
+  pad = gst_element_get_static_pad (depayloader, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      kms_vp8_layer_meta_frame_probe, tag, NULL);
+  g_object_unref (pad);
+}
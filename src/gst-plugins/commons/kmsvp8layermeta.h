@@ -0,0 +1,65 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_VP8_LAYER_META_H__
+#define __KMS_VP8_LAYER_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _KmsVp8LayerMeta KmsVp8LayerMeta;
+
+/**
+ * KmsVp8LayerMeta:
+ * @meta: the parent type
+ * @tid: Temporal layer index of the frame
+ * @layer_sync: The frame only depends on the base layer
+ * @tl0picidx: Running index of the base layer frames
+ *
+ * Buffer metadata carrying the VP8 temporal scalability information of the
+ * RTP payload descriptor, which is lost once the frame is depayloaded.
+ */
+struct _KmsVp8LayerMeta {
+  GstMeta       meta;
+
+  guint8 tid;
+  gboolean layer_sync;
+  guint8 tl0picidx;
+};
+
+GType kms_vp8_layer_meta_api_get_type (void);
+#define KMS_VP8_LAYER_META_API_TYPE \
+  (kms_vp8_layer_meta_api_get_type())
+
+#define kms_buffer_get_vp8_layer_meta(b) \
+  ((KmsVp8LayerMeta*)gst_buffer_get_meta((b), KMS_VP8_LAYER_META_API_TYPE))
+
+/* implementation */
+const GstMetaInfo *kms_vp8_layer_meta_get_info (void);
+#define KMS_VP8_LAYER_META_INFO (kms_vp8_layer_meta_get_info ())
+
+KmsVp8LayerMeta * kms_buffer_add_vp8_layer_meta (GstBuffer *buffer,
+  guint8 tid, gboolean layer_sync, guint8 tl0picidx);
+
+/* Tags the frames output by a VP8 @depayloader with the temporal layer of
+ * the RTP packets they were built from. The tag is set on the depayloaded
+ * frame itself, as depayloaders aggregating several packets into one frame
+ * do not keep the metadata of the packets. */
+void kms_vp8_layer_meta_watch_depayloader (GstElement *depayloader);
+
+G_END_DECLS
+
+#endif /* __KMS_VP8_LAYER_META_H__ */
@@ -17,6 +17,7 @@
 #include <gst/gst.h>
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define GST_CAT_DEFAULT sdp_utils
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -137,6 +138,46 @@ sdp_utils_media_get_ssrc (const GstSDPMedia * media)
   return ssrc;
 }
 
+gboolean
+sdp_utils_media_for_each_ssrc (const GstSDPMedia * media,
+    GstSDPSsrcFunc func, gpointer user_data)
+{
+  guint i, len;
+  guint64 last = G_MAXUINT64;
+
+  len = gst_sdp_media_attributes_len (media);
+
+  for (i = 0; i < len; i++) {
+    const GstSDPAttribute *a = gst_sdp_media_get_attribute (media, i);
+    gchar *end;
+    guint64 val;
+
+    if (g_strcmp0 (a->key, "ssrc") != 0 || a->value == NULL) {
+      continue;
+    }
+
+    val = g_ascii_strtoull (a->value, &end, 10);
+    if (end == a->value || val > G_MAXUINT32) {
+      GST_WARNING ("Invalid ssrc attribute '%s'", a->value);
+      continue;
+    }
+
+    /* Each SSRC usually comes in several consecutive lines */
+    if (val == last) {
+      continue;
+    }
+
+    last = val;
+
+    if (!func (val, user_data)) {
+      /* Do not continue iterating */
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
 GstSDPDirection
 sdp_utils_media_config_get_direction (const GstSDPMedia * media)
 {
@@ -159,6 +200,23 @@ sdp_utils_media_config_get_direction (const GstSDPMedia * media)
   return dir;
 }
 
+static const gchar *
+sdp_utils_get_static_rtpmap (const gchar * format)
+{
+  gint pt, i;
+
+  for (i = 0; format[i] != '\0'; i++) {
+    if (!g_ascii_isdigit (format[i]))
+      return NULL;
+  }
+
+  pt = atoi (format);
+  if (pt > 34)
+    return NULL;
+
+  return rtpmaps[pt];
+}
+
 /**
  * Returns : a string or NULL if any.
  */
@@ -183,23 +241,165 @@ sdp_utils_sdp_media_get_rtpmap (const GstSDPMedia * media, const gchar * format)
   }
 
   if (rtpmap == NULL) {
-    gint pt;
+    return sdp_utils_get_static_rtpmap (format);
+  }
+
+  return rtpmap;
+}
+
+/* Indexed media view begin */
+
+struct _SdpMediaIndex
+{
+  GHashTable *attrs;            /* key -> GPtrArray of GstSDPAttribute */
+  GHashTable *maps;             /* key -> GHashTable (fmt -> GPtrArray of values) */
+};
+
+SdpMediaIndex *
+sdp_utils_media_index_new (const GstSDPMedia * media)
+{
+  SdpMediaIndex *index;
+  guint i, len;
 
-    for (i = 0; format[i] != '\0'; i++) {
-      if (!g_ascii_isdigit (format[i]))
-        return NULL;
+  index = g_slice_new0 (SdpMediaIndex);
+  index->attrs = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) g_ptr_array_unref);
+  index->maps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_hash_table_unref);
+
+  len = gst_sdp_media_attributes_len (media);
+
+  for (i = 0; i < len; i++) {
+    const GstSDPAttribute *attr = gst_sdp_media_get_attribute (media, i);
+    GPtrArray *bucket;
+
+    if (attr->key == NULL) {
+      continue;
     }
 
-    pt = atoi (format);
-    if (pt > 34)
-      return NULL;
+    bucket = g_hash_table_lookup (index->attrs, attr->key);
+    if (bucket == NULL) {
+      bucket = g_ptr_array_new ();
+      g_hash_table_insert (index->attrs, attr->key, bucket);
+    }
 
-    rtpmap = rtpmaps[pt];
+    g_ptr_array_add (bucket, (gpointer) attr);
   }
 
-  return rtpmap;
+  return index;
+}
+
+void
+sdp_utils_media_index_free (SdpMediaIndex * index)
+{
+  g_hash_table_unref (index->attrs);
+  g_hash_table_unref (index->maps);
+
+  g_slice_free (SdpMediaIndex, index);
+}
+
+static GHashTable *
+sdp_media_index_get_map (SdpMediaIndex * index, const gchar * name)
+{
+  GHashTable *map;
+  GPtrArray *bucket;
+  guint i;
+
+  map = g_hash_table_lookup (index->maps, name);
+  if (map != NULL) {
+    return map;
+  }
+
+  /* Values are grouped by their first token, the format they refer to */
+  map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_ptr_array_unref);
+  g_hash_table_insert (index->maps, g_strdup (name), map);
+
+  bucket = g_hash_table_lookup (index->attrs, name);
+
+  for (i = 0; bucket != NULL && i < bucket->len; i++) {
+    const GstSDPAttribute *attr = g_ptr_array_index (bucket, i);
+    const gchar *sep;
+    GPtrArray *values;
+    gchar *fmt;
+
+    if (attr->value == NULL) {
+      continue;
+    }
+
+    sep = strchr (attr->value, ' ');
+    fmt = (sep != NULL) ? g_strndup (attr->value, sep - attr->value) :
+        g_strdup (attr->value);
+
+    values = g_hash_table_lookup (map, fmt);
+    if (values == NULL) {
+      values = g_ptr_array_new ();
+      g_hash_table_insert (map, fmt, values);
+    } else {
+      g_free (fmt);
+    }
+
+    g_ptr_array_add (values, attr->value);
+  }
+
+  return map;
+}
+
+const gchar *
+sdp_utils_media_index_get_attr_map_value (SdpMediaIndex * index,
+    const gchar * name, const gchar * fmt, guint n)
+{
+  GPtrArray *values;
+
+  values = g_hash_table_lookup (sdp_media_index_get_map (index, name), fmt);
+
+  if (values == NULL || n >= values->len) {
+    return NULL;
+  }
+
+  return g_ptr_array_index (values, n);
 }
 
+const gchar *
+sdp_utils_media_index_get_rtpmap (SdpMediaIndex * index, const gchar * format)
+{
+  const gchar *val;
+
+  val = sdp_utils_media_index_get_attr_map_value (index, RTPMAP, format, 0);
+
+  if (val == NULL) {
+    return sdp_utils_get_static_rtpmap (format);
+  }
+
+  val = strchr (val, ' ');
+
+  return (val != NULL) ? val + 1 : NULL;
+}
+
+gboolean
+sdp_utils_media_index_has_attribute (SdpMediaIndex * index,
+    const GstSDPAttribute * attr)
+{
+  GPtrArray *bucket = NULL;
+  guint i;
+
+  if (attr->key != NULL) {
+    bucket = g_hash_table_lookup (index->attrs, attr->key);
+  }
+
+  for (i = 0; bucket != NULL && i < bucket->len; i++) {
+    const GstSDPAttribute *a = g_ptr_array_index (bucket, i);
+
+    if (g_strcmp0 (attr->value, a->value) == 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Indexed media view end */
+
 static gboolean
 sdp_utils_add_setup_attribute (const GstSDPAttribute * attr,
     GstSDPAttribute * new_attr)
@@ -339,6 +539,13 @@ sdp_utils_intersect_media_attributes (const GstSDPMedia * offer,
 const gchar *
 sdp_utils_get_attr_map_value (const GstSDPMedia * media, const gchar * name,
     const gchar * fmt)
+{
+  return sdp_utils_get_attr_map_value_n (media, name, fmt, 0);
+}
+
+const gchar *
+sdp_utils_get_attr_map_value_n (const GstSDPMedia * media, const gchar * name,
+    const gchar * fmt, guint n)
 {
   const gchar *val = NULL;
   guint i;
@@ -355,8 +562,12 @@ sdp_utils_get_attr_map_value (const GstSDPMedia * media, const gchar * name,
     attrs = g_strsplit (val, " ", 0);
 
     if (g_strcmp0 (fmt, attrs[0] /* format */ ) == 0) {
-      g_strfreev (attrs);
-      return val;
+      if (n == 0) {
+        g_strfreev (attrs);
+        return val;
+      }
+
+      n--;
     }
 
     g_strfreev (attrs);
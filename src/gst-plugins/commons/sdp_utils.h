@@ -36,10 +36,22 @@ typedef enum GstSDPDirection
 
 typedef gboolean (*GstSDPMediaFunc) (const GstSDPMedia *media, gpointer user_data);
 typedef gboolean (*GstSDPIntersectMediaFunc) (const GstSDPAttribute *attr, gpointer user_data);
+typedef gboolean (*GstSDPSsrcFunc) (guint ssrc, gpointer user_data);
+
+/* Attributes of a media bucketed by key, and by format for map-style */
+/* ones. Owned by the caller, the media must outlive it unmodified.   */
+typedef struct _SdpMediaIndex SdpMediaIndex;
+
+SdpMediaIndex *sdp_utils_media_index_new (const GstSDPMedia * media);
+void sdp_utils_media_index_free (SdpMediaIndex * index);
+const gchar *sdp_utils_media_index_get_attr_map_value (SdpMediaIndex * index, const gchar *name, const gchar * fmt, guint n);
+const gchar *sdp_utils_media_index_get_rtpmap (SdpMediaIndex * index, const gchar * format);
+gboolean sdp_utils_media_index_has_attribute (SdpMediaIndex * index, const GstSDPAttribute * attr);
 
 gboolean sdp_utils_is_attribute_in_media (const GstSDPMedia * media, const GstSDPAttribute * attr);
 gboolean sdp_utils_attribute_is_direction (const GstSDPAttribute * attr, GstSDPDirection * direction);
 guint sdp_utils_media_get_ssrc (const GstSDPMedia * media);
+gboolean sdp_utils_media_for_each_ssrc (const GstSDPMedia * media, GstSDPSsrcFunc func, gpointer user_data);
 GstSDPDirection sdp_utils_media_config_get_direction (const GstSDPMedia * media);
 
 const gchar *sdp_utils_sdp_media_get_rtpmap (const GstSDPMedia * media,
@@ -49,6 +61,7 @@ gboolean sdp_utils_intersect_session_attributes (const GstSDPMessage * msg, GstS
 gboolean sdp_utils_intersect_media_attributes (const GstSDPMedia * offer, GstSDPIntersectMediaFunc func, gpointer user_data);
 
 const gchar *sdp_utils_get_attr_map_value (const GstSDPMedia * media, const gchar *name, const gchar * fmt);
+const gchar *sdp_utils_get_attr_map_value_n (const GstSDPMedia * media, const gchar *name, const gchar * fmt, guint n);
 
 gboolean sdp_utils_for_each_media (const GstSDPMessage * msg, GstSDPMediaFunc func, gpointer user_data);
 gboolean sdp_utils_media_is_active (const GstSDPMedia * media, gboolean offerer);
@@ -29,6 +29,7 @@ GST_DEBUG_CATEGORY_STATIC (kms_sdp_agent_debug_category);
 
 #define DEFAULT_USE_IPV6 FALSE
 #define DEFAULT_BUNDLE FALSE
+#define DEFAULT_PARALLEL_ANSWERS TRUE
 
 #define ORIGIN_ATTR_NETTYPE "IN"
 #define ORIGIN_ATTR_ADDR_TYPE_IP4 "IP4"
@@ -44,6 +45,7 @@ enum
   PROP_ADDR,
   PROP_LOCAL_DESC,
   PROP_REMOTE_DESC,
+  PROP_PARALLEL_ANSWERS,
   N_PROPERTIES
 };
 
@@ -117,6 +119,7 @@ struct _KmsSdpAgentPrivate
   GstSDPMessage *remote_description;
   gboolean use_ipv6;
   gboolean bundle;
+  gboolean parallel_answers;
   gchar *addr;
 
   GSList *handlers;
@@ -239,6 +242,9 @@ kms_sdp_agent_get_property (GObject * object, guint prop_id,
     case PROP_ADDR:
       g_value_set_string (value, self->priv->addr);
       break;
+    case PROP_PARALLEL_ANSWERS:
+      g_value_set_boolean (value, self->priv->parallel_answers);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -263,6 +269,9 @@ kms_sdp_agent_set_property (GObject * object, guint prop_id,
       g_free (self->priv->addr);
       self->priv->addr = g_value_dup_string (value);
       break;
+    case PROP_PARALLEL_ANSWERS:
+      self->priv->parallel_answers = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -398,13 +407,6 @@ kms_sdp_agent_create_offer_impl (KmsSdpAgent * agent, GError ** error)
   return ctx;
 }
 
-struct SdpAnswerData
-{
-  KmsSdpAgent *agent;
-  SdpMessageContext *ctx;
-  GError **err;
-};
-
 static GstSDPMedia *
 reject_media_answer (const GstSDPMedia * offered)
 {
@@ -468,63 +470,206 @@ kms_sdp_agent_get_handler_for_media (KmsSdpAgent * agent,
   return NULL;
 }
 
-static gboolean
-create_media_answer (const GstSDPMedia * media, struct SdpAnswerData *data)
+/* Answers for offered medias are built concurrently and merged back in */
+/* m-line order.                                                        */
+
+typedef struct _SdpAnswerBatch
+{
+  GMutex mutex;
+  GCond cond;
+  guint pending;
+} SdpAnswerBatch;
+
+typedef struct _SdpMediaAnswer
 {
-  KmsSdpAgent *agent = data->agent;
-  GstSDPMedia *answer_media = NULL;
+  SdpAnswerBatch *batch;
+  SdpMessageContext *ctx;
+  const GstSDPMedia *offer;
   SdpHandler *sdp_handler;
-  GError **err = data->err;
+  GstSDPMedia *answer;
+  GError *err;
+} SdpMediaAnswer;
 
-  SDP_AGENT_LOCK (agent);
+static void
+sdp_media_answer_create (SdpMediaAnswer * m_answer)
+{
+  m_answer->answer =
+      kms_sdp_media_handler_create_answer (m_answer->sdp_handler->handler,
+      m_answer->ctx, m_answer->offer, &m_answer->err);
+}
 
-  sdp_handler = kms_sdp_agent_get_handler_for_media (agent, media);
+static void
+sdp_media_answer_task (SdpMediaAnswer * m_answer, gpointer user_data)
+{
+  SdpAnswerBatch *batch = m_answer->batch;
 
-  SDP_AGENT_UNLOCK (agent);
+  sdp_media_answer_create (m_answer);
 
-  if (sdp_handler == NULL) {
-    GST_WARNING_OBJECT (agent,
-        "No handler for '%s' media proto '%s' found",
-        gst_sdp_media_get_media (media), gst_sdp_media_get_proto (media));
-    goto answer;
+  g_mutex_lock (&batch->mutex);
+  if (--batch->pending == 0) {
+    g_cond_signal (&batch->cond);
   }
+  g_mutex_unlock (&batch->mutex);
+}
 
-  answer_media = kms_sdp_media_handler_create_answer (sdp_handler->handler,
-      data->ctx, media, err);
+/* Media handlers answer from pool threads while the agent lock is not  */
+/* held, and one handler may answer several m-lines at the same time.   */
+/* So create_answer and every vfunc it reaches must only read handler   */
+/* state: no payload types assigned, no caches filled, no properties    */
+/* set. Handlers needing that must not be used with parallel-answers.   */
+static gpointer
+create_answers_pool (gpointer data)
+{
+  return g_thread_pool_new ((GFunc) sdp_media_answer_task, NULL,
+      g_get_num_processors (), FALSE, NULL);
+}
+
+static GThreadPool *
+get_answers_pool ()
+{
+  static GOnce once = G_ONCE_INIT;
+
+  g_once (&once, create_answers_pool, NULL);
+
+  return once.retval;
+}
+
+static void
+kms_sdp_agent_create_media_answers (SdpMediaAnswer * m_answers, guint len,
+    gboolean parallel)
+{
+  SdpAnswerBatch batch;
+  guint i, pending = 0;
+
+  for (i = 0; i < len; i++) {
+    pending += (m_answers[i].sdp_handler != NULL) ? 1 : 0;
+  }
+
+  if (!parallel || pending < 2) {
+    for (i = 0; i < len; i++) {
+      if (m_answers[i].sdp_handler != NULL) {
+        sdp_media_answer_create (&m_answers[i]);
+      }
+    }
+
+    return;
+  }
+
+  g_mutex_init (&batch.mutex);
+  g_cond_init (&batch.cond);
+  batch.pending = pending;
+
+  for (i = 0; i < len; i++) {
+    if (m_answers[i].sdp_handler == NULL) {
+      continue;
+    }
+
+    m_answers[i].batch = &batch;
+    g_thread_pool_push (get_answers_pool (), &m_answers[i], NULL);
+  }
+
+  g_mutex_lock (&batch.mutex);
+  while (batch.pending > 0) {
+    g_cond_wait (&batch.cond, &batch.mutex);
+  }
+  g_mutex_unlock (&batch.mutex);
+
+  g_mutex_clear (&batch.mutex);
+  g_cond_clear (&batch.cond);
+}
+
+static gboolean
+kms_sdp_agent_add_media_answer (KmsSdpAgent * agent, SdpMessageContext * ctx,
+    SdpMediaAnswer * m_answer, GError ** error)
+{
+  GstSDPMedia *answer_media = m_answer->answer;
+  SdpMediaConfig *mconf;
+  gboolean do_call = TRUE;
+
+  if (m_answer->sdp_handler != NULL && answer_media == NULL) {
+    if (m_answer->err != NULL) {
+      g_propagate_error (error, m_answer->err);
+      m_answer->err = NULL;
+    }
+
+    return FALSE;
+  }
 
   if (answer_media == NULL) {
+    answer_media = reject_media_answer (m_answer->offer);
+    do_call = FALSE;
+  }
+
+  m_answer->answer = NULL;
+
+  mconf = kms_sdp_message_context_add_media (ctx, answer_media, error);
+  if (mconf == NULL) {
     return FALSE;
   }
 
-answer:
-  {
-    SdpMediaConfig *mconf;
-    gboolean do_call = TRUE;
+  if (do_call && agent->priv->configure_media_callback_data != NULL) {
+    agent->priv->configure_media_callback_data->callback (agent,
+        mconf, agent->priv->configure_media_callback_data->user_data);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+kms_sdp_agent_create_answer_medias (KmsSdpAgent * agent,
+    SdpMessageContext * ctx, const GstSDPMessage * offer, GError ** error)
+{
+  SdpMediaAnswer *m_answers;
+  gboolean ret = TRUE, parallel;
+  guint i, len;
+
+  len = gst_sdp_message_medias_len (offer);
+  m_answers = g_new0 (SdpMediaAnswer, len);
+
+  SDP_AGENT_LOCK (agent);
+
+  parallel = agent->priv->parallel_answers;
 
-    if (answer_media == NULL) {
-      answer_media = reject_media_answer (media);
-      do_call = FALSE;
+  for (i = 0; i < len; i++) {
+    const GstSDPMedia *media = gst_sdp_message_get_media (offer, i);
+
+    m_answers[i].ctx = ctx;
+    m_answers[i].offer = media;
+    m_answers[i].sdp_handler =
+        kms_sdp_agent_get_handler_for_media (agent, media);
+
+    if (m_answers[i].sdp_handler == NULL) {
+      GST_WARNING_OBJECT (agent,
+          "No handler for '%s' media proto '%s' found",
+          gst_sdp_media_get_media (media), gst_sdp_media_get_proto (media));
     }
+  }
+
+  SDP_AGENT_UNLOCK (agent);
+
+  kms_sdp_agent_create_media_answers (m_answers, len, parallel);
 
-    mconf = kms_sdp_message_context_add_media (data->ctx, answer_media, err);
-    if (mconf == NULL) {
-      return FALSE;
+  for (i = 0; i < len; i++) {
+    if (ret) {
+      ret = kms_sdp_agent_add_media_answer (agent, ctx, &m_answers[i], error);
     }
 
-    if (do_call && data->agent->priv->configure_media_callback_data != NULL) {
-      data->agent->priv->configure_media_callback_data->callback (data->agent,
-          mconf, data->agent->priv->configure_media_callback_data->user_data);
+    if (m_answers[i].answer != NULL) {
+      gst_sdp_media_free (m_answers[i].answer);
     }
 
-    return TRUE;
+    g_clear_error (&m_answers[i].err);
   }
+
+  g_free (m_answers);
+
+  return ret;
 }
 
 static SdpMessageContext *
 kms_sdp_agent_create_answer_impl (KmsSdpAgent * agent,
     const GstSDPMessage * offer, GError ** error)
 {
-  struct SdpAnswerData data;
   SdpMessageContext *ctx;
   gboolean bundle;
   SdpIPv ipv;
@@ -551,12 +696,7 @@ kms_sdp_agent_create_answer_impl (KmsSdpAgent * agent,
     goto error;
   }
 
-  data.agent = agent;
-  data.ctx = ctx;
-  data.err = error;
-
-  if (!sdp_utils_for_each_media (offer, (GstSDPMediaFunc) create_media_answer,
-          &data)) {
+  if (!kms_sdp_agent_create_answer_medias (agent, ctx, offer, error)) {
     goto error;
   }
 
@@ -695,6 +835,11 @@ kms_sdp_agent_class_init (KmsSdpAgentClass * klass)
       "Remote description", "The temote SDP description", GST_TYPE_SDP_MESSAGE,
       G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  obj_properties[PROP_PARALLEL_ANSWERS] =
+      g_param_spec_boolean ("parallel-answers", "Parallel answers",
+      "Answer offered m-lines concurrently", DEFAULT_PARALLEL_ANSWERS,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class,
       N_PROPERTIES, obj_properties);
 
@@ -0,0 +1,209 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "kmssdpcodectable.h"
+
+#define MAX_ENCODING_LENGTH 64
+
+/* Codecs known by the media handlers. Static payload types are taken */
+/* from rfc3551 [6]. This table is never modified once the library is */
+/* loaded, so it can be read from any thread without locking.         */
+static const KmsSdpCodecInfo codecs[] = {
+  /* Static audio payload types */
+  {"PCMU/8000", 0, 8000, 1},
+  {"GSM/8000", 3, 8000, 1},
+  {"G723/8000", 4, 8000, 1},
+  {"DVI4/8000", 5, 8000, 1},
+  {"DVI4/16000", 6, 16000, 1},
+  {"LPC/8000", 7, 8000, 1},
+  {"PCMA/8000", 8, 8000, 1},
+  {"G722/8000", 9, 8000, 1},
+  {"L16/44100/2", 10, 44100, 2},
+  {"L16/44100", 11, 44100, 1},
+  {"QCELP/8000", 12, 8000, 1},
+  {"CN/8000", 13, 8000, 1},
+  {"MPA/90000", 14, 90000, 1},
+  {"G728/8000", 15, 8000, 1},
+  {"DVI4/11025", 16, 11025, 1},
+  {"DVI4/22050", 17, 22050, 1},
+  {"G729/8000", 18, 8000, 1},
+
+  /* Static video payload types */
+  {"CelB/90000", 25, 90000, 0},
+  {"JPEG/90000", 26, 90000, 0},
+  {"nv/90000", 28, 90000, 0},
+  {"H261/90000", 31, 90000, 0},
+  {"MPV/90000", 32, 90000, 0},
+  {"MP2T/90000", 33, 90000, 0},
+  {"H263/90000", 34, 90000, 0},
+
+  /* Dynamic audio payload types */
+  {"opus/48000/2", -1, 48000, 2},
+  {"AMR/8000", -1, 8000, 1},
+  {"iLBC/8000", -1, 8000, 1},
+  {"speex/8000", -1, 8000, 1},
+  {"speex/16000", -1, 16000, 1},
+  {"telephone-event/8000", -1, 8000, 1},
+
+  /* Dynamic video payload types */
+  {"VP8/90000", -1, 90000, 0},
+  {"VP9/90000", -1, 90000, 0},
+  {"H264/90000", -1, 90000, 0},
+  {"H263-1998/90000", -1, 90000, 0},
+  {"MP4V-ES/90000", -1, 90000, 0},
+  {"red/90000", -1, 90000, 0},
+  {"ulpfec/90000", -1, 90000, 0},
+};
+
+G_STATIC_ASSERT (G_N_ELEMENTS (codecs) <= KMS_SDP_CODEC_TABLE_MAX_SIZE);
+
+/* Encoding names are case-insensitive and the number of channels may */
+/* be omitted if it is one [rfc4566] section 6.                       */
+static gboolean
+normalize_encoding (const gchar * encoding, gchar * buff, gsize size)
+{
+  const gchar *c;
+  guint slashes = 0;
+  gsize len, i;
+
+  for (c = encoding; *c != '\0'; c++) {
+    if (*c == '/') {
+      slashes++;
+    }
+  }
+
+  len = c - encoding;
+
+  if (slashes == 2 && g_str_has_suffix (encoding, "/1")) {
+    len -= 2;
+  }
+
+  if (len >= size) {
+    return FALSE;
+  }
+
+  for (i = 0; i < len; i++) {
+    buff[i] = g_ascii_tolower (encoding[i]);
+  }
+
+  buff[len] = '\0';
+
+  return TRUE;
+}
+
+/* Entries by static payload type, filled along with the index */
+static const KmsSdpCodecInfo
+    * static_codecs[KMS_SDP_CODEC_TABLE_MAX_STATIC_PAYLOAD + 1];
+
+static gpointer
+create_codec_index (gpointer data)
+{
+  GHashTable *index;
+  guint i;
+
+  index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (codecs); i++) {
+    g_hash_table_insert (index, g_ascii_strdown (codecs[i].encoding, -1),
+        (gpointer) & codecs[i]);
+
+    if (codecs[i].payload >= 0) {
+      static_codecs[codecs[i].payload] = &codecs[i];
+    }
+  }
+
+  return index;
+}
+
+static GHashTable *
+get_codec_index ()
+{
+  static GOnce once = G_ONCE_INIT;
+
+  g_once (&once, create_codec_index, NULL);
+
+  return once.retval;
+}
+
+guint
+kms_sdp_codec_table_get_size (void)
+{
+  return G_N_ELEMENTS (codecs);
+}
+
+const KmsSdpCodecInfo *
+kms_sdp_codec_table_get (guint index)
+{
+  g_return_val_if_fail (index < G_N_ELEMENTS (codecs), NULL);
+
+  return &codecs[index];
+}
+
+const KmsSdpCodecInfo *
+kms_sdp_codec_table_lookup (const gchar * encoding)
+{
+  gchar key[MAX_ENCODING_LENGTH];
+
+  if (encoding == NULL ||
+      !normalize_encoding (encoding, key, MAX_ENCODING_LENGTH)) {
+    return NULL;
+  }
+
+  return g_hash_table_lookup (get_codec_index (), key);
+}
+
+const KmsSdpCodecInfo *
+kms_sdp_codec_table_lookup_static (gint payload)
+{
+  if (payload < 0 || payload > KMS_SDP_CODEC_TABLE_MAX_STATIC_PAYLOAD) {
+    return NULL;
+  }
+
+  get_codec_index ();
+
+  return static_codecs[payload];
+}
+
+void
+kms_sdp_codec_set_clear (KmsSdpCodecSet * set)
+{
+  memset (set, 0, sizeof (KmsSdpCodecSet));
+}
+
+void
+kms_sdp_codec_set_add (KmsSdpCodecSet * set, const KmsSdpCodecInfo * codec)
+{
+  guint pos = codec - codecs;
+
+  g_return_if_fail (pos < G_N_ELEMENTS (codecs));
+
+  set->bits[pos / 32] |= 1U << (pos % 32);
+}
+
+gboolean
+kms_sdp_codec_set_contains (const KmsSdpCodecSet * set,
+    const KmsSdpCodecInfo * codec)
+{
+  guint pos = codec - codecs;
+
+  g_return_val_if_fail (pos < G_N_ELEMENTS (codecs), FALSE);
+
+  return (set->bits[pos / 32] & (1U << (pos % 32))) != 0;
+}
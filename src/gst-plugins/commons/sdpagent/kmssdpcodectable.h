@@ -0,0 +1,55 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef _KMS_SDP_CODEC_TABLE_H_
+#define _KMS_SDP_CODEC_TABLE_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_SDP_CODEC_TABLE_MAX_SIZE 64
+#define KMS_SDP_CODEC_TABLE_MAX_STATIC_PAYLOAD 34
+
+typedef struct _KmsSdpCodecInfo KmsSdpCodecInfo;
+typedef struct _KmsSdpCodecSet KmsSdpCodecSet;
+
+struct _KmsSdpCodecInfo
+{
+  const gchar *encoding;        /* <name>/<clock rate>[/<channels>] */
+  gint payload;                 /* static payload type or -1 if dynamic */
+  guint clock_rate;
+  guint channels;
+};
+
+/* Bitmap of entries of the codec table. It contains no pointers so it */
+/* can be copied by value.                                             */
+struct _KmsSdpCodecSet
+{
+  guint32 bits[KMS_SDP_CODEC_TABLE_MAX_SIZE / 32];
+};
+
+guint kms_sdp_codec_table_get_size (void);
+const KmsSdpCodecInfo * kms_sdp_codec_table_get (guint index);
+const KmsSdpCodecInfo * kms_sdp_codec_table_lookup (const gchar * encoding);
+const KmsSdpCodecInfo * kms_sdp_codec_table_lookup_static (gint payload);
+
+void kms_sdp_codec_set_clear (KmsSdpCodecSet * set);
+void kms_sdp_codec_set_add (KmsSdpCodecSet * set, const KmsSdpCodecInfo * codec);
+gboolean kms_sdp_codec_set_contains (const KmsSdpCodecSet * set, const KmsSdpCodecInfo * codec);
+
+G_END_DECLS
+
+#endif /* _KMS_SDP_CODEC_TABLE_H_ */
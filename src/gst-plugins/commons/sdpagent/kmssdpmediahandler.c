@@ -121,6 +121,12 @@ struct _KmsSdpMediaHandlerPrivate
   gchar *addr;
   gchar *addr_type;
   GArray *bwtypes;
+
+  /* Offered m-lines only depend on the handler configuration, so the first */
+  /* one built for each media is kept and copied into later offers.         */
+  GHashTable *offers;           /* media -> GstSDPMedia */
+  guint generation;
+  GMutex mutex;
 };
 
 static void
@@ -182,10 +188,19 @@ kms_sdp_media_handler_finalize (GObject * object)
   g_free (self->priv->addr_type);
 
   g_array_free (self->priv->bwtypes, TRUE);
+  g_hash_table_unref (self->priv->offers);
+  g_mutex_clear (&self->priv->mutex);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+kms_sdp_media_handler_notify (GObject * object, GParamSpec * pspec)
+{
+  /* Any property may end up in the offered m-line */
+  kms_sdp_media_handler_invalidate_offer (KMS_SDP_MEDIA_HANDLER (object));
+}
+
 static GstSDPMedia *
 kms_sdp_media_handler_create_offer_impl (KmsSdpMediaHandler * handler,
     const gchar * media, GError ** error)
@@ -214,6 +229,8 @@ kms_sdp_media_handler_add_bandwidth_impl (KmsSdpMediaHandler * handler,
 
   gst_sdp_bandwidth_set (&bw, bwtype, bandwidth);
   g_array_append_val (handler->priv->bwtypes, bw);
+
+  kms_sdp_media_handler_invalidate_offer (handler);
 }
 
 static gboolean
@@ -343,6 +360,7 @@ kms_sdp_media_handler_class_init (KmsSdpMediaHandlerClass * klass)
   gobject_class->get_property = kms_sdp_media_handler_get_property;
   gobject_class->set_property = kms_sdp_media_handler_set_property;
   gobject_class->finalize = kms_sdp_media_handler_finalize;
+  gobject_class->notify = kms_sdp_media_handler_notify;
 
   g_object_class_install_property (gobject_class, PROP_PROTO,
       g_param_spec_string ("proto", "Protocol",
@@ -383,16 +401,62 @@ kms_sdp_media_handler_init (KmsSdpMediaHandler * self)
   self->priv->bwtypes = g_array_new (FALSE, TRUE, sizeof (GstSDPBandwidth));
   g_array_set_clear_func (self->priv->bwtypes,
       (GDestroyNotify) gst_sdp_bandwidth_clear);
+  self->priv->offers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) gst_sdp_media_free);
+  g_mutex_init (&self->priv->mutex);
 }
 
 GstSDPMedia *
 kms_sdp_media_handler_create_offer (KmsSdpMediaHandler * handler,
     const gchar * media, GError ** error)
 {
+  GstSDPMedia *offer, *template;
+  guint generation;
+
   g_return_val_if_fail (KMS_IS_SDP_MEDIA_HANDLER (handler), NULL);
 
-  return KMS_SDP_MEDIA_HANDLER_GET_CLASS (handler)->create_offer (handler,
+  g_mutex_lock (&handler->priv->mutex);
+
+  template = g_hash_table_lookup (handler->priv->offers, media);
+  if (template != NULL) {
+    gst_sdp_media_copy (template, &offer);
+    g_mutex_unlock (&handler->priv->mutex);
+
+    return offer;
+  }
+
+  generation = handler->priv->generation;
+  g_mutex_unlock (&handler->priv->mutex);
+
+  offer = KMS_SDP_MEDIA_HANDLER_GET_CLASS (handler)->create_offer (handler,
       media, error);
+
+  if (offer == NULL) {
+    return NULL;
+  }
+
+  g_mutex_lock (&handler->priv->mutex);
+
+  /* Do not keep it if configuration changed while it was being built */
+  if (generation == handler->priv->generation) {
+    gst_sdp_media_copy (offer, &template);
+    g_hash_table_insert (handler->priv->offers, g_strdup (media), template);
+  }
+
+  g_mutex_unlock (&handler->priv->mutex);
+
+  return offer;
+}
+
+void
+kms_sdp_media_handler_invalidate_offer (KmsSdpMediaHandler * handler)
+{
+  g_return_if_fail (KMS_IS_SDP_MEDIA_HANDLER (handler));
+
+  g_mutex_lock (&handler->priv->mutex);
+  handler->priv->generation++;
+  g_hash_table_remove_all (handler->priv->offers);
+  g_mutex_unlock (&handler->priv->mutex);
 }
 
 GstSDPMedia *
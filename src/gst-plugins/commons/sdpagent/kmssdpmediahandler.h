@@ -94,6 +94,7 @@ GstSDPMedia * kms_sdp_media_handler_create_offer (KmsSdpMediaHandler *handler, c
 GstSDPMedia * kms_sdp_media_handler_create_answer (KmsSdpMediaHandler *handler, SdpMessageContext *ctx, const GstSDPMedia * offer, GError **error);
 void kms_sdp_media_handler_add_bandwidth (KmsSdpMediaHandler *handler, const gchar *bwtype, guint bandwidth);
 gboolean kms_sdp_media_handler_manage_protocol (KmsSdpMediaHandler *handler, const gchar *protocol);
+void kms_sdp_media_handler_invalidate_offer (KmsSdpMediaHandler *handler);
 
 G_END_DECLS
 
@@ -22,6 +22,7 @@
 #include "kmssdpagent.h"
 #include "sdp_utils.h"
 #include "kmssdprtpavpmediahandler.h"
+#include "kmssdpcodectable.h"
 
 #define OBJECT_NAME "rtpavpmediahandler"
 
@@ -49,56 +50,15 @@ struct _KmsSdpRtpAvpMediaHandlerPrivate
   KmsISdpPayloadManager *ptmanager;
   GSList *audio_fmts;
   GSList *video_fmts;
+  KmsSdpCodecSet audio_codecs;
+  KmsSdpCodecSet video_codecs;
 };
 
 #define SDP_AUDIO_MEDIA "audio"
 #define SDP_VIDEO_MEDIA "video"
 
-#define DEFAULT_RTP_AUDIO_BASE_PAYLOAD 0
 #define DEFAULT_RTP_VIDEO_BASE_PAYLOAD 24
 
-/* Table extracted from rfc3551 [6] */
-static gchar *rtpmaps[] = {
-  /* Payload types (PT) for audio encodings */
-  "PCMU/8000",
-  NULL,                         /* reserved */
-  NULL,                         /* reserved */
-  "GSM/8000",
-  "G723/8000",
-  "DVI4/8000",
-  "DVI4/16000",
-  "LPC/8000",
-  "PCMA/8000",
-  "G722/8000",
-  "L16/44100/2",
-  "L16/44100",
-  "QCELP/8000",
-  "CN/8000",
-  "MPA/90000",
-  "G728/8000",
-  "DVI4/11025",
-  "DVI4/22050",
-  "G729/8000",
-  NULL,                         /* reserved */
-  NULL,                         /* unasigned */
-  NULL,                         /* unasigned */
-  NULL,                         /* unasigned */
-  NULL,                         /* unasigned */
-
-  /* Payload types (PT) for video encodings */
-  NULL,                         /* unasigned */
-  "CelB/90000",
-  "JPEG/90000",
-  NULL,                         /* unasigned */
-  "nv/90000",
-  NULL,                         /* unasigned */
-  NULL,                         /* unasigned */
-  "H261/90000",
-  "MPV/90000",
-  "MP2T/90000",
-  "H263/90000",
-};
-
 typedef struct _KmsSdpRtpMap KmsSdpRtpMap;
 struct _KmsSdpRtpMap
 {
@@ -143,59 +103,39 @@ kms_sdp_rtp_map_destroy_pointer (gpointer rtpmap)
 }
 
 static gboolean
-cmp_static_payload (const gchar * enc, const gchar * static_pt)
+kms_sdp_rtp_map_add_fmtp (KmsSdpRtpMap * rtpmap, const gchar * value,
+    GError ** error)
 {
-  const gchar *cmp;
-  gchar *substr = NULL;
-  gboolean ret;
-
-  if (static_pt == NULL || !g_str_has_prefix (enc, static_pt)) {
-    return FALSE;
-  }
+  GstSDPAttribute *fmtp;
+  gchar *attr;
 
-  /* For audio streams, <encoding parameters> indicates the number */
-  /* of audio channels.  This parameter is OPTIONAL and may be     */
-  /* omitted if the number of channels is one, provided that no    */
-  /* additional parameters are needed. [rfc4566] section 6.        */
+  fmtp = g_slice_new0 (GstSDPAttribute);
 
-  if (g_str_has_suffix (enc, "/1")) {
-    substr = g_strndup (enc, strlen (enc) - 2);
-    cmp = substr;
-  } else {
-    cmp = enc;
+  attr = g_strdup_printf ("%u %s", rtpmap->payload, value);
+  if (gst_sdp_attribute_set (fmtp, "fmtp", attr) != GST_SDP_OK) {
+    g_set_error_literal (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
+        "Can not create fmtp attribute");
+    g_slice_free (GstSDPAttribute, fmtp);
+    g_free (attr);
+    return FALSE;
   }
 
-  ret = g_strcmp0 (cmp, static_pt) == 0;
-  g_free (substr);
-
-  return ret;
-}
-
-static gint
-get_static_payload_for_codec_name (const gchar * name)
-{
-  guint i;
+  g_free (attr);
 
-  for (i = 0; i < G_N_ELEMENTS (rtpmaps); i++) {
-    if (cmp_static_payload (name, rtpmaps[i])) {
-      return i;
-    }
-  }
+  rtpmap->fmtps = g_slist_prepend (rtpmap->fmtps, fmtp);
 
-  return -1;
+  return TRUE;
 }
 
 static KmsSdpRtpMap *
 kms_sdp_rtp_map_create_for_codec (KmsSdpRtpAvpMediaHandler * self,
-    const gchar * name, GError ** error)
+    const KmsSdpCodecInfo * codec, const gchar * name, GError ** error)
 {
   KmsSdpRtpMap *rtpmap = NULL;
   gint payload;
 
-  payload = get_static_payload_for_codec_name (name);
-
-  if (payload >= 0) {
-    return kms_sdp_rtp_map_new (payload, name);
+  if (codec != NULL && codec->payload >= 0) {
+    return kms_sdp_rtp_map_new (codec->payload, name);
   }
 
   if (self->priv->ptmanager == NULL) {
@@ -208,10 +148,12 @@ kms_sdp_rtp_map_create_for_codec (KmsSdpRtpAvpMediaHandler * self,
   payload = kms_i_sdp_payload_manager_get_dynamic_pt (self->priv->ptmanager,
       error);
 
-  if (payload >= 0) {
-    rtpmap = kms_sdp_rtp_map_new (payload, name);
+  if (payload < 0) {
+    return NULL;
   }
 
+  rtpmap = kms_sdp_rtp_map_new (payload, name);
+
   return rtpmap;
 }
 
@@ -262,12 +204,14 @@ kms_sdp_rtp_avp_media_handler_add_supported_fmts (KmsSdpRtpAvpMediaHandler *
 
   while (item != NULL) {
     KmsSdpRtpMap *rtpmap = item->data;
+    const KmsSdpCodecInfo *codec;
     gchar *fmt;
 
     /* Make some checks for default PTs */
-    if (rtpmap->payload >= DEFAULT_RTP_AUDIO_BASE_PAYLOAD &&
-        rtpmap->payload <= G_N_ELEMENTS (rtpmaps)) {
-      if (rtpmaps[rtpmap->payload] == NULL) {
+    if (rtpmap->payload <= KMS_SDP_CODEC_TABLE_MAX_STATIC_PAYLOAD) {
+      codec = kms_sdp_codec_table_lookup_static (rtpmap->payload);
+
+      if (codec == NULL) {
         g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
             "Trying to use an invalid PT (%d)", rtpmap->payload);
       } else if (is_audio && rtpmap->payload >= DEFAULT_RTP_VIDEO_BASE_PAYLOAD) {
@@ -281,13 +225,13 @@ kms_sdp_rtp_avp_media_handler_add_supported_fmts (KmsSdpRtpAvpMediaHandler *
             rtpmap->payload);
         return FALSE;
       } else {
-        gchar **codec;
+        gchar **tokens;
         gboolean ret;
 
-        codec = g_strsplit (rtpmap->name, "/", 0);
+        tokens = g_strsplit (rtpmap->name, "/", 0);
 
-        ret = g_str_has_prefix (rtpmaps[rtpmap->payload], codec[0]);
-        g_strfreev (codec);
+        ret = g_str_has_prefix (codec->encoding, tokens[0]);
+        g_strfreev (tokens);
 
         if (!ret) {
           g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
@@ -388,7 +332,7 @@ kms_sdp_rtp_avp_media_handler_add_rtpmap_attrs (KmsSdpRtpAvpMediaHandler * self,
 
     /* [rfc4566] rtpmap attribute can be omitted for static payload type  */
     /* numbers so it is completely defined in the RTP Audio/Video profile */
-    omit = pt >= DEFAULT_RTP_AUDIO_BASE_PAYLOAD && pt <= G_N_ELEMENTS (rtpmaps);
+    omit = pt <= KMS_SDP_CODEC_TABLE_MAX_STATIC_PAYLOAD;
 
     for (item = fmts; item != NULL; item = g_slist_next (item)) {
       KmsSdpRtpMap *rtpmap = item->data;
@@ -474,12 +418,13 @@ kms_sdp_rtp_avp_media_handler_encoding_supported (KmsSdpRtpAvpMediaHandler *
 
   while (item != NULL) {
     KmsSdpRtpMap *rtpmap = item->data;
+    const KmsSdpCodecInfo *codec;
     gboolean supported = FALSE;
 
-    if (rtpmap->payload >= DEFAULT_RTP_AUDIO_BASE_PAYLOAD &&
-        rtpmap->payload <= G_N_ELEMENTS (rtpmaps)) {
+    if (rtpmap->payload <= KMS_SDP_CODEC_TABLE_MAX_STATIC_PAYLOAD) {
       /* Check static payload type */
-      supported = cmp_static_payload (enc, rtpmaps[rtpmap->payload]);
+      codec = kms_sdp_codec_table_lookup_static (rtpmap->payload);
+      supported = codec != NULL && kms_sdp_codec_table_lookup (enc) == codec;
     } else {
       /* Check dynamic pt */
       supported = g_strcmp0 (rtpmap->name, enc) == 0;
@@ -497,24 +442,24 @@ kms_sdp_rtp_avp_media_handler_encoding_supported (KmsSdpRtpAvpMediaHandler *
 
 static gboolean
 kms_sdp_rtp_avp_media_handler_format_supported (KmsSdpRtpAvpMediaHandler * self,
-    const GstSDPMedia * media, const gchar * fmt)
+    const GstSDPMedia * media, SdpMediaIndex * index, const gchar * fmt)
 {
   const gchar *val;
   gchar **attrs;
   gboolean ret;
 
-  val = sdp_utils_get_attr_map_value (media, "rtpmap", fmt);
+  val = sdp_utils_media_index_get_attr_map_value (index, "rtpmap", fmt, 0);
 
   if (val == NULL) {
-    gint pt;
+    const KmsSdpCodecInfo *codec;
 
     /* Check if this is a static payload type so they do not need to be */
     /* set in an rtpmap attribute */
 
-    pt = atoi (fmt);
-    if (pt >= 0 && pt <= G_N_ELEMENTS (rtpmaps) && rtpmaps[pt] != NULL) {
+    codec = kms_sdp_codec_table_lookup_static (atoi (fmt));
+    if (codec != NULL) {
       return kms_sdp_rtp_avp_media_handler_encoding_supported (self, media,
-          rtpmaps[pt]);
+          codec->encoding);
     } else {
       return FALSE;
     }
@@ -580,7 +525,7 @@ static gboolean
 static gboolean
     kms_sdp_rtp_avp_media_handler_add_supported_rtpmap_attrs
     (KmsSdpRtpAvpMediaHandler * self, const GstSDPMedia * offer,
-    GstSDPMedia * answer, GError ** error)
+    SdpMediaIndex * index, GstSDPMedia * answer, GError ** error)
 {
   guint i, len;
 
@@ -590,18 +535,18 @@ static gboolean
     const gchar *fmt, *val;
 
     fmt = gst_sdp_media_get_format (answer, i);
-    val = sdp_utils_get_attr_map_value (offer, "rtpmap", fmt);
+    val = sdp_utils_media_index_get_attr_map_value (index, "rtpmap", fmt, 0);
 
     if (val == NULL) {
-      gint pt;
+      const KmsSdpCodecInfo *codec;
 
       /* Check if this is a static payload type so they do not need to be */
       /* set in an rtpmap attribute */
 
-      pt = atoi (fmt);
-      if (pt >= 0 && pt <= G_N_ELEMENTS (rtpmaps) && rtpmaps[pt] != NULL) {
+      codec = kms_sdp_codec_table_lookup_static (atoi (fmt));
+      if (codec != NULL) {
         if (kms_sdp_rtp_avp_media_handler_encoding_supported (self, offer,
-                rtpmaps[pt])) {
+                codec->encoding)) {
           /* Static payload do not nee to be set as rtpmap attribute */
           continue;
         } else {
@@ -841,6 +786,8 @@ kms_sdp_rtp_avp_media_handler_add_answer_attributes_impl (KmsSdpMediaHandler *
     handler, const GstSDPMedia * offer, GstSDPMedia * answer, GError ** error)
 {
   KmsSdpRtpAvpMediaHandler *self = KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler);
+  SdpMediaIndex *index;
+  gboolean ret = FALSE;
   guint i, len, port;
 
   len = gst_sdp_media_formats_len (offer);
@@ -850,20 +797,24 @@ kms_sdp_rtp_avp_media_handler_add_answer_attributes_impl (KmsSdpMediaHandler *
     return FALSE;
   }
 
+  /* Offered rtpmaps are looked up once per format */
+  index = sdp_utils_media_index_new (offer);
+
   /* Set only supported media formats in answer */
   for (i = 0; i < len; i++) {
     const gchar *fmt;
 
     fmt = gst_sdp_media_get_format (offer, i);
 
-    if (!kms_sdp_rtp_avp_media_handler_format_supported (self, offer, fmt)) {
+    if (!kms_sdp_rtp_avp_media_handler_format_supported (self, offer, index,
+            fmt)) {
       continue;
     }
 
     if (gst_sdp_media_add_format (answer, fmt) != GST_SDP_OK) {
       g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
           "Can add format '%s'", fmt);
-      return FALSE;
+      goto end;
     }
   }
 
@@ -877,16 +828,21 @@ kms_sdp_rtp_avp_media_handler_add_answer_attributes_impl (KmsSdpMediaHandler *
   if (gst_sdp_media_set_port_info (answer, port, 1) != GST_SDP_OK) {
     g_set_error_literal (error, KMS_SDP_AGENT_ERROR,
         SDP_AGENT_INVALID_PARAMETER, "Can not set port attribute");
-    return FALSE;
+    goto end;
   }
 
   if (!kms_sdp_rtp_avp_media_handler_add_supported_extmaps (self, offer,
           answer, error)) {
-    return FALSE;
+    goto end;
   }
 
-  return kms_sdp_rtp_avp_media_handler_add_supported_rtpmap_attrs (self, offer,
-      answer, error);
+  ret = kms_sdp_rtp_avp_media_handler_add_supported_rtpmap_attrs (self, offer,
+      index, answer, error);
+
+end:
+  sdp_utils_media_index_free (index);
+
+  return ret;
 }
 
 static void
@@ -970,6 +926,7 @@ kms_sdp_rtp_avp_media_handler_add_extmap (KmsSdpRtpAvpMediaHandler * self,
 
   g_hash_table_insert (self->priv->extmaps, GUINT_TO_POINTER (id),
       g_strdup (uri));
+  kms_sdp_media_handler_invalidate_offer (KMS_SDP_MEDIA_HANDLER (self));
 
   return TRUE;
 }
@@ -988,6 +945,7 @@ kms_sdp_rtp_avp_media_handler_use_payload_manager (KmsSdpRtpAvpMediaHandler *
 
   /* take ownership */
   self->priv->ptmanager = manager;
+  kms_sdp_media_handler_invalidate_offer (KMS_SDP_MEDIA_HANDLER (self));
 
   return TRUE;
 }
@@ -1012,32 +970,52 @@ static gint
 kms_sdp_rtp_avp_media_handler_add_codec (KmsSdpRtpAvpMediaHandler * self,
     const gchar * media, const gchar * name, GError ** error)
 {
+  const KmsSdpCodecInfo *codec;
+  KmsSdpCodecSet *codecs;
   KmsSdpRtpMap *rtpmap;
   GSList **fmts;
+  gboolean used;
 
   if (g_strcmp0 (media, SDP_AUDIO_MEDIA) == 0) {
     fmts = &self->priv->audio_fmts;
+    codecs = &self->priv->audio_codecs;
   } else if (g_strcmp0 (media, SDP_VIDEO_MEDIA) == 0) {
     fmts = &self->priv->video_fmts;
+    codecs = &self->priv->video_codecs;
   } else {
     g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
         "Unsuported media '%s'", media);
     return -1;
   }
 
-  if (is_codec_used (*fmts, name)) {
+  /* Well-known codecs are checked against the bitmap, only generic */
+  /* payloads need to walk through the list of formats               */
+  codec = kms_sdp_codec_table_lookup (name);
+
+  if (codec != NULL) {
+    used = kms_sdp_codec_set_contains (codecs, codec);
+  } else {
+    used = is_codec_used (*fmts, name);
+  }
+
+  if (used) {
     g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
         "Codec %s is already used", name);
     return -1;
   }
 
-  rtpmap = kms_sdp_rtp_map_create_for_codec (self, name, error);
+  rtpmap = kms_sdp_rtp_map_create_for_codec (self, codec, name, error);
 
   if (rtpmap == NULL) {
     return -1;
   }
 
+  if (codec != NULL) {
+    kms_sdp_codec_set_add (codecs, codec);
+  }
+
   *fmts = g_slist_append (*fmts, rtpmap);
+  kms_sdp_media_handler_invalidate_offer (KMS_SDP_MEDIA_HANDLER (self));
 
   return rtpmap->payload;
 }
@@ -1082,9 +1060,6 @@ gboolean
 kms_sdp_rtp_avp_media_handler_add_fmtp (KmsSdpRtpAvpMediaHandler * self,
     guint payload, const gchar * value, GError ** error)
 {
-  GstSDPAttribute *fmtp;
-  KmsSdpRtpMap *rtpmap;
-  gchar *attr;
   GSList *l;
 
   l = g_slist_find_custom (self->priv->audio_fmts, &payload,
@@ -1101,21 +1076,11 @@ kms_sdp_rtp_avp_media_handler_add_fmtp (KmsSdpRtpAvpMediaHandler * self,
     return FALSE;
   }
 
-  fmtp = g_slice_new0 (GstSDPAttribute);
-
-  attr = g_strdup_printf ("%u %s", payload, value);
-  if (gst_sdp_attribute_set (fmtp, "fmtp", attr) != GST_SDP_OK) {
-    g_set_error_literal (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
-        "Can not create fmtp attribute");
-    g_slice_free (GstSDPAttribute, fmtp);
-    g_free (attr);
+  if (!kms_sdp_rtp_map_add_fmtp (l->data, value, error)) {
     return FALSE;
   }
 
-  g_free (attr);
-
-  rtpmap = l->data;
-  rtpmap->fmtps = g_slist_prepend (rtpmap->fmtps, fmtp);
+  kms_sdp_media_handler_invalidate_offer (KMS_SDP_MEDIA_HANDLER (self));
 
   return TRUE;
 }
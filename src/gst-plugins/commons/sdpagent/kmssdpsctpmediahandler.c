@@ -118,13 +118,13 @@ subproto_supported (const gchar * subproto)
 }
 
 static gboolean
-format_supported (const GstSDPMedia * media, const gchar * fmt)
+format_supported (SdpMediaIndex * index, const gchar * fmt)
 {
   const gchar *val;
   gchar **attrs;
   gboolean ret;
 
-  val = sdp_utils_get_attr_map_value (media, "sctpmap", fmt);
+  val = sdp_utils_media_index_get_attr_map_value (index, "sctpmap", fmt, 0);
 
   if (val == NULL) {
     return FALSE;
@@ -138,7 +138,7 @@ format_supported (const GstSDPMedia * media, const gchar * fmt)
 }
 
 static gboolean
-add_supported_sctmap_attrs (const GstSDPMedia * offer, GstSDPMedia * answer,
+add_supported_sctmap_attrs (SdpMediaIndex * index, GstSDPMedia * answer,
     GError ** error)
 {
   guint i, len;
@@ -149,7 +149,7 @@ add_supported_sctmap_attrs (const GstSDPMedia * offer, GstSDPMedia * answer,
     const gchar *fmt, *val;
 
     fmt = gst_sdp_media_get_format (answer, i);
-    val = sdp_utils_get_attr_map_value (offer, "sctpmap", fmt);
+    val = sdp_utils_media_index_get_attr_map_value (index, "sctpmap", fmt, 0);
 
     if (val == NULL) {
       GST_WARNING ("Not 'sctpmap:%s' attribute found in offer", fmt);
@@ -167,8 +167,8 @@ add_supported_sctmap_attrs (const GstSDPMedia * offer, GstSDPMedia * answer,
 }
 
 static gboolean
-add_supported_subproto_attrs (const GstSDPMedia * offer, GstSDPMedia * answer,
-    GError ** error)
+add_supported_subproto_attrs (const GstSDPMedia * offer,
+    SdpMediaIndex * index, GstSDPMedia * answer, GError ** error)
 {
   guint i, len;
 
@@ -180,7 +180,7 @@ add_supported_subproto_attrs (const GstSDPMedia * offer, GstSDPMedia * answer,
     guint j;
 
     fmt = gst_sdp_media_get_format (answer, i);
-    val = sdp_utils_get_attr_map_value (offer, "sctpmap", fmt);
+    val = sdp_utils_media_index_get_attr_map_value (index, "sctpmap", fmt, 0);
 
     if (val == NULL) {
       g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
@@ -502,6 +502,8 @@ static gboolean
 kms_sdp_sctp_media_handler_add_answer_attributes_impl (KmsSdpMediaHandler *
     handler, const GstSDPMedia * offer, GstSDPMedia * answer, GError ** error)
 {
+  SdpMediaIndex *index;
+  gboolean ret = FALSE;
   guint i, len;
 
   if (!KMS_SDP_MEDIA_HANDLER_CLASS (parent_class)->add_answer_attributes
@@ -509,6 +511,7 @@ kms_sdp_sctp_media_handler_add_answer_attributes_impl (KmsSdpMediaHandler *
     return FALSE;
   }
 
+  index = sdp_utils_media_index_new (offer);
   len = gst_sdp_media_formats_len (offer);
 
   /* Set only supported media formats in answer */
@@ -517,22 +520,27 @@ kms_sdp_sctp_media_handler_add_answer_attributes_impl (KmsSdpMediaHandler *
 
     fmt = gst_sdp_media_get_format (offer, i);
 
-    if (!format_supported (offer, fmt)) {
+    if (!format_supported (index, fmt)) {
       continue;
     }
 
     if (gst_sdp_media_add_format (answer, fmt) != GST_SDP_OK) {
       g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
           "Can not add format '%s'", fmt);
-      return FALSE;
+      goto end;
     }
   }
 
-  if (!add_supported_sctmap_attrs (offer, answer, error)) {
-    return FALSE;
+  if (!add_supported_sctmap_attrs (index, answer, error)) {
+    goto end;
   }
 
-  return add_supported_subproto_attrs (offer, answer, error);
+  ret = add_supported_subproto_attrs (offer, index, answer, error);
+
+end:
+  sdp_utils_media_index_free (index);
+
+  return ret;
 }
 
 static void
@@ -20,9 +20,13 @@
 #include "kmsagnosticbin.h"
 #include "kmsagnosticcaps.h"
 #include "kmsutils.h"
+#include "kmsgopcache.h"
+#include "kmsvp8layerfilter.h"
 #include "kmsparsetreebin.h"
 #include "kmsdectreebin.h"
 #include "kmsenctreebin.h"
+#include "kmsconverttreebin.h"
+#include "kmsloop.h"
 
 #define PLUGIN_NAME "agnosticbin"
 
@@ -58,12 +62,20 @@ G_DEFINE_TYPE (KmsAgnosticBin2, kms_agnostic_bin2, GST_TYPE_BIN);
 
 #define OLD_CHAIN_KEY "kms-old-chain-key"
 #define CONFIGURED_KEY "kms-configured-key"
+#define GOP_CACHE_KEY "kms-gop-cache"
+#define TREE_STATE_KEY "kms-tree-state"
 
 #define TARGET_BITRATE_DEFAULT 300000
+#define GOP_CACHE_SIZE_DEFAULT 0
+#define VP8_LAYER_RATE_WINDOW GST_SECOND
+#define VP8_LAYER_FILTER_DEFAULT TRUE
+#define IDLE_TREE_TIMEOUT_DEFAULT 5000  /* ms */
 
 struct _KmsAgnosticBin2Private
 {
   GHashTable *bins;
+  GHashTable *bins_index;
+  GHashTable *convert_bins;
 
   GRecMutex thread_mutex;
 
@@ -79,12 +91,30 @@ struct _KmsAgnosticBin2Private
   GThreadPool *remove_pool;
 
   gint default_bitrate;
+  guint gop_cache_size;
+  guint idle_tree_timeout;
+  gboolean vp8_layer_filter;
+
+  guint bitrate_update_interval;
+  guint bitrate_up_threshold;
+  guint bitrate_down_threshold;
+  guint bitrate_up_ramp;
+  guint bitrate_down_ramp;
 };
 
 enum
 {
   PROP_0,
   PROP_DEFAULT_BITRATE,
+  PROP_GOP_CACHE_SIZE,
+  PROP_IDLE_TREE_TIMEOUT,
+  PROP_BITRATE_UPDATE_INTERVAL,
+  PROP_BITRATE_UP_THRESHOLD,
+  PROP_BITRATE_DOWN_THRESHOLD,
+  PROP_BITRATE_UP_RAMP,
+  PROP_BITRATE_DOWN_RAMP,
+  PROP_VP8_LAYER_FILTER,
+  PROP_STATS,
   N_PROPERTIES
 };
 
@@ -99,11 +129,151 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src_%u",
     GST_PAD_REQUEST,
     GST_STATIC_CAPS_ANY);
 
+static GstCaps *
+kms_agnostic_bin2_get_bin_caps (GstBin * bin)
+{
+  GstElement *output_tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin));
+  GstPad *tee_sink = gst_element_get_static_pad (output_tee, "sink");
+  GstCaps *caps = gst_pad_get_current_caps (tee_sink);
+
+  if (caps == NULL) {
+    caps = gst_pad_get_allowed_caps (tee_sink);
+    GST_TRACE_OBJECT (bin, "Allowed caps are: %" GST_PTR_FORMAT, caps);
+  } else {
+    GST_TRACE_OBJECT (bin, "Current caps are: %" GST_PTR_FORMAT, caps);
+  }
+
+  g_object_unref (tee_sink);
+
+  return caps;
+}
+
+static void
+kms_agnostic_bin2_index_add (KmsAgnosticBin2 * self, GQuark name, GstBin * bin)
+{
+  GSList *bins = g_hash_table_lookup (self->priv->bins_index,
+      GUINT_TO_POINTER (name));
+
+  if (g_slist_find (bins, bin) == NULL) {
+    g_hash_table_insert (self->priv->bins_index, GUINT_TO_POINTER (name),
+        g_slist_prepend (bins, bin));
+  }
+}
+
+static void
+kms_agnostic_bin2_index_remove (KmsAgnosticBin2 * self, GstBin * bin)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init (&iter, self->priv->bins_index);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    GSList *bins = g_slist_remove (value, bin);
+
+    if (bins == NULL) {
+      g_hash_table_iter_remove (&iter);
+    } else if (bins != value) {
+      g_hash_table_iter_replace (&iter, bins);
+    }
+  }
+}
+
+static void
+kms_agnostic_bin2_index_clear (KmsAgnosticBin2 * self)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init (&iter, self->priv->bins_index);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    g_slist_free (value);
+    g_hash_table_iter_remove (&iter);
+  }
+}
+
+/*
+ * Bins are indexed by the media names (structure name quarks) their output
+ * can produce, so looking up a bin for some caps only has to intersect
+ * against the bins producing the same media. Bins whose caps can not be
+ * known yet are kept under the 0 quark and always checked, until caps are
+ * negotiated on their output tee.
+ */
+static void
+kms_agnostic_bin2_index_bin_caps (KmsAgnosticBin2 * self, GstBin * bin,
+    const GstCaps * caps)
+{
+  guint i;
+
+  /* The bin may be indexed again after a caps change */
+  kms_agnostic_bin2_index_remove (self, bin);
+
+  if (caps == NULL || gst_caps_is_any (caps) || gst_caps_is_empty (caps)) {
+    kms_agnostic_bin2_index_add (self, 0, bin);
+  } else {
+    for (i = 0; i < gst_caps_get_size (caps); i++) {
+      kms_agnostic_bin2_index_add (self,
+          gst_structure_get_name_id (gst_caps_get_structure (caps, i)), bin);
+    }
+  }
+}
+
+static void
+kms_agnostic_bin2_index_bin (KmsAgnosticBin2 * self, GstBin * bin)
+{
+  GstCaps *caps;
+
+  caps = kms_agnostic_bin2_get_bin_caps (bin);
+  kms_agnostic_bin2_index_bin_caps (self, bin, caps);
+
+  if (caps != NULL) {
+    gst_caps_unref (caps);
+  }
+}
+
+static GstPadProbeReturn
+kms_agnostic_bin2_output_caps_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer bin)
+{
+  KmsAgnosticBin2 *self = KMS_AGNOSTIC_BIN2 (GST_OBJECT_PARENT (bin));
+  GstEvent *event = gst_pad_probe_info_get_event (info);
+  GstCaps *caps;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS || self == NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  gst_event_parse_caps (event, &caps);
+
+  KMS_AGNOSTIC_BIN2_LOCK (self);
+
+  /* Released bins must not get back into the index */
+  if (g_hash_table_lookup (self->priv->bins, GST_OBJECT_NAME (bin)) == bin) {
+    GST_TRACE_OBJECT (bin, "Indexing with caps %" GST_PTR_FORMAT, caps);
+    kms_agnostic_bin2_index_bin_caps (self, GST_BIN (bin), caps);
+  }
+
+  KMS_AGNOSTIC_BIN2_UNLOCK (self);
+
+  return GST_PAD_PROBE_OK;
+}
+
 static void
 kms_agnostic_bin2_insert_bin (KmsAgnosticBin2 * self, GstBin * bin)
 {
+  GstElement *output_tee;
+  GstPad *tee_sink;
+
   g_hash_table_insert (self->priv->bins, GST_OBJECT_NAME (bin),
       g_object_ref (bin));
+  kms_agnostic_bin2_index_bin (self, bin);
+
+  /* Bins are usually inserted before their output caps are negotiated. */
+  /* The pad belongs to the bin, so the probe does not hold a reference. */
+  output_tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin));
+  tee_sink = gst_element_get_static_pad (output_tee, "sink");
+  gst_pad_add_probe (tee_sink, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      kms_agnostic_bin2_output_caps_probe, bin, NULL);
+  g_object_unref (tee_sink);
 }
 
 /*
@@ -133,18 +303,6 @@ send_dummy_event (GstPad * pad)
   g_object_unref (parent);
 }
 
-static gboolean
-is_raw_caps (GstCaps * caps)
-{
-  gboolean ret;
-  GstCaps *raw_caps = gst_caps_from_string (KMS_AGNOSTIC_RAW_CAPS);
-
-  ret = gst_caps_is_always_compatible (caps, raw_caps);
-
-  gst_caps_unref (raw_caps);
-  return ret;
-}
-
 static GstPadProbeReturn
 tee_src_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
 {
@@ -166,10 +324,10 @@ remove_on_unlinked_async (gpointer data, gpointer not_used)
 {
   GstElement *elem = GST_ELEMENT_CAST (data);
   GstObject *parent = gst_object_get_parent (GST_OBJECT (elem));
+  GstElementFactory *factory = gst_element_get_factory (elem);
 
   gst_element_set_locked_state (elem, TRUE);
-  if (g_strcmp0 (GST_OBJECT_NAME (gst_element_get_factory (elem)),
-          "queue") == 0) {
+  if (factory != NULL && g_strcmp0 (GST_OBJECT_NAME (factory), "queue") == 0) {
     g_object_set (G_OBJECT (elem), "flush-on-eos", TRUE, NULL);
     gst_element_send_event (elem, gst_event_new_eos ());
   }
@@ -400,17 +558,307 @@ remove_target_pad (GstPad * pad)
   g_object_unref (target);
 }
 
+/* Encoded outputs of @bin keep their last GOP to prime new pads */
+static void
+kms_agnostic_bin2_add_gop_cache (KmsAgnosticBin2 * self, GstBin * bin)
+{
+  GstElement *output_tee;
+  KmsGopCache *cache;
+  GstPad *tee_sink;
+
+  if (self->priv->gop_cache_size == 0) {
+    return;
+  }
+
+  output_tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin));
+  tee_sink = gst_element_get_static_pad (output_tee, "sink");
+
+  cache = kms_gop_cache_new (self->priv->gop_cache_size);
+  kms_gop_cache_watch_pad (cache, tee_sink);
+  g_object_set_data_full (G_OBJECT (output_tee), GOP_CACHE_KEY, cache,
+      (GDestroyNotify) kms_gop_cache_unref);
+
+  g_object_unref (tee_sink);
+}
+
+static gboolean
+kms_agnostic_bin2_forwards_vp8 (KmsAgnosticBin2 * self, GstElement * tee)
+{
+  GstCaps *caps = self->priv->input_bin_src_caps;
+
+  if (caps == NULL || gst_caps_get_size (caps) == 0 ||
+      !gst_structure_has_name (gst_caps_get_structure (caps, 0),
+          "video/x-vp8")) {
+    return FALSE;
+  }
+
+  return tee ==
+      kms_tree_bin_get_output_tee (KMS_TREE_BIN (self->priv->input_bin));
+}
+
+/* Forwarded VP8 outputs adapt to their own REMB by dropping temporal layers */
+static void
+kms_agnostic_bin2_add_layer_filter (KmsAgnosticBin2 * self, GstElement * queue)
+{
+  KmsVp8LayerFilter *filter;
+  GstPad *queue_src;
+
+  queue_src = gst_element_get_static_pad (queue, "src");
+
+  filter = kms_vp8_layer_filter_new (VP8_LAYER_RATE_WINDOW);
+  kms_vp8_layer_filter_watch_pad (filter, queue_src);
+  kms_vp8_layer_filter_unref (filter);
+
+  g_object_unref (queue_src);
+}
+
+/*
+ * Tree bins that lose all their users (outputs or tree bins linked to their
+ * output tee) are parked: their input is dropped and they release their own
+ * upstream bin. A parked bin is reused if a new user arrives within
+ * idle-tree-timeout, otherwise it is torn down.
+ */
+typedef struct _KmsTreeState
+{
+  GstBin *upstream;
+  guint users;
+  gboolean parked;
+  gulong probe_id;
+  GSource *timer;
+} KmsTreeState;
+
+static KmsLoop *idle_loop;
+static GMainContext *idle_context;
+
+static gpointer
+kms_agnostic_bin2_create_idle_loop (gpointer data)
+{
+  idle_loop = kms_loop_new ();
+  g_object_get (idle_loop, "context", &idle_context, NULL);
+
+  return NULL;
+}
+
+static void
+kms_agnostic_bin2_init_idle_loop (void)
+{
+  static GOnce idle_once = G_ONCE_INIT;
+
+  g_once (&idle_once, kms_agnostic_bin2_create_idle_loop, NULL);
+}
+
+static void
+kms_tree_state_clear_timer (KmsTreeState * state)
+{
+  if (state->timer != NULL) {
+    g_source_destroy (state->timer);
+    g_source_unref (state->timer);
+    state->timer = NULL;
+  }
+}
+
+static void
+kms_tree_state_destroy (KmsTreeState * state)
+{
+  kms_tree_state_clear_timer (state);
+  g_slice_free (KmsTreeState, state);
+}
+
+static KmsTreeState *
+kms_agnostic_bin2_get_tree_state (GstBin * bin)
+{
+  return g_object_get_data (G_OBJECT (bin), TREE_STATE_KEY);
+}
+
+static GstPadProbeReturn
+drop_while_parked (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  return GST_PAD_PROBE_DROP;
+}
+
+static void
+kms_agnostic_bin2_acquire_bin (KmsAgnosticBin2 * self, GstBin * bin)
+{
+  KmsTreeState *state = kms_agnostic_bin2_get_tree_state (bin);
+  GstElement *input;
+  GstPad *sink;
+
+  /* The input bin is always active */
+  if (state == NULL || state->users++ > 0 || !state->parked) {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (self, "Reusing idle %" GST_PTR_FORMAT, bin);
+
+  kms_tree_state_clear_timer (state);
+  state->parked = FALSE;
+
+  input = kms_tree_bin_get_input_element (KMS_TREE_BIN (bin));
+  sink = gst_element_get_static_pad (input, "sink");
+  gst_pad_remove_probe (sink, state->probe_id);
+  state->probe_id = 0;
+  kms_utils_drop_until_keyframe (sink, TRUE);
+  g_object_unref (sink);
+
+  if (state->upstream != NULL) {
+    kms_agnostic_bin2_acquire_bin (self, state->upstream);
+  }
+}
+
+static gboolean
+is_convert_bin (gpointer key, gpointer value, gpointer bin)
+{
+  return value == bin;
+}
+
+static void
+kms_agnostic_bin2_teardown_bin (KmsAgnosticBin2 * self, GstBin * bin)
+{
+  KmsTreeState *state = kms_agnostic_bin2_get_tree_state (bin);
+  GList *bins, *l;
+
+  /* Bins still hanging from this one can only be parked ones */
+  bins = g_list_concat (g_hash_table_get_values (self->priv->bins),
+      g_hash_table_get_values (self->priv->convert_bins));
+  g_list_foreach (bins, (GFunc) g_object_ref, NULL);
+  for (l = bins; l != NULL; l = l->next) {
+    KmsTreeState *child = kms_agnostic_bin2_get_tree_state (l->data);
+
+    if (child != NULL && child->upstream == bin) {
+      kms_agnostic_bin2_teardown_bin (self, l->data);
+    }
+  }
+  g_list_free_full (bins, g_object_unref);
+
+  GST_DEBUG_OBJECT (self, "Releasing idle %" GST_PTR_FORMAT, bin);
+
+  kms_tree_state_clear_timer (state);
+  state->upstream = NULL;
+
+  g_object_ref (bin);
+  kms_agnostic_bin2_index_remove (self, bin);
+  if (g_hash_table_lookup (self->priv->bins, GST_OBJECT_NAME (bin)) == bin) {
+    g_hash_table_remove (self->priv->bins, GST_OBJECT_NAME (bin));
+  }
+  g_hash_table_foreach_remove (self->priv->convert_bins, is_convert_bin, bin);
+
+  kms_tree_bin_unlink_input_element_from_tee (KMS_TREE_BIN (bin));
+  g_thread_pool_push (self->priv->remove_pool, bin, NULL);
+}
+
+static gboolean
+kms_agnostic_bin2_idle_timeout (gpointer data)
+{
+  GstBin *bin = GST_BIN (data);
+  KmsTreeState *state;
+  GstObject *parent;
+
+  parent = gst_object_get_parent (GST_OBJECT (bin));
+
+  if (parent == NULL) {
+    /* Already removed from the agnosticbin */
+    state = kms_agnostic_bin2_get_tree_state (bin);
+    kms_tree_state_clear_timer (state);
+    return G_SOURCE_REMOVE;
+  }
+
+  KMS_AGNOSTIC_BIN2_LOCK (parent);
+
+  state = kms_agnostic_bin2_get_tree_state (bin);
+  if (state->timer == g_main_current_source ()) {
+    kms_agnostic_bin2_teardown_bin (KMS_AGNOSTIC_BIN2 (parent), bin);
+  }
+
+  KMS_AGNOSTIC_BIN2_UNLOCK (parent);
+  gst_object_unref (parent);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+kms_agnostic_bin2_release_bin (KmsAgnosticBin2 * self, GstBin * bin)
+{
+  KmsTreeState *state = kms_agnostic_bin2_get_tree_state (bin);
+  GstElement *input;
+  GstPad *sink;
+
+  if (state == NULL || state->users == 0 || --state->users > 0) {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (self, "Parking idle %" GST_PTR_FORMAT, bin);
+
+  input = kms_tree_bin_get_input_element (KMS_TREE_BIN (bin));
+  sink = gst_element_get_static_pad (input, "sink");
+  state->probe_id = gst_pad_add_probe (sink,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      drop_while_parked, NULL, NULL);
+  g_object_unref (sink);
+  state->parked = TRUE;
+
+  state->timer = g_timeout_source_new (self->priv->idle_tree_timeout);
+  g_source_set_callback (state->timer, kms_agnostic_bin2_idle_timeout,
+      g_object_ref (bin), g_object_unref);
+  g_source_attach (state->timer, idle_context);
+
+  if (state->upstream != NULL) {
+    kms_agnostic_bin2_release_bin (self, state->upstream);
+  }
+}
+
+/* @bin starts unused and keeps @upstream in use while it is not parked */
+static void
+kms_agnostic_bin2_track_bin (KmsAgnosticBin2 * self, GstBin * bin,
+    GstBin * upstream)
+{
+  KmsTreeState *state = g_slice_new0 (KmsTreeState);
+
+  state->upstream = upstream;
+  g_object_set_data_full (G_OBJECT (bin), TREE_STATE_KEY, state,
+      (GDestroyNotify) kms_tree_state_destroy);
+
+  kms_agnostic_bin2_acquire_bin (self, upstream);
+}
+
+static gboolean
+kms_agnostic_bin2_output_gone (gpointer data)
+{
+  GstBin *bin = GST_BIN (data);
+  GstObject *parent = gst_object_get_parent (GST_OBJECT (bin));
+
+  if (parent == NULL) {
+    return G_SOURCE_REMOVE;
+  }
+
+  KMS_AGNOSTIC_BIN2_LOCK (parent);
+  kms_agnostic_bin2_release_bin (KMS_AGNOSTIC_BIN2 (parent), bin);
+  KMS_AGNOSTIC_BIN2_UNLOCK (parent);
+  gst_object_unref (parent);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+kms_agnostic_bin2_output_unlinked (GstPad * pad, GstPad * peer, GstBin * bin)
+{
+  /* Unlinking happens from streaming threads, account it outside of them */
+  kms_loop_idle_add_full (idle_loop, G_PRIORITY_DEFAULT,
+      kms_agnostic_bin2_output_gone, g_object_ref (bin), g_object_unref);
+}
+
 static void
 kms_agnostic_bin2_link_to_tee (KmsAgnosticBin2 * self, GstPad * pad,
     GstElement * tee, GstCaps * caps)
 {
   GstElement *queue = gst_element_factory_make ("queue", NULL);
-  GstPad *target;
+  KmsGopCache *cache;
+  GstPad *target, *queue_sink;
+  GstBin *bin;
 
   gst_bin_add (GST_BIN (self), queue);
   gst_element_sync_state_with_parent (queue);
 
-  if (!gst_caps_is_any (caps) && is_raw_caps (caps)) {
+  if (kms_utils_caps_are_raw (caps)) {
     GstElement *convert = kms_utils_create_convert_for_caps (caps);
     GstElement *rate = kms_utils_create_rate_for_caps (caps);
     GstElement *mediator = kms_utils_create_mediator_element (caps);
@@ -428,49 +876,78 @@ kms_agnostic_bin2_link_to_tee (KmsAgnosticBin2 * self, GstPad * pad,
     gst_element_link_many (queue, rate, convert, mediator, NULL);
     target = gst_element_get_static_pad (mediator, "src");
   } else {
+    if (self->priv->vp8_layer_filter
+        && kms_agnostic_bin2_forwards_vp8 (self, tee)) {
+      kms_agnostic_bin2_add_layer_filter (self, queue);
+    }
+
     target = gst_element_get_static_pad (queue, "src");
   }
 
   gst_ghost_pad_set_target (GST_GHOST_PAD (pad), target);
   g_object_unref (target);
+
+  queue_sink = gst_element_get_static_pad (queue, "sink");
+
+  cache = g_object_get_data (G_OBJECT (tee), GOP_CACHE_KEY);
+  if (cache != NULL) {
+    /* Must be in place before the first buffer reaches the queue */
+    kms_gop_cache_prime_pad (cache, queue_sink);
+  }
+
+  bin = GST_BIN (GST_OBJECT_PARENT (tee));
+  kms_agnostic_bin2_acquire_bin (self, bin);
+  g_signal_connect_data (queue_sink, "unlinked",
+      G_CALLBACK (kms_agnostic_bin2_output_unlinked), g_object_ref (bin),
+      (GClosureNotify) g_object_unref, 0);
+  g_object_unref (queue_sink);
+
   link_element_to_tee (tee, queue);
 }
 
+static GstBin *
+kms_agnostic_bin2_find_bin_in_index (KmsAgnosticBin2 * self, GQuark name,
+    GstCaps * caps)
+{
+  GSList *l;
+
+  l = g_hash_table_lookup (self->priv->bins_index, GUINT_TO_POINTER (name));
+
+  for (; l != NULL; l = l->next) {
+    GstCaps *current_caps = kms_agnostic_bin2_get_bin_caps (l->data);
+    gboolean found = FALSE;
+
+    if (current_caps != NULL) {
+      found = gst_caps_can_intersect (caps, current_caps);
+      gst_caps_unref (current_caps);
+    }
+
+    if (found) {
+      return l->data;
+    }
+  }
+
+  return NULL;
+}
+
 static GstBin *
 kms_agnostic_bin2_find_bin_for_caps (KmsAgnosticBin2 * self, GstCaps * caps)
 {
-  GList *bins, *l;
   GstBin *bin = NULL;
+  guint i;
 
   if (gst_caps_is_any (caps)) {
     return self->priv->input_bin;
   }
 
-  bins = g_hash_table_get_values (self->priv->bins);
-  for (l = bins; l != NULL && bin == NULL; l = l->next) {
-    GstElement *output_tee =
-        kms_tree_bin_get_output_tee (KMS_TREE_BIN (l->data));
-    GstPad *tee_sink = gst_element_get_static_pad (output_tee, "sink");
-    GstCaps *current_caps = gst_pad_get_current_caps (tee_sink);
-
-    if (current_caps == NULL) {
-      current_caps = gst_pad_get_allowed_caps (tee_sink);
-      GST_TRACE_OBJECT (l->data, "Allowed caps are: %" GST_PTR_FORMAT,
-          current_caps);
-    } else {
-      GST_TRACE_OBJECT (l->data, "Current caps are: %" GST_PTR_FORMAT,
-          current_caps);
-    }
-
-    if (current_caps != NULL) {
-      if (gst_caps_can_intersect (caps, current_caps))
-        bin = l->data;
-      gst_caps_unref (current_caps);
-    }
+  for (i = 0; i < gst_caps_get_size (caps) && bin == NULL; i++) {
+    bin = kms_agnostic_bin2_find_bin_in_index (self,
+        gst_structure_get_name_id (gst_caps_get_structure (caps, i)), caps);
+  }
 
-    g_object_unref (tee_sink);
+  if (bin == NULL) {
+    bin = kms_agnostic_bin2_find_bin_in_index (self, 0, caps);
   }
-  g_list_free (bins);
 
   return bin;
 }
@@ -513,6 +990,7 @@ kms_agnostic_bin2_create_dec_bin (KmsAgnosticBin2 * self,
       kms_tree_bin_get_output_tee (KMS_TREE_BIN (self->priv->input_bin));
   input_element = kms_tree_bin_get_input_element (KMS_TREE_BIN (dec_bin));
   link_element_to_tee (output_tee, input_element);
+  kms_agnostic_bin2_track_bin (self, GST_BIN (dec_bin), self->priv->input_bin);
 
   return GST_BIN (dec_bin);
 }
@@ -546,34 +1024,179 @@ kms_agnostic_bin2_get_or_create_dec_bin (KmsAgnosticBin2 * self, GstCaps * caps)
   }
 }
 
+/* Raw caps the conversion stage must produce for @enc_bin */
+static GstCaps *
+kms_agnostic_bin2_get_convert_caps (KmsEncTreeBin * enc_bin,
+    const GstCaps * caps)
+{
+  const gchar *fields[] = { "width", "height", "framerate" };
+  GstStructure *st, *raw_st;
+  GstCaps *raw_caps;
+  guint i;
+
+  raw_caps = kms_enc_tree_bin_get_raw_caps (enc_bin);
+  raw_st = gst_caps_get_structure (raw_caps, 0);
+  st = gst_caps_get_structure (caps, 0);
+
+  /* Geometry is only part of the key when the output fixes it */
+  for (i = 0; i < G_N_ELEMENTS (fields); i++) {
+    const GValue *value = gst_structure_get_value (st, fields[i]);
+
+    if (value != NULL && gst_value_is_fixed (value)) {
+      gst_structure_set_value (raw_st, fields[i], value);
+    }
+  }
+
+  return raw_caps;
+}
+
+/*
+ * Video encoders fed by the same decoder share one conversion stage for each
+ * (format, width, height, framerate), so the colorspace conversion is done
+ * once for all of them.
+ */
+static GstBin *
+kms_agnostic_bin2_get_or_create_convert_bin (KmsAgnosticBin2 * self,
+    GstBin * dec_bin, KmsEncTreeBin * enc_bin, const GstCaps * caps)
+{
+  KmsConvertTreeBin *convert_bin;
+  GstElement *output_tee, *input_element;
+  GstCaps *raw_caps;
+  gchar *caps_str, *key;
+
+  raw_caps = kms_agnostic_bin2_get_convert_caps (enc_bin, caps);
+  caps_str = gst_caps_to_string (raw_caps);
+  key = g_strdup_printf ("%s:%s", GST_OBJECT_NAME (dec_bin), caps_str);
+  g_free (caps_str);
+
+  convert_bin = g_hash_table_lookup (self->priv->convert_bins, key);
+
+  if (convert_bin != NULL) {
+    GST_DEBUG_OBJECT (self, "Reusing conversion %s", key);
+    g_free (key);
+    gst_caps_unref (raw_caps);
+    return GST_BIN (convert_bin);
+  }
+
+  convert_bin = kms_convert_tree_bin_new (raw_caps);
+  gst_caps_unref (raw_caps);
+
+  gst_bin_add (GST_BIN (self), GST_ELEMENT (convert_bin));
+  gst_element_sync_state_with_parent (GST_ELEMENT (convert_bin));
+
+  output_tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (dec_bin));
+  input_element = kms_tree_bin_get_input_element (KMS_TREE_BIN (convert_bin));
+  link_element_to_tee (output_tee, input_element);
+  kms_agnostic_bin2_track_bin (self, GST_BIN (convert_bin), dec_bin);
+
+  GST_DEBUG_OBJECT (self, "Created conversion %s", key);
+  g_hash_table_insert (self->priv->convert_bins, key,
+      g_object_ref (convert_bin));
+
+  return GST_BIN (convert_bin);
+}
+
+static void
+kms_agnostic_bin2_configure_bitrate_controller (KmsAgnosticBin2 * self,
+    KmsEncTreeBin * enc_bin)
+{
+  KmsBitrateController *controller;
+
+  controller = kms_enc_tree_bin_get_bitrate_controller (enc_bin);
+  kms_bitrate_controller_set_min_interval (controller,
+      self->priv->bitrate_update_interval * GST_MSECOND);
+  kms_bitrate_controller_set_thresholds (controller,
+      self->priv->bitrate_up_threshold, self->priv->bitrate_down_threshold);
+  kms_bitrate_controller_set_ramps (controller, self->priv->bitrate_up_ramp,
+      self->priv->bitrate_down_ramp);
+}
+
+static void
+kms_agnostic_bin2_configure_bitrate_controllers (KmsAgnosticBin2 * self)
+{
+  GHashTableIter iter;
+  gpointer bin;
+
+  g_hash_table_iter_init (&iter, self->priv->bins);
+  while (g_hash_table_iter_next (&iter, NULL, &bin)) {
+    if (KMS_IS_ENC_TREE_BIN (bin)) {
+      kms_agnostic_bin2_configure_bitrate_controller (self,
+          KMS_ENC_TREE_BIN (bin));
+    }
+  }
+}
+
+static GstStructure *
+kms_agnostic_bin2_get_stats (KmsAgnosticBin2 * self)
+{
+  GstStructure *stats;
+  GHashTableIter iter;
+  gpointer name, bin;
+
+  stats = gst_structure_new_empty ("stats");
+
+  g_hash_table_iter_init (&iter, self->priv->bins);
+  while (g_hash_table_iter_next (&iter, &name, &bin)) {
+    GstStructure *controller_stats;
+
+    if (!KMS_IS_ENC_TREE_BIN (bin)) {
+      continue;
+    }
+
+    controller_stats =
+        kms_bitrate_controller_get_stats
+        (kms_enc_tree_bin_get_bitrate_controller (KMS_ENC_TREE_BIN (bin)));
+    gst_structure_set (stats, name, GST_TYPE_STRUCTURE, controller_stats,
+        NULL);
+    gst_structure_free (controller_stats);
+  }
+
+  return stats;
+}
+
 static GstBin *
 kms_agnostic_bin2_create_bin_for_caps (KmsAgnosticBin2 * self, GstCaps * caps)
 {
-  GstBin *dec_bin;
+  GstBin *dec_bin, *raw_bin;
   KmsEncTreeBin *enc_bin;
   GstElement *input_element, *output_tee;
+  gboolean shared_convert;
 
   dec_bin = kms_agnostic_bin2_get_or_create_dec_bin (self, caps);
   if (dec_bin == NULL) {
     return NULL;
   }
 
-  if (is_raw_caps (caps)) {
+  if (kms_utils_caps_are_raw (caps)) {
     return dec_bin;
   }
 
-  enc_bin = kms_enc_tree_bin_new (caps, self->priv->default_bitrate);
+  shared_convert = kms_utils_caps_are_video (caps);
+  enc_bin = kms_enc_tree_bin_new (caps, self->priv->default_bitrate,
+      !shared_convert);
   if (enc_bin == NULL) {
     return NULL;
   }
 
+  kms_agnostic_bin2_configure_bitrate_controller (self, enc_bin);
+
+  if (shared_convert) {
+    raw_bin = kms_agnostic_bin2_get_or_create_convert_bin (self, dec_bin,
+        enc_bin, caps);
+  } else {
+    raw_bin = dec_bin;
+  }
+
   gst_bin_add (GST_BIN (self), GST_ELEMENT (enc_bin));
   gst_element_sync_state_with_parent (GST_ELEMENT (enc_bin));
 
-  output_tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (dec_bin));
+  output_tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (raw_bin));
   input_element = kms_tree_bin_get_input_element (KMS_TREE_BIN (enc_bin));
   link_element_to_tee (output_tee, input_element);
 
+  kms_agnostic_bin2_track_bin (self, GST_BIN (enc_bin), raw_bin);
+
+  kms_agnostic_bin2_add_gop_cache (self, GST_BIN (enc_bin));
   kms_agnostic_bin2_insert_bin (self, GST_BIN (enc_bin));
 
   return GST_BIN (enc_bin);
@@ -610,8 +1233,15 @@ kms_agnostic_bin2_link_pad (KmsAgnosticBin2 * self, GstPad * pad, GstPad * peer)
 
   if (bin != NULL) {
     GstElement *tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin));
+    KmsGopCache *cache = g_object_get_data (G_OBJECT (tee), GOP_CACHE_KEY);
+
+    /* With a GOP cache the priming probe on the queue decides, on the first */
+    /* buffer, whether a key frame has to be requested, so it is only asked  */
+    /* for once per output                                                   */
+    if (cache == NULL) {
+      kms_utils_drop_until_keyframe (pad, TRUE);
+    }
 
-    kms_utils_drop_until_keyframe (pad, TRUE);
     kms_agnostic_bin2_link_to_tee (self, pad, tee, caps);
   }
 
@@ -754,6 +1384,10 @@ kms_agnostic_bin2_configure_input (KmsAgnosticBin2 * self, const GstCaps * caps)
   parse_bin = kms_parse_tree_bin_new (caps);
   self->priv->input_bin = GST_BIN (parse_bin);
 
+  if (!kms_utils_caps_are_raw (caps)) {
+    kms_agnostic_bin2_add_gop_cache (self, GST_BIN (parse_bin));
+  }
+
   parser = kms_parse_tree_bin_get_parser (KMS_PARSE_TREE_BIN (parse_bin));
   parser_src = gst_element_get_static_pad (parser, "src");
   gst_pad_add_probe (parser_src, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
@@ -771,6 +1405,9 @@ kms_agnostic_bin2_configure_input (KmsAgnosticBin2 * self, const GstCaps * caps)
   GST_DEBUG ("Removing old treebins");
   g_hash_table_foreach (self->priv->bins, remove_bin, self);
   g_hash_table_remove_all (self->priv->bins);
+  kms_agnostic_bin2_index_clear (self);
+  g_hash_table_foreach (self->priv->convert_bins, remove_bin, self);
+  g_hash_table_remove_all (self->priv->convert_bins);
 
   KMS_AGNOSTIC_BIN2_UNLOCK (self);
 }
@@ -811,7 +1448,8 @@ kms_agnostic_bin2_sink_caps_probe (GstPad * pad, GstPadProbeInfo * info,
         current_caps);
 
     if (!gst_caps_can_intersect (new_caps, current_caps) &&
-        !is_raw_caps (current_caps) && !is_raw_caps (new_caps)) {
+        !kms_utils_caps_are_raw (current_caps)
+        && !kms_utils_caps_are_raw (new_caps)) {
       GST_DEBUG_OBJECT (user_data, "Caps differ caps: %" GST_PTR_FORMAT,
           new_caps);
       kms_agnostic_bin2_configure_input (self, new_caps);
@@ -942,6 +1580,9 @@ kms_agnostic_bin2_finalize (GObject * object)
 
   g_rec_mutex_clear (&self->priv->thread_mutex);
 
+  kms_agnostic_bin2_index_clear (self);
+  g_hash_table_unref (self->priv->bins_index);
+  g_hash_table_unref (self->priv->convert_bins);
   g_hash_table_unref (self->priv->bins);
 
   /* chain up */
@@ -961,6 +1602,51 @@ kms_agnostic_bin2_set_property (GObject * object, guint property_id,
       GST_DEBUG ("default bitrate configured %d", self->priv->default_bitrate);
       KMS_AGNOSTIC_BIN2_UNLOCK (self);
       break;
+    case PROP_GOP_CACHE_SIZE:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->gop_cache_size = g_value_get_uint (value);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_IDLE_TREE_TIMEOUT:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->idle_tree_timeout = g_value_get_uint (value);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_UPDATE_INTERVAL:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->bitrate_update_interval = g_value_get_uint (value);
+      kms_agnostic_bin2_configure_bitrate_controllers (self);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_UP_THRESHOLD:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->bitrate_up_threshold = g_value_get_uint (value);
+      kms_agnostic_bin2_configure_bitrate_controllers (self);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_DOWN_THRESHOLD:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->bitrate_down_threshold = g_value_get_uint (value);
+      kms_agnostic_bin2_configure_bitrate_controllers (self);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_UP_RAMP:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->bitrate_up_ramp = g_value_get_uint (value);
+      kms_agnostic_bin2_configure_bitrate_controllers (self);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_DOWN_RAMP:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->bitrate_down_ramp = g_value_get_uint (value);
+      kms_agnostic_bin2_configure_bitrate_controllers (self);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_VP8_LAYER_FILTER:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->vp8_layer_filter = g_value_get_boolean (value);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -979,6 +1665,51 @@ kms_agnostic_bin2_get_property (GObject * object, guint property_id,
       g_value_set_int (value, self->priv->default_bitrate);
       KMS_AGNOSTIC_BIN2_UNLOCK (self);
       break;
+    case PROP_GOP_CACHE_SIZE:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_uint (value, self->priv->gop_cache_size);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_IDLE_TREE_TIMEOUT:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_uint (value, self->priv->idle_tree_timeout);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_UPDATE_INTERVAL:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_uint (value, self->priv->bitrate_update_interval);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_UP_THRESHOLD:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_uint (value, self->priv->bitrate_up_threshold);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_DOWN_THRESHOLD:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_uint (value, self->priv->bitrate_down_threshold);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_UP_RAMP:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_uint (value, self->priv->bitrate_up_ramp);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_BITRATE_DOWN_RAMP:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_uint (value, self->priv->bitrate_down_ramp);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_VP8_LAYER_FILTER:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_boolean (value, self->priv->vp8_layer_filter);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_STATS:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_take_boxed (value, kms_agnostic_bin2_get_stats (self));
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -1020,6 +1751,66 @@ kms_agnostic_bin2_class_init (KmsAgnosticBin2Class * klass)
           "Configure the default bitrate to media encoding",
           0, G_MAXINT, 0, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_GOP_CACHE_SIZE,
+      g_param_spec_uint ("gop-cache-size", "GOP cache size",
+          "Maximum buffers of the last GOP kept to start new encoded outputs "
+          "without requesting a key frame (0 disables the cache)",
+          0, G_MAXUINT, GOP_CACHE_SIZE_DEFAULT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_IDLE_TREE_TIMEOUT,
+      g_param_spec_uint ("idle-tree-timeout", "Idle tree timeout",
+          "Milliseconds a decoding or encoding branch without outputs is kept "
+          "paused, ready to be reused, before being released",
+          0, G_MAXUINT, IDLE_TREE_TIMEOUT_DEFAULT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BITRATE_UPDATE_INTERVAL,
+      g_param_spec_uint ("bitrate-update-interval", "Bitrate update interval",
+          "Minimum milliseconds before increasing the bitrate of an encoder "
+          "again, decreases are applied at once",
+          0, G_MAXUINT, KMS_BITRATE_CONTROLLER_DEFAULT_MIN_INTERVAL,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BITRATE_UP_THRESHOLD,
+      g_param_spec_uint ("bitrate-up-threshold", "Bitrate up threshold",
+          "Percentage over the encoding bitrate a target has to reach "
+          "before the encoder is reconfigured",
+          0, G_MAXUINT, KMS_BITRATE_CONTROLLER_DEFAULT_UP_THRESHOLD,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BITRATE_DOWN_THRESHOLD,
+      g_param_spec_uint ("bitrate-down-threshold", "Bitrate down threshold",
+          "Percentage under the encoding bitrate a target has to reach "
+          "before the encoder is reconfigured",
+          0, 100, KMS_BITRATE_CONTROLLER_DEFAULT_DOWN_THRESHOLD,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BITRATE_UP_RAMP,
+      g_param_spec_uint ("bitrate-up-ramp", "Bitrate up ramp",
+          "Maximum percentage the encoding bitrate grows in one update "
+          "(0 means no limit)",
+          0, G_MAXUINT, KMS_BITRATE_CONTROLLER_DEFAULT_UP_RAMP,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_BITRATE_DOWN_RAMP,
+      g_param_spec_uint ("bitrate-down-ramp", "Bitrate down ramp",
+          "Maximum percentage the encoding bitrate drops in one update "
+          "(0 means no limit)",
+          0, 100, KMS_BITRATE_CONTROLLER_DEFAULT_DOWN_RAMP,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_VP8_LAYER_FILTER,
+      g_param_spec_boolean ("vp8-layer-filter", "VP8 layer filter",
+          "Adapt forwarded VP8 outputs to their REMB by dropping temporal "
+          "layers. Applies to outputs linked afterwards",
+          VP8_LAYER_FILTER_DEFAULT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Bitrate decisions taken for each encoder, indexed by bin name",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  kms_agnostic_bin2_init_idle_loop ();
+
   GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, PLUGIN_NAME, 0, PLUGIN_NAME);
 
   g_type_class_add_private (klass, sizeof (KmsAgnosticBin2Private));
@@ -1083,8 +1874,22 @@ kms_agnostic_bin2_init (KmsAgnosticBin2 * self)
       g_thread_pool_new (remove_on_unlinked_async, NULL, -1, FALSE, NULL);
   self->priv->bins =
       g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+  self->priv->bins_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->priv->convert_bins =
+      g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
   g_rec_mutex_init (&self->priv->thread_mutex);
   self->priv->default_bitrate = TARGET_BITRATE_DEFAULT;
+  self->priv->gop_cache_size = GOP_CACHE_SIZE_DEFAULT;
+  self->priv->idle_tree_timeout = IDLE_TREE_TIMEOUT_DEFAULT;
+  self->priv->vp8_layer_filter = VP8_LAYER_FILTER_DEFAULT;
+  self->priv->bitrate_update_interval =
+      KMS_BITRATE_CONTROLLER_DEFAULT_MIN_INTERVAL;
+  self->priv->bitrate_up_threshold =
+      KMS_BITRATE_CONTROLLER_DEFAULT_UP_THRESHOLD;
+  self->priv->bitrate_down_threshold =
+      KMS_BITRATE_CONTROLLER_DEFAULT_DOWN_THRESHOLD;
+  self->priv->bitrate_up_ramp = KMS_BITRATE_CONTROLLER_DEFAULT_UP_RAMP;
+  self->priv->bitrate_down_ramp = KMS_BITRATE_CONTROLLER_DEFAULT_DOWN_RAMP;
 }
 
 gboolean
@@ -18,7 +18,6 @@
 #endif
 
 #include "kmsbitratefilter.h"
-#include <commons/kmsutils.h>
 
 #define PLUGIN_NAME "bitratefilter"
 
@@ -36,13 +35,32 @@ G_DEFINE_TYPE (KmsBitrateFilter, kms_bitrate_filter, GST_TYPE_BASE_TRANSFORM);
   )                                           \
 )
 
-#define BITRATE_CALC_INTERVAL GST_SECOND
+#define BITRATE_CALC_INTERVAL_DEFAULT 1000      /* ms */
 #define BITRATE_CALC_THRESHOLD 100000   /* bps */
+#define BITRATE_CALC_INITIAL_SAMPLES 64
+
+enum
+{
+  PROP_0,
+  PROP_WINDOW,
+  N_PROPERTIES
+};
+
+typedef struct _KmsBitrateSample
+{
+  GstClockTime pts;
+  gsize size;
+} KmsBitrateSample;
 
 typedef struct _KmsBitrateCalcData
 {
-  GQueue /*GstClockTime */  * pts_queue;
-  GQueue /*gsize */  * sizes_queue;
+  /* Ring buffer of the samples inside the window, oldest at head */
+  KmsBitrateSample *samples;
+  guint capacity;
+  guint head;
+  guint length;
+
+  GstClockTime window;
   guint64 total_size;
   gint bitrate, last_bitrate;   /* bps */
 } KmsBitrateCalcData;
@@ -69,46 +87,68 @@ kms_bitrate_calc_data_clear (KmsBitrateCalcData * data)
     return;
   }
 
-  g_queue_free_full (data->pts_queue,
-      (GDestroyNotify) kms_utils_destroy_guint64);
-  g_queue_free (data->sizes_queue);
+  g_free (data->samples);
+  data->samples = NULL;
+  data->capacity = 0;
+  data->head = 0;
+  data->length = 0;
+  data->total_size = 0;
 }
 
 static void
 kms_bitrate_calc_data_init (KmsBitrateCalcData * data)
 {
-  data->pts_queue = g_queue_new ();
-  data->sizes_queue = g_queue_new ();
+  data->capacity = BITRATE_CALC_INITIAL_SAMPLES;
+  data->samples = g_new (KmsBitrateSample, data->capacity);
+  data->window = BITRATE_CALC_INTERVAL_DEFAULT * GST_MSECOND;
 }
 
+/* Only needed while the stream rate keeps increasing */
 static void
-kms_bitrate_calc_data_update (KmsBitrateCalcData * data, GstBuffer * buffer)
+kms_bitrate_calc_data_grow (KmsBitrateCalcData * data)
 {
-  gsize size;
-  guint64 *current_pts, *last_pts, diff;
+  KmsBitrateSample *samples;
+  guint i;
+
+  samples = g_new (KmsBitrateSample, data->capacity * 2);
 
-  current_pts = g_slice_new0 (guint64);
-  *current_pts = buffer->pts;
-  g_queue_push_head (data->pts_queue, current_pts);
+  for (i = 0; i < data->length; i++) {
+    samples[i] = data->samples[(data->head + i) % data->capacity];
+  }
 
-  size = gst_buffer_get_size (buffer);
-  g_queue_push_head (data->sizes_queue, GSIZE_TO_POINTER (size));
-  data->total_size += size;
+  g_free (data->samples);
+  data->samples = samples;
+  data->capacity *= 2;
+  data->head = 0;
+}
 
-  /* Remove old buffers */
-  last_pts = (guint64 *) g_queue_peek_tail (data->pts_queue);
-  diff = *current_pts - *last_pts;
-  while (diff > BITRATE_CALC_INTERVAL) {
-    gpointer p;
+static void
+kms_bitrate_calc_data_update (KmsBitrateCalcData * data, GstBuffer * buffer,
+    GstClockTime window)
+{
+  KmsBitrateSample *current, *last;
+  guint64 diff;
 
-    p = g_queue_pop_tail (data->pts_queue);
-    kms_utils_destroy_guint64 (p);
+  if (data->length == data->capacity) {
+    kms_bitrate_calc_data_grow (data);
+  }
 
-    p = g_queue_pop_tail (data->sizes_queue);
-    data->total_size -= GPOINTER_TO_SIZE (p);
+  current = &data->samples[(data->head + data->length) % data->capacity];
+  current->pts = buffer->pts;
+  current->size = gst_buffer_get_size (buffer);
+  data->length++;
+  data->total_size += current->size;
 
-    last_pts = (guint64 *) g_queue_peek_tail (data->pts_queue);
-    diff = *current_pts - *last_pts;
+  /* Remove old buffers */
+  last = &data->samples[data->head];
+  diff = current->pts - last->pts;
+  while (diff > window) {
+    data->total_size -= last->size;
+    data->head = (data->head + 1) % data->capacity;
+    data->length--;
+
+    last = &data->samples[data->head];
+    diff = current->pts - last->pts;
   }
 
   if (diff == 0) {
@@ -160,10 +200,15 @@ kms_bitrate_filter_prepare_buf (GstBaseTransform * trans, GstBuffer * input,
 {
   KmsBitrateFilter *self = KMS_BITRATE_FILTER (trans);
   KmsBitrateCalcData *data = &self->priv->bitrate_calc_data;
+  GstClockTime window;
+
+  GST_OBJECT_LOCK (self);
+  window = data->window;
+  GST_OBJECT_UNLOCK (self);
 
   /* always return the input as output buffer */
   *buf = input;
-  kms_bitrate_calc_data_update (data, input);
+  kms_bitrate_calc_data_update (data, input, window);
   kms_bitrate_filter_update_src_caps (self);
 
   GST_TRACE_OBJECT (self, "bitrate: %" G_GINT32_FORMAT " bps", data->bitrate);
@@ -182,6 +227,48 @@ kms_bitrate_filter_dispose (GObject * object)
   G_OBJECT_CLASS (kms_bitrate_filter_parent_class)->dispose (object);
 }
 
+static void
+kms_bitrate_filter_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsBitrateFilter *self = KMS_BITRATE_FILTER (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_WINDOW:
+      self->priv->bitrate_calc_data.window =
+          g_value_get_uint (value) * GST_MSECOND;
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_bitrate_filter_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsBitrateFilter *self = KMS_BITRATE_FILTER (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_WINDOW:
+      g_value_set_uint (value,
+          self->priv->bitrate_calc_data.window / GST_MSECOND);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
 static GstCaps *
 kms_bitrate_filter_transform_caps (GstBaseTransform * base,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter)
@@ -226,6 +313,14 @@ kms_bitrate_filter_class_init (KmsBitrateFilterClass * klass)
   GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS (klass);
 
   gobject_class->dispose = kms_bitrate_filter_dispose;
+  gobject_class->set_property = kms_bitrate_filter_set_property;
+  gobject_class->get_property = kms_bitrate_filter_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_WINDOW,
+      g_param_spec_uint ("window", "Window",
+          "Time window used to compute the bitrate (ms)",
+          1, G_MAXUINT, BITRATE_CALC_INTERVAL_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_details_simple (gstelement_class,
       "BitrateFilter",
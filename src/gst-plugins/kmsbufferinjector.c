@@ -18,9 +18,11 @@
 #endif
 
 #include "kmsbufferinjector.h"
+#include <commons/kmsloop.h>
 
 #define PLUGIN_NAME "bufferinjector"
 #define DEFAULT_WAITING_TIME (G_TIME_SPAN_MILLISECOND / (gfloat)15)
+#define INJECT_POOL_MIN_THREADS 2
 
 #define KMS_BUFFER_INJECTOR_CAPS "video/x-raw; audio/x-raw"
 
@@ -53,10 +55,6 @@ G_DEFINE_TYPE_WITH_CODE (KmsBufferInjector, kms_buffer_injector,
   )                                          \
 )
 
-#define KMS_BUFFER_INJECTOR_GET_COND(obj) (       \
-  &KMS_BUFFER_INJECTOR (obj)->priv->thread_cond   \
-)
-
 #define KMS_BUFFER_INJECTOR_LOCK(obj) (                           \
   g_rec_mutex_lock (&KMS_BUFFER_INJECTOR (obj)->priv->thread_mutex)   \
 )
@@ -77,22 +75,27 @@ struct _KmsBufferInjectorPrivate
   GstPad *sinkpad;
   GstPad *srcpad;
   gboolean configured;
-  gboolean still_waiting;
   MediaType type;
   GstBuffer *previous_buffer;
-  GMutex mutex_generate;
-  GCond cond_generate;
+  /* Attached to the shared timer loop while the src pad is active */
+  GSource *timer;
+  gboolean injecting;
+  /* monotonic time of the last pushed buffer, real or injected */
+  gint64 last_time;
   /* milliseconds */
   gint64 wait_time;
   /* nanoseconds */
   gint64 acumulated_time;
   gint64 factor_wait_time;
+  /* stats */
+  guint64 injected_buffers;
 };
 
 enum
 {
   PROP_0,
   PROP_FACTOR_WAIT_TIME,
+  PROP_STATS,
   N_PROPERTIES
 };
 
@@ -117,69 +120,182 @@ kms_buffer_injector_check_segment_event (KmsBufferInjector * self)
   gst_segment_free (segment);
 }
 
+/* Timers of every injector in the process share one thread. Injected buffers
+ * are pushed from a pool so that a blocking downstream element does not
+ * delay other injectors. The pool is bounded, each injector has at most one
+ * push queued, and extra ones wait for a free thread. */
+static KmsLoop *timer_loop;
+static GMainContext *timer_context;
+static GThreadPool *inject_pool;
+
+/* Must be called with the injector lock held */
+static gint64
+kms_buffer_injector_get_deadline (KmsBufferInjector * self)
+{
+  gint64 offset_time;           /* milliseconds */
+
+  offset_time = (self->priv->factor_wait_time * self->priv->wait_time);
+
+  return self->priv->last_time + offset_time * G_TIME_SPAN_MILLISECOND;
+}
+
 static void
-kms_buffer_injector_generate_buffers (KmsBufferInjector * self)
+kms_buffer_injector_inject (KmsBufferInjector * self, gpointer unused)
 {
-  gint64 end_time;              /* microseconds */
   gint64 offset_time;           /* milliseconds */
+  GstBuffer *copy;
 
   KMS_BUFFER_INJECTOR_LOCK (self);
-  if ((!self->priv->configured) || (self->priv->previous_buffer == NULL)) {
-    GST_WARNING_OBJECT (self,
-        "Buffer injector is not correctly configured, there is no buffer to send");
+
+  if (self->priv->timer == NULL || self->priv->previous_buffer == NULL) {
+    self->priv->injecting = FALSE;
     KMS_BUFFER_INJECTOR_UNLOCK (self);
-    g_usleep (10000);
-    return;
+    goto end;
   }
 
   offset_time = (self->priv->factor_wait_time * self->priv->wait_time);
-  end_time = g_get_monotonic_time () + (offset_time) * G_TIME_SPAN_MILLISECOND;
-
   self->priv->acumulated_time =
       self->priv->acumulated_time + (offset_time * G_TIME_SPAN_SECOND);
 
+  //timeout reached, it is necessary to inject a new buffer
+  GST_DEBUG_OBJECT (self->priv->srcpad, "Injecting buffer");
+
+  copy = gst_buffer_copy (self->priv->previous_buffer);
+  self->priv->injected_buffers++;
+
+  if (GST_BUFFER_DTS_IS_VALID (copy)) {
+    GST_BUFFER_DTS (copy) = GST_BUFFER_DTS (copy) + self->priv->acumulated_time;
+  }
+  if (GST_BUFFER_PTS_IS_VALID (copy)) {
+    GST_BUFFER_PTS (copy) = GST_BUFFER_PTS (copy) + self->priv->acumulated_time;
+  }
+
+  GST_BUFFER_FLAG_SET (copy, GST_BUFFER_FLAG_GAP);
+  GST_BUFFER_FLAG_SET (copy, GST_BUFFER_FLAG_DROPPABLE);
   KMS_BUFFER_INJECTOR_UNLOCK (self);
 
-  g_mutex_lock (&self->priv->mutex_generate);
+  /* We need to check if segment event is present,
+   * we could have receive a flush */
+  kms_buffer_injector_check_segment_event (self);
+  gst_pad_push (self->priv->srcpad, copy);
 
-  if (!self->priv->still_waiting) {
-    g_mutex_unlock (&self->priv->mutex_generate);
-    return;
+  KMS_BUFFER_INJECTOR_LOCK (self);
+  self->priv->injecting = FALSE;
+  self->priv->last_time = g_get_monotonic_time ();
+
+  if (self->priv->timer != NULL) {
+    g_source_set_ready_time (self->priv->timer,
+        kms_buffer_injector_get_deadline (self));
   }
 
-  if (!g_cond_wait_until (&self->priv->cond_generate,
-          &self->priv->mutex_generate, end_time)) {
-    GstBuffer *copy;
+  KMS_BUFFER_INJECTOR_UNLOCK (self);
 
-    //timeout reached, it is necessary to inject a new buffer
-    GST_DEBUG_OBJECT (self->priv->srcpad, "Injecting buffer");
-    KMS_BUFFER_INJECTOR_LOCK (self);
-    if (!self->priv->previous_buffer) {
-      KMS_BUFFER_INJECTOR_UNLOCK (self);
-      g_mutex_unlock (&self->priv->mutex_generate);
-      return;
-    }
-    copy = gst_buffer_copy (self->priv->previous_buffer);
+end:
+  gst_object_unref (self);
+}
 
-    if (GST_BUFFER_DTS_IS_VALID (copy)) {
-      GST_BUFFER_DTS (copy) =
-          GST_BUFFER_DTS (copy) + self->priv->acumulated_time;
-    }
-    if (GST_BUFFER_PTS_IS_VALID (copy)) {
-      GST_BUFFER_PTS (copy) =
-          GST_BUFFER_PTS (copy) + self->priv->acumulated_time;
-    }
+static gpointer
+kms_buffer_injector_create_timers (gpointer data)
+{
+  timer_loop = kms_loop_new ();
+  g_object_get (timer_loop, "context", &timer_context, NULL);
 
-    GST_BUFFER_FLAG_SET (copy, GST_BUFFER_FLAG_GAP);
-    GST_BUFFER_FLAG_SET (copy, GST_BUFFER_FLAG_DROPPABLE);
-    KMS_BUFFER_INJECTOR_UNLOCK (self);
+  inject_pool = g_thread_pool_new ((GFunc) kms_buffer_injector_inject, NULL,
+      MAX (g_get_num_processors (), INJECT_POOL_MIN_THREADS), FALSE, NULL);
+
+  return NULL;
+}
+
+static void
+kms_buffer_injector_init_timers (void)
+{
+  static GOnce timers_once = G_ONCE_INIT;
+
+  g_once (&timers_once, kms_buffer_injector_create_timers, NULL);
+}
+
+static gboolean
+kms_buffer_injector_timeout (KmsBufferInjector * self)
+{
+  gint64 deadline;
+
+  KMS_BUFFER_INJECTOR_LOCK (self);
+
+  if (self->priv->timer == NULL) {
+    goto end;
+  }
+
+  /* Not armed again until a buffer is received or injected */
+  g_source_set_ready_time (self->priv->timer, -1);
+
+  if ((!self->priv->configured) || (self->priv->previous_buffer == NULL)) {
+    GST_WARNING_OBJECT (self,
+        "Buffer injector is not correctly configured, there is no buffer to send");
+    goto end;
+  }
+
+  deadline = kms_buffer_injector_get_deadline (self);
+
+  if (g_get_monotonic_time () < deadline) {
+    /* Buffers were received since the timer was armed */
+    g_source_set_ready_time (self->priv->timer, deadline);
+    goto end;
+  }
+
+  if (!self->priv->injecting) {
+    self->priv->injecting = TRUE;
+    g_thread_pool_push (inject_pool, gst_object_ref (self), NULL);
+  }
+
+end:
+  KMS_BUFFER_INJECTOR_UNLOCK (self);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+kms_buffer_injector_timer_dispatch (GSource * source, GSourceFunc callback,
+    gpointer user_data)
+{
+  return callback (user_data);
+}
+
+static GSourceFuncs timer_funcs = {
+  NULL, NULL, kms_buffer_injector_timer_dispatch, NULL
+};
+
+static void
+kms_buffer_injector_start_timer (KmsBufferInjector * self)
+{
+  kms_buffer_injector_init_timers ();
+
+  KMS_BUFFER_INJECTOR_LOCK (self);
+
+  if (self->priv->timer == NULL) {
+    self->priv->timer = g_source_new (&timer_funcs, sizeof (GSource));
+    g_source_set_callback (self->priv->timer,
+        (GSourceFunc) kms_buffer_injector_timeout, gst_object_ref (self),
+        gst_object_unref);
+    g_source_attach (self->priv->timer, timer_context);
+  }
+
+  KMS_BUFFER_INJECTOR_UNLOCK (self);
+}
+
+static void
+kms_buffer_injector_stop_timer (KmsBufferInjector * self)
+{
+  GSource *timer;
+
+  KMS_BUFFER_INJECTOR_LOCK (self);
+  timer = self->priv->timer;
+  self->priv->timer = NULL;
+  KMS_BUFFER_INJECTOR_UNLOCK (self);
 
-    /* We need to check if segment event is present,
-     * we could have receive a flush */
-    kms_buffer_injector_check_segment_event (self);
-    gst_pad_push (self->priv->srcpad, copy);
+  if (timer != NULL) {
+    g_source_destroy (timer);
+    g_source_unref (timer);
   }
-  g_mutex_unlock (&self->priv->mutex_generate);
 }
 
 static gboolean
@@ -253,13 +369,16 @@ kms_buffer_injector_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
   gst_buffer_replace (&buffer_injector->priv->previous_buffer, buffer);
   buffer_injector->priv->acumulated_time = 0;
+  buffer_injector->priv->last_time = g_get_monotonic_time ();
 
-  KMS_BUFFER_INJECTOR_UNLOCK (buffer_injector);
+  /* While buffers keep arriving the timer just moves its own deadline */
+  if (buffer_injector->priv->timer != NULL && !buffer_injector->priv->injecting
+      && g_source_get_ready_time (buffer_injector->priv->timer) == -1) {
+    g_source_set_ready_time (buffer_injector->priv->timer,
+        kms_buffer_injector_get_deadline (buffer_injector));
+  }
 
-  //wake up pad task
-  g_mutex_lock (&buffer_injector->priv->mutex_generate);
-  g_cond_signal (&buffer_injector->priv->cond_generate);
-  g_mutex_unlock (&buffer_injector->priv->mutex_generate);
+  KMS_BUFFER_INJECTOR_UNLOCK (buffer_injector);
 
   return gst_pad_push (buffer_injector->priv->srcpad, buffer);
 }
@@ -293,12 +412,11 @@ kms_buffer_injector_activate_mode (GstPad * pad, GstObject * parent,
   switch (mode) {
     case GST_PAD_MODE_PUSH:
       if (active) {
-        res = gst_pad_start_task (pad,
-            (GstTaskFunction) kms_buffer_injector_generate_buffers,
-            buffer_injector, NULL);
+        kms_buffer_injector_start_timer (buffer_injector);
       } else {
-        res = gst_pad_stop_task (pad);
+        kms_buffer_injector_stop_timer (buffer_injector);
       }
+      res = TRUE;
       break;
     case GST_PAD_MODE_PULL:
       res = TRUE;
@@ -332,49 +450,20 @@ kms_buffer_injector_init (KmsBufferInjector * self)
       kms_buffer_injector_activate_mode);
 
   g_rec_mutex_init (&self->priv->thread_mutex);
-  g_mutex_init (&self->priv->mutex_generate);
-  g_cond_init (&self->priv->cond_generate);
 
   self->priv->wait_time = DEFAULT_WAITING_TIME;
   self->priv->configured = FALSE;
-  self->priv->still_waiting = TRUE;
   self->priv->acumulated_time = 0;
 
   self->priv->factor_wait_time = 2;
 }
 
-static GstStateChangeReturn
-kms_buffer_injector_change_state (GstElement * element,
-    GstStateChange transition)
-{
-  KmsBufferInjector *buffer_injector = KMS_BUFFER_INJECTOR (element);
-  GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
-
-  switch (transition) {
-    case GST_STATE_CHANGE_PAUSED_TO_READY:
-      g_mutex_lock (&buffer_injector->priv->mutex_generate);
-      buffer_injector->priv->still_waiting = FALSE;
-      g_cond_signal (&buffer_injector->priv->cond_generate);
-      g_mutex_unlock (&buffer_injector->priv->mutex_generate);
-      gst_pad_pause_task (buffer_injector->priv->srcpad);
-      break;
-    default:
-      break;
-  }
-
-  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
-
-  return ret;
-}
-
 static void
 kms_buffer_injector_finalize (GObject * object)
 {
   KmsBufferInjector *buffer_injector = KMS_BUFFER_INJECTOR (object);
 
   g_rec_mutex_clear (&buffer_injector->priv->thread_mutex);
-  g_mutex_clear (&buffer_injector->priv->mutex_generate);
-  g_cond_clear (&buffer_injector->priv->cond_generate);
 
   if (buffer_injector->priv->previous_buffer != NULL) {
     gst_buffer_unref (buffer_injector->priv->previous_buffer);
@@ -413,6 +502,13 @@ kms_buffer_injector_get_property (GObject * object, guint property_id,
       g_value_set_int (value, bufferinjector->priv->factor_wait_time);
       KMS_BUFFER_INJECTOR_UNLOCK (bufferinjector);
       break;
+    case PROP_STATS:
+      KMS_BUFFER_INJECTOR_LOCK (bufferinjector);
+      g_value_take_boxed (value, gst_structure_new ("stats",
+              "injected-buffers", G_TYPE_UINT64,
+              bufferinjector->priv->injected_buffers, NULL));
+      KMS_BUFFER_INJECTOR_UNLOCK (bufferinjector);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -430,7 +526,6 @@ kms_buffer_injector_class_init (KmsBufferInjectorClass * klass)
 
   gstelement_class = GST_ELEMENT_CLASS (klass);
 
-  gstelement_class->change_state = kms_buffer_injector_change_state;
   gobject_class->set_property = kms_buffer_injector_set_property;
   gobject_class->get_property = kms_buffer_injector_get_property;
 
@@ -456,6 +551,12 @@ kms_buffer_injector_class_init (KmsBufferInjectorClass * klass)
           "This property allows change the wait time. The wait time will be"
           "multiply by this factor", 2, G_MAXINT, 2, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Number of injected buffers, reported in the stats of the "
+          "KmsElement containing the injector",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   g_type_class_add_private (klass, sizeof (KmsBufferInjectorPrivate));
 }
 
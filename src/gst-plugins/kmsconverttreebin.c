@@ -0,0 +1,87 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "kmsconverttreebin.h"
+#include "kmsutils.h"
+
+#define GST_DEFAULT_NAME "converttreebin"
+#define GST_CAT_DEFAULT kms_convert_tree_bin_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define kms_convert_tree_bin_parent_class parent_class
+G_DEFINE_TYPE (KmsConvertTreeBin, kms_convert_tree_bin, KMS_TYPE_TREE_BIN);
+
+static void
+kms_convert_tree_bin_configure (KmsConvertTreeBin * self,
+    const GstCaps * raw_caps)
+{
+  KmsTreeBin *tree_bin = KMS_TREE_BIN (self);
+  GstElement *rate, *convert, *mediator, *capsfilter, *output_tee;
+
+  rate = kms_utils_create_rate_for_caps (raw_caps);
+  convert = kms_utils_create_convert_for_caps (raw_caps);
+  mediator = kms_utils_create_mediator_element (raw_caps);
+  capsfilter = gst_element_factory_make ("capsfilter", NULL);
+
+  g_object_set (capsfilter, "caps", raw_caps, NULL);
+
+  gst_bin_add_many (GST_BIN (self), rate, convert, mediator, capsfilter, NULL);
+  gst_element_sync_state_with_parent (capsfilter);
+  gst_element_sync_state_with_parent (mediator);
+  gst_element_sync_state_with_parent (convert);
+  gst_element_sync_state_with_parent (rate);
+
+  kms_tree_bin_set_input_element (tree_bin, rate);
+  output_tee = kms_tree_bin_get_output_tee (tree_bin);
+  gst_element_link_many (rate, convert, mediator, capsfilter, output_tee, NULL);
+}
+
+KmsConvertTreeBin *
+kms_convert_tree_bin_new (const GstCaps * raw_caps)
+{
+  GObject *convert;
+
+  convert = g_object_new (KMS_TYPE_CONVERT_TREE_BIN, NULL);
+  kms_convert_tree_bin_configure (KMS_CONVERT_TREE_BIN (convert), raw_caps);
+
+  GST_DEBUG_OBJECT (convert, "Converting to %" GST_PTR_FORMAT, raw_caps);
+
+  return KMS_CONVERT_TREE_BIN (convert);
+}
+
+static void
+kms_convert_tree_bin_init (KmsConvertTreeBin * self)
+{
+  /* Nothing to do */
+}
+
+static void
+kms_convert_tree_bin_class_init (KmsConvertTreeBinClass * klass)
+{
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_set_details_simple (gstelement_class,
+      "ConvertTreeBin",
+      "Generic",
+      "Bin to convert and distribute RAW media to several encoders.",
+      "Kurento <kurento@googlegroups.com>");
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,53 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_CONVERT_TREE_BIN_H__
+#define __KMS_CONVERT_TREE_BIN_H__
+
+#include "kmstreebin.h"
+
+G_BEGIN_DECLS
+/* #defines don't like whitespacey bits */
+#define KMS_TYPE_CONVERT_TREE_BIN \
+  (kms_convert_tree_bin_get_type())
+#define KMS_CONVERT_TREE_BIN(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_CONVERT_TREE_BIN,KmsConvertTreeBin))
+#define KMS_CONVERT_TREE_BIN_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_CONVERT_TREE_BIN,KmsConvertTreeBinClass))
+#define KMS_IS_CONVERT_TREE_BIN(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_CONVERT_TREE_BIN))
+#define KMS_IS_CONVERT_TREE_BIN_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_CONVERT_TREE_BIN))
+#define KMS_CONVERT_TREE_BIN_CAST(obj) ((KmsConvertTreeBin*)(obj))
+
+typedef struct _KmsConvertTreeBin KmsConvertTreeBin;
+typedef struct _KmsConvertTreeBinClass KmsConvertTreeBinClass;
+
+struct _KmsConvertTreeBin
+{
+  KmsTreeBin parent;
+};
+
+struct _KmsConvertTreeBinClass
+{
+  KmsTreeBinClass parent_class;
+};
+
+GType kms_convert_tree_bin_get_type (void);
+
+KmsConvertTreeBin * kms_convert_tree_bin_new (const GstCaps * raw_caps);
+
+G_END_DECLS
+#endif /* __KMS_CONVERT_TREE_BIN_H__ */
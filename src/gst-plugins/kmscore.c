@@ -23,6 +23,8 @@
 #include <kmsaudiomixerbin.h>
 #include <kmsbitratefilter.h>
 #include <kmsbufferinjector.h>
+#include <kmsudpbatchsrc.h>
+#include <kmsudpbatchsink.h>
 #include <kmspassthrough.h>
 #include <kmsdummysrc.h>
 #include <kmsdummysink.h>
@@ -56,6 +58,12 @@ kurento_init (GstPlugin * kurento)
   if (!kms_buffer_injector_plugin_init (kurento))
     return FALSE;
 
+  if (!kms_udp_batch_src_plugin_init (kurento))
+    return FALSE;
+
+  if (!kms_udp_batch_sink_plugin_init (kurento))
+    return FALSE;
+
   if (!kms_pass_through_plugin_init (kurento))
     return FALSE;
 
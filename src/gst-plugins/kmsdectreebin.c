@@ -19,6 +19,7 @@
 
 #include "kmsdectreebin.h"
 #include "kmsutils.h"
+#include "kmsfactorycache.h"
 
 #define GST_DEFAULT_NAME "dectreebin"
 #define GST_CAT_DEFAULT kms_dec_tree_bin_debug
@@ -33,24 +34,13 @@ create_decoder_for_caps (const GstCaps * caps, const GstCaps * raw_caps)
   GList *decoder_list, *filtered_list, *aux_list, *l;
   GstElementFactory *decoder_factory = NULL;
   GstElement *decoder = NULL;
-  gboolean contains_openh264 = FALSE;
+  gboolean contains_openh264;
 
-  decoder_list =
-      gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_DECODER,
-      GST_RANK_NONE);
-
-  /* HACK: Augment the openh264 rank */
-  for (l = decoder_list; l != NULL; l = l->next) {
-    decoder_factory = GST_ELEMENT_FACTORY (l->data);
-
-    if (g_str_has_prefix (GST_OBJECT_NAME (decoder_factory), "openh264")) {
-      decoder_list = g_list_remove (decoder_list, l->data);
-      decoder_list = g_list_prepend (decoder_list, decoder_factory);
-      contains_openh264 = TRUE;
-      break;
-    }
-  }
-  decoder_factory = NULL;
+  /* The cache moves openh264 to the head of the list */
+  decoder_list = kms_factory_cache_get_elements
+      (GST_ELEMENT_FACTORY_TYPE_DECODER);
+  contains_openh264 = decoder_list != NULL &&
+      g_str_has_prefix (GST_OBJECT_NAME (decoder_list->data), "openh264");
 
   /* Remove stream-format from raw_caps to allow select openh264dec */
   if (contains_openh264 &&
@@ -63,13 +53,13 @@ create_decoder_for_caps (const GstCaps * caps, const GstCaps * raw_caps)
     gst_structure_remove_field (structure, "stream-format");
     caps_copy = gst_caps_new_full (structure, NULL);
     aux_list =
-        gst_element_factory_list_filter (decoder_list, caps_copy, GST_PAD_SINK,
-        FALSE);
+        kms_factory_cache_filter (GST_ELEMENT_FACTORY_TYPE_DECODER, caps_copy,
+        GST_PAD_SINK);
     gst_caps_unref (caps_copy);
   } else {
     aux_list =
-        gst_element_factory_list_filter (decoder_list, caps, GST_PAD_SINK,
-        FALSE);
+        kms_factory_cache_filter (GST_ELEMENT_FACTORY_TYPE_DECODER, caps,
+        GST_PAD_SINK);
   }
 
   filtered_list =
@@ -19,6 +19,7 @@
 
 #include "kmsenctreebin.h"
 #include "kmsutils.h"
+#include "kmsfactorycache.h"
 
 #define GST_DEFAULT_NAME "enctreebin"
 #define GST_CAT_DEFAULT kms_enc_tree_bin_debug
@@ -49,6 +50,8 @@ struct _KmsEncTreeBinPrivate
   GstElement *enc;
   EncoderType enc_type;
   RembEventManager *remb_manager;
+  KmsBitrateController *controller;
+  gulong tick_probe_id;
 
   gint remb_bitrate;
 };
@@ -108,27 +111,12 @@ static void
 kms_enc_tree_bin_create_encoder_for_caps (KmsEncTreeBin * self,
     const GstCaps * caps, gint target_bitrate)
 {
-  GList *encoder_list, *filtered_list, *l;
+  GList *filtered_list, *l;
   GstElementFactory *encoder_factory = NULL;
 
-  encoder_list =
-      gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_ENCODER,
-      GST_RANK_NONE);
-
-  /* HACK: Augment the openh264 rank */
-  for (l = encoder_list; l != NULL; l = l->next) {
-    encoder_factory = GST_ELEMENT_FACTORY (l->data);
-
-    if (g_str_has_prefix (GST_OBJECT_NAME (encoder_factory), "openh264")) {
-      encoder_list = g_list_remove (encoder_list, l->data);
-      encoder_list = g_list_prepend (encoder_list, encoder_factory);
-      break;
-    }
-  }
-
-  encoder_factory = NULL;
   filtered_list =
-      gst_element_factory_list_filter (encoder_list, caps, GST_PAD_SRC, FALSE);
+      kms_factory_cache_filter (GST_ELEMENT_FACTORY_TYPE_ENCODER, caps,
+      GST_PAD_SRC);
 
   for (l = filtered_list; l != NULL && encoder_factory == NULL; l = l->next) {
     encoder_factory = GST_ELEMENT_FACTORY (l->data);
@@ -143,7 +131,6 @@ kms_enc_tree_bin_create_encoder_for_caps (KmsEncTreeBin * self,
   }
 
   gst_plugin_feature_list_free (filtered_list);
-  gst_plugin_feature_list_free (encoder_list);
 }
 
 static gint
@@ -206,6 +193,18 @@ kms_enc_tree_bin_set_target_bitrate (KmsEncTreeBin * self)
   }
 }
 
+static void
+controller_callback (KmsBitrateController * controller, guint bitrate,
+    gpointer user_data)
+{
+  KmsEncTreeBin *self = user_data;
+
+  /* The controller serializes its callbacks, the last one carries the */
+  /* latest applied bitrate whichever thread (REMB or streaming) runs it */
+  self->priv->remb_bitrate = bitrate;
+  kms_enc_tree_bin_set_target_bitrate (self);
+}
+
 static void
 bitrate_callback (RembEventManager * remb_manager, guint bitrate,
     gpointer user_data)
@@ -214,11 +213,23 @@ bitrate_callback (RembEventManager * remb_manager, guint bitrate,
 
   // TODO: Get min of remb and tag
   if (bitrate != 0) {
-    self->priv->remb_bitrate = bitrate;
-    kms_enc_tree_bin_set_target_bitrate (self);
+    kms_bitrate_controller_set_target (self->priv->controller, bitrate,
+        kms_utils_get_time_nsecs ());
   }
 }
 
+/* Lets ramps and rate limited targets progress without waiting for REMB */
+static GstPadProbeReturn
+tick_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KmsEncTreeBin *self = data;
+
+  kms_bitrate_controller_tick (self->priv->controller,
+      kms_utils_get_time_nsecs ());
+
+  return GST_PAD_PROBE_OK;
+}
+
 /*
  * FIXME: This is a hack to make x264 work.
  *
@@ -275,12 +286,52 @@ check_caps_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
   return GST_PAD_PROBE_OK;
 }
 
+KmsBitrateController *
+kms_enc_tree_bin_get_bitrate_controller (KmsEncTreeBin * self)
+{
+  return self->priv->controller;
+}
+
+GstCaps *
+kms_enc_tree_bin_get_raw_caps (KmsEncTreeBin * self)
+{
+  GstCaps *templ_caps, *preferred, *raw_caps;
+  GstStructure *st;
+  const gchar *format;
+
+  templ_caps = gst_pad_get_pad_template_caps (self->priv->enc_sink);
+  preferred = gst_caps_from_string ("video/x-raw,format=I420");
+
+  /* I420 is taken by all the usual encoders, so they can share conversion */
+  if (gst_caps_can_intersect (templ_caps, preferred)) {
+    gst_caps_unref (templ_caps);
+    return preferred;
+  }
+
+  gst_caps_unref (preferred);
+  raw_caps = gst_caps_from_string ("video/x-raw");
+
+  if (!gst_caps_is_any (templ_caps) && !gst_caps_is_empty (templ_caps)) {
+    st = gst_caps_get_structure (templ_caps, 0);
+    format = gst_structure_get_string (st, "format");
+
+    if (format != NULL) {
+      gst_caps_set_simple (raw_caps, "format", G_TYPE_STRING, format, NULL);
+    }
+  }
+
+  gst_caps_unref (templ_caps);
+
+  return raw_caps;
+}
+
 static gboolean
 kms_enc_tree_bin_configure (KmsEncTreeBin * self, const GstCaps * caps,
-    gint target_bitrate)
+    gint target_bitrate, gboolean convert_input)
 {
   KmsTreeBin *tree_bin = KMS_TREE_BIN (self);
-  GstElement *rate, *convert, *mediator, *output_tee, *capsfilter = NULL;
+  GstElement *rate = NULL, *convert = NULL, *mediator, *output_tee,
+      *capsfilter = NULL, *input;
 
   kms_enc_tree_bin_create_encoder_for_caps (self, caps, target_bitrate);
 
@@ -293,21 +344,36 @@ kms_enc_tree_bin_configure (KmsEncTreeBin * self, const GstCaps * caps,
   GST_DEBUG_OBJECT (self, "Encoder found: %" GST_PTR_FORMAT, self->priv->enc);
 
   self->priv->enc_sink = gst_element_get_static_pad (self->priv->enc, "sink");
+  self->priv->controller = kms_bitrate_controller_new (MAX (target_bitrate, 0));
+  kms_bitrate_controller_set_callback (self->priv->controller,
+      controller_callback, self, NULL);
+  self->priv->tick_probe_id = gst_pad_add_probe (self->priv->enc_sink,
+      GST_PAD_PROBE_TYPE_BUFFER, tick_probe, self, NULL);
   self->priv->remb_manager =
       kms_utils_remb_event_manager_create (self->priv->enc_sink);
   kms_utils_remb_event_manager_set_callback (self->priv->remb_manager,
       bitrate_callback, self, NULL);
 
-  rate = kms_utils_create_rate_for_caps (caps);
-  convert = kms_utils_create_convert_for_caps (caps);
-  mediator = kms_utils_create_mediator_element (caps);
+  /* Without input conversion raw media comes already converted from a */
+  /* shared stage, only x264 keeps its own scaler for the odd size hack */
+  if (convert_input) {
+    rate = kms_utils_create_rate_for_caps (caps);
+    convert = kms_utils_create_convert_for_caps (caps);
+    gst_bin_add_many (GST_BIN (self), rate, convert, NULL);
+    gst_element_sync_state_with_parent (convert);
+    gst_element_sync_state_with_parent (rate);
+  }
+
+  if (convert_input || self->priv->enc_type == X264) {
+    mediator = kms_utils_create_mediator_element (caps);
+    gst_bin_add (GST_BIN (self), mediator);
+    gst_element_sync_state_with_parent (mediator);
+  } else {
+    mediator = NULL;
+  }
 
-  gst_bin_add_many (GST_BIN (self), rate, convert, mediator, self->priv->enc,
-      NULL);
+  gst_bin_add (GST_BIN (self), self->priv->enc);
   gst_element_sync_state_with_parent (self->priv->enc);
-  gst_element_sync_state_with_parent (mediator);
-  gst_element_sync_state_with_parent (convert);
-  gst_element_sync_state_with_parent (rate);
   // FIXME: This is a hack to avoid an error on x264enc that does not work
   // properly with some raw formats, this should be fixed in gstreamer
   // but until this is done this hack makes it work
@@ -328,27 +394,35 @@ kms_enc_tree_bin_configure (KmsEncTreeBin * self, const GstCaps * caps,
     gst_element_sync_state_with_parent (capsfilter);
   }
 
-  kms_tree_bin_set_input_element (tree_bin, rate);
-  output_tee = kms_tree_bin_get_output_tee (tree_bin);
-  if (self->priv->enc_type == X264) {
-    gst_element_link_many (rate, convert, mediator, capsfilter, self->priv->enc,
-        output_tee, NULL);
+  if (convert_input) {
+    gst_element_link_many (rate, convert, mediator, NULL);
+    input = rate;
   } else {
-    gst_element_link_many (rate, convert, mediator, self->priv->enc, output_tee,
-        NULL);
+    input = mediator != NULL ? mediator : self->priv->enc;
   }
 
+  if (capsfilter != NULL) {
+    gst_element_link_many (mediator, capsfilter, self->priv->enc, NULL);
+  } else if (mediator != NULL) {
+    gst_element_link (mediator, self->priv->enc);
+  }
+
+  kms_tree_bin_set_input_element (tree_bin, input);
+  output_tee = kms_tree_bin_get_output_tee (tree_bin);
+  gst_element_link (self->priv->enc, output_tee);
+
   return TRUE;
 }
 
 KmsEncTreeBin *
-kms_enc_tree_bin_new (const GstCaps * caps, gint target_bitrate)
+kms_enc_tree_bin_new (const GstCaps * caps, gint target_bitrate,
+    gboolean convert_input)
 {
   GObject *enc;
 
   enc = g_object_new (KMS_TYPE_ENC_TREE_BIN, NULL);
   if (!kms_enc_tree_bin_configure (KMS_ENC_TREE_BIN (enc), caps,
-          target_bitrate)) {
+          target_bitrate, convert_input)) {
     g_object_unref (enc);
     return NULL;
   }
@@ -363,6 +437,8 @@ kms_enc_tree_bin_init (KmsEncTreeBin * self)
 
   self->priv->enc_sink = NULL;
   self->priv->remb_manager = NULL;
+  self->priv->controller = NULL;
+  self->priv->tick_probe_id = 0;
 
   self->priv->remb_bitrate = -1;
 }
@@ -373,13 +449,24 @@ kms_enc_tree_bin_dispose (GObject * object)
   KmsEncTreeBin *self = KMS_ENC_TREE_BIN (object);
 
   GST_DEBUG_OBJECT (object, "dispose");
+  if (self->priv->remb_manager) {
+    kms_utils_remb_event_manager_destroy (self->priv->remb_manager);
+    self->priv->remb_manager = NULL;
+  }
+
   if (self->priv->enc_sink) {
+    if (self->priv->tick_probe_id != 0) {
+      gst_pad_remove_probe (self->priv->enc_sink, self->priv->tick_probe_id);
+      self->priv->tick_probe_id = 0;
+    }
     g_clear_object (&self->priv->enc_sink);
   }
 
-  if (self->priv->remb_manager) {
-    kms_utils_remb_event_manager_destroy (self->priv->remb_manager);
-    self->priv->remb_manager = NULL;
+  if (self->priv->controller) {
+    kms_bitrate_controller_set_callback (self->priv->controller, NULL, NULL,
+        NULL);
+    kms_bitrate_controller_unref (self->priv->controller);
+    self->priv->controller = NULL;
   }
 
   /* chain up */
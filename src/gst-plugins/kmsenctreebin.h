@@ -17,6 +17,7 @@
 #define __KMS_ENC_TREE_BIN_H__
 
 #include "kmstreebin.h"
+#include "kmsbitratecontroller.h"
 
 G_BEGIN_DECLS
 /* #defines don't like whitespacey bits */
@@ -50,7 +51,11 @@ struct _KmsEncTreeBinClass
 
 GType kms_enc_tree_bin_get_type (void);
 
-KmsEncTreeBin * kms_enc_tree_bin_new (const GstCaps * caps, gint target_bitrate);
+KmsEncTreeBin * kms_enc_tree_bin_new (const GstCaps * caps, gint target_bitrate,
+    gboolean convert_input);
+GstCaps * kms_enc_tree_bin_get_raw_caps (KmsEncTreeBin * self);
+KmsBitrateController * kms_enc_tree_bin_get_bitrate_controller (
+    KmsEncTreeBin * self);
 
 G_END_DECLS
 #endif /* __KMS_ENC_TREE_BIN_H__ */
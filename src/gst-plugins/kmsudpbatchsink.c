@@ -0,0 +1,511 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             /* sendmmsg */
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "kmsudpbatchsink.h"
+#include <commons/kmsudpsocket.h>
+
+#define PLUGIN_NAME "udpbatchsink"
+
+#define GST_CAT_DEFAULT kms_udp_batch_sink_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define kms_udp_batch_sink_parent_class parent_class
+G_DEFINE_TYPE (KmsUdpBatchSink, kms_udp_batch_sink, GST_TYPE_BASE_SINK);
+
+#define KMS_UDP_BATCH_SINK_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (               \
+    (obj),                                    \
+    KMS_TYPE_UDP_BATCH_SINK,                  \
+    KmsUdpBatchSinkPrivate                    \
+  )                                           \
+)
+
+#define DEFAULT_HOST NULL
+#define DEFAULT_PORT 0
+#define DEFAULT_SOCKET_FD -1
+#define DEFAULT_BUFFER_SIZE 0
+
+/* Packets sent with a single sendmmsg call */
+#define MAX_BATCH 64
+/* Memories of a buffer sent without merging, RTP usually uses 2 or 3 */
+#define MAX_IOV 4
+
+enum
+{
+  PROP_0,
+  PROP_HOST,
+  PROP_PORT,
+  PROP_SOCKET_FD,
+  PROP_BUFFER_SIZE,
+  PROP_PACKETS_SENT,
+  PROP_BATCHES_SENT
+};
+
+typedef struct _KmsUdpBatchSinkPacket
+{
+  GstBuffer *buffer;
+  gboolean merged;
+  guint n_maps;
+  GstMapInfo maps[MAX_IOV];
+  struct iovec iovs[MAX_IOV];
+} KmsUdpBatchSinkPacket;
+
+struct _KmsUdpBatchSinkPrivate
+{
+  /* Properties */
+  gchar *host;
+  gint port;
+  gint socket_fd;
+  gint buffer_size;
+  gboolean dest_changed;
+
+  /* Streaming state, only used from the streaming thread and start/stop */
+  gint fd;
+  struct sockaddr_storage dest;
+  socklen_t dest_len;
+  KmsUdpBatchSinkPacket packets[MAX_BATCH];
+  struct mmsghdr msgs[MAX_BATCH];
+
+  /* Stats, protected by the object lock */
+  guint64 packets_sent;
+  guint64 batches_sent;
+};
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static gboolean
+kms_udp_batch_sink_update_dest (KmsUdpBatchSink * self)
+{
+  KmsUdpBatchSinkPrivate *priv = self->priv;
+  gboolean changed;
+  gchar *host;
+  guint16 port;
+
+  GST_OBJECT_LOCK (self);
+  changed = priv->dest_changed;
+  priv->dest_changed = FALSE;
+  host = g_strdup (priv->host);
+  port = priv->port;
+  GST_OBJECT_UNLOCK (self);
+
+  if (changed) {
+    priv->dest_len = 0;
+
+    if (host != NULL && !kms_udp_socket_resolve (host, port, FALSE,
+            &priv->dest, &priv->dest_len)) {
+      GST_ELEMENT_WARNING (self, RESOURCE, NOT_FOUND, (NULL),
+          ("Cannot resolve %s", host));
+      priv->dest_len = 0;
+    }
+  }
+
+  g_free (host);
+
+  if (priv->dest_len == 0) {
+    return FALSE;
+  }
+
+  if (priv->fd < 0) {
+    priv->fd = kms_udp_socket_new_for_family (priv->dest.ss_family);
+    if (priv->fd < 0) {
+      return FALSE;
+    }
+    kms_udp_socket_set_buffer_sizes (priv->fd, 0, priv->buffer_size);
+  }
+
+  return TRUE;
+}
+
+static void
+kms_udp_batch_sink_release_packet (KmsUdpBatchSink * self, guint idx)
+{
+  KmsUdpBatchSinkPacket *packet = &self->priv->packets[idx];
+  guint i;
+
+  if (packet->merged) {
+    if (packet->n_maps > 0) {
+      gst_buffer_unmap (packet->buffer, &packet->maps[0]);
+    }
+  } else {
+    for (i = 0; i < packet->n_maps; i++) {
+      gst_memory_unmap (packet->maps[i].memory, &packet->maps[i]);
+    }
+  }
+
+  packet->buffer = NULL;
+  packet->n_maps = 0;
+}
+
+/* Returns FALSE if the buffer cannot be read, it must be dropped then */
+static gboolean
+kms_udp_batch_sink_prepare_packet (KmsUdpBatchSink * self, guint idx,
+    GstBuffer * buffer)
+{
+  KmsUdpBatchSinkPacket *packet = &self->priv->packets[idx];
+  struct msghdr *hdr = &self->priv->msgs[idx].msg_hdr;
+  guint i, n_mem;
+
+  packet->buffer = buffer;
+  packet->n_maps = 0;
+  n_mem = gst_buffer_n_memory (buffer);
+
+  if (n_mem > MAX_IOV) {
+    packet->merged = TRUE;
+    if (!gst_buffer_map (buffer, &packet->maps[0], GST_MAP_READ)) {
+      goto map_failed;
+    }
+    packet->n_maps = 1;
+  } else {
+    packet->merged = FALSE;
+
+    /* Map every memory on its own, no need to merge them in a copy */
+    for (i = 0; i < n_mem; i++) {
+      if (!gst_memory_map (gst_buffer_peek_memory (buffer, i),
+              &packet->maps[i], GST_MAP_READ)) {
+        goto map_failed;
+      }
+      packet->n_maps++;
+    }
+  }
+
+  for (i = 0; i < packet->n_maps; i++) {
+    packet->iovs[i].iov_base = packet->maps[i].data;
+    packet->iovs[i].iov_len = packet->maps[i].size;
+  }
+
+  memset (hdr, 0, sizeof (struct msghdr));
+  hdr->msg_name = &self->priv->dest;
+  hdr->msg_namelen = self->priv->dest_len;
+  hdr->msg_iov = packet->iovs;
+  hdr->msg_iovlen = packet->n_maps;
+
+  return TRUE;
+
+map_failed:
+  GST_WARNING_OBJECT (self, "Cannot map %" GST_PTR_FORMAT ", dropping it",
+      buffer);
+  kms_udp_batch_sink_release_packet (self, idx);
+
+  return FALSE;
+}
+
+static void
+kms_udp_batch_sink_flush (KmsUdpBatchSink * self, guint n)
+{
+  KmsUdpBatchSinkPrivate *priv = self->priv;
+  guint sent = 0, packets = 0, batches = 0, i;
+
+  while (sent < n) {
+    gint ret = sendmmsg (priv->fd, &priv->msgs[sent], n - sent, 0);
+
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      /* Skip the failing datagram, the rest may still be sent */
+      GST_DEBUG_OBJECT (self, "Cannot send packet: %s", g_strerror (errno));
+      sent++;
+      continue;
+    }
+
+    packets += ret;
+    batches++;
+    sent += ret;
+  }
+
+  GST_OBJECT_LOCK (self);
+  priv->packets_sent += packets;
+  priv->batches_sent += batches;
+  GST_OBJECT_UNLOCK (self);
+
+  for (i = 0; i < n; i++) {
+    kms_udp_batch_sink_release_packet (self, i);
+  }
+}
+
+static GstFlowReturn
+kms_udp_batch_sink_render_list (GstBaseSink * sink, GstBufferList * list)
+{
+  KmsUdpBatchSink *self = KMS_UDP_BATCH_SINK (sink);
+  guint len, i, n = 0;
+
+  if (!kms_udp_batch_sink_update_dest (self)) {
+    GST_TRACE_OBJECT (self, "No destination, dropping packets");
+    return GST_FLOW_OK;
+  }
+
+  len = gst_buffer_list_length (list);
+
+  for (i = 0; i < len; i++) {
+    if (!kms_udp_batch_sink_prepare_packet (self, n,
+            gst_buffer_list_get (list, i))) {
+      continue;
+    }
+
+    if (++n == MAX_BATCH) {
+      kms_udp_batch_sink_flush (self, n);
+      n = 0;
+    }
+  }
+
+  if (n > 0) {
+    kms_udp_batch_sink_flush (self, n);
+  }
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+kms_udp_batch_sink_render (GstBaseSink * sink, GstBuffer * buffer)
+{
+  KmsUdpBatchSink *self = KMS_UDP_BATCH_SINK (sink);
+
+  if (!kms_udp_batch_sink_update_dest (self)) {
+    GST_TRACE_OBJECT (self, "No destination, dropping packet");
+  } else if (kms_udp_batch_sink_prepare_packet (self, 0, buffer)) {
+    kms_udp_batch_sink_flush (self, 1);
+  }
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+kms_udp_batch_sink_start (GstBaseSink * sink)
+{
+  KmsUdpBatchSink *self = KMS_UDP_BATCH_SINK (sink);
+  KmsUdpBatchSinkPrivate *priv = self->priv;
+  gint socket_fd;
+
+  GST_OBJECT_LOCK (self);
+  socket_fd = priv->socket_fd;
+  priv->dest_changed = TRUE;
+  GST_OBJECT_UNLOCK (self);
+
+  if (socket_fd < 0) {
+    /* Created once the destination family is known */
+    return TRUE;
+  }
+
+  priv->fd = dup (socket_fd);
+  if (priv->fd < 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_WRITE, (NULL),
+        ("Cannot use socket %d: %s", socket_fd, g_strerror (errno)));
+    return FALSE;
+  }
+
+  kms_udp_socket_set_buffer_sizes (priv->fd, 0, priv->buffer_size);
+
+  return TRUE;
+}
+
+static void
+kms_udp_batch_sink_close (KmsUdpBatchSink * self)
+{
+  if (self->priv->fd >= 0) {
+    close (self->priv->fd);
+    self->priv->fd = -1;
+  }
+
+  self->priv->dest_len = 0;
+}
+
+static gboolean
+kms_udp_batch_sink_stop (GstBaseSink * sink)
+{
+  kms_udp_batch_sink_close (KMS_UDP_BATCH_SINK (sink));
+
+  return TRUE;
+}
+
+static void
+kms_udp_batch_sink_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsUdpBatchSink *self = KMS_UDP_BATCH_SINK (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_HOST:
+      g_free (self->priv->host);
+      self->priv->host = g_value_dup_string (value);
+      self->priv->dest_changed = TRUE;
+      break;
+    case PROP_PORT:
+      self->priv->port = g_value_get_int (value);
+      self->priv->dest_changed = TRUE;
+      break;
+    case PROP_SOCKET_FD:
+      self->priv->socket_fd = g_value_get_int (value);
+      break;
+    case PROP_BUFFER_SIZE:
+      self->priv->buffer_size = g_value_get_int (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_udp_batch_sink_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsUdpBatchSink *self = KMS_UDP_BATCH_SINK (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_HOST:
+      g_value_set_string (value, self->priv->host);
+      break;
+    case PROP_PORT:
+      g_value_set_int (value, self->priv->port);
+      break;
+    case PROP_SOCKET_FD:
+      g_value_set_int (value, self->priv->socket_fd);
+      break;
+    case PROP_BUFFER_SIZE:
+      g_value_set_int (value, self->priv->buffer_size);
+      break;
+    case PROP_PACKETS_SENT:
+      g_value_set_uint64 (value, self->priv->packets_sent);
+      break;
+    case PROP_BATCHES_SENT:
+      g_value_set_uint64 (value, self->priv->batches_sent);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_udp_batch_sink_finalize (GObject * object)
+{
+  KmsUdpBatchSink *self = KMS_UDP_BATCH_SINK (object);
+
+  kms_udp_batch_sink_close (self);
+  g_free (self->priv->host);
+
+  /* chain up */
+  G_OBJECT_CLASS (kms_udp_batch_sink_parent_class)->finalize (object);
+}
+
+static void
+kms_udp_batch_sink_init (KmsUdpBatchSink * self)
+{
+  self->priv = KMS_UDP_BATCH_SINK_GET_PRIVATE (self);
+
+  self->priv->host = DEFAULT_HOST;
+  self->priv->port = DEFAULT_PORT;
+  self->priv->socket_fd = DEFAULT_SOCKET_FD;
+  self->priv->buffer_size = DEFAULT_BUFFER_SIZE;
+  self->priv->fd = -1;
+
+  /* Network sink: send as soon as data arrives, do not wait for preroll */
+  gst_base_sink_set_sync (GST_BASE_SINK (self), FALSE);
+  gst_base_sink_set_async_enabled (GST_BASE_SINK (self), FALSE);
+}
+
+static void
+kms_udp_batch_sink_class_init (KmsUdpBatchSinkClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSinkClass *gstbasesink_class = GST_BASE_SINK_CLASS (klass);
+
+  gobject_class->set_property = kms_udp_batch_sink_set_property;
+  gobject_class->get_property = kms_udp_batch_sink_get_property;
+  gobject_class->finalize = kms_udp_batch_sink_finalize;
+
+  gstbasesink_class->start = GST_DEBUG_FUNCPTR (kms_udp_batch_sink_start);
+  gstbasesink_class->stop = GST_DEBUG_FUNCPTR (kms_udp_batch_sink_stop);
+  gstbasesink_class->render = GST_DEBUG_FUNCPTR (kms_udp_batch_sink_render);
+  gstbasesink_class->render_list =
+      GST_DEBUG_FUNCPTR (kms_udp_batch_sink_render_list);
+
+  gst_element_class_set_details_simple (gstelement_class,
+      "UdpBatchSink",
+      "Sink/Network",
+      "Send buffer lists as UDP datagrams using sendmmsg",
+      "Kurento <kurento@googlegroups.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sinktemplate));
+
+  g_object_class_install_property (gobject_class, PROP_HOST,
+      g_param_spec_string ("host", "Host",
+          "Destination host", DEFAULT_HOST,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PORT,
+      g_param_spec_int ("port", "Port",
+          "Destination port", 0, G_MAXUINT16, DEFAULT_PORT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SOCKET_FD,
+      g_param_spec_int ("socket-fd", "Socket fd",
+          "Socket to send from, i.e. the receiving one for symmetric RTP "
+          "(-1 = create a new one)", -1, G_MAXINT, DEFAULT_SOCKET_FD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BUFFER_SIZE,
+      g_param_spec_int ("buffer-size", "Buffer size",
+          "Socket send buffer size (0 = system default)", 0, G_MAXINT,
+          DEFAULT_BUFFER_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PACKETS_SENT,
+      g_param_spec_uint64 ("packets-sent", "Packets sent",
+          "Number of datagrams sent", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BATCHES_SENT,
+      g_param_spec_uint64 ("batches-sent", "Batches sent",
+          "Number of successful sendmmsg calls", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, PLUGIN_NAME, 0, PLUGIN_NAME);
+
+  g_type_class_add_private (klass, sizeof (KmsUdpBatchSinkPrivate));
+}
+
+gboolean
+kms_udp_batch_sink_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, PLUGIN_NAME, GST_RANK_NONE,
+      KMS_TYPE_UDP_BATCH_SINK);
+}
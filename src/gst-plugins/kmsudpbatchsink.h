@@ -0,0 +1,56 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_UDP_BATCH_SINK_H__
+#define __KMS_UDP_BATCH_SINK_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesink.h>
+
+G_BEGIN_DECLS
+#define KMS_TYPE_UDP_BATCH_SINK \
+  (kms_udp_batch_sink_get_type())
+#define KMS_UDP_BATCH_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_UDP_BATCH_SINK,KmsUdpBatchSink))
+#define KMS_UDP_BATCH_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_UDP_BATCH_SINK,KmsUdpBatchSinkClass))
+#define KMS_IS_UDP_BATCH_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_UDP_BATCH_SINK))
+#define KMS_IS_UDP_BATCH_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_UDP_BATCH_SINK))
+#define KMS_UDP_BATCH_SINK_CAST(obj) ((KmsUdpBatchSink*)(obj))
+
+typedef struct _KmsUdpBatchSink KmsUdpBatchSink;
+typedef struct _KmsUdpBatchSinkClass KmsUdpBatchSinkClass;
+typedef struct _KmsUdpBatchSinkPrivate KmsUdpBatchSinkPrivate;
+
+struct _KmsUdpBatchSink
+{
+  GstBaseSink parent;
+
+  KmsUdpBatchSinkPrivate *priv;
+};
+
+struct _KmsUdpBatchSinkClass
+{
+  GstBaseSinkClass parent_class;
+};
+
+GType kms_udp_batch_sink_get_type (void);
+
+gboolean kms_udp_batch_sink_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+#endif /* __KMS_UDP_BATCH_SINK_H__ */
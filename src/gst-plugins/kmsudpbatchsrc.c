@@ -0,0 +1,754 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             /* recvmmsg */
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "kmsudpbatchsrc.h"
+#include <commons/kmsudpsocket.h>
+
+#define PLUGIN_NAME "udpbatchsrc"
+
+#define GST_CAT_DEFAULT kms_udp_batch_src_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define kms_udp_batch_src_parent_class parent_class
+G_DEFINE_TYPE (KmsUdpBatchSrc, kms_udp_batch_src, GST_TYPE_ELEMENT);
+
+#define KMS_UDP_BATCH_SRC_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (              \
+    (obj),                                   \
+    KMS_TYPE_UDP_BATCH_SRC,                  \
+    KmsUdpBatchSrcPrivate                    \
+  )                                          \
+)
+
+#define DEFAULT_ADDRESS "0.0.0.0"
+#define DEFAULT_PORT 0
+#define DEFAULT_REUSE_PORT FALSE
+#define DEFAULT_SOCKET_FD -1
+#define DEFAULT_BATCH_SIZE 32
+#define MAX_BATCH_SIZE 1024
+#define DEFAULT_MAX_PACKET_SIZE 1500
+#define DEFAULT_BUFFER_SIZE 0
+
+enum
+{
+  PROP_0,
+  PROP_ADDRESS,
+  PROP_PORT,
+  PROP_REUSE_PORT,
+  PROP_SOCKET_FD,
+  PROP_BATCH_SIZE,
+  PROP_MAX_PACKET_SIZE,
+  PROP_BUFFER_SIZE,
+  PROP_CAPS,
+  PROP_PACKETS_RECEIVED,
+  PROP_PACKETS_TRUNCATED,
+  PROP_BATCHES_RECEIVED
+};
+
+struct _KmsUdpBatchSrcPrivate
+{
+  GstPad *srcpad;
+
+  /* Properties */
+  gchar *address;
+  gint port;
+  gboolean reuse_port;
+  gint socket_fd;
+  guint batch_size;
+  guint max_packet_size;
+  gint buffer_size;
+  GstCaps *caps;
+
+  /* Streaming state, only touched from the streaming thread */
+  gint fd;
+  GstPoll *poll;
+  GstPollFD pollfd;
+  GstBufferPool *pool;
+  guint slots;
+  GstBuffer **buffers;
+  GstMapInfo *maps;
+  struct iovec *iovs;
+  struct mmsghdr *msgs;
+  gboolean events_sent;
+
+  /* Stats, protected by the object lock */
+  guint64 packets_received;
+  guint64 packets_truncated;
+  guint64 batches_received;
+};
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static void
+kms_udp_batch_src_release_slots (KmsUdpBatchSrc * self)
+{
+  KmsUdpBatchSrcPrivate *priv = self->priv;
+  guint i;
+
+  for (i = 0; i < priv->slots; i++) {
+    if (priv->buffers[i] == NULL) {
+      continue;
+    }
+
+    gst_buffer_unmap (priv->buffers[i], &priv->maps[i]);
+    gst_buffer_unref (priv->buffers[i]);
+    priv->buffers[i] = NULL;
+  }
+
+  g_clear_pointer (&priv->buffers, g_free);
+  g_clear_pointer (&priv->maps, g_free);
+  g_clear_pointer (&priv->iovs, g_free);
+  g_clear_pointer (&priv->msgs, g_free);
+  priv->slots = 0;
+}
+
+static gboolean
+kms_udp_batch_src_alloc_slots (KmsUdpBatchSrc * self)
+{
+  KmsUdpBatchSrcPrivate *priv = self->priv;
+  GstStructure *config;
+
+  priv->pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (priv->pool);
+  /* Enough buffers to refill a whole batch while the previous one */
+  /* is still travelling downstream */
+  gst_buffer_pool_config_set_params (config, NULL, priv->max_packet_size,
+      2 * priv->batch_size, 0);
+
+  if (!gst_buffer_pool_set_config (priv->pool, config) ||
+      !gst_buffer_pool_set_active (priv->pool, TRUE)) {
+    GST_ERROR_OBJECT (self, "Cannot configure buffer pool");
+    g_clear_object (&priv->pool);
+    return FALSE;
+  }
+
+  priv->slots = priv->batch_size;
+  priv->buffers = g_new0 (GstBuffer *, priv->slots);
+  priv->maps = g_new0 (GstMapInfo, priv->slots);
+  priv->iovs = g_new0 (struct iovec, priv->slots);
+  priv->msgs = g_new0 (struct mmsghdr, priv->slots);
+
+  return TRUE;
+}
+
+static void
+kms_udp_batch_src_free_slots (KmsUdpBatchSrc * self)
+{
+  kms_udp_batch_src_release_slots (self);
+
+  if (self->priv->pool != NULL) {
+    gst_buffer_pool_set_active (self->priv->pool, FALSE);
+    g_clear_object (&self->priv->pool);
+  }
+}
+
+/* Slots keep their buffer mapped until a datagram is received on them, */
+/* so only consumed slots have to be refilled after every batch */
+static gboolean
+kms_udp_batch_src_refill_slots (KmsUdpBatchSrc * self)
+{
+  KmsUdpBatchSrcPrivate *priv = self->priv;
+  guint i;
+
+  for (i = 0; i < priv->slots; i++) {
+    if (priv->buffers[i] != NULL) {
+      continue;
+    }
+
+    if (gst_buffer_pool_acquire_buffer (priv->pool, &priv->buffers[i],
+            NULL) != GST_FLOW_OK) {
+      return FALSE;
+    }
+
+    /* Recycled buffers keep the size of the last datagram */
+    gst_buffer_set_size (priv->buffers[i], priv->max_packet_size);
+    gst_buffer_map (priv->buffers[i], &priv->maps[i], GST_MAP_WRITE);
+
+    priv->iovs[i].iov_base = priv->maps[i].data;
+    priv->iovs[i].iov_len = priv->maps[i].size;
+    priv->msgs[i].msg_hdr.msg_iov = &priv->iovs[i];
+    priv->msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+kms_udp_batch_src_open (KmsUdpBatchSrc * self)
+{
+  KmsUdpBatchSrcPrivate *priv = self->priv;
+  gchar *address;
+  gint socket_fd;
+  guint16 port;
+  gboolean reuse_port;
+
+  GST_OBJECT_LOCK (self);
+  address = g_strdup (priv->address);
+  port = priv->port;
+  reuse_port = priv->reuse_port;
+  socket_fd = priv->socket_fd;
+  GST_OBJECT_UNLOCK (self);
+
+  if (socket_fd >= 0) {
+    /* Keep our own descriptor, the owner may close the given one */
+    priv->fd = dup (socket_fd);
+  } else {
+    priv->fd = kms_udp_socket_new_bound (address, &port, reuse_port);
+  }
+
+  if (priv->fd < 0) {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("Cannot open socket on %s:%u", address, port));
+    g_free (address);
+    return FALSE;
+  }
+
+  g_free (address);
+
+  if (socket_fd < 0) {
+    GST_OBJECT_LOCK (self);
+    priv->port = port;
+    GST_OBJECT_UNLOCK (self);
+    g_object_notify (G_OBJECT (self), "port");
+  }
+
+  kms_udp_socket_set_buffer_sizes (priv->fd, priv->buffer_size, 0);
+
+  priv->poll = gst_poll_new (TRUE);
+  gst_poll_fd_init (&priv->pollfd);
+  priv->pollfd.fd = priv->fd;
+  gst_poll_add_fd (priv->poll, &priv->pollfd);
+  gst_poll_fd_ctl_read (priv->poll, &priv->pollfd, TRUE);
+
+  return TRUE;
+}
+
+static void
+kms_udp_batch_src_close (KmsUdpBatchSrc * self)
+{
+  KmsUdpBatchSrcPrivate *priv = self->priv;
+
+  if (priv->poll != NULL) {
+    gst_poll_free (priv->poll);
+    priv->poll = NULL;
+  }
+
+  if (priv->fd >= 0) {
+    close (priv->fd);
+    priv->fd = -1;
+  }
+}
+
+static void
+kms_udp_batch_src_push_events (KmsUdpBatchSrc * self)
+{
+  GstSegment segment;
+  GstCaps *caps = NULL;
+  gchar *stream_id;
+
+  stream_id = gst_pad_create_stream_id (self->priv->srcpad,
+      GST_ELEMENT (self), NULL);
+  gst_pad_push_event (self->priv->srcpad,
+      gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
+
+  GST_OBJECT_LOCK (self);
+  if (self->priv->caps != NULL) {
+    caps = gst_caps_ref (self->priv->caps);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (caps != NULL) {
+    gst_pad_push_event (self->priv->srcpad, gst_event_new_caps (caps));
+    gst_caps_unref (caps);
+  }
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (self->priv->srcpad, gst_event_new_segment (&segment));
+
+  self->priv->events_sent = TRUE;
+}
+
+static GstClockTime
+kms_udp_batch_src_get_running_time (KmsUdpBatchSrc * self)
+{
+  GstClockTime ts = GST_CLOCK_TIME_NONE;
+  GstClock *clock;
+
+  clock = gst_element_get_clock (GST_ELEMENT (self));
+  if (clock != NULL) {
+    ts = gst_clock_get_time (clock) -
+        gst_element_get_base_time (GST_ELEMENT (self));
+    gst_object_unref (clock);
+  }
+
+  return ts;
+}
+
+static GstBufferList *
+kms_udp_batch_src_receive (KmsUdpBatchSrc * self)
+{
+  KmsUdpBatchSrcPrivate *priv = self->priv;
+  GstBufferList *list;
+  GstClockTime ts;
+  guint truncated = 0;
+  gint n, i;
+
+  n = recvmmsg (priv->fd, priv->msgs, priv->slots, MSG_DONTWAIT, NULL);
+  if (n <= 0) {
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      GST_WARNING_OBJECT (self, "recvmmsg failed: %s", g_strerror (errno));
+    }
+    return NULL;
+  }
+
+  /* The whole batch arrived in the same wake up */
+  ts = kms_udp_batch_src_get_running_time (self);
+  list = gst_buffer_list_new_sized (n);
+
+  for (i = 0; i < n; i++) {
+    GstBuffer *buffer = priv->buffers[i];
+
+    gst_buffer_unmap (buffer, &priv->maps[i]);
+    priv->buffers[i] = NULL;
+
+    if (priv->msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+      GST_WARNING_OBJECT (self, "Dropping datagram bigger than %u bytes",
+          priv->max_packet_size);
+      gst_buffer_unref (buffer);
+      truncated++;
+      continue;
+    }
+
+    gst_buffer_set_size (buffer, priv->msgs[i].msg_len);
+    GST_BUFFER_PTS (buffer) = ts;
+    GST_BUFFER_DTS (buffer) = ts;
+    gst_buffer_list_add (list, buffer);
+  }
+
+  GST_OBJECT_LOCK (self);
+  priv->packets_received += n - truncated;
+  priv->packets_truncated += truncated;
+  priv->batches_received++;
+  GST_OBJECT_UNLOCK (self);
+
+  return list;
+}
+
+static void
+kms_udp_batch_src_loop (KmsUdpBatchSrc * self)
+{
+  KmsUdpBatchSrcPrivate *priv = self->priv;
+  GstBufferList *list;
+  GstFlowReturn ret;
+
+  if (!priv->events_sent) {
+    kms_udp_batch_src_push_events (self);
+  }
+
+  if (!kms_udp_batch_src_refill_slots (self)) {
+    GST_DEBUG_OBJECT (self, "Buffer pool is flushing");
+    gst_pad_pause_task (priv->srcpad);
+    return;
+  }
+
+  if (gst_poll_wait (priv->poll, GST_CLOCK_TIME_NONE) < 0) {
+    if (errno == EBUSY) {
+      GST_DEBUG_OBJECT (self, "Poll is flushing, pausing");
+      gst_pad_pause_task (priv->srcpad);
+    } else if (errno != EINTR && errno != EAGAIN) {
+      GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+          ("Poll error: %s", g_strerror (errno)));
+      gst_pad_pause_task (priv->srcpad);
+    }
+    return;
+  }
+
+  list = kms_udp_batch_src_receive (self);
+  if (list == NULL) {
+    return;
+  }
+
+  if (gst_buffer_list_length (list) == 0) {
+    gst_buffer_list_unref (list);
+    return;
+  }
+
+  ret = gst_pad_push_list (priv->srcpad, list);
+
+  if (ret == GST_FLOW_FLUSHING) {
+    GST_DEBUG_OBJECT (self, "Flushing, pausing");
+    gst_pad_pause_task (priv->srcpad);
+  } else if (ret == GST_FLOW_NOT_LINKED) {
+    /* RTP connections are created before negotiation finishes */
+    GST_TRACE_OBJECT (self, "Not linked, dropping packets");
+  } else if (ret < GST_FLOW_EOS) {
+    GST_ELEMENT_ERROR (self, STREAM, FAILED, (NULL),
+        ("Streaming error: %s", gst_flow_get_name (ret)));
+    gst_pad_pause_task (priv->srcpad);
+  }
+}
+
+static void
+kms_udp_batch_src_stop_task (KmsUdpBatchSrc * self, gboolean pause)
+{
+  if (self->priv->poll != NULL) {
+    gst_poll_set_flushing (self->priv->poll, TRUE);
+  }
+
+  if (pause) {
+    gst_pad_pause_task (self->priv->srcpad);
+  } else {
+    gst_pad_stop_task (self->priv->srcpad);
+  }
+
+  if (self->priv->poll != NULL) {
+    gst_poll_set_flushing (self->priv->poll, FALSE);
+  }
+}
+
+static GstStateChangeReturn
+kms_udp_batch_src_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!kms_udp_batch_src_open (self)) {
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!kms_udp_batch_src_alloc_slots (self)) {
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      self->priv->events_sent = FALSE;
+      break;
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      kms_udp_batch_src_stop_task (self, TRUE);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      kms_udp_batch_src_stop_task (self, FALSE);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  if (ret == GST_STATE_CHANGE_FAILURE) {
+    return ret;
+  }
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      /* Live source, data only flows in PLAYING */
+      ret = GST_STATE_CHANGE_NO_PREROLL;
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      gst_pad_start_task (self->priv->srcpad,
+          (GstTaskFunction) kms_udp_batch_src_loop, self, NULL);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      kms_udp_batch_src_free_slots (self);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      kms_udp_batch_src_close (self);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static gboolean
+kms_udp_batch_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY:
+      gst_query_set_latency (query, TRUE, 0, GST_CLOCK_TIME_NONE);
+      return TRUE;
+    case GST_QUERY_CAPS:{
+      KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (parent);
+      GstCaps *caps, *filter;
+
+      GST_OBJECT_LOCK (self);
+      caps = self->priv->caps != NULL ? gst_caps_ref (self->priv->caps) :
+          gst_caps_new_any ();
+      GST_OBJECT_UNLOCK (self);
+
+      gst_query_parse_caps (query, &filter);
+      if (filter != NULL) {
+        GstCaps *intersection;
+
+        intersection = gst_caps_intersect_full (filter, caps,
+            GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (caps);
+        caps = intersection;
+      }
+
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+    default:
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
+
+static void
+kms_udp_batch_src_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_ADDRESS:
+      g_free (self->priv->address);
+      self->priv->address = g_value_dup_string (value);
+      break;
+    case PROP_PORT:
+      self->priv->port = g_value_get_int (value);
+      break;
+    case PROP_REUSE_PORT:
+      self->priv->reuse_port = g_value_get_boolean (value);
+      break;
+    case PROP_SOCKET_FD:
+      self->priv->socket_fd = g_value_get_int (value);
+      break;
+    case PROP_BATCH_SIZE:
+      self->priv->batch_size = g_value_get_uint (value);
+      break;
+    case PROP_MAX_PACKET_SIZE:
+      self->priv->max_packet_size = g_value_get_uint (value);
+      break;
+    case PROP_BUFFER_SIZE:
+      self->priv->buffer_size = g_value_get_int (value);
+      break;
+    case PROP_CAPS:
+      gst_caps_replace (&self->priv->caps, gst_value_get_caps (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_udp_batch_src_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (object);
+
+  GST_OBJECT_LOCK (self);
+
+  switch (property_id) {
+    case PROP_ADDRESS:
+      g_value_set_string (value, self->priv->address);
+      break;
+    case PROP_PORT:
+      g_value_set_int (value, self->priv->port);
+      break;
+    case PROP_REUSE_PORT:
+      g_value_set_boolean (value, self->priv->reuse_port);
+      break;
+    case PROP_SOCKET_FD:
+      g_value_set_int (value, self->priv->socket_fd);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint (value, self->priv->batch_size);
+      break;
+    case PROP_MAX_PACKET_SIZE:
+      g_value_set_uint (value, self->priv->max_packet_size);
+      break;
+    case PROP_BUFFER_SIZE:
+      g_value_set_int (value, self->priv->buffer_size);
+      break;
+    case PROP_CAPS:
+      gst_value_set_caps (value, self->priv->caps);
+      break;
+    case PROP_PACKETS_RECEIVED:
+      g_value_set_uint64 (value, self->priv->packets_received);
+      break;
+    case PROP_PACKETS_TRUNCATED:
+      g_value_set_uint64 (value, self->priv->packets_truncated);
+      break;
+    case PROP_BATCHES_RECEIVED:
+      g_value_set_uint64 (value, self->priv->batches_received);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+kms_udp_batch_src_finalize (GObject * object)
+{
+  KmsUdpBatchSrc *self = KMS_UDP_BATCH_SRC (object);
+
+  kms_udp_batch_src_free_slots (self);
+  kms_udp_batch_src_close (self);
+
+  g_free (self->priv->address);
+  gst_caps_replace (&self->priv->caps, NULL);
+
+  /* chain up */
+  G_OBJECT_CLASS (kms_udp_batch_src_parent_class)->finalize (object);
+}
+
+static void
+kms_udp_batch_src_init (KmsUdpBatchSrc * self)
+{
+  self->priv = KMS_UDP_BATCH_SRC_GET_PRIVATE (self);
+
+  self->priv->address = g_strdup (DEFAULT_ADDRESS);
+  self->priv->port = DEFAULT_PORT;
+  self->priv->reuse_port = DEFAULT_REUSE_PORT;
+  self->priv->socket_fd = DEFAULT_SOCKET_FD;
+  self->priv->batch_size = DEFAULT_BATCH_SIZE;
+  self->priv->max_packet_size = DEFAULT_MAX_PACKET_SIZE;
+  self->priv->buffer_size = DEFAULT_BUFFER_SIZE;
+  self->priv->fd = -1;
+
+  self->priv->srcpad =
+      gst_pad_new_from_static_template (&srctemplate, "src");
+  gst_pad_set_query_function (self->priv->srcpad,
+      GST_DEBUG_FUNCPTR (kms_udp_batch_src_query));
+  gst_pad_use_fixed_caps (self->priv->srcpad);
+  gst_element_add_pad (GST_ELEMENT (self), self->priv->srcpad);
+
+  GST_OBJECT_FLAG_SET (self, GST_ELEMENT_FLAG_SOURCE);
+}
+
+static void
+kms_udp_batch_src_class_init (KmsUdpBatchSrcClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->set_property = kms_udp_batch_src_set_property;
+  gobject_class->get_property = kms_udp_batch_src_get_property;
+  gobject_class->finalize = kms_udp_batch_src_finalize;
+
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (kms_udp_batch_src_change_state);
+
+  gst_element_class_set_details_simple (gstelement_class,
+      "UdpBatchSrc",
+      "Source/Network",
+      "Receive UDP datagrams in batches using recvmmsg, "
+      "pushing them as buffer lists",
+      "Kurento <kurento@googlegroups.com>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&srctemplate));
+
+  g_object_class_install_property (gobject_class, PROP_ADDRESS,
+      g_param_spec_string ("address", "Address",
+          "Address to receive packets on", DEFAULT_ADDRESS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PORT,
+      g_param_spec_int ("port", "Port",
+          "Port to receive packets on (0 = any, updated once bound)", 0,
+          G_MAXUINT16, DEFAULT_PORT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_REUSE_PORT,
+      g_param_spec_boolean ("reuse-port", "Reuse port",
+          "Bind with SO_REUSEPORT so several sockets can share the port",
+          DEFAULT_REUSE_PORT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SOCKET_FD,
+      g_param_spec_int ("socket-fd", "Socket fd",
+          "Already bound socket to use (-1 = bind address:port)", -1,
+          G_MAXINT, DEFAULT_SOCKET_FD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BATCH_SIZE,
+      g_param_spec_uint ("batch-size", "Batch size",
+          "Maximum number of datagrams read with a single system call", 1,
+          MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_PACKET_SIZE,
+      g_param_spec_uint ("max-packet-size", "Max packet size",
+          "Size of the preallocated buffers, bigger datagrams are dropped",
+          1, G_MAXUINT16, DEFAULT_MAX_PACKET_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BUFFER_SIZE,
+      g_param_spec_int ("buffer-size", "Buffer size",
+          "Socket receive buffer size (0 = system default)", 0, G_MAXINT,
+          DEFAULT_BUFFER_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CAPS,
+      g_param_spec_boxed ("caps", "Caps",
+          "Caps of the received data", GST_TYPE_CAPS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PACKETS_RECEIVED,
+      g_param_spec_uint64 ("packets-received", "Packets received",
+          "Number of datagrams received and pushed downstream", 0,
+          G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PACKETS_TRUNCATED,
+      g_param_spec_uint64 ("packets-truncated", "Packets truncated",
+          "Number of datagrams dropped for being bigger than max-packet-size",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BATCHES_RECEIVED,
+      g_param_spec_uint64 ("batches-received", "Batches received",
+          "Number of recvmmsg calls that returned data", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, PLUGIN_NAME, 0, PLUGIN_NAME);
+
+  g_type_class_add_private (klass, sizeof (KmsUdpBatchSrcPrivate));
+}
+
+gboolean
+kms_udp_batch_src_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, PLUGIN_NAME, GST_RANK_NONE,
+      KMS_TYPE_UDP_BATCH_SRC);
+}
@@ -0,0 +1,55 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef __KMS_UDP_BATCH_SRC_H__
+#define __KMS_UDP_BATCH_SRC_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+#define KMS_TYPE_UDP_BATCH_SRC \
+  (kms_udp_batch_src_get_type())
+#define KMS_UDP_BATCH_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_UDP_BATCH_SRC,KmsUdpBatchSrc))
+#define KMS_UDP_BATCH_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_UDP_BATCH_SRC,KmsUdpBatchSrcClass))
+#define KMS_IS_UDP_BATCH_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_UDP_BATCH_SRC))
+#define KMS_IS_UDP_BATCH_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_UDP_BATCH_SRC))
+#define KMS_UDP_BATCH_SRC_CAST(obj) ((KmsUdpBatchSrc*)(obj))
+
+typedef struct _KmsUdpBatchSrc KmsUdpBatchSrc;
+typedef struct _KmsUdpBatchSrcClass KmsUdpBatchSrcClass;
+typedef struct _KmsUdpBatchSrcPrivate KmsUdpBatchSrcPrivate;
+
+struct _KmsUdpBatchSrc
+{
+  GstElement parent;
+
+  KmsUdpBatchSrcPrivate *priv;
+};
+
+struct _KmsUdpBatchSrcClass
+{
+  GstElementClass parent_class;
+};
+
+GType kms_udp_batch_src_get_type (void);
+
+gboolean kms_udp_batch_src_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+#endif /* __KMS_UDP_BATCH_SRC_H__ */
@@ -18,16 +18,13 @@
 
 #include "kmsvp8parse.h"
 
-#include <string.h>
-
 #include <gst/gst.h>
 #include <gst/base/gstbaseparse.h>
 #include <gst/video/video-event.h>
 
-#define PLUGIN_NAME "vp8parse"
+#include "kmsvp8.h"
 
-#include <vpx/vpx_decoder.h>
-#include <vpx/vp8dx.h>
+#define PLUGIN_NAME "vp8parse"
 
 #define GST_CAT_DEFAULT kms_vp8_parse_debug_category
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -106,9 +103,8 @@ kms_vp8_parse_check_caps_ready (KmsVp8Parse * self)
 static gboolean
 kms_vp8_parse_detect_framerate (KmsVp8Parse * self, GstBaseParseFrame * frame)
 {
-  GValue value = G_VALUE_INIT;
   GstClockTime duration;
-  gint num = 0, denom = 0;
+  gint num, denom, gcd;
   gboolean update_caps = FALSE;
 
   if (GST_CLOCK_TIME_IS_VALID (frame->buffer->duration)) {
@@ -131,10 +127,14 @@ kms_vp8_parse_detect_framerate (KmsVp8Parse * self, GstBaseParseFrame * frame)
     return FALSE;
   }
 
-  g_value_init (&value, GST_TYPE_FRACTION);
-  gst_value_set_fraction (&value, (GST_SECOND / duration) * 1000, 1000);
-  num = gst_value_get_fraction_numerator (&value);
-  denom = gst_value_get_fraction_denominator (&value);
+  num = (GST_SECOND / duration) * 1000;
+  denom = 1000;
+  gcd = gst_util_greatest_common_divisor (num, denom);
+
+  if (gcd != 0) {
+    num /= gcd;
+    denom /= gcd;
+  }
 
   if (num != 0) {
     if (self->priv->framerate_num != num) {
@@ -150,8 +150,6 @@ kms_vp8_parse_detect_framerate (KmsVp8Parse * self, GstBaseParseFrame * frame)
     }
   }
 
-  g_value_reset (&value);
-
   return update_caps;
 }
 
@@ -187,38 +185,30 @@ static GstFlowReturn
 kms_vp8_parse_handle_frame (GstBaseParse * parse, GstBaseParseFrame * frame,
     gint * skipsize)
 {
-  vpx_codec_stream_info_t stream_info;
-  vpx_codec_err_t status;
-  GstMapInfo minfo;
+  guint8 data[KMS_VP8_FRAME_HEADER_SIZE];
+  KmsVp8FrameHeader header;
+  gsize size;
   gboolean update_caps = FALSE;
   KmsVp8Parse *self = KMS_VP8_PARSE (parse);
 
-  if (!gst_buffer_map (frame->buffer, &minfo, GST_MAP_READ)) {
-    GST_ERROR_OBJECT (parse, "Failed to map input buffer");
-    return GST_FLOW_ERROR;
-  }
-
   if ((GST_CLOCK_TIME_IS_VALID (frame->buffer->duration) ||
           GST_BUFFER_PTS_IS_VALID (frame->buffer) ||
           GST_BUFFER_DTS_IS_VALID (frame->buffer)) && !self->priv->started)
     gst_base_parse_set_has_timing_info (parse, TRUE);
 
-  memset (&stream_info, 0, sizeof (stream_info));
-  stream_info.sz = sizeof (stream_info);
+  /* Only the uncompressed data chunk is needed, avoid mapping the frame */
+  size = gst_buffer_extract (frame->buffer, 0, data, sizeof (data));
 
-  status = vpx_codec_peek_stream_info (&vpx_codec_vp8_dx_algo,
-      minfo.data, minfo.size, &stream_info);
-
-  if (status == VPX_CODEC_OK && stream_info.is_kf) {
-    if (self->priv->height != stream_info.h) {
-      self->priv->height = stream_info.h;
-      GST_INFO_OBJECT (parse, "Updating height: %d", stream_info.h);
+  if (kms_vp8_parse_frame_header (data, size, &header) && header.key_frame) {
+    if (self->priv->height != header.height) {
+      self->priv->height = header.height;
+      GST_INFO_OBJECT (parse, "Updating height: %d", header.height);
       update_caps = TRUE;
     }
 
-    if (self->priv->width != stream_info.w) {
-      self->priv->width = stream_info.w;
-      GST_INFO_OBJECT (parse, "Updating width: %d", stream_info.w);
+    if (self->priv->width != header.width) {
+      self->priv->width = header.width;
+      GST_INFO_OBJECT (parse, "Updating width: %d", header.width);
       update_caps = TRUE;
     }
 
@@ -269,9 +259,7 @@ kms_vp8_parse_handle_frame (GstBaseParse * parse, GstBaseParseFrame * frame,
   self->priv->last_dts = frame->buffer->dts;
   self->priv->last_pts = frame->buffer->pts;
 
-  frame->size = minfo.size;
-
-  gst_buffer_unmap (frame->buffer, &minfo);
+  frame->size = gst_buffer_get_size (frame->buffer);
 
   return gst_base_parse_finish_frame (parse, frame, frame->size);
 }
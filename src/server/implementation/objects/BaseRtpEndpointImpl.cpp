@@ -187,6 +187,38 @@ void BaseRtpEndpointImpl::setMaxVideoSendBandwidth (int maxVideoSendBandwidth)
   g_object_set (element, "max-video-send-bandwidth", maxVideoSendBandwidth, NULL);
 }
 
+int BaseRtpEndpointImpl::getJitterBufferMinLatency ()
+{
+  int jitterBufferMinLatency;
+
+  g_object_get (element, "jitter-buffer-min-latency", &jitterBufferMinLatency,
+                NULL);
+
+  return jitterBufferMinLatency;
+}
+
+void BaseRtpEndpointImpl::setJitterBufferMinLatency (int jitterBufferMinLatency)
+{
+  g_object_set (element, "jitter-buffer-min-latency", jitterBufferMinLatency,
+                NULL);
+}
+
+int BaseRtpEndpointImpl::getJitterBufferMaxLatency ()
+{
+  int jitterBufferMaxLatency;
+
+  g_object_get (element, "jitter-buffer-max-latency", &jitterBufferMaxLatency,
+                NULL);
+
+  return jitterBufferMaxLatency;
+}
+
+void BaseRtpEndpointImpl::setJitterBufferMaxLatency (int jitterBufferMaxLatency)
+{
+  g_object_set (element, "jitter-buffer-max-latency", jitterBufferMaxLatency,
+                NULL);
+}
+
 std::shared_ptr<MediaState>
 BaseRtpEndpointImpl::getMediaState ()
 {
@@ -325,12 +357,13 @@ static std::shared_ptr<RTCInboundRTPStreamStats>
 createRTCInboundRTPStreamStats (const GstStructure *stats)
 {
   guint64 bytesReceived, packetsReceived;
-  guint jitter, fractionLost, pliCount, firCount, remb;
+  guint jitter, fractionLost, pliCount, firCount, remb, targetLatency;
   gint packetLost, clock_rate;
   float jitterSec;
+  GstStructure *jbStats;
 
   packetLost = jitter = fractionLost = pliCount = firCount = remb =
-                                         clock_rate = 0;
+                                         clock_rate = targetLatency = 0;
   bytesReceived = packetsReceived = G_GUINT64_CONSTANT (0);
   jitterSec = 0.0;
 
@@ -357,11 +390,17 @@ createRTCInboundRTPStreamStats (const GstStructure *stats)
     GST_TRACE ("No remb stats collected");
   }
 
+  if (gst_structure_get (stats, "jitter-buffer", GST_TYPE_STRUCTURE, &jbStats,
+                         NULL) ) {
+    gst_structure_get_uint (jbStats, "target-latency", &targetLatency);
+    gst_structure_free (jbStats);
+  }
+
   return std::make_shared <RTCInboundRTPStreamStats> ("",
          std::make_shared <StatsType> (StatsType::inboundrtp), 0.0, "",
          "", false, "", "", "", firCount, pliCount, 0, 0, remb,
          packetLost, (float) fractionLost, packetsReceived, bytesReceived,
-         jitterSec);
+         jitterSec, targetLatency / 1000.0);
 }
 
 static std::shared_ptr<RTCOutboundRTPStreamStats>
@@ -561,7 +600,7 @@ BaseRtpEndpointImpl::fillStatsReport (std::map
                        "audio-e2e-latency", G_TYPE_UINT64, &a_e2e, NULL);
     endpointStats = std::make_shared <EndpointStats> (getId (),
                     std::make_shared <StatsType> (StatsType::endpoint), timestamp,
-                    0.0, 0.0, a_e2e, v_e2e);
+                    0.0, 0.0, 0, 0, 0, 0, 0, 0, 0, 0, a_e2e, v_e2e);
 
     report[getId ()] = endpointStats;
   }
@@ -43,6 +43,12 @@ public:
   virtual int getMaxVideoSendBandwidth ();
   virtual void setMaxVideoSendBandwidth (int maxVideoSendBandwidth);
 
+  virtual int getJitterBufferMinLatency ();
+  virtual void setJitterBufferMinLatency (int jitterBufferMinLatency);
+
+  virtual int getJitterBufferMaxLatency ();
+  virtual void setJitterBufferMaxLatency (int jitterBufferMaxLatency);
+
   virtual std::shared_ptr<MediaState> getMediaState ();
   virtual std::shared_ptr<ConnectionState> getConnectionState ();
 
@@ -18,12 +18,20 @@
 #include <StatsType.hpp>
 #include "ElementStats.hpp"
 #include "kmsstats.h"
+#include "kmselementpool.h"
+#include <mutex>
+#include <set>
 
 #define GST_CAT_DEFAULT kurento_media_element_impl
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "KurentoMediaElementImpl"
 
 #define TARGET_BITRATE "output-bitrate"
+#define ELEMENT_POOL "elementPool"
+#define AGNOSTICBIN_FACTORY "agnosticbin"
+#define ASYNC_STATE_SYNC "asyncStateSync"
+#define KEY_FRAME_REQUEST_WINDOW "keyFrameRequestWindow"
+#define GOP_CACHE_SIZE "gopCacheSize"
 
 namespace kurento
 {
@@ -341,7 +349,9 @@ MediaElementImpl::MediaElementImpl (const boost::property_tree::ptree &config,
 
   pipe = std::dynamic_pointer_cast<MediaPipelineImpl> (getMediaPipeline() );
 
-  element = gst_element_factory_make (factoryName.c_str(), NULL);
+  configureElementPools (factoryName);
+
+  element = kms_element_pool_acquire (factoryName.c_str() );
 
   if (element == NULL) {
     throw KurentoException (MEDIA_OBJECT_NOT_AVAILABLE,
@@ -357,7 +367,8 @@ MediaElementImpl::MediaElementImpl (const boost::property_tree::ptree &config,
                                         G_CALLBACK (_media_element_pad_added), this);
 
   g_object_ref (element);
-  pipe->addElement (element);
+  pipe->addElement (element,
+                    getConfigValue<bool, MediaElement> (ASYNC_STATE_SYNC, false) );
 
   //read default configuration for output bitrate
   try {
@@ -367,6 +378,43 @@ MediaElementImpl::MediaElementImpl (const boost::property_tree::ptree &config,
   } catch (boost::property_tree::ptree_error &e) {
   }
 
+  try {
+    int window = getConfigValue<int, MediaElement> (KEY_FRAME_REQUEST_WINDOW);
+    GST_DEBUG ("Key frame request window configured to %d ms", window);
+    g_object_set (G_OBJECT (element), "key-frame-request-window", window, NULL);
+  } catch (boost::property_tree::ptree_error &e) {
+  }
+
+  try {
+    int gopCacheSize = getConfigValue<int, MediaElement> (GOP_CACHE_SIZE);
+    GST_DEBUG ("GOP cache configured to %d buffers", gopCacheSize);
+    g_object_set (G_OBJECT (element), "gop-cache-size", gopCacheSize, NULL);
+  } catch (boost::property_tree::ptree_error &e) {
+  }
+
+}
+
+void
+MediaElementImpl::configureElementPools (const std::string &factoryName)
+{
+  static std::mutex mutex;
+  static std::set<std::string> configured;
+  std::vector<std::string> names = {factoryName, AGNOSTICBIN_FACTORY};
+  std::unique_lock<std::mutex> lock (mutex);
+
+  /* Idle elements are built in background once a factory is first used */
+  for (auto &name : names) {
+    if (!configured.insert (name).second) {
+      continue;
+    }
+
+    int poolSize = getConfigValue<int, MediaElement> (ELEMENT_POOL "." + name,
+                   0);
+
+    if (poolSize > 0) {
+      kms_element_pool_set_size (name.c_str(), poolSize);
+    }
+  }
 }
 
 MediaElementImpl::~MediaElementImpl ()
@@ -375,9 +423,10 @@ MediaElementImpl::~MediaElementImpl ()
 
   GST_LOG ("Deleting media element %s", getName().c_str () );
 
-  disconnectAll();
-
   pipe = std::dynamic_pointer_cast<MediaPipelineImpl> (getMediaPipeline() );
+  pipe->cancelElementOperations (element);
+
+  disconnectAll();
 
   gst_element_send_event (element, gst_event_new_eos () );
   gst_element_set_locked_state (element, TRUE);
@@ -398,8 +447,67 @@ MediaElementImpl::release ()
   MediaObjectImpl::release();
 }
 
+void
+MediaElementImpl::whenReady (std::shared_ptr<MediaElement> peer,
+                             std::function<void () > op)
+{
+  std::shared_ptr<MediaPipelineImpl> pipe;
+  std::shared_ptr<MediaElementImpl> peerImpl;
+  std::vector<GstElement *> elements;
+  std::weak_ptr<MediaObjectImpl> wself;
+
+  pipe = std::dynamic_pointer_cast<MediaPipelineImpl> (getMediaPipeline() );
+  peerImpl = std::dynamic_pointer_cast<MediaElementImpl> (peer);
+  elements.push_back (element);
+
+  if (peerImpl && peerImpl->element != element) {
+    elements.push_back (peerImpl->element);
+  }
+
+  if (pipe->areElementsReady (elements) ) {
+    op ();
+    return;
+  }
+
+  GST_DEBUG ("Queuing operation on %s until it is ready", getName().c_str () );
+  wself = shared_from_this ();
+  pipe->postElementOperation (elements, [wself, op] () {
+    std::shared_ptr<MediaObjectImpl> self = wself.lock ();
+
+    if (self) {
+      op ();
+    }
+  }, [wself] (const std::string & message) {
+    std::shared_ptr<MediaObjectImpl> self = wself.lock ();
+
+    /* The request already returned, report through an error event */
+    if (!self) {
+      GST_WARNING ("Deferred operation failed: %s", message.c_str () );
+      return;
+    }
+
+    try {
+      Error error (self, message, CONNECT_ERROR, "CONNECT_ERROR");
+
+      self->signalError (error);
+    } catch (std::bad_weak_ptr &e) {
+    }
+  });
+}
+
+void
+MediaElementImpl::waitReady ()
+{
+  std::shared_ptr<MediaPipelineImpl> pipe;
+
+  pipe = std::dynamic_pointer_cast<MediaPipelineImpl> (getMediaPipeline() );
+  pipe->waitElementOperations (element);
+}
+
 void MediaElementImpl::disconnectAll ()
 {
+  waitReady ();
+
   while (!getSinkConnections().empty() ) {
     std::unique_lock<std::recursive_timed_mutex> sinkLock (sinksMutex,
         std::defer_lock);
@@ -416,7 +524,7 @@ void MediaElementImpl::disconnectAll ()
           std::defer_lock);
 
       if (sinkLock.try_lock_for (std::chrono::milliseconds {dist (rnd) }) ) {
-        disconnect (connData->getSink (), connData->getType (),
+        disconnectNow (connData->getSink (), connData->getType (),
                     connData->getSourceDescription (),
                     connData->getSinkDescription () );
       }
@@ -444,7 +552,7 @@ void MediaElementImpl::disconnectAll ()
           std::defer_lock);
 
       if (sourceLock.try_lock_for (std::chrono::milliseconds {dist (rnd) }) ) {
-        connData->getSource ()->disconnect (connData->getSink (),
+        sourceImpl->disconnectNow (connData->getSink (),
                                             connData->getType (),
                                             connData->getSourceDescription (),
                                             connData->getSinkDescription () );
@@ -611,8 +719,6 @@ void MediaElementImpl::connect (std::shared_ptr<MediaElement> sink,
                                 const std::string &sourceMediaDescription,
                                 const std::string &sinkMediaDescription)
 {
-  KmsElementPadType type;
-  gchar *padName;
   std::shared_ptr<MediaElementImpl> sinkImpl =
     std::dynamic_pointer_cast<MediaElementImpl> (sink);
 
@@ -621,6 +727,21 @@ void MediaElementImpl::connect (std::shared_ptr<MediaElement> sink,
                             "Media elements does not share pipeline");
   }
 
+  whenReady (sink, [this, sink, mediaType, sourceMediaDescription,
+  sinkMediaDescription] () {
+    connectNow (sink, mediaType, sourceMediaDescription, sinkMediaDescription);
+  });
+}
+
+void MediaElementImpl::connectNow (std::shared_ptr<MediaElement> sink,
+                                   std::shared_ptr<MediaType> mediaType,
+                                   const std::string &sourceMediaDescription,
+                                   const std::string &sinkMediaDescription)
+{
+  KmsElementPadType type;
+  gchar *padName;
+  std::shared_ptr<MediaElementImpl> sinkImpl =
+    std::dynamic_pointer_cast<MediaElementImpl> (sink);
   std::unique_lock<std::recursive_timed_mutex> lock (sinksMutex);
   std::unique_lock<std::recursive_timed_mutex> sinkLock (sinkImpl->sourcesMutex);
   std::vector <std::shared_ptr <ElementConnectionData>> connections;
@@ -638,9 +759,12 @@ void MediaElementImpl::connect (std::shared_ptr<MediaElement> sink,
 
   if (!connections.empty () ) {
     std::shared_ptr <ElementConnectionData> connection = connections.at (0);
-    connection->getSource()->disconnect (connection->getSink (), mediaType,
-                                         sourceMediaDescription,
-                                         connection->getSinkDescription () );
+    std::shared_ptr<MediaElementImpl> sourceImpl =
+      std::dynamic_pointer_cast<MediaElementImpl> (connection->getSource() );
+
+    sourceImpl->disconnectNow (connection->getSink (), mediaType,
+                               sourceMediaDescription,
+                               connection->getSinkDescription () );
   }
 
   type = convertMediaType (mediaType);
@@ -741,6 +865,17 @@ void MediaElementImpl::disconnect (std::shared_ptr<MediaElement> sink,
                                    std::shared_ptr<MediaType> mediaType,
                                    const std::string &sourceMediaDescription,
                                    const std::string &sinkMediaDescription)
+{
+  whenReady (sink, [this, sink, mediaType, sourceMediaDescription,
+  sinkMediaDescription] () {
+    disconnectNow (sink, mediaType, sourceMediaDescription, sinkMediaDescription);
+  });
+}
+
+void MediaElementImpl::disconnectNow (std::shared_ptr<MediaElement> sink,
+                                      std::shared_ptr<MediaType> mediaType,
+                                      const std::string &sourceMediaDescription,
+                                      const std::string &sinkMediaDescription)
 {
   if (!sink) {
     GST_WARNING ("Sink not available while disconnecting");
@@ -934,6 +1069,9 @@ MediaElementImpl::fillStatsReport (std::map
 {
   std::shared_ptr<Stats> elementStats;
   guint64 input_video, input_audio;
+  guint64 requested_kf = 0, forwarded_kf = 0, injected = 0;
+  guint64 increases = 0, decreases = 0, below_threshold = 0, rate_limited = 0;
+  guint64 ramped = 0;
   const GValue *value;
 
   value = gst_structure_get_value (stats, KMS_MEDIA_ELEMENT_FIELD);
@@ -957,17 +1095,34 @@ MediaElementImpl::fillStatsReport (std::map
   /* Get common element base parameters */
   gst_structure_get (gst_value_get_structure (value), "input-video-latency",
                      G_TYPE_UINT64, &input_video, "input-audio-latency", G_TYPE_UINT64,
-                     &input_audio, NULL);
+                     &input_audio, "requested-key-frames", G_TYPE_UINT64,
+                     &requested_kf, "forwarded-key-frames", G_TYPE_UINT64, &forwarded_kf,
+                     "injected-buffers", G_TYPE_UINT64, &injected,
+                     "bitrate-increases", G_TYPE_UINT64, &increases,
+                     "bitrate-decreases", G_TYPE_UINT64, &decreases,
+                     "bitrate-below-threshold", G_TYPE_UINT64, &below_threshold,
+                     "bitrate-rate-limited", G_TYPE_UINT64, &rate_limited,
+                     "bitrate-ramped", G_TYPE_UINT64, &ramped, NULL);
 
   if (report.find (getId () ) != report.end() ) {
     std::shared_ptr<ElementStats> eStats =
       std::dynamic_pointer_cast <ElementStats> (report[getId ()]);
     eStats->setInputAudioLatency (input_audio);
     eStats->setInputVideoLatency (input_video);
+    eStats->setRequestedKeyFrames (requested_kf);
+    eStats->setForwardedKeyFrames (forwarded_kf);
+    eStats->setInjectedBuffers (injected);
+    eStats->setBitrateIncreases (increases);
+    eStats->setBitrateDecreases (decreases);
+    eStats->setBitrateBelowThreshold (below_threshold);
+    eStats->setBitrateRateLimited (rate_limited);
+    eStats->setBitrateRamped (ramped);
   } else {
     elementStats = std::make_shared <ElementStats> (getId (),
                    std::make_shared <StatsType> (StatsType::element), timestamp,
-                   input_audio, input_video);
+                   input_audio, input_video, requested_kf, forwarded_kf,
+                   injected, increases, decreases, below_threshold, rate_limited,
+                   ramped);
     report[getId ()] = elementStats;
   }
 }
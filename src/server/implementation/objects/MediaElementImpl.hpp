@@ -6,6 +6,7 @@
 #include "MediaType.hpp"
 #include <EventHandler.hpp>
 #include <gst/gst.h>
+#include <functional>
 #include <mutex>
 #include <set>
 #include <random>
@@ -132,7 +133,19 @@ private:
 
   gulong padAddedHandlerId;
 
+  void configureElementPools (const std::string &factoryName);
   void disconnectAll();
+  void whenReady (std::shared_ptr<MediaElement> peer,
+                  std::function<void () > op);
+  void waitReady ();
+  void connectNow (std::shared_ptr<MediaElement> sink,
+                   std::shared_ptr<MediaType> mediaType,
+                   const std::string &sourceMediaDescription,
+                   const std::string &sinkMediaDescription);
+  void disconnectNow (std::shared_ptr<MediaElement> sink,
+                      std::shared_ptr<MediaType> mediaType,
+                      const std::string &sourceMediaDescription,
+                      const std::string &sinkMediaDescription);
   void performConnection (std::shared_ptr <ElementConnectionDataInternal> data);
   std::map <std::string, std::shared_ptr<Stats>> generateStats (
         const gchar *selector);
@@ -8,6 +8,7 @@
 #include <GstreamerDotDetails.hpp>
 #include <SignalHandler.hpp>
 #include <commons/kmselement.h>
+#include <algorithm>
 
 #define GST_CAT_DEFAULT kurento_media_pipeline_impl
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -69,7 +70,7 @@ void MediaPipelineImpl::postConstructor ()
 }
 
 MediaPipelineImpl::MediaPipelineImpl (const boost::property_tree::ptree &config)
-  : MediaObjectImpl (config)
+  : MediaObjectImpl (config), operations (new ElementOperationQueue () )
 {
   GstClock *clock;
 
@@ -92,6 +93,32 @@ MediaPipelineImpl::MediaPipelineImpl (const boost::property_tree::ptree &config)
 MediaPipelineImpl::~MediaPipelineImpl ()
 {
   GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline) );
+  std::unique_lock <std::mutex> lock (operations->mutex);
+  std::deque<ElementOperation> dropped;
+
+  operations->terminated = true;
+  operations->cond.notify_all ();
+  lock.unlock ();
+
+  if (operationsThread.joinable () ) {
+    if (std::this_thread::get_id () != operationsThread.get_id () ) {
+      operationsThread.join ();
+    } else {
+      /* Destroyed from an operation, the thread holds its own reference to
+       * the queue and finishes once the operation returns */
+      operationsThread.detach ();
+    }
+  }
+
+  /* Operations still queued will never run, let their issuers know */
+  lock.lock ();
+  dropped.swap (operations->operations);
+  operations->pending.clear ();
+  lock.unlock ();
+
+  for (ElementOperation &op : dropped) {
+    op.fail ("Media pipeline released before the operation could run");
+  }
 
   if (busMessageHandler > 0) {
     unregister_signal_handler (bus, busMessageHandler);
@@ -182,9 +209,10 @@ MediaPipelineImpl::setLatencyStats (bool latencyStats)
 }
 
 bool
-MediaPipelineImpl::addElement (GstElement *element)
+MediaPipelineImpl::addElement (GstElement *element, bool asyncStateSync)
 {
   std::unique_lock <std::recursive_mutex> lock (recMutex);
+  ElementOperation syncOp;
   bool ret;
 
   if (KMS_IS_ELEMENT (element) ) {
@@ -193,13 +221,193 @@ MediaPipelineImpl::addElement (GstElement *element)
 
   ret = gst_bin_add (GST_BIN (pipeline), element);
 
-  if (ret) {
+  if (!ret) {
+    return ret;
+  }
+
+  if (!asyncStateSync) {
     gst_element_sync_state_with_parent (element);
+    return ret;
+  }
+
+  /* The caller gets the element back right away, state is synchronized by
+   * the operations thread. Anything posted meanwhile runs after it */
+  std::unique_lock <std::mutex> opsLock (operations->mutex);
+
+  if (!operationsThread.joinable () ) {
+    operationsThread = std::thread (&MediaPipelineImpl::runElementOperations,
+                                    operations);
   }
 
+  syncOp.elements.push_back (element);
+  syncOp.run = [element] () {
+    GST_DEBUG ("Synchronizing state of %" GST_PTR_FORMAT, element);
+    gst_element_sync_state_with_parent (element);
+  };
+  syncOp.fail = [] (const std::string & error) {
+    GST_WARNING ("Element state not synchronized: %s", error.c_str () );
+  };
+  operations->queue (std::move (syncOp) );
+
   return ret;
 }
 
+void
+MediaPipelineImpl::ElementOperationQueue::queue (ElementOperation op)
+{
+  for (GstElement *element : op.elements) {
+    pending[element]++;
+  }
+
+  operations.push_back (std::move (op) );
+  cond.notify_all ();
+}
+
+void
+MediaPipelineImpl::ElementOperationQueue::release (const
+    std::vector<GstElement *> &elements)
+{
+  for (GstElement *element : elements) {
+    auto it = pending.find (element);
+
+    if (it != pending.end () && --it->second == 0) {
+      pending.erase (it);
+    }
+  }
+}
+
+bool
+MediaPipelineImpl::areElementsReady (const std::vector<GstElement *>
+                                     &elements)
+{
+  std::unique_lock <std::mutex> lock (operations->mutex);
+
+  for (GstElement *element : elements) {
+    if (operations->pending.find (element) != operations->pending.end () ) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void
+MediaPipelineImpl::postElementOperation (const std::vector<GstElement *>
+    &elements, std::function<void () > op,
+    std::function<void (const std::string &) > fail)
+{
+  std::unique_lock <std::mutex> lock (operations->mutex);
+
+  for (GstElement *element : elements) {
+    if (operations->pending.find (element) != operations->pending.end () ) {
+      /* Queued operations run in order, so this one runs after whatever is
+       * still pending on any of the elements */
+      operations->queue (ElementOperation {elements, op, fail});
+      return;
+    }
+  }
+
+  lock.unlock ();
+  op ();
+}
+
+void
+MediaPipelineImpl::waitElementOperations (GstElement *element)
+{
+  std::shared_ptr<ElementOperationQueue> queue = operations;
+  std::unique_lock <std::mutex> lock (queue->mutex);
+
+  if (std::this_thread::get_id () == operationsThread.get_id () ) {
+    /* Operations are run in order, waiting from here would never end */
+    return;
+  }
+
+  queue->cond.wait (lock, [queue, element] () {
+    return queue->terminated
+           || queue->pending.find (element) == queue->pending.end ();
+  });
+}
+
+void
+MediaPipelineImpl::cancelElementOperations (GstElement *element)
+{
+  std::unique_lock <std::mutex> lock (operations->mutex);
+  std::deque<ElementOperation> dropped;
+
+  if (std::this_thread::get_id () != operationsThread.get_id () ) {
+    lock.unlock ();
+    waitElementOperations (element);
+    return;
+  }
+
+  /* The element is being destroyed from one of the queued operations, its
+   * remaining ones are failed instead of run */
+  for (auto it = operations->operations.begin ();
+       it != operations->operations.end ();) {
+    if (std::find (it->elements.begin (), it->elements.end (),
+                   element) == it->elements.end () ) {
+      ++it;
+      continue;
+    }
+
+    operations->release (it->elements);
+    dropped.push_back (std::move (*it) );
+    it = operations->operations.erase (it);
+  }
+
+  operations->pending.erase (element);
+  operations->running.erase (std::remove (operations->running.begin (),
+                                          operations->running.end (), element),
+                             operations->running.end () );
+  lock.unlock ();
+
+  for (ElementOperation &op : dropped) {
+    op.fail ("Media element released before the operation could run");
+  }
+}
+
+void
+MediaPipelineImpl::runElementOperations (std::shared_ptr<ElementOperationQueue>
+    queue)
+{
+  std::unique_lock <std::mutex> lock (queue->mutex);
+
+  while (!queue->terminated) {
+    ElementOperation op;
+
+    if (queue->operations.empty () ) {
+      queue->cond.wait (lock);
+      continue;
+    }
+
+    op = std::move (queue->operations.front () );
+    queue->operations.pop_front ();
+    queue->running = op.elements;
+    lock.unlock ();
+
+    try {
+      op.run ();
+    } catch (KurentoException &e) {
+      GST_WARNING ("Error in deferred operation: %s", e.what () );
+      op.fail (e.getMessage () );
+    } catch (std::exception &e) {
+      GST_WARNING ("Error in deferred operation: %s", e.what () );
+      op.fail (e.what () );
+    } catch (...) {
+      GST_WARNING ("Unexpected error in deferred operation");
+      op.fail ("Unexpected error");
+    }
+
+    /* Captured references may be the last ones to the pipeline */
+    op = ElementOperation ();
+    lock.lock ();
+
+    queue->release (queue->running);
+    queue->running.clear ();
+    queue->cond.notify_all ();
+  }
+}
+
 MediaObjectImpl *
 MediaPipelineImplFactory::createObject (const boost::property_tree::ptree &pt)
 const
@@ -6,6 +6,12 @@
 #include <EventHandler.hpp>
 #include <gst/gst.h>
 #include <boost/property_tree/ptree.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace kurento
 {
@@ -46,7 +52,14 @@ public:
 
   virtual void Serialize (JsonSerializer &serializer);
 
-  bool addElement (GstElement *element);
+  bool addElement (GstElement *element, bool asyncStateSync = false);
+
+  bool areElementsReady (const std::vector<GstElement *> &elements);
+  void postElementOperation (const std::vector<GstElement *> &elements,
+                             std::function<void () > op,
+                             std::function<void (const std::string &) > fail);
+  void waitElementOperations (GstElement *element);
+  void cancelElementOperations (GstElement *element);
 
 protected:
   virtual void postConstructor ();
@@ -61,6 +74,36 @@ private:
 
   void busMessage (GstMessage *message);
 
+  /* Operations on elements whose state is still being synchronized. Each
+   * one is pending on every element it involves and reports failures
+   * through its fail callback */
+  struct ElementOperation {
+    std::vector<GstElement *> elements;
+    std::function<void () > run;
+    std::function<void (const std::string &) > fail;
+  };
+
+  /* Shared with the operations thread, which keeps it alive on its own.
+   * An operation may drop the last reference to the pipeline, so the
+   * thread must not touch the pipeline once the operation returns */
+  struct ElementOperationQueue {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<ElementOperation> operations;
+    std::unordered_map<GstElement *, int> pending;
+    std::vector<GstElement *> running;
+    bool terminated = false;
+
+    void queue (ElementOperation op);
+    void release (const std::vector<GstElement *> &elements);
+  };
+
+  std::shared_ptr<ElementOperationQueue> operations;
+  std::thread operationsThread;
+
+  static void runElementOperations (std::shared_ptr<ElementOperationQueue>
+                                    queue);
+
   class StaticConstructor
   {
   public:
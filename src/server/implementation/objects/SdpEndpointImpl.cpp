@@ -5,6 +5,7 @@
 #include <gst/gst.h>
 #include <boost/filesystem.hpp>
 #include <fstream>
+#include <mutex>
 #include <CodecConfiguration.hpp>
 #include <gst/sdp/gstsdpmessage.h>
 
@@ -70,6 +71,13 @@ append_codec_to_array (GArray *array, const char *codec)
   g_array_append_val (array, v);
 }
 
+/* Codec lists are read from the configuration by the first endpoint and
+ * kept for the life of the process. Configuration is only loaded at start
+ * up, so changes to it need a restart to be seen here as anywhere else */
+static std::once_flag codecsOnce;
+static std::vector<std::string> audioCodecNames;
+static std::vector<std::string> videoCodecNames;
+
 SdpEndpointImpl::SdpEndpointImpl (const boost::property_tree::ptree &config,
                                   std::shared_ptr< MediaObjectImpl > parent,
                                   const std::string &factoryName) :
@@ -88,26 +96,30 @@ SdpEndpointImpl::SdpEndpointImpl (const boost::property_tree::ptree &config,
   audio_medias = getConfigValue <guint, SdpEndpoint> (PARAM_NUM_AUDIO_MEDIAS, 1);
   video_medias = getConfigValue <guint, SdpEndpoint> (PARAM_NUM_VIDEO_MEDIAS, 1);
 
-  {
-    std::vector<std::shared_ptr<CodecConfiguration>> list = getConfigValue
-        <std::vector<std::shared_ptr<CodecConfiguration>>, SdpEndpoint>
-        (PARAM_AUDIO_CODECS);
+  std::call_once (codecsOnce, [this] () {
+    std::vector<std::shared_ptr<CodecConfiguration>> list;
 
-    for (std::shared_ptr<CodecConfiguration> conf : list) {
+    list = getConfigValue <std::vector<std::shared_ptr<CodecConfiguration>>,
+    SdpEndpoint> (PARAM_AUDIO_CODECS);
 
-      append_codec_to_array (audio_codecs, conf->getName().c_str() );
+    for (std::shared_ptr<CodecConfiguration> conf : list) {
+      audioCodecNames.push_back (conf->getName() );
     }
-  }
 
-  {
-    std::vector<std::shared_ptr<CodecConfiguration>> list = getConfigValue
-        <std::vector<std::shared_ptr<CodecConfiguration>>, SdpEndpoint>
-        (PARAM_VIDEO_CODECS);
+    list = getConfigValue <std::vector<std::shared_ptr<CodecConfiguration>>,
+    SdpEndpoint> (PARAM_VIDEO_CODECS);
 
     for (std::shared_ptr<CodecConfiguration> conf : list) {
-
-      append_codec_to_array (video_codecs, conf->getName().c_str() );
+      videoCodecNames.push_back (conf->getName() );
     }
+  });
+
+  for (const std::string &name : audioCodecNames) {
+    append_codec_to_array (audio_codecs, name.c_str() );
+  }
+
+  for (const std::string &name : videoCodecNames) {
+    append_codec_to_array (video_codecs, name.c_str() );
   }
 
   g_object_set (element, "num-audio-medias", audio_medias, "audio-codecs",
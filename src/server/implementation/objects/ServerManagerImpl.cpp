@@ -8,6 +8,7 @@
 #include <KurentoException.hpp>
 #include <MediaSet.hpp>
 #include <boost/property_tree/json_parser.hpp>
+#include "kmselementpool.h"
 
 #define GST_CAT_DEFAULT kurento_server_manager_impl
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -85,6 +86,41 @@ std::string ServerManagerImpl::getKmd (const std::string &moduleName)
                           "Requested kmd module doesn't exist");
 }
 
+static gboolean
+poolStatsFieldToJson (GQuark fieldId, const GValue *value, gpointer data)
+{
+  Json::Value *json = static_cast<Json::Value *> (data);
+  const gchar *name = g_quark_to_string (fieldId);
+
+  if (G_VALUE_HOLDS_UINT (value) ) {
+    (*json) [name] = g_value_get_uint (value);
+  } else if (G_VALUE_HOLDS_UINT64 (value) ) {
+    (*json) [name] = (Json::UInt64) g_value_get_uint64 (value);
+  } else if (G_VALUE_HOLDS_DOUBLE (value) ) {
+    (*json) [name] = g_value_get_double (value);
+  } else if (GST_VALUE_HOLDS_STRUCTURE (value) ) {
+    Json::Value child;
+
+    gst_structure_foreach (gst_value_get_structure (value),
+                           poolStatsFieldToJson, &child);
+    (*json) [name] = child;
+  }
+
+  return TRUE;
+}
+
+std::string ServerManagerImpl::getElementPoolStats ()
+{
+  GstStructure *stats = kms_element_pool_get_stats ();
+  Json::Value json (Json::objectValue);
+  Json::FastWriter writer;
+
+  gst_structure_foreach (stats, poolStatsFieldToJson, &json);
+  gst_structure_free (stats);
+
+  return writer.write (json);
+}
+
 ServerManagerImpl::StaticConstructor ServerManagerImpl::staticConstructor;
 
 ServerManagerImpl::StaticConstructor::StaticConstructor()
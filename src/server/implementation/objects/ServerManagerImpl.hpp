@@ -42,6 +42,8 @@ public:
 
   std::string getKmd (const std::string &moduleName);
 
+  std::string getElementPoolStats ();
+
   virtual std::shared_ptr<ServerInfo> getInfo ();
 
   virtual std::vector<std::shared_ptr<MediaPipeline>> getPipelines ();
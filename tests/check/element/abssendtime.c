@@ -0,0 +1,219 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsutils.h"
+
+#define EXT_ID 3
+#define EXT_SIZE 3
+#define LIST_SIZE 8
+
+static GstBufferList *received;
+
+static GstFlowReturn
+sink_chain_list_function (GstPad * pad, GstObject * parent,
+    GstBufferList * list)
+{
+  if (received != NULL) {
+    gst_buffer_list_unref (received);
+  }
+
+  received = list;
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+sink_chain_function (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstBufferList *list = gst_buffer_list_new ();
+
+  gst_buffer_list_add (list, buffer);
+
+  return sink_chain_list_function (pad, parent, list);
+}
+
+static void
+setup_pads (GstPad ** srcpad, GstPad ** sinkpad)
+{
+  GstSegment segment;
+
+  *srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  *sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function (*sinkpad, sink_chain_function);
+  gst_pad_set_chain_list_function (*sinkpad, sink_chain_list_function);
+  fail_unless (gst_pad_link (*srcpad, *sinkpad) == GST_PAD_LINK_OK);
+  gst_pad_set_active (*srcpad, TRUE);
+  gst_pad_set_active (*sinkpad, TRUE);
+
+  gst_pad_push_event (*srcpad, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (*srcpad, gst_event_new_segment (&segment));
+
+  kms_utils_add_abs_send_time_probe (*srcpad, EXT_ID);
+}
+
+static void
+teardown_pads (GstPad * srcpad, GstPad * sinkpad)
+{
+  gst_pad_set_active (srcpad, FALSE);
+  gst_pad_set_active (sinkpad, FALSE);
+  g_object_unref (srcpad);
+  g_object_unref (sinkpad);
+
+  if (received != NULL) {
+    gst_buffer_list_unref (received);
+    received = NULL;
+  }
+}
+
+/* Returns the stamped value and checks the extension is there only once */
+static guint32
+get_abs_send_time (GstBuffer * buffer)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  gpointer data;
+  guint size;
+  guint8 *bytes;
+  guint32 value;
+
+  fail_unless (gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp));
+  fail_unless (gst_rtp_buffer_get_extension_onebyte_header (&rtp, EXT_ID, 0,
+          &data, &size));
+  fail_unless (size == EXT_SIZE);
+  fail_if (gst_rtp_buffer_get_extension_onebyte_header (&rtp, EXT_ID, 1,
+          &data, &size));
+
+  gst_rtp_buffer_get_extension_onebyte_header (&rtp, EXT_ID, 0, &data, &size);
+  bytes = data;
+  value = (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+  gst_rtp_buffer_unmap (&rtp);
+
+  return value;
+}
+
+static void
+check_in_range (guint32 value, GstClockTime before, GstClockTime after)
+{
+  guint32 first = kms_utils_get_abs_send_time (before);
+  guint32 last = kms_utils_get_abs_send_time (after);
+
+  if (first <= last) {
+    fail_unless (value >= first && value <= last);
+  } else {
+    /* The 24 bits counter wrapped in between */
+    fail_unless (value >= first || value <= last);
+  }
+}
+
+GST_START_TEST (abs_send_time_value)
+{
+  fail_unless (kms_utils_get_abs_send_time (0) == 0);
+  fail_unless (kms_utils_get_abs_send_time (GST_SECOND) == 1 << 18);
+  fail_unless (kms_utils_get_abs_send_time (GST_SECOND / 2) == 1 << 17);
+  fail_unless (kms_utils_get_abs_send_time (GST_SECOND + GST_MSECOND / 2)
+      == 1 << 18);
+  /* 6.18 fixed point seconds wrap every 64 seconds */
+  fail_unless (kms_utils_get_abs_send_time (64 * GST_SECOND) == 0);
+}
+
+GST_END_TEST
+GST_START_TEST (list_shares_send_time)
+{
+  GstPad *srcpad, *sinkpad;
+  GstBufferList *list;
+  GstClockTime before, after;
+  guint32 value;
+  guint i;
+
+  setup_pads (&srcpad, &sinkpad);
+
+  list = gst_buffer_list_new_sized (LIST_SIZE);
+  for (i = 0; i < LIST_SIZE; i++) {
+    gst_buffer_list_add (list, gst_rtp_buffer_new_allocate (100, 0, 0));
+  }
+
+  before = kms_utils_get_time_nsecs ();
+  fail_unless (gst_pad_push_list (srcpad, list) == GST_FLOW_OK);
+  after = kms_utils_get_time_nsecs ();
+
+  fail_unless (received != NULL);
+  fail_unless (gst_buffer_list_length (received) == LIST_SIZE);
+
+  value = get_abs_send_time (gst_buffer_list_get (received, 0));
+  check_in_range (value, before, after);
+
+  for (i = 1; i < LIST_SIZE; i++) {
+    fail_unless (get_abs_send_time (gst_buffer_list_get (received, i)) ==
+        value);
+  }
+
+  teardown_pads (srcpad, sinkpad);
+}
+
+GST_END_TEST
+GST_START_TEST (restamp_in_place)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  guint8 stale[EXT_SIZE] = { 0xff, 0xff, 0xff };
+  GstPad *srcpad, *sinkpad;
+  GstBuffer *buffer;
+  GstClockTime before, after;
+
+  setup_pads (&srcpad, &sinkpad);
+
+  /* A retransmitted packet already carries the extension */
+  buffer = gst_rtp_buffer_new_allocate (100, 0, 0);
+  fail_unless (gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp));
+  fail_unless (gst_rtp_buffer_add_extension_onebyte_header (&rtp, EXT_ID,
+          stale, EXT_SIZE));
+  gst_rtp_buffer_unmap (&rtp);
+
+  before = kms_utils_get_time_nsecs ();
+  fail_unless (gst_pad_push (srcpad, buffer) == GST_FLOW_OK);
+  after = kms_utils_get_time_nsecs ();
+
+  fail_unless (received != NULL);
+  check_in_range (get_abs_send_time (gst_buffer_list_get (received, 0)),
+      before, after);
+
+  teardown_pads (srcpad, sinkpad);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+abssendtime_suite (void)
+{
+  Suite *s = suite_create ("abssendtime");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, abs_send_time_value);
+  tcase_add_test (tc_chain, list_shares_send_time);
+  tcase_add_test (tc_chain, restamp_in_place);
+
+  return s;
+}
+
+GST_CHECK_MAIN (abssendtime);
@@ -971,6 +971,382 @@ GST_START_TEST (h264_encoding_odd_dimension)
   g_main_loop_unref (loop);
 }
 
+GST_END_TEST
+static void
+shared_convert_hand_off (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    gpointer pipeline)
+{
+  gint *pending = g_object_get_data (G_OBJECT (pipeline), COUNT_KEY);
+
+  g_object_set (G_OBJECT (fakesink), "signal-handoffs", FALSE, NULL);
+
+  if (g_atomic_int_dec_and_test (pending)) {
+    g_idle_add (quit_main_loop_idle, loop);
+  }
+}
+
+static guint
+count_elements_by_factory (GstBin * bin, const gchar * factory_name)
+{
+  GstIterator *it = gst_bin_iterate_recurse (bin);
+  GValue item = G_VALUE_INIT;
+  gboolean done = FALSE;
+  guint count = 0;
+
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstElementFactory *factory =
+            gst_element_get_factory (g_value_get_object (&item));
+
+        if (factory != NULL &&
+            g_strcmp0 (GST_OBJECT_NAME (factory), factory_name) == 0) {
+          count++;
+        }
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        gst_iterator_resync (it);
+        count = 0;
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return count;
+}
+
+GST_START_TEST (shared_raw_conversion)
+{
+  GstElement *pipeline =
+      gst_parse_launch
+      ("videotestsrc is-live=true ! agnosticbin name=agnosticbin "
+      "agnosticbin. ! video/x-vp8 ! fakesink name=vp8sink async=false "
+      "agnosticbin. ! video/x-h264 ! fakesink name=h264sink async=false",
+      NULL);
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  GstElement *agnosticbin, *vp8sink, *h264sink;
+  gint *pending;
+
+  loop = g_main_loop_new (NULL, TRUE);
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), pipeline);
+
+  agnosticbin = gst_bin_get_by_name (GST_BIN (pipeline), "agnosticbin");
+  vp8sink = gst_bin_get_by_name (GST_BIN (pipeline), "vp8sink");
+  h264sink = gst_bin_get_by_name (GST_BIN (pipeline), "h264sink");
+
+  pending = g_malloc0 (sizeof (gint));
+  *pending = 2;
+  g_object_set_data_full (G_OBJECT (pipeline), COUNT_KEY, pending, g_free);
+
+  g_object_set (G_OBJECT (vp8sink), "signal-handoffs", TRUE, NULL);
+  g_signal_connect (G_OBJECT (vp8sink), "handoff",
+      G_CALLBACK (shared_convert_hand_off), pipeline);
+  g_object_set (G_OBJECT (h264sink), "signal-handoffs", TRUE, NULL);
+  g_signal_connect (G_OBJECT (h264sink), "handoff",
+      G_CALLBACK (shared_convert_hand_off), pipeline);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  mark_point ();
+  g_timeout_add_seconds (10, timeout_check, pipeline);
+  g_main_loop_run (loop);
+  mark_point ();
+
+  /* Both encoders take I420 at the source size, one conversion feeds them */
+  fail_unless_equals_int (count_elements_by_factory (GST_BIN (agnosticbin),
+          "videoconvert"), 1);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (agnosticbin);
+  g_object_unref (vp8sink);
+  g_object_unref (h264sink);
+  g_object_unref (bus);
+  g_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST
+GST_START_TEST (index_lookup)
+{
+  GstElement *pipeline =
+      gst_parse_launch
+      ("videotestsrc is-live=true ! vp8enc deadline=1 ! "
+      "agnosticbin name=agnosticbin "
+      "agnosticbin. ! video/x-vp8 ! fakesink name=vp8sink async=false "
+      "agnosticbin. ! video/x-raw ! fakesink name=rawsink1 async=false "
+      "agnosticbin. ! video/x-raw ! fakesink name=rawsink2 async=false",
+      NULL);
+  const gchar *sinks[] = { "vp8sink", "rawsink1", "rawsink2" };
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  GstElement *agnosticbin;
+  gint *pending;
+  guint i;
+
+  loop = g_main_loop_new (NULL, TRUE);
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), pipeline);
+
+  agnosticbin = gst_bin_get_by_name (GST_BIN (pipeline), "agnosticbin");
+
+  pending = g_malloc0 (sizeof (gint));
+  *pending = G_N_ELEMENTS (sinks);
+  g_object_set_data_full (G_OBJECT (pipeline), COUNT_KEY, pending, g_free);
+
+  for (i = 0; i < G_N_ELEMENTS (sinks); i++) {
+    GstElement *sink = gst_bin_get_by_name (GST_BIN (pipeline), sinks[i]);
+
+    g_object_set (G_OBJECT (sink), "signal-handoffs", TRUE, NULL);
+    g_signal_connect (G_OBJECT (sink), "handoff",
+        G_CALLBACK (shared_convert_hand_off), pipeline);
+    g_object_unref (sink);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  mark_point ();
+  g_timeout_add_seconds (10, timeout_check, pipeline);
+  g_main_loop_run (loop);
+  mark_point ();
+
+  /* VP8 output is found in the input bin, raw outputs share one decoder */
+  fail_unless_equals_int (count_elements_by_factory (GST_BIN (agnosticbin),
+          "vp8enc"), 0);
+  fail_unless_equals_int (count_elements_by_factory (GST_BIN (agnosticbin),
+          "vp8dec"), 1);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (agnosticbin);
+  g_object_unref (bus);
+  g_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST
+static GstElement *
+find_element_by_factory (GstBin * bin, const gchar * factory_name)
+{
+  GstIterator *it = gst_bin_iterate_recurse (bin);
+  GValue item = G_VALUE_INIT;
+  GstElement *found = NULL;
+  gboolean done = FALSE;
+
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstElement *element = g_value_get_object (&item);
+        GstElementFactory *factory = gst_element_get_factory (element);
+
+        if (factory != NULL &&
+            g_strcmp0 (GST_OBJECT_NAME (factory), factory_name) == 0) {
+          found = element;
+          done = TRUE;
+        }
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        gst_iterator_resync (it);
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return found;
+}
+
+typedef struct _IdleTreeData
+{
+  GstElement *agnosticbin;
+  GstElement *filter;
+  GstElement *fakesink;
+  GstPad *pad;
+  GstElement *encoder;
+  gint encoded;
+  gint last_encoded;
+  gboolean key_frame;
+  gint step;
+} IdleTreeData;
+
+static void
+idle_tree_link_output (IdleTreeData * data)
+{
+  GstPad *sink = gst_element_get_static_pad (data->filter, "sink");
+
+  data->pad = gst_element_get_request_pad (data->agnosticbin, "src_%u");
+  fail_unless (gst_pad_link (data->pad, sink) == GST_PAD_LINK_OK);
+  g_object_unref (sink);
+
+  g_object_set (G_OBJECT (data->fakesink), "signal-handoffs", TRUE, NULL);
+}
+
+static void
+idle_tree_unlink_output (IdleTreeData * data)
+{
+  GstPad *sink = gst_element_get_static_pad (data->filter, "sink");
+
+  gst_pad_unlink (data->pad, sink);
+  gst_element_release_request_pad (data->agnosticbin, data->pad);
+  g_clear_object (&data->pad);
+  g_object_unref (sink);
+}
+
+static gboolean
+idle_tree_check_released (gpointer user_data)
+{
+  IdleTreeData *data = user_data;
+
+  fail_unless (find_element_by_factory (GST_BIN (data->agnosticbin),
+          "vp8enc") == NULL);
+  fail_unless (find_element_by_factory (GST_BIN (data->agnosticbin),
+          "videoconvert") == NULL);
+
+  g_main_loop_quit (loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn
+idle_tree_count_encoded (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  IdleTreeData *data = user_data;
+
+  g_atomic_int_inc (&data->encoded);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+idle_tree_wait_parked (gpointer user_data)
+{
+  IdleTreeData *data = user_data;
+  gint encoded = g_atomic_int_get (&data->encoded);
+
+  if (encoded != data->last_encoded) {
+    data->last_encoded = encoded;
+    return G_SOURCE_CONTINUE;
+  }
+
+  /* Encoder stopped receiving frames, the branch is parked but kept */
+  fail_unless (find_element_by_factory (GST_BIN (data->agnosticbin),
+          "vp8enc") == data->encoder);
+  idle_tree_link_output (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+idle_tree_next_step (gpointer user_data)
+{
+  IdleTreeData *data = user_data;
+  GstPad *sink;
+
+  switch (data->step++) {
+    case 0:
+      /* Viewer flaps, the encoder must be kept warm and reused */
+      data->encoder = find_element_by_factory (GST_BIN (data->agnosticbin),
+          "vp8enc");
+      fail_if (data->encoder == NULL);
+      sink = gst_element_get_static_pad (data->encoder, "sink");
+      gst_pad_add_probe (sink, GST_PAD_PROBE_TYPE_BUFFER,
+          idle_tree_count_encoded, data, NULL);
+      g_object_unref (sink);
+      idle_tree_unlink_output (data);
+      data->last_encoded = g_atomic_int_get (&data->encoded);
+      g_timeout_add (200, idle_tree_wait_parked, data);
+      break;
+    case 1:
+      fail_unless (find_element_by_factory (GST_BIN (data->agnosticbin),
+              "vp8enc") == data->encoder);
+      /* The reused branch starts the new output with a key frame */
+      fail_unless (data->key_frame);
+      /* Viewer leaves for longer than the timeout, the branch is released */
+      g_object_set (data->agnosticbin, "idle-tree-timeout", 100, NULL);
+      idle_tree_unlink_output (data);
+      g_timeout_add (1000, idle_tree_check_released, data);
+      break;
+    default:
+      break;
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+idle_tree_hand_off (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    gpointer user_data)
+{
+  IdleTreeData *data = user_data;
+
+  g_object_set (G_OBJECT (fakesink), "signal-handoffs", FALSE, NULL);
+  data->key_frame = !GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+  g_idle_add (idle_tree_next_step, data);
+}
+
+GST_START_TEST (idle_tree_reuse)
+{
+  GstElement *pipeline = gst_pipeline_new (__FUNCTION__);
+  GstElement *videotestsrc = gst_element_factory_make ("videotestsrc", NULL);
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  IdleTreeData data = { NULL, };
+  GstCaps *caps;
+
+  loop = g_main_loop_new (NULL, TRUE);
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), pipeline);
+
+  data.agnosticbin = gst_element_factory_make ("agnosticbin", NULL);
+  data.filter = gst_element_factory_make ("capsfilter", NULL);
+  data.fakesink = gst_element_factory_make ("fakesink", NULL);
+
+  g_object_set (G_OBJECT (videotestsrc), "is-live", TRUE, NULL);
+  g_object_set (G_OBJECT (data.fakesink), "async", FALSE, "sync", FALSE, NULL);
+  g_signal_connect (G_OBJECT (data.fakesink), "handoff",
+      G_CALLBACK (idle_tree_hand_off), &data);
+
+  caps = gst_caps_from_string ("video/x-vp8");
+  g_object_set (G_OBJECT (data.filter), "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (pipeline), videotestsrc, data.agnosticbin,
+      data.filter, data.fakesink, NULL);
+  fail_unless (gst_element_link (videotestsrc, data.agnosticbin));
+  fail_unless (gst_element_link (data.filter, data.fakesink));
+  idle_tree_link_output (&data);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  mark_point ();
+  g_timeout_add_seconds (10, timeout_check, pipeline);
+  g_main_loop_run (loop);
+  mark_point ();
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_clear_object (&data.pad);
+  g_object_unref (bus);
+  g_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
 GST_END_TEST
 /*
  * End of test cases
@@ -998,6 +1374,9 @@ agnostic2_suite (void)
   tcase_add_test (tc_chain, input_caps_reconfiguration);
   tcase_add_test (tc_chain, encoded_input_n_encoded_output);
   tcase_add_test (tc_chain, h264_encoding_odd_dimension);
+  tcase_add_test (tc_chain, shared_raw_conversion);
+  tcase_add_test (tc_chain, index_lookup);
+  tcase_add_test (tc_chain, idle_tree_reuse);
 
   return s;
 }
@@ -0,0 +1,282 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+
+#include "kmsbitratecontroller.h"
+
+#define INITIAL_BITRATE 300000
+
+static guint notified;
+static guint last_bitrate;
+
+static void
+bitrate_cb (KmsBitrateController * controller, guint bitrate,
+    gpointer user_data)
+{
+  notified++;
+  last_bitrate = bitrate;
+}
+
+static KmsBitrateController *
+create_controller (void)
+{
+  KmsBitrateController *controller;
+
+  notified = 0;
+  last_bitrate = 0;
+
+  controller = kms_bitrate_controller_new (INITIAL_BITRATE);
+  kms_bitrate_controller_set_callback (controller, bitrate_cb, NULL, NULL);
+  kms_bitrate_controller_set_thresholds (controller, 10, 5);
+  kms_bitrate_controller_set_ramps (controller, 0, 0);
+  kms_bitrate_controller_set_min_interval (controller, GST_SECOND);
+
+  return controller;
+}
+
+static guint64
+get_counter (KmsBitrateController * controller, const gchar * field)
+{
+  GstStructure *stats;
+  guint64 value;
+
+  stats = kms_bitrate_controller_get_stats (controller);
+  fail_unless (gst_structure_get_uint64 (stats, field, &value));
+  gst_structure_free (stats);
+
+  return value;
+}
+
+GST_START_TEST (small_changes_ignored)
+{
+  KmsBitrateController *controller = create_controller ();
+
+  /* 5% up and 2% down are under the thresholds */
+  kms_bitrate_controller_set_target (controller, 315000, 0);
+  kms_bitrate_controller_set_target (controller, 294000, 0);
+  fail_unless (notified == 0);
+  fail_unless (get_counter (controller, "below-threshold") == 2);
+
+  /* A 10% drop is over the down threshold */
+  kms_bitrate_controller_set_target (controller, 270000, 0);
+  fail_unless (notified == 1);
+  fail_unless (last_bitrate == 270000);
+  fail_unless (get_counter (controller, "decreases") == 1);
+
+  kms_bitrate_controller_unref (controller);
+}
+
+GST_END_TEST
+GST_START_TEST (updates_rate_limited)
+{
+  KmsBitrateController *controller = create_controller ();
+
+  kms_bitrate_controller_set_target (controller, 400000, 0);
+  fail_unless (notified == 1);
+
+  /* Too close to the previous update, kept as pending target */
+  kms_bitrate_controller_set_target (controller, 500000, GST_SECOND / 2);
+  fail_unless (notified == 1);
+  fail_unless (get_counter (controller, "rate-limited") == 1);
+
+  kms_bitrate_controller_tick (controller, GST_SECOND / 2 + 1);
+  fail_unless (notified == 1);
+
+  kms_bitrate_controller_tick (controller, GST_SECOND);
+  fail_unless (notified == 2);
+  fail_unless (last_bitrate == 500000);
+  fail_unless (kms_bitrate_controller_get_bitrate (controller) == 500000);
+
+  /* Nothing pending, ticks do not notify */
+  kms_bitrate_controller_tick (controller, 3 * GST_SECOND);
+  fail_unless (notified == 2);
+
+  kms_bitrate_controller_unref (controller);
+}
+
+GST_END_TEST
+GST_START_TEST (decreases_not_rate_limited)
+{
+  KmsBitrateController *controller = create_controller ();
+
+  kms_bitrate_controller_set_target (controller, 400000, 0);
+  fail_unless (notified == 1);
+
+  /* Congestion is answered even right after an update */
+  kms_bitrate_controller_set_target (controller, 200000, GST_SECOND / 4);
+  fail_unless (notified == 2);
+  fail_unless (last_bitrate == 200000);
+  fail_unless (get_counter (controller, "rate-limited") == 0);
+
+  /* The next increase is spaced from the decrease */
+  kms_bitrate_controller_set_target (controller, 400000, GST_SECOND / 2);
+  fail_unless (notified == 2);
+  fail_unless (get_counter (controller, "rate-limited") == 1);
+
+  kms_bitrate_controller_tick (controller, GST_SECOND);
+  fail_unless (notified == 2);
+
+  kms_bitrate_controller_tick (controller, GST_SECOND + GST_SECOND / 4);
+  fail_unless (notified == 3);
+  fail_unless (last_bitrate == 400000);
+  fail_unless (get_counter (controller, "increases") == 2);
+  fail_unless (get_counter (controller, "decreases") == 1);
+
+  kms_bitrate_controller_unref (controller);
+}
+
+GST_END_TEST
+GST_START_TEST (asymmetric_ramps)
+{
+  KmsBitrateController *controller = create_controller ();
+  GstClockTime now = 0;
+
+  kms_bitrate_controller_set_ramps (controller, 10, 0);
+
+  /* Increases are spread in steps of 10% */
+  kms_bitrate_controller_set_target (controller, 400000, now);
+  fail_unless (last_bitrate == 330000);
+  fail_unless (get_counter (controller, "ramped") == 1);
+
+  now += GST_SECOND;
+  kms_bitrate_controller_tick (controller, now);
+  fail_unless (last_bitrate == 363000);
+
+  now += GST_SECOND;
+  kms_bitrate_controller_tick (controller, now);
+  fail_unless (last_bitrate == 399300);
+
+  /* The rest of the ramp is under the up threshold, it is not worth it */
+  now += GST_SECOND;
+  kms_bitrate_controller_tick (controller, now);
+  fail_unless (notified == 3);
+
+  /* Decreases are applied at once */
+  now += GST_SECOND;
+  kms_bitrate_controller_set_target (controller, 100000, now);
+  fail_unless (notified == 4);
+  fail_unless (last_bitrate == 100000);
+  fail_unless (get_counter (controller, "increases") == 3);
+  fail_unless (get_counter (controller, "decreases") == 1);
+  fail_unless (get_counter (controller, "targets") == 2);
+
+  kms_bitrate_controller_unref (controller);
+}
+
+GST_END_TEST
+#define RACE_ITERATIONS 200
+#define RACE_LOW_BITRATE 100000
+#define RACE_HIGH_BITRATE 1000000
+static gint in_callback;
+static gboolean overlapped;
+static gboolean repeated;
+
+static void
+race_bitrate_cb (KmsBitrateController * controller, guint bitrate,
+    gpointer user_data)
+{
+  if (g_atomic_int_add (&in_callback, 1) != 0) {
+    overlapped = TRUE;
+  }
+
+  if (bitrate == last_bitrate) {
+    repeated = TRUE;
+  }
+
+  /* Widen the window where a stale value could be applied */
+  g_usleep (50);
+
+  notified++;
+  last_bitrate = bitrate;
+
+  g_atomic_int_add (&in_callback, -1);
+}
+
+typedef struct _RaceData
+{
+  KmsBitrateController *controller;
+  guint first;
+  guint second;
+} RaceData;
+
+static gpointer
+set_targets (gpointer data)
+{
+  RaceData *race = data;
+  gint i;
+
+  for (i = 0; i < RACE_ITERATIONS; i++) {
+    kms_bitrate_controller_set_target (race->controller,
+        (i % 2 == 0) ? race->first : race->second, 0);
+  }
+
+  return NULL;
+}
+
+GST_START_TEST (interleaved_updates)
+{
+  KmsBitrateController *controller = create_controller ();
+  RaceData down = { controller, RACE_LOW_BITRATE, RACE_HIGH_BITRATE };
+  RaceData up = { controller, RACE_HIGH_BITRATE, RACE_LOW_BITRATE };
+  GThread *decreasing, *increasing;
+
+  kms_bitrate_controller_set_callback (controller, race_bitrate_cb, NULL,
+      NULL);
+  kms_bitrate_controller_set_min_interval (controller, 0);
+  in_callback = 0;
+  overlapped = FALSE;
+  repeated = FALSE;
+
+  decreasing = g_thread_new ("decreasing", set_targets, &down);
+  increasing = g_thread_new ("increasing", set_targets, &up);
+  g_thread_join (decreasing);
+  g_thread_join (increasing);
+
+  fail_if (overlapped);
+  fail_if (repeated);
+  fail_unless (notified > 0);
+
+  /* Whatever the interleaving, the encoder ends with the applied bitrate */
+  fail_unless (last_bitrate == kms_bitrate_controller_get_bitrate (controller));
+
+  kms_bitrate_controller_unref (controller);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+bitratecontroller_suite (void)
+{
+  Suite *s = suite_create ("bitratecontroller");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, small_changes_ignored);
+  tcase_add_test (tc_chain, updates_rate_limited);
+  tcase_add_test (tc_chain, decreases_not_rate_limited);
+  tcase_add_test (tc_chain, asymmetric_ramps);
+  tcase_add_test (tc_chain, interleaved_updates);
+
+  return s;
+}
+
+GST_CHECK_MAIN (bitratecontroller);
@@ -0,0 +1,189 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+
+#define WINDOW GST_SECOND
+#define THRESHOLD 100000        /* bps */
+#define BUFFERS 3000
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-vp8"));
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-vp8"));
+
+/* Bitrate computation as done before samples were kept in a ring buffer */
+typedef struct _Reference
+{
+  GQueue pts;
+  GQueue sizes;
+  guint64 total_size;
+  gint bitrate, last_bitrate;
+  GArray *updates;
+} Reference;
+
+static void
+reference_update (Reference * ref, GstClockTime pts, gsize size)
+{
+  guint64 last_pts, diff;
+
+  g_queue_push_head (&ref->pts, g_memdup (&pts, sizeof (pts)));
+  g_queue_push_head (&ref->sizes, GSIZE_TO_POINTER (size));
+  ref->total_size += size;
+
+  last_pts = *(guint64 *) g_queue_peek_tail (&ref->pts);
+  diff = pts - last_pts;
+  while (diff > WINDOW) {
+    g_free (g_queue_pop_tail (&ref->pts));
+    ref->total_size -= GPOINTER_TO_SIZE (g_queue_pop_tail (&ref->sizes));
+
+    last_pts = *(guint64 *) g_queue_peek_tail (&ref->pts);
+    diff = pts - last_pts;
+  }
+
+  if (diff == 0) {
+    ref->bitrate = 0;
+  } else {
+    ref->bitrate = (8 * GST_SECOND * ref->total_size) / diff;
+  }
+
+  if (ABS (ref->bitrate - ref->last_bitrate) >= THRESHOLD) {
+    ref->last_bitrate = ref->bitrate;
+    g_array_append_val (ref->updates, ref->bitrate);
+  }
+}
+
+static GstPadProbeReturn
+caps_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GArray *updates = user_data;
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+  GstStructure *st;
+  GstCaps *caps;
+  gint bitrate;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  gst_event_parse_caps (event, &caps);
+  st = gst_caps_get_structure (caps, 0);
+
+  if (gst_structure_get_int (st, "bitrate", &bitrate)) {
+    g_array_append_val (updates, bitrate);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (caps_bitrate_unchanged)
+{
+  GArray *updates = g_array_new (FALSE, FALSE, sizeof (gint));
+  Reference ref = { G_QUEUE_INIT, G_QUEUE_INIT, 0, 0, 0, NULL };
+  GstElement *filter;
+  GstPad *src, *sink;
+  GstCaps *caps;
+  GstClockTime pts = 0;
+  GRand *rand;
+  guint i;
+
+  ref.updates = g_array_new (FALSE, FALSE, sizeof (gint));
+  rand = g_rand_new_with_seed (42);
+
+  filter = gst_check_setup_element ("bitratefilter");
+  src = gst_check_setup_src_pad (filter, &src_template);
+  sink = gst_check_setup_sink_pad (filter, &sink_template);
+  gst_pad_add_probe (sink, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, caps_probe,
+      updates, NULL);
+  gst_pad_set_active (src, TRUE);
+  gst_pad_set_active (sink, TRUE);
+
+  caps = gst_caps_new_empty_simple ("video/x-vp8");
+  gst_check_setup_events (src, filter, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  fail_unless (gst_element_set_state (filter, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < BUFFERS; i++) {
+    GstBuffer *buffer;
+    gsize size;
+
+    /* Bursts of small buffers make the window hold hundreds of samples */
+    if (i % 1000 < 300) {
+      pts += g_rand_int_range (rand, 1, 5) * GST_MSECOND;
+      size = g_rand_int_range (rand, 50, 200);
+    } else {
+      pts += g_rand_int_range (rand, 10, 60) * GST_MSECOND;
+      size = g_rand_int_range (rand, 100, 4000);
+    }
+
+    buffer = gst_buffer_new_allocate (NULL, size, NULL);
+    GST_BUFFER_PTS (buffer) = pts;
+
+    reference_update (&ref, pts, size);
+    fail_unless (gst_pad_push (src, buffer) == GST_FLOW_OK);
+  }
+
+  fail_unless (ref.updates->len > 10);
+  fail_unless (updates->len == ref.updates->len);
+
+  for (i = 0; i < updates->len; i++) {
+    fail_unless (g_array_index (updates, gint, i) ==
+        g_array_index (ref.updates, gint, i));
+  }
+
+  gst_check_drop_buffers ();
+  gst_element_set_state (filter, GST_STATE_NULL);
+  gst_pad_set_active (src, FALSE);
+  gst_pad_set_active (sink, FALSE);
+  gst_check_teardown_src_pad (filter);
+  gst_check_teardown_sink_pad (filter);
+  gst_check_teardown_element (filter);
+
+  g_queue_foreach (&ref.pts, (GFunc) g_free, NULL);
+  g_queue_clear (&ref.pts);
+  g_queue_clear (&ref.sizes);
+  g_array_unref (ref.updates);
+  g_array_unref (updates);
+  g_rand_free (rand);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+bitratefilter_suite (void)
+{
+  Suite *s = suite_create ("bitratefilter");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, caps_bitrate_unchanged);
+
+  return s;
+}
+
+GST_CHECK_MAIN (bitratefilter);
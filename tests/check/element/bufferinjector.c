@@ -189,6 +189,74 @@ GST_START_TEST (buffer_injector_drop_buffers)
 
 GST_END_TEST;
 
+static void
+fakesink_count_hand_off (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    gpointer data)
+{
+  GstElement *pipeline = (GstElement *) data;
+  guint count;
+
+  count = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (fakesink), "count"));
+  g_object_set_data (G_OBJECT (fakesink), "count", GUINT_TO_POINTER (++count));
+
+  if (count == 10) {
+    gst_element_post_message (data, gst_message_new_eos (GST_OBJECT (pipeline)));
+  }
+}
+
+GST_START_TEST (buffer_injector_stats)
+{
+  GstElement *pipeline, *videotestsrc, *identity, *bufferinjector, *fakesink;
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  guint64 injected = 0;
+  GstStructure *stats;
+  GstBus *bus;
+
+  pipeline = gst_pipeline_new ("bufferinjector0-test");
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), loop);
+
+  videotestsrc = gst_element_factory_make ("videotestsrc", NULL);
+  identity = gst_element_factory_make ("identity", NULL);
+  bufferinjector = gst_element_factory_make ("bufferinjector", NULL);
+  fakesink = gst_element_factory_make ("fakesink", NULL);
+
+  g_object_set (fakesink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+  g_object_set (identity, "sleep-time", 500000, NULL);
+  g_object_set (videotestsrc, "is-live", TRUE, NULL);
+
+  g_signal_connect (G_OBJECT (fakesink), "handoff",
+      G_CALLBACK (fakesink_count_hand_off), pipeline);
+
+  gst_bin_add_many (GST_BIN (pipeline), videotestsrc, identity, bufferinjector,
+      fakesink, NULL);
+  gst_element_link_many (videotestsrc, identity, bufferinjector, fakesink,
+      NULL);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  g_main_loop_run (loop);
+
+  /* Gaps between the slow input buffers were filled */
+  g_object_get (bufferinjector, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "injected-buffers",
+          &injected));
+  gst_structure_free (stats);
+
+  GST_DEBUG ("Injected %" G_GUINT64_FORMAT " buffers", injected);
+  fail_unless (injected > 0);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  gst_object_unref (GST_OBJECT (bus));
+  gst_object_unref (GST_OBJECT (pipeline));
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
 static GstPadProbeReturn
 caps_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
 {
@@ -266,6 +334,141 @@ GST_START_TEST (renegotiate_input)
 
 GST_END_TEST;
 
+typedef struct _InjectorOutput
+{
+  GstElement *injector;
+  GstPad *src;
+  GstPad *sink;
+  gint injected;
+} InjectorOutput;
+
+static GstFlowReturn
+injected_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  InjectorOutput *output = g_object_get_data (G_OBJECT (pad), "output");
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_GAP)) {
+    g_atomic_int_inc (&output->injected);
+  }
+
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static void
+injector_output_start (InjectorOutput * output, GstElement * parent)
+{
+  GstPad *pad;
+  GstSegment segment;
+  GstCaps *caps;
+  GstBuffer *buffer;
+
+  output->injector = gst_element_factory_make ("bufferinjector", NULL);
+  gst_bin_add (GST_BIN (parent), output->injector);
+  output->src = gst_pad_new ("src", GST_PAD_SRC);
+  output->sink = gst_pad_new ("sink", GST_PAD_SINK);
+  g_object_set_data (G_OBJECT (output->sink), "output", output);
+  gst_pad_set_chain_function (output->sink, injected_chain);
+
+  pad = gst_element_get_static_pad (output->injector, "sink");
+  fail_unless (gst_pad_link (output->src, pad) == GST_PAD_LINK_OK);
+  g_object_unref (pad);
+
+  pad = gst_element_get_static_pad (output->injector, "src");
+  fail_unless (gst_pad_link (pad, output->sink) == GST_PAD_LINK_OK);
+  g_object_unref (pad);
+
+  gst_pad_set_active (output->src, TRUE);
+  gst_pad_set_active (output->sink, TRUE);
+  fail_unless (gst_element_set_state (output->injector, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  gst_pad_push_event (output->src, gst_event_new_stream_start ("test"));
+  caps = gst_caps_from_string ("video/x-raw, framerate=(fraction)30/1");
+  gst_pad_push_event (output->src, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (output->src, gst_event_new_segment (&segment));
+
+  /* A single frame, every following one has to be injected */
+  buffer = gst_buffer_new_allocate (NULL, 1000, NULL);
+  GST_BUFFER_PTS (buffer) = 0;
+  fail_unless (gst_pad_push (output->src, buffer) == GST_FLOW_OK);
+}
+
+static void
+injector_output_stop (InjectorOutput * output)
+{
+  gst_element_set_state (output->injector, GST_STATE_NULL);
+  gst_pad_set_active (output->src, FALSE);
+  gst_pad_set_active (output->sink, FALSE);
+  g_object_unref (output->src);
+  g_object_unref (output->sink);
+}
+
+GST_START_TEST (shared_timers)
+{
+  InjectorOutput *outputs;
+  guint n_outputs, i, waited;
+  gboolean done = FALSE;
+  guint64 total = 0, reported;
+  const GstStructure *e_stats;
+  GstStructure *stats;
+  GstElement *element;
+
+  /* Injectors inside a KmsElement report through its stats */
+  element = gst_element_factory_make ("passthrough", NULL);
+  g_object_set (element, "media-stats", TRUE, NULL);
+
+  /* More injectors than threads in the inject pool */
+  n_outputs = 2 * g_get_num_processors () + 1;
+  outputs = g_new0 (InjectorOutput, n_outputs);
+
+  for (i = 0; i < n_outputs; i++) {
+    injector_output_start (&outputs[i], element);
+  }
+
+  for (waited = 0; !done && waited < 5000; waited += 10) {
+    g_usleep (10 * G_TIME_SPAN_MILLISECOND);
+
+    done = TRUE;
+    for (i = 0; i < n_outputs; i++) {
+      done = done && g_atomic_int_get (&outputs[i].injected) >= 5;
+    }
+  }
+
+  for (i = 0; i < n_outputs; i++) {
+    guint64 injected;
+
+    injector_output_stop (&outputs[i]);
+
+    GST_DEBUG ("Injector %u injected %d buffers", i,
+        g_atomic_int_get (&outputs[i].injected));
+    fail_unless (g_atomic_int_get (&outputs[i].injected) >= 5);
+
+    g_object_get (outputs[i].injector, "stats", &stats, NULL);
+    fail_unless (gst_structure_get_uint64 (stats, "injected-buffers",
+            &injected));
+    fail_unless (injected >= 5);
+    total += injected;
+    gst_structure_free (stats);
+  }
+
+  g_signal_emit_by_name (element, "stats", NULL, &stats);
+  e_stats = gst_value_get_structure (gst_structure_get_value (stats,
+          "media-element"));
+  fail_unless (gst_structure_get_uint64 (e_stats, "injected-buffers",
+          &reported));
+  fail_unless (reported == total);
+  gst_structure_free (stats);
+
+  g_object_unref (element);
+  g_free (outputs);
+}
+
+GST_END_TEST;
+
 static Suite *
 buffer_injector_suite (void)
 {
@@ -276,7 +479,9 @@ buffer_injector_suite (void)
   tcase_add_test (tc_chain, audio_test_buffer_injector);
   tcase_add_test (tc_chain, video_test_buffer_injector);
   tcase_add_test (tc_chain, buffer_injector_drop_buffers);
+  tcase_add_test (tc_chain, buffer_injector_stats);
   tcase_add_test (tc_chain, renegotiate_input);
+  tcase_add_test (tc_chain, shared_timers);
   return s;
 }
 
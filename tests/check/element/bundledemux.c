@@ -0,0 +1,215 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <glib.h>
+
+#include "kmsbundledemux.h"
+
+#define N_SSRCS 64
+#define N_SESSIONS 2
+#define FIRST_SSRC 0x10000000
+#define PACKETS_PER_SSRC 2000
+#define PAYLOAD_SIZE 200
+#define RTP_HEADER_SIZE 12
+
+typedef struct _SessionSink
+{
+  guint session;
+  gint received;
+  gint misrouted;
+} SessionSink;
+
+static guint32
+packet_get_ssrc (GstBuffer * buffer)
+{
+  guint8 header[RTP_HEADER_SIZE];
+
+  gst_buffer_extract (buffer, 0, header, RTP_HEADER_SIZE);
+
+  return GST_READ_UINT32_BE (header + 8);
+}
+
+static GstPadProbeReturn
+check_session (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  SessionSink *sink = data;
+  guint32 ssrc = packet_get_ssrc (GST_PAD_PROBE_INFO_BUFFER (info));
+
+  if ((ssrc - FIRST_SSRC) % N_SESSIONS != sink->session) {
+    g_atomic_int_inc (&sink->misrouted);
+  }
+
+  g_atomic_int_inc (&sink->received);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstBuffer *
+create_packet (guint32 ssrc, guint16 seq)
+{
+  GstBuffer *buffer;
+  guint8 *data;
+
+  data = g_malloc0 (RTP_HEADER_SIZE + PAYLOAD_SIZE);
+  data[0] = 0x80;
+  data[1] = 96;
+  GST_WRITE_UINT16_BE (data + 2, seq);
+  GST_WRITE_UINT32_BE (data + 4, seq * 3000);
+  GST_WRITE_UINT32_BE (data + 8, ssrc);
+
+  buffer = gst_buffer_new_wrapped (data, RTP_HEADER_SIZE + PAYLOAD_SIZE);
+
+  return buffer;
+}
+
+static GstPad *
+add_sink (GstElement * pipeline, SessionSink * data)
+{
+  GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *pad;
+
+  g_object_set (fakesink, "sync", FALSE, "async", FALSE, NULL);
+  gst_bin_add (GST_BIN (pipeline), fakesink);
+  pad = gst_element_get_static_pad (fakesink, "sink");
+
+  if (data != NULL) {
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, check_session, data,
+        NULL);
+  }
+
+  return pad;
+}
+
+GST_START_TEST (route_64_ssrcs)
+{
+  SessionSink sinks[N_SESSIONS];
+  GstElement *pipeline;
+  KmsBundleDemux *demux;
+  GstPad *srcpad, *sinkpad;
+  GstSegment segment;
+  GstCaps *caps;
+  gint64 start, setup, first_round, elapsed;
+  gint i, j, received = 0;
+  GstPluginFeature *rtcpdemux;
+
+  rtcpdemux = gst_registry_lookup_feature (gst_registry_get (), "rtcpdemux");
+  if (rtcpdemux == NULL) {
+    GST_WARNING ("rtcpdemux not available, skipping test");
+    return;
+  }
+  gst_object_unref (rtcpdemux);
+
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  demux = kms_bundle_demux_new (GST_BIN (pipeline));
+
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < N_SESSIONS; i++) {
+    GstPad *rtp_sink, *rtcp_sink;
+
+    sinks[i].session = i;
+    sinks[i].received = sinks[i].misrouted = 0;
+
+    rtp_sink = add_sink (pipeline, &sinks[i]);
+    rtcp_sink = add_sink (pipeline, NULL);
+    fail_unless (kms_bundle_demux_add_session (demux, i, rtp_sink, rtcp_sink,
+            0));
+    g_object_unref (rtp_sink);
+    g_object_unref (rtcp_sink);
+  }
+
+  for (i = 0; i < N_SSRCS; i++) {
+    kms_bundle_demux_add_ssrc (demux, FIRST_SSRC + i, i % N_SESSIONS);
+  }
+
+  setup = g_get_monotonic_time () - start;
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad = kms_bundle_demux_get_rtp_sink (demux);
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+  g_object_unref (sinkpad);
+  gst_pad_set_active (srcpad, TRUE);
+
+  gst_pad_push_event (srcpad, gst_event_new_stream_start (__FUNCTION__));
+  caps = gst_caps_new_empty_simple ("application/x-rtp");
+  gst_pad_push_event (srcpad, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (srcpad, gst_event_new_segment (&segment));
+
+  start = g_get_monotonic_time ();
+
+  /* First packet of each SSRC makes rtpssrcdemux create and route a pad */
+  for (i = 0; i < N_SSRCS; i++) {
+    fail_unless (gst_pad_push (srcpad, create_packet (FIRST_SSRC + i,
+                0)) == GST_FLOW_OK);
+  }
+
+  first_round = g_get_monotonic_time () - start;
+
+  for (j = 1; j < PACKETS_PER_SSRC; j++) {
+    for (i = 0; i < N_SSRCS; i++) {
+      fail_unless (gst_pad_push (srcpad, create_packet (FIRST_SSRC + i,
+                  j)) == GST_FLOW_OK);
+    }
+  }
+
+  elapsed = g_get_monotonic_time () - start;
+
+  for (i = 0; i < N_SESSIONS; i++) {
+    fail_unless (sinks[i].misrouted == 0);
+    received += sinks[i].received;
+  }
+
+  GST_INFO ("%d SSRCs: table setup %" G_GINT64_FORMAT " us, new SSRC routing "
+      "%f us/SSRC, %d packets in %" G_GINT64_FORMAT " us: %f pps", N_SSRCS,
+      setup, first_round / (gdouble) N_SSRCS, received, elapsed,
+      received * (gdouble) G_USEC_PER_SEC / MAX (elapsed, 1));
+
+  fail_unless (received == N_SSRCS * PACKETS_PER_SSRC);
+
+  gst_pad_set_active (srcpad, FALSE);
+  g_object_unref (srcpad);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  kms_bundle_demux_unref (demux);
+  g_object_unref (pipeline);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+bundledemux_suite (void)
+{
+  Suite *s = suite_create ("bundledemux");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, route_64_ssrcs);
+
+  return s;
+}
+
+GST_CHECK_MAIN (bundledemux);
@@ -0,0 +1,139 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+
+#include "kmselementpool.h"
+
+#define FACTORY "fakesink"
+#define POOL_SIZE 4
+#define REQUESTS 6
+#define FILL_TIMEOUT (5 * G_TIME_SPAN_SECOND)
+
+static const GstStructure *
+get_factory_stats (const GstStructure * stats)
+{
+  const GValue *value = gst_structure_get_value (stats, FACTORY);
+
+  if (value == NULL) {
+    return NULL;
+  }
+
+  return gst_value_get_structure (value);
+}
+
+static guint
+get_idle (void)
+{
+  GstStructure *stats = kms_element_pool_get_stats ();
+  const GstStructure *factory_stats = get_factory_stats (stats);
+  guint idle = 0;
+
+  if (factory_stats != NULL) {
+    gst_structure_get_uint (factory_stats, "idle", &idle);
+  }
+
+  gst_structure_free (stats);
+
+  return idle;
+}
+
+static void
+wait_for_idle (guint expected)
+{
+  gint64 deadline = g_get_monotonic_time () + FILL_TIMEOUT;
+
+  while (get_idle () < expected && g_get_monotonic_time () < deadline) {
+    g_usleep (1000);
+  }
+}
+
+GST_START_TEST (prewarmed_acquire)
+{
+  GstElement *elements[REQUESTS];
+  const GstStructure *factory_stats;
+  GstStructure *stats;
+  guint64 hits, misses, acquire_time, build_time;
+  gdouble hit_rate;
+  GstState state;
+  gint i;
+
+  kms_element_pool_set_size (FACTORY, POOL_SIZE);
+  wait_for_idle (POOL_SIZE);
+  fail_unless (get_idle () == POOL_SIZE);
+
+  for (i = 0; i < REQUESTS; i++) {
+    elements[i] = kms_element_pool_acquire (FACTORY);
+    fail_unless (elements[i] != NULL);
+    fail_unless (g_object_is_floating (elements[i]));
+
+    gst_element_get_state (elements[i], &state, NULL, 0);
+    fail_unless (state == GST_STATE_NULL);
+  }
+
+  for (i = 0; i < REQUESTS; i++) {
+    fail_unless (gst_object_ref_sink (elements[i]) != NULL);
+    g_object_unref (elements[i]);
+  }
+
+  /* Acquisitions are refilled in background */
+  wait_for_idle (POOL_SIZE);
+
+  stats = kms_element_pool_get_stats ();
+  factory_stats = get_factory_stats (stats);
+  fail_unless (factory_stats != NULL);
+
+  fail_unless (gst_structure_get (factory_stats, "hits", G_TYPE_UINT64, &hits,
+          "misses", G_TYPE_UINT64, &misses, "hit-rate", G_TYPE_DOUBLE,
+          &hit_rate, "avg-acquire-time", G_TYPE_UINT64, &acquire_time,
+          "avg-build-time", G_TYPE_UINT64, &build_time, NULL));
+
+  GST_INFO ("Hits: %" G_GUINT64_FORMAT ", misses: %" G_GUINT64_FORMAT
+      ", hit rate: %f, acquire: %" GST_TIME_FORMAT ", build: %"
+      GST_TIME_FORMAT, hits, misses, hit_rate, GST_TIME_ARGS (acquire_time),
+      GST_TIME_ARGS (build_time));
+
+  fail_unless (hits >= POOL_SIZE);
+  fail_unless (hits + misses == REQUESTS);
+  fail_unless (get_idle () == POOL_SIZE);
+
+  gst_structure_free (stats);
+
+  kms_element_pool_set_size (FACTORY, 0);
+  fail_unless (get_idle () == 0);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+elementpool_suite (void)
+{
+  Suite *s = suite_create ("elementpool");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, prewarmed_acquire);
+
+  return s;
+}
+
+GST_CHECK_MAIN (elementpool);
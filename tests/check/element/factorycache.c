@@ -0,0 +1,257 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+
+#include "kmsfactorycache.h"
+
+#define ITERATIONS 200
+
+#define TEST_CAPS "application/x-kms-factory-cache-test"
+
+typedef struct _Lookup
+{
+  GstElementFactoryListType type;
+  const gchar *caps;
+  GstPadDirection direction;
+} Lookup;
+
+/* Lookups done while an endpoint and its agnosticbin branches are built */
+static const Lookup endpoint_lookups[] = {
+  {GST_ELEMENT_FACTORY_TYPE_PAYLOADER, "application/x-rtp,media=video,"
+        "encoding-name=VP8,clock-rate=90000,payload=96", GST_PAD_SRC},
+  {GST_ELEMENT_FACTORY_TYPE_PAYLOADER, "application/x-rtp,media=audio,"
+        "encoding-name=OPUS,clock-rate=48000,payload=98", GST_PAD_SRC},
+  {GST_ELEMENT_FACTORY_TYPE_DEPAYLOADER, "application/x-rtp,media=video,"
+        "encoding-name=VP8,clock-rate=90000,payload=96", GST_PAD_SINK},
+  {GST_ELEMENT_FACTORY_TYPE_DEPAYLOADER, "application/x-rtp,media=audio,"
+        "encoding-name=OPUS,clock-rate=48000,payload=98", GST_PAD_SINK},
+  {GST_ELEMENT_FACTORY_TYPE_PARSER, "video/x-vp8", GST_PAD_SINK},
+  {GST_ELEMENT_FACTORY_TYPE_DECODER, "video/x-vp8", GST_PAD_SINK},
+  {GST_ELEMENT_FACTORY_TYPE_ENCODER, "video/x-vp8", GST_PAD_SRC},
+  {GST_ELEMENT_FACTORY_TYPE_ENCODER, "audio/x-opus", GST_PAD_SRC},
+};
+
+static GList *
+registry_filter (const Lookup * lookup, const GstCaps * caps)
+{
+  GList *elements, *filtered;
+
+  elements = gst_element_factory_list_get_elements (lookup->type,
+      GST_RANK_NONE);
+  filtered = gst_element_factory_list_filter (elements, caps,
+      lookup->direction, FALSE);
+  gst_plugin_feature_list_free (elements);
+
+  return filtered;
+}
+
+static gint64
+run_lookups (gboolean cached)
+{
+  gint64 start = g_get_monotonic_time ();
+  guint i, j;
+
+  for (i = 0; i < ITERATIONS; i++) {
+    for (j = 0; j < G_N_ELEMENTS (endpoint_lookups); j++) {
+      const Lookup *lookup = &endpoint_lookups[j];
+      GstCaps *caps = gst_caps_from_string (lookup->caps);
+      GList *list;
+
+      if (cached) {
+        list = kms_factory_cache_filter (lookup->type, caps,
+            lookup->direction);
+      } else {
+        list = registry_filter (lookup, caps);
+      }
+
+      gst_plugin_feature_list_free (list);
+      gst_caps_unref (caps);
+    }
+  }
+
+  return g_get_monotonic_time () - start;
+}
+
+GST_START_TEST (endpoint_lookup_time)
+{
+  gint64 uncached, cached;
+  guint j;
+
+  /* Cached results must match a registry scan */
+  for (j = 0; j < G_N_ELEMENTS (endpoint_lookups); j++) {
+    const Lookup *lookup = &endpoint_lookups[j];
+    GstCaps *caps = gst_caps_from_string (lookup->caps);
+    GList *expected, *list;
+
+    expected = registry_filter (lookup, caps);
+    list = kms_factory_cache_filter (lookup->type, caps, lookup->direction);
+
+    fail_unless (g_list_length (list) == g_list_length (expected));
+
+    gst_plugin_feature_list_free (expected);
+    gst_plugin_feature_list_free (list);
+    gst_caps_unref (caps);
+  }
+
+  uncached = run_lookups (FALSE);
+  cached = run_lookups (TRUE);
+
+  GST_INFO ("Factory lookups for %d endpoints: %" G_GINT64_FORMAT
+      " us scanning the registry, %" G_GINT64_FORMAT " us cached",
+      ITERATIONS, uncached, cached);
+}
+
+GST_END_TEST
+/* Minimal parser registered at run time to check invalidation */
+typedef GstElement KmsFactoryCacheTest;
+typedef GstElementClass KmsFactoryCacheTestClass;
+
+G_DEFINE_TYPE (KmsFactoryCacheTest, kms_factory_cache_test, GST_TYPE_ELEMENT);
+
+static GstStaticPadTemplate test_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (TEST_CAPS));
+
+static GstStaticPadTemplate test_src_template =
+GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (TEST_CAPS));
+
+static void
+kms_factory_cache_test_class_init (KmsFactoryCacheTestClass * klass)
+{
+  gst_element_class_add_pad_template (klass,
+      gst_static_pad_template_get (&test_sink_template));
+  gst_element_class_add_pad_template (klass,
+      gst_static_pad_template_get (&test_src_template));
+  gst_element_class_set_static_metadata (klass, "Factory cache test",
+      "Codec/Parser", "Test parser", "Kurento <kurento@googlegroups.com>");
+}
+
+static void
+kms_factory_cache_test_init (KmsFactoryCacheTest * self)
+{
+}
+
+GST_START_TEST (registry_invalidation)
+{
+  GstCaps *caps = gst_caps_from_string (TEST_CAPS);
+  GList *list;
+
+  list = kms_factory_cache_filter (GST_ELEMENT_FACTORY_TYPE_PARSER, caps,
+      GST_PAD_SINK);
+  fail_unless (list == NULL);
+
+  fail_unless (gst_element_register (NULL, "kmsfactorycachetest",
+          GST_RANK_PRIMARY, kms_factory_cache_test_get_type ()));
+
+  list = kms_factory_cache_filter (GST_ELEMENT_FACTORY_TYPE_PARSER, caps,
+      GST_PAD_SINK);
+  fail_unless (g_list_length (list) == 1);
+  fail_unless (g_strcmp0 (GST_OBJECT_NAME (list->data),
+          "kmsfactorycachetest") == 0);
+
+  gst_plugin_feature_list_free (list);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST
+#define RTP_STREAM_CAPS "application/x-rtp,media=video,encoding-name=VP8," \
+    "clock-rate=90000,payload=96,clock-base=(uint)%u,seqnum-base=(uint)%u," \
+    "ssrc=(uint)%u"
+static GList *
+filter_rtp_stream (guint ssrc)
+{
+  gchar *caps_str = g_strdup_printf (RTP_STREAM_CAPS, ssrc * 3, ssrc * 7,
+      ssrc);
+  GstCaps *caps = gst_caps_from_string (caps_str);
+  GList *list;
+
+  list = kms_factory_cache_filter (GST_ELEMENT_FACTORY_TYPE_DEPAYLOADER, caps,
+      GST_PAD_SINK);
+
+  gst_caps_unref (caps);
+  g_free (caps_str);
+
+  return list;
+}
+
+GST_START_TEST (streams_share_entry)
+{
+  GList *first, *second;
+
+  kms_factory_cache_clear ();
+  fail_unless (kms_factory_cache_get_size () == 0);
+
+  first = filter_rtp_stream (1111);
+  fail_unless (kms_factory_cache_get_size () == 1);
+
+  /* Only ssrc and sequence bases differ, the entry is reused */
+  second = filter_rtp_stream (2222);
+  fail_unless (kms_factory_cache_get_size () == 1);
+  fail_unless (g_list_length (first) == g_list_length (second));
+
+  gst_plugin_feature_list_free (first);
+  gst_plugin_feature_list_free (second);
+}
+
+GST_END_TEST
+GST_START_TEST (size_bounded)
+{
+  guint i;
+
+  kms_factory_cache_clear ();
+
+  for (i = 0; i < KMS_FACTORY_CACHE_MAX_FILTERED * 2; i++) {
+    gchar *caps_str = g_strdup_printf (TEST_CAPS "-%u", i);
+    GstCaps *caps = gst_caps_from_string (caps_str);
+    GList *list;
+
+    list = kms_factory_cache_filter (GST_ELEMENT_FACTORY_TYPE_PARSER, caps,
+        GST_PAD_SINK);
+    gst_plugin_feature_list_free (list);
+    gst_caps_unref (caps);
+    g_free (caps_str);
+  }
+
+  fail_unless (kms_factory_cache_get_size () ==
+      KMS_FACTORY_CACHE_MAX_FILTERED);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+factorycache_suite (void)
+{
+  Suite *s = suite_create ("factorycache");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, endpoint_lookup_time);
+  tcase_add_test (tc_chain, registry_invalidation);
+  tcase_add_test (tc_chain, streams_share_entry);
+  tcase_add_test (tc_chain, size_bounded);
+
+  return s;
+}
+
+GST_CHECK_MAIN (factorycache);
@@ -0,0 +1,219 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <gst/video/video-event.h>
+
+#include "kmsgopcache.h"
+
+typedef struct _Link
+{
+  GstPad *src;
+  GstPad *sink;
+  GList *received;
+  guint key_frame_requests;
+} Link;
+
+static gboolean
+src_event_function (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  Link *link = g_object_get_data (G_OBJECT (pad), "link");
+
+  if (gst_video_event_is_force_key_unit (event)) {
+    link->key_frame_requests++;
+  }
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+sink_chain_function (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  Link *link = g_object_get_data (G_OBJECT (pad), "link");
+
+  link->received = g_list_append (link->received, buffer);
+
+  return GST_FLOW_OK;
+}
+
+static void
+link_init (Link * link)
+{
+  GstSegment segment;
+  GstCaps *caps;
+
+  link->received = NULL;
+  link->key_frame_requests = 0;
+
+  link->src = gst_pad_new ("src", GST_PAD_SRC);
+  link->sink = gst_pad_new ("sink", GST_PAD_SINK);
+  g_object_set_data (G_OBJECT (link->src), "link", link);
+  g_object_set_data (G_OBJECT (link->sink), "link", link);
+  gst_pad_set_event_function (link->src, src_event_function);
+  gst_pad_set_chain_function (link->sink, sink_chain_function);
+  fail_unless (gst_pad_link (link->src, link->sink) == GST_PAD_LINK_OK);
+  gst_pad_set_active (link->src, TRUE);
+  gst_pad_set_active (link->sink, TRUE);
+
+  caps = gst_caps_from_string ("video/x-vp8");
+  gst_pad_push_event (link->src, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (link->src, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (link->src, gst_event_new_segment (&segment));
+}
+
+static void
+link_clear (Link * link)
+{
+  g_list_free_full (link->received, (GDestroyNotify) gst_buffer_unref);
+  gst_pad_set_active (link->src, FALSE);
+  gst_pad_set_active (link->sink, FALSE);
+  g_object_unref (link->src);
+  g_object_unref (link->sink);
+}
+
+static GstBuffer *
+new_frame (gboolean key_frame)
+{
+  GstBuffer *buffer = gst_buffer_new ();
+
+  if (!key_frame) {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  }
+
+  return buffer;
+}
+
+/* Behaves like a tee: the cache sees the buffer before the outputs */
+static GstBuffer *
+push_frame (Link * input, Link * output, gboolean key_frame)
+{
+  GstBuffer *buffer = new_frame (key_frame);
+
+  fail_unless (gst_pad_push (input->src, gst_buffer_ref (buffer)) ==
+      GST_FLOW_OK);
+
+  if (output != NULL) {
+    fail_unless (gst_pad_push (output->src, gst_buffer_ref (buffer)) ==
+        GST_FLOW_OK);
+  }
+
+  return buffer;
+}
+
+GST_START_TEST (prime_new_output)
+{
+  GstBuffer *frames[4];
+  KmsGopCache *cache;
+  Link input, output;
+  GList *l;
+  guint i;
+
+  link_init (&input);
+  link_init (&output);
+
+  cache = kms_gop_cache_new (10);
+  kms_gop_cache_watch_pad (cache, input.sink);
+  fail_if (kms_gop_cache_has_key_frame (cache));
+
+  /* Deltas before the first key frame are not cached */
+  gst_buffer_unref (push_frame (&input, NULL, FALSE));
+  fail_if (kms_gop_cache_has_key_frame (cache));
+
+  frames[0] = push_frame (&input, NULL, TRUE);
+  frames[1] = push_frame (&input, NULL, FALSE);
+  frames[2] = push_frame (&input, NULL, FALSE);
+  fail_unless (kms_gop_cache_has_key_frame (cache));
+
+  /* A new output joins the running stream */
+  kms_gop_cache_prime_pad (cache, output.sink);
+  frames[3] = push_frame (&input, &output, FALSE);
+
+  fail_unless (g_list_length (output.received) == G_N_ELEMENTS (frames));
+  for (i = 0, l = output.received; l != NULL; i++, l = l->next) {
+    fail_unless (l->data == frames[i]);
+  }
+
+  fail_unless (output.key_frame_requests == 0);
+
+  for (i = 0; i < G_N_ELEMENTS (frames); i++) {
+    gst_buffer_unref (frames[i]);
+  }
+
+  kms_gop_cache_unref (cache);
+  link_clear (&input);
+  link_clear (&output);
+}
+
+GST_END_TEST
+GST_START_TEST (long_gop_not_cached)
+{
+  KmsGopCache *cache;
+  Link input, output;
+  GstBuffer *key_frame;
+
+  link_init (&input);
+  link_init (&output);
+
+  cache = kms_gop_cache_new (2);
+  kms_gop_cache_watch_pad (cache, input.sink);
+
+  gst_buffer_unref (push_frame (&input, NULL, TRUE));
+  gst_buffer_unref (push_frame (&input, NULL, FALSE));
+  gst_buffer_unref (push_frame (&input, NULL, FALSE));
+  fail_if (kms_gop_cache_has_key_frame (cache));
+
+  /* Without a cached GOP the output waits for a key frame */
+  kms_gop_cache_prime_pad (cache, output.sink);
+  gst_buffer_unref (push_frame (&input, &output, FALSE));
+  gst_buffer_unref (push_frame (&input, &output, FALSE));
+  fail_unless (output.received == NULL);
+  fail_unless (output.key_frame_requests == 1);
+
+  key_frame = push_frame (&input, &output, TRUE);
+  fail_unless (g_list_length (output.received) == 1);
+  fail_unless (output.received->data == key_frame);
+  gst_buffer_unref (key_frame);
+
+  kms_gop_cache_unref (cache);
+  link_clear (&input);
+  link_clear (&output);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+gopcache_suite (void)
+{
+  Suite *s = suite_create ("gopcache");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, prime_new_output);
+  tcase_add_test (tc_chain, long_gop_not_cached);
+
+  return s;
+}
+
+GST_CHECK_MAIN (gopcache);
@@ -129,6 +129,144 @@ GST_START_TEST (create_element)
   g_object_unref (hubport);
 }
 
+GST_END_TEST
+#define BENCHMARK_PORTS 500
+#define BENCHMARK_THREADS 10
+typedef struct _HubBenchmarkData
+{
+  GstElement *hub;
+  GstElement **ports;
+  gint *ids;
+  gint n_ports;
+  gint *errors;
+} HubBenchmarkData;
+
+static gpointer
+handle_ports (gpointer user_data)
+{
+  HubBenchmarkData *data = user_data;
+  gint i;
+
+  for (i = 0; i < data->n_ports; i++) {
+    g_signal_emit_by_name (data->hub, "handle-port", data->ports[i],
+        &data->ids[i]);
+
+    if (data->ids[i] < 0) {
+      g_atomic_int_inc (data->errors);
+    }
+  }
+
+  return NULL;
+}
+
+static gpointer
+unhandle_ports (gpointer user_data)
+{
+  HubBenchmarkData *data = user_data;
+  gint i;
+
+  for (i = 0; i < data->n_ports; i++) {
+    g_signal_emit_by_name (data->hub, "unhandle-port", data->ids[i]);
+  }
+
+  return NULL;
+}
+
+static gint64
+run_threads (GThreadFunc func, HubBenchmarkData * data)
+{
+  GThread *threads[BENCHMARK_THREADS];
+  gint64 start;
+  gint i;
+
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < BENCHMARK_THREADS; i++) {
+    threads[i] = g_thread_new (NULL, func, &data[i]);
+  }
+
+  for (i = 0; i < BENCHMARK_THREADS; i++) {
+    g_thread_join (threads[i]);
+  }
+
+  return g_get_monotonic_time () - start;
+}
+
+static gboolean
+port_is_handled (GstElement * port)
+{
+  /* The hub watches pad-added on every port it handles */
+  return g_signal_has_handler_pending (port,
+      g_signal_lookup ("pad-added", GST_TYPE_ELEMENT), 0, FALSE);
+}
+
+GST_START_TEST (handle_ports_concurrently)
+{
+  GstElement *pipe = gst_pipeline_new (__FUNCTION__);
+  GstElement *ports[BENCHMARK_PORTS];
+  gint ids[BENCHMARK_PORTS];
+  gboolean seen[BENCHMARK_PORTS];
+  HubBenchmarkData data[BENCHMARK_THREADS];
+  gint ports_per_thread = BENCHMARK_PORTS / BENCHMARK_THREADS;
+  gint errors = 0;
+  GstElement *hub;
+  GType hub_type;
+  gint64 elapsed;
+  gint i;
+
+  /* Creating a hubport loads the library where the base hub is defined */
+  for (i = 0; i < BENCHMARK_PORTS; i++) {
+    ports[i] = gst_element_factory_make ("hubport", NULL);
+    gst_bin_add (GST_BIN (pipe), ports[i]);
+  }
+
+  hub_type = g_type_from_name ("KmsBaseHub");
+  fail_if (hub_type == 0);
+
+  hub = g_object_new (hub_type, NULL);
+  gst_bin_add (GST_BIN (pipe), hub);
+
+  for (i = 0; i < BENCHMARK_THREADS; i++) {
+    data[i].hub = hub;
+    data[i].ports = &ports[i * ports_per_thread];
+    data[i].ids = &ids[i * ports_per_thread];
+    data[i].n_ports = ports_per_thread;
+    data[i].errors = &errors;
+  }
+
+  elapsed = run_threads (handle_ports, data);
+  GST_INFO ("Handled %d ports from %d threads in %" G_GINT64_FORMAT
+      " us (%f ports/s)", BENCHMARK_PORTS, BENCHMARK_THREADS, elapsed,
+      BENCHMARK_PORTS * G_USEC_PER_SEC / (gdouble) MAX (elapsed, 1));
+
+  fail_unless (errors == 0);
+
+  /* Every port got its own id and is in the table */
+  memset (seen, 0, sizeof (seen));
+  for (i = 0; i < BENCHMARK_PORTS; i++) {
+    fail_unless (ids[i] >= 0 && ids[i] < BENCHMARK_PORTS);
+    fail_if (seen[ids[i]]);
+    seen[ids[i]] = TRUE;
+    fail_unless (port_is_handled (ports[i]));
+  }
+
+  elapsed = run_threads (unhandle_ports, data);
+  GST_INFO ("Unhandled %d ports from %d threads in %" G_GINT64_FORMAT
+      " us (%f ports/s)", BENCHMARK_PORTS, BENCHMARK_THREADS, elapsed,
+      BENCHMARK_PORTS * G_USEC_PER_SEC / (gdouble) MAX (elapsed, 1));
+
+  for (i = 0; i < BENCHMARK_PORTS; i++) {
+    fail_if (port_is_handled (ports[i]));
+  }
+
+  /* Unhandling twice is harmless */
+  g_signal_emit_by_name (hub, "unhandle-port", ids[0]);
+
+  fail_unless (GST_ELEMENT (hub)->numpads == 0);
+
+  g_object_unref (pipe);
+}
+
 GST_END_TEST static Suite *
 hubport_suite (void)
 {
@@ -140,6 +278,7 @@ hubport_suite (void)
   tcase_add_test (tc_chain, create_element);
   tcase_add_test (tc_chain, connect_sinks);
   tcase_add_test (tc_chain, connect_srcs);
+  tcase_add_test (tc_chain, handle_ports_concurrently);
 
   return s;
 }
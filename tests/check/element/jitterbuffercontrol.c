@@ -0,0 +1,243 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsjitterbuffercontrol.h"
+
+#define CLOCK_RATE 90000
+#define PACKET_INTERVAL (20 * GST_MSECOND)
+/* Longer than the control update interval (1s) */
+#define PHASE_PACKETS 60
+
+typedef struct _JitterBufferTest
+{
+  GstElement *jitterbuffer;
+  GstPad *srcpad, *sinkpad;
+  guint16 seq;
+} JitterBufferTest;
+
+static GstFlowReturn
+sink_chain_function (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static void
+setup_jitterbuffer (JitterBufferTest * test)
+{
+  GstPad *jb_sink, *jb_src;
+
+  test->seq = 0;
+  test->jitterbuffer = gst_element_factory_make ("rtpjitterbuffer", NULL);
+  fail_unless (test->jitterbuffer != NULL);
+
+  test->srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  test->sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function (test->sinkpad, sink_chain_function);
+
+  jb_sink = gst_element_get_static_pad (test->jitterbuffer, "sink");
+  jb_src = gst_element_get_static_pad (test->jitterbuffer, "src");
+  fail_unless (gst_pad_link (test->srcpad, jb_sink) == GST_PAD_LINK_OK);
+  fail_unless (gst_pad_link (jb_src, test->sinkpad) == GST_PAD_LINK_OK);
+  g_object_unref (jb_sink);
+  g_object_unref (jb_src);
+
+  gst_pad_set_active (test->srcpad, TRUE);
+  gst_pad_set_active (test->sinkpad, TRUE);
+  gst_element_set_state (test->jitterbuffer, GST_STATE_PLAYING);
+}
+
+static void
+start_stream (JitterBufferTest * test)
+{
+  GstSegment segment;
+  GstCaps *caps;
+
+  gst_pad_push_event (test->srcpad, gst_event_new_stream_start ("test"));
+  caps = gst_caps_new_simple ("application/x-rtp",
+      "media", G_TYPE_STRING, "video",
+      "clock-rate", G_TYPE_INT, CLOCK_RATE,
+      "encoding-name", G_TYPE_STRING, "VP8",
+      "payload", G_TYPE_INT, 96, NULL);
+  gst_pad_push_event (test->srcpad, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (test->srcpad, gst_event_new_segment (&segment));
+}
+
+static void
+teardown_jitterbuffer (JitterBufferTest * test)
+{
+  gst_element_set_state (test->jitterbuffer, GST_STATE_NULL);
+  gst_pad_set_active (test->srcpad, FALSE);
+  gst_pad_set_active (test->sinkpad, FALSE);
+  g_object_unref (test->srcpad);
+  g_object_unref (test->sinkpad);
+  g_object_unref (test->jitterbuffer);
+}
+
+/* Pushes packets sent every PACKET_INTERVAL. With jitter, every other */
+/* packet arrives one interval late */
+static void
+push_packets (JitterBufferTest * test, guint count, gboolean jitter)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  guint i;
+
+  for (i = 0; i < count; i++) {
+    GstBuffer *buffer = gst_rtp_buffer_new_allocate (10, 0, 0);
+    GstClockTime pts = test->seq * PACKET_INTERVAL;
+
+    fail_unless (gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp));
+    gst_rtp_buffer_set_payload_type (&rtp, 96);
+    gst_rtp_buffer_set_ssrc (&rtp, 0x1234);
+    gst_rtp_buffer_set_seq (&rtp, test->seq);
+    gst_rtp_buffer_set_timestamp (&rtp,
+        gst_util_uint64_scale_int (pts, CLOCK_RATE, GST_SECOND));
+    gst_rtp_buffer_unmap (&rtp);
+
+    GST_BUFFER_PTS (buffer) = GST_BUFFER_DTS (buffer) = pts;
+    test->seq++;
+
+    fail_unless (gst_pad_push (test->srcpad, buffer) == GST_FLOW_OK);
+
+    if (!jitter) {
+      g_usleep (PACKET_INTERVAL / GST_USECOND);
+    } else if (i % 2 == 1) {
+      g_usleep (2 * PACKET_INTERVAL / GST_USECOND);
+    }
+  }
+}
+
+static guint
+get_latency (JitterBufferTest * test)
+{
+  guint latency;
+
+  g_object_get (test->jitterbuffer, "latency", &latency, NULL);
+
+  return latency;
+}
+
+GST_START_TEST (fixed_latency)
+{
+  KmsJitterBufferControl *control;
+  JitterBufferTest test;
+
+  setup_jitterbuffer (&test);
+  g_object_set (test.jitterbuffer, "latency", 0, NULL);
+
+  /* Same bounds, as configured by default in endpoints */
+  control = kms_jitter_buffer_control_new (test.jitterbuffer, 1500, 1500,
+      FALSE);
+  start_stream (&test);
+
+  push_packets (&test, 1, FALSE);
+  fail_unless (get_latency (&test) == 1500);
+
+  push_packets (&test, PHASE_PACKETS, TRUE);
+  fail_unless (get_latency (&test) == 1500);
+  fail_unless (kms_jitter_buffer_control_get_target_latency (control) == 1500);
+
+  kms_jitter_buffer_control_unref (control);
+  teardown_jitterbuffer (&test);
+}
+
+GST_END_TEST
+GST_START_TEST (latency_follows_jitter)
+{
+  KmsJitterBufferControl *control;
+  JitterBufferTest test;
+  guint raised, decayed;
+
+  setup_jitterbuffer (&test);
+
+  control = kms_jitter_buffer_control_new (test.jitterbuffer, 20, 1500,
+      FALSE);
+  start_stream (&test);
+
+  /* Starts at the lower bound */
+  push_packets (&test, 1, FALSE);
+  fail_unless (get_latency (&test) == 20);
+
+  /* 20ms of jitter needs room for several times that */
+  push_packets (&test, PHASE_PACKETS, TRUE);
+  raised = kms_jitter_buffer_control_get_target_latency (control);
+  GST_INFO ("Latency with jitter: %u ms", raised);
+  fail_unless (raised >= 40 && raised < 1500);
+  fail_unless (get_latency (&test) == raised);
+
+  /* Without jitter it goes down, but not at once */
+  push_packets (&test, PHASE_PACKETS, FALSE);
+  decayed = kms_jitter_buffer_control_get_target_latency (control);
+  GST_INFO ("Latency without jitter: %u ms", decayed);
+  fail_unless (decayed < raised);
+  fail_unless (decayed > 20);
+  fail_unless (get_latency (&test) == decayed);
+
+  kms_jitter_buffer_control_unref (control);
+  teardown_jitterbuffer (&test);
+}
+
+GST_END_TEST
+GST_START_TEST (bounds_update)
+{
+  KmsJitterBufferControl *control;
+  JitterBufferTest test;
+
+  setup_jitterbuffer (&test);
+
+  control = kms_jitter_buffer_control_new (test.jitterbuffer, 20, 1500,
+      FALSE);
+  start_stream (&test);
+  push_packets (&test, 1, FALSE);
+
+  /* A max lower than the min is raised to the min */
+  kms_jitter_buffer_control_set_bounds (control, 200, 100);
+  push_packets (&test, PHASE_PACKETS, TRUE);
+  fail_unless (kms_jitter_buffer_control_get_target_latency (control) == 200);
+  fail_unless (get_latency (&test) == 200);
+
+  kms_jitter_buffer_control_unref (control);
+  teardown_jitterbuffer (&test);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+jitterbuffercontrol_suite (void)
+{
+  Suite *s = suite_create ("jitterbuffercontrol");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, fixed_latency);
+  tcase_add_test (tc_chain, latency_follows_jitter);
+  tcase_add_test (tc_chain, bounds_update);
+
+  return s;
+}
+
+GST_CHECK_MAIN (jitterbuffercontrol);
@@ -0,0 +1,146 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <gst/video/video-event.h>
+
+#include "kmskeyframearbiter.h"
+
+#define LONG_WINDOW (60 * GST_SECOND)
+#define VIEWERS 200
+
+static guint received;
+
+static gboolean
+src_event_function (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  if (gst_video_event_is_force_key_unit (event)) {
+    received++;
+  }
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+sink_chain_function (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static void
+request_key_frames (GstPad * sinkpad, guint count)
+{
+  guint i;
+
+  for (i = 0; i < count; i++) {
+    gst_pad_push_event (sinkpad,
+        gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE,
+            TRUE, 0));
+  }
+}
+
+static void
+push_frame (GstPad * srcpad, gboolean key_frame)
+{
+  GstBuffer *buffer = gst_buffer_new ();
+
+  if (!key_frame) {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  }
+
+  fail_unless (gst_pad_push (srcpad, buffer) == GST_FLOW_OK);
+}
+
+GST_START_TEST (coalesce_requests)
+{
+  KmsKeyFrameArbiter *arbiter;
+  GstPad *srcpad, *sinkpad;
+  guint64 requested, forwarded;
+  GstSegment segment;
+
+  received = 0;
+
+  srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_event_function (srcpad, src_event_function);
+  gst_pad_set_chain_function (sinkpad, sink_chain_function);
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_pad_set_active (srcpad, TRUE);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  gst_pad_push_event (srcpad, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (srcpad, gst_event_new_segment (&segment));
+
+  arbiter = kms_key_frame_arbiter_new (LONG_WINDOW);
+  kms_key_frame_arbiter_watch_pad (arbiter, sinkpad);
+
+  /* Every viewer asks for a key frame at the same time */
+  request_key_frames (sinkpad, VIEWERS);
+  fail_unless (received == 1);
+
+  /* Requests keep being coalesced until a key frame arrives */
+  push_frame (srcpad, FALSE);
+  request_key_frames (sinkpad, VIEWERS);
+  fail_unless (received == 1);
+
+  push_frame (srcpad, TRUE);
+  request_key_frames (sinkpad, VIEWERS);
+  fail_unless (received == 2);
+
+  /* An expired window lets the next request through */
+  kms_key_frame_arbiter_set_window (arbiter, 0);
+  request_key_frames (sinkpad, 1);
+  fail_unless (received == 3);
+
+  kms_key_frame_arbiter_get_counters (arbiter, &requested, &forwarded);
+  GST_INFO ("Requested: %" G_GUINT64_FORMAT ", forwarded: %" G_GUINT64_FORMAT,
+      requested, forwarded);
+  fail_unless (requested == 3 * VIEWERS + 1);
+  fail_unless (forwarded == received);
+
+  kms_key_frame_arbiter_unref (arbiter);
+
+  gst_pad_set_active (srcpad, FALSE);
+  gst_pad_set_active (sinkpad, FALSE);
+  g_object_unref (srcpad);
+  g_object_unref (sinkpad);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+keyframearbiter_suite (void)
+{
+  Suite *s = suite_create ("keyframearbiter");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, coalesce_requests);
+
+  return s;
+}
+
+GST_CHECK_MAIN (keyframearbiter);
@@ -22,6 +22,9 @@
 #include <time.h>
 
 #include "kmsbufferlacentymeta.h"
+#include "kmsserializablemeta.h"
+
+#define BENCH_ITERATIONS 1000
 
 #define KMS_FACTORY_MAKE_IF_AVAILABLE(factory_name) ({      \
   GstElement *_element;                                     \
@@ -414,6 +417,128 @@ GST_START_TEST (check_metadata_enc)
   }
 }
 
+GST_END_TEST
+static guint
+count_metas (GstBuffer * buffer, GType api)
+{
+  gpointer state = NULL;
+  GstMeta *meta;
+  guint count = 0;
+
+  while ((meta = gst_buffer_iterate_meta (buffer, &state)) != NULL) {
+    if (meta->info->api == api) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+GST_START_TEST (serializable_meta_shared)
+{
+  KmsSerializableMeta *meta, *copy_meta;
+  GstBuffer *buffer, *copy;
+  gint value = 0;
+
+  buffer = gst_buffer_new ();
+  kms_buffer_add_serializable_meta (buffer,
+      gst_structure_new ("data", "value", G_TYPE_INT, 42, NULL));
+
+  copy = gst_buffer_copy (buffer);
+
+  meta = kms_buffer_get_serializable_meta (buffer);
+  copy_meta = kms_buffer_get_serializable_meta (copy);
+  fail_if (meta == NULL || copy_meta == NULL);
+  fail_unless (meta->data == copy_meta->data);
+  fail_unless (meta->payload == copy_meta->payload);
+
+  gst_buffer_unref (buffer);
+
+  fail_unless (gst_structure_get_int (copy_meta->data, "value", &value));
+  fail_unless (value == 42);
+
+  gst_buffer_unref (copy);
+}
+
+GST_END_TEST
+GST_START_TEST (latency_meta_single)
+{
+  KmsBufferLatencyMeta *meta;
+  GstBuffer *buffer;
+
+  buffer = gst_buffer_new ();
+
+  kms_buffer_add_buffer_latency_meta (buffer, 1, FALSE, KMS_MEDIA_TYPE_AUDIO);
+  kms_buffer_add_buffer_latency_meta (buffer, 2, TRUE, KMS_MEDIA_TYPE_VIDEO);
+
+  fail_unless (count_metas (buffer, KMS_BUFFER_LATENCY_META_API_TYPE) == 1);
+
+  meta = kms_buffer_get_buffer_latency_meta (buffer);
+  fail_unless (meta->ts == 2);
+  fail_unless (meta->valid);
+  fail_unless (meta->type == KMS_MEDIA_TYPE_VIDEO);
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST
+/* Time needed to produce a writable copy of @buffer for each output */
+static gint64
+measure_copies (GstBuffer * buffer, guint outputs)
+{
+  GstBuffer **copies;
+  gint64 start;
+  guint i, j;
+
+  copies = g_new (GstBuffer *, outputs);
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < BENCH_ITERATIONS; i++) {
+    for (j = 0; j < outputs; j++) {
+      copies[j] = gst_buffer_copy (buffer);
+    }
+
+    for (j = 0; j < outputs; j++) {
+      gst_buffer_unref (copies[j]);
+    }
+  }
+
+  g_free (copies);
+
+  return g_get_monotonic_time () - start;
+}
+
+GST_START_TEST (meta_copy_overhead)
+{
+  guint outputs[] = { 1, 10, 100 };
+  GstBuffer *plain, *tagged;
+  guint i;
+
+  plain = gst_buffer_new_allocate (NULL, 1024, NULL);
+  tagged = gst_buffer_copy (plain);
+
+  kms_buffer_add_buffer_latency_meta (tagged, g_get_monotonic_time (), TRUE,
+      KMS_MEDIA_TYPE_VIDEO);
+  kms_buffer_add_serializable_meta (tagged,
+      gst_structure_new ("data", "id", G_TYPE_STRING, "benchmark",
+          "value", G_TYPE_INT, 42, NULL));
+
+  for (i = 0; i < G_N_ELEMENTS (outputs); i++) {
+    gint64 plain_us, tagged_us;
+
+    plain_us = measure_copies (plain, outputs[i]);
+    tagged_us = measure_copies (tagged, outputs[i]);
+
+    GST_INFO ("%u outputs: %" G_GINT64_FORMAT " us without metas, %"
+        G_GINT64_FORMAT " us with metas (%.1f ns of meta overhead per copy)",
+        outputs[i], plain_us, tagged_us,
+        (tagged_us - plain_us) * 1000.0 / (BENCH_ITERATIONS * outputs[i]));
+  }
+
+  gst_buffer_unref (plain);
+  gst_buffer_unref (tagged);
+}
+
 GST_END_TEST
 /******************************/
 /* metadata test suite        */
@@ -427,6 +552,9 @@ metadata_suite (void)
   suite_add_tcase (s, tc_chain);
 
   tcase_add_test (tc_chain, check_metadata_enc);
+  tcase_add_test (tc_chain, serializable_meta_shared);
+  tcase_add_test (tc_chain, latency_meta_single);
+  tcase_add_test (tc_chain, meta_copy_overhead);
 
   return s;
 }
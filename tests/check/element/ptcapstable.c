@@ -0,0 +1,146 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+
+#include "kmsptcapstable.h"
+
+#define DYNAMIC_PT 96
+#define READERS 4
+#define RENEGOTIATIONS 2000
+
+typedef struct _ReaderData
+{
+  KmsPtCapsTable *table;
+  GstCaps *vp8;
+  GstCaps *h264;
+  gint running;
+  guint lookups;
+} ReaderData;
+
+static GHashTable *
+create_pt_caps (GstCaps * caps)
+{
+  GHashTable *pt_caps;
+
+  pt_caps = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      (GDestroyNotify) gst_caps_unref);
+  g_hash_table_insert (pt_caps, GUINT_TO_POINTER (DYNAMIC_PT),
+      gst_caps_ref (caps));
+
+  return pt_caps;
+}
+
+static gpointer
+reader_thread (gpointer user_data)
+{
+  ReaderData *data = user_data;
+  guint lookups = 0;
+
+  while (g_atomic_int_get (&data->running)) {
+    GstCaps *caps;
+
+    caps = kms_pt_caps_table_get_caps (data->table, DYNAMIC_PT);
+    fail_unless (caps == data->vp8 || caps == data->h264);
+    gst_caps_unref (caps);
+
+    fail_unless (kms_pt_caps_table_get_caps (data->table, 0) == NULL);
+    lookups++;
+  }
+
+  return GUINT_TO_POINTER (lookups);
+}
+
+GST_START_TEST (not_negotiated)
+{
+  KmsPtCapsTable *table;
+
+  table = kms_pt_caps_table_new ();
+  fail_unless (kms_pt_caps_table_get_caps (table, DYNAMIC_PT) == NULL);
+  kms_pt_caps_table_free (table);
+}
+
+GST_END_TEST
+GST_START_TEST (renegotiate_while_streaming)
+{
+  GThread *readers[READERS];
+  ReaderData data;
+  GstCaps *caps;
+  guint i;
+
+  data.table = kms_pt_caps_table_new ();
+  data.vp8 = gst_caps_from_string ("application/x-rtp, media=(string)video, "
+      "clock-rate=(int)90000, encoding-name=(string)VP8");
+  data.h264 = gst_caps_from_string ("application/x-rtp, media=(string)video, "
+      "clock-rate=(int)90000, encoding-name=(string)H264");
+  data.running = TRUE;
+
+  kms_pt_caps_table_set (data.table, create_pt_caps (data.vp8));
+
+  for (i = 0; i < READERS; i++) {
+    readers[i] = g_thread_new ("reader", reader_thread, &data);
+  }
+
+  /* Each renegotiation retires the previous map while readers may hold it */
+  for (i = 0; i < RENEGOTIATIONS; i++) {
+    kms_pt_caps_table_set (data.table,
+        create_pt_caps (i % 2 == 0 ? data.h264 : data.vp8));
+  }
+
+  g_atomic_int_set (&data.running, FALSE);
+
+  for (i = 0; i < READERS; i++) {
+    g_thread_join (readers[i]);
+  }
+
+  /* Retired maps are released, only our references and the current */
+  /* map's one remain */
+  caps = kms_pt_caps_table_get_caps (data.table, DYNAMIC_PT);
+  fail_unless (caps == data.vp8);
+  gst_caps_unref (caps);
+
+  fail_unless (GST_MINI_OBJECT_REFCOUNT_VALUE (data.vp8) == 2);
+  fail_unless (GST_MINI_OBJECT_REFCOUNT_VALUE (data.h264) == 1);
+
+  kms_pt_caps_table_free (data.table);
+
+  fail_unless (GST_MINI_OBJECT_REFCOUNT_VALUE (data.vp8) == 1);
+
+  gst_caps_unref (data.vp8);
+  gst_caps_unref (data.h264);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+ptcapstable_suite (void)
+{
+  Suite *s = suite_create ("ptcapstable");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, not_negotiated);
+  tcase_add_test (tc_chain, renegotiate_while_streaming);
+
+  return s;
+}
+
+GST_CHECK_MAIN (ptcapstable);
@@ -0,0 +1,148 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "kmsrtppayloader.h"
+
+#define VP8_RTP_CAPS "application/x-rtp,media=video,encoding-name=VP8," \
+    "clock-rate=90000,payload=96"
+#define PAYLOAD_TYPE 96
+#define FRAMES 5
+/* Small enough to split every encoded frame in several packets */
+#define MTU 200
+
+typedef struct _Received
+{
+  guint lists;
+  guint list_packets;
+  guint buffers;
+  gboolean wrong_pt;
+} Received;
+
+static gboolean
+check_packet (GstBuffer ** buffer, guint idx, gpointer data)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  Received *received = data;
+
+  if (!gst_rtp_buffer_map (*buffer, GST_MAP_READ, &rtp)) {
+    received->wrong_pt = TRUE;
+    return TRUE;
+  }
+
+  if (gst_rtp_buffer_get_payload_type (&rtp) != PAYLOAD_TYPE) {
+    received->wrong_pt = TRUE;
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+  received->list_packets++;
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+sink_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  Received *received = data;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    received->lists++;
+    gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+        check_packet, received);
+  } else {
+    received->buffers++;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (vp8_frames_as_lists)
+{
+  GstElement *pipeline, *src, *enc, *pay, *sink;
+  Received received = { 0, 0, 0, FALSE };
+  GstMessage *msg;
+  GstCaps *caps;
+  GstPad *pad;
+  GstBus *bus;
+
+  caps = gst_caps_from_string (VP8_RTP_CAPS);
+  pay = kms_rtp_payloader_new_for_caps (caps);
+  gst_caps_unref (caps);
+  fail_unless (pay != NULL);
+  g_object_set (pay, "mtu", MTU, NULL);
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("videotestsrc", NULL);
+  enc = gst_element_factory_make ("vp8enc", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (src, "num-buffers", FRAMES, NULL);
+  g_object_set (enc, "deadline", G_GINT64_CONSTANT (1), NULL);
+  g_object_set (sink, "sync", FALSE, "async", FALSE, NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, enc, pay, sink, NULL);
+  fail_unless (gst_element_link_many (src, enc, pay, sink, NULL));
+
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST, sink_probe,
+      &received, NULL);
+  g_object_unref (pad);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  msg = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  g_object_unref (bus);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  g_object_unref (pipeline);
+
+  GST_INFO ("Received %u lists with %u packets and %u single buffers",
+      received.lists, received.list_packets, received.buffers);
+
+  /* Frames reach the sink as lists, key frames split in several packets */
+  fail_unless (received.lists > 0);
+  fail_unless (received.list_packets > received.lists);
+  fail_unless (received.buffers == 0);
+  fail_if (received.wrong_pt);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+rtppayloader_suite (void)
+{
+  Suite *s = suite_create ("rtppayloader");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, vp8_frames_as_lists);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtppayloader);
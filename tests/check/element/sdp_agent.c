@@ -26,6 +26,7 @@
 #include "kmsisdppayloadmanager.h"
 #include "kmssdpmediahandler.h"
 #include "kmssdppayloadmanager.h"
+#include "kmssdpcodectable.h"
 #include "kmssdpsctpmediahandler.h"
 #include "kmssdprtpavpmediahandler.h"
 #include "kmssdprtpavpfmediahandler.h"
@@ -2448,6 +2449,404 @@ GST_START_TEST (sdp_agent_avp_generic_payload_negotiation)
   g_object_unref (answerer);
 }
 
+GST_END_TEST;
+
+#define BENCHMARK_ITERATIONS 2000
+
+static KmsSdpAgent *
+create_benchmark_agent (const gchar * addr)
+{
+  KmsSdpMediaHandler *handler;
+  KmsSdpAgent *agent;
+  gint id;
+
+  agent = kms_sdp_agent_new ();
+  g_object_set (agent, "addr", addr, NULL);
+
+  handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_savpf_media_handler_new ());
+  set_default_codecs (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), audio_codecs,
+      G_N_ELEMENTS (audio_codecs), video_codecs, G_N_ELEMENTS (video_codecs));
+  id = kms_sdp_agent_add_proto_handler (agent, "audio", handler);
+  fail_if (id < 0);
+
+  handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_savpf_media_handler_new ());
+  set_default_codecs (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), audio_codecs,
+      G_N_ELEMENTS (audio_codecs), video_codecs, G_N_ELEMENTS (video_codecs));
+  id = kms_sdp_agent_add_proto_handler (agent, "video", handler);
+  fail_if (id < 0);
+
+  return agent;
+}
+
+static GstSDPMessage *
+benchmark_create_offer (KmsSdpAgent * agent)
+{
+  GstSDPMessage *offer;
+  SdpMessageContext *ctx;
+  GError *err = NULL;
+
+  ctx = kms_sdp_agent_create_offer (agent, &err);
+  fail_if (err != NULL);
+  offer = kms_sdp_message_context_pack (ctx, &err);
+  fail_if (err != NULL);
+  kms_sdp_message_context_destroy (ctx);
+
+  return offer;
+}
+
+GST_START_TEST (sdp_agent_test_offer_answer_rate)
+{
+  KmsSdpAgent *offerer, *answerer;
+  GstSDPMessage *offer, *answer, *first;
+  SdpMessageContext *ctx;
+  GError *err = NULL;
+  gchar *first_str, *offer_str;
+  gint64 start, elapsed;
+  guint i;
+
+  offerer = create_benchmark_agent (OFFERER_ADDR);
+  answerer = create_benchmark_agent (ANSWERER_ADDR);
+
+  /* Offers built from cached m-lines must match the first one */
+  first = benchmark_create_offer (offerer);
+  first_str = gst_sdp_message_as_text (first);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    offer = benchmark_create_offer (offerer);
+    gst_sdp_message_free (offer);
+  }
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  GST_INFO ("Offers: %.0f/s",
+      BENCHMARK_ITERATIONS * (gdouble) G_USEC_PER_SEC / elapsed);
+
+  offer = benchmark_create_offer (offerer);
+  offer_str = gst_sdp_message_as_text (offer);
+  fail_if (g_strcmp0 (first_str, offer_str) != 0);
+  g_free (offer_str);
+  gst_sdp_message_free (offer);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    ctx = kms_sdp_agent_create_answer (answerer, first, &err);
+    fail_if (err != NULL);
+    answer = kms_sdp_message_context_pack (ctx, &err);
+    fail_if (err != NULL);
+    kms_sdp_message_context_destroy (ctx);
+    gst_sdp_message_free (answer);
+  }
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  GST_INFO ("Answers: %.0f/s",
+      BENCHMARK_ITERATIONS * (gdouble) G_USEC_PER_SEC / elapsed);
+
+  g_free (first_str);
+  gst_sdp_message_free (first);
+  g_object_unref (offerer);
+  g_object_unref (answerer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (sdp_agent_test_offer_template_invalidation)
+{
+  KmsSdpMediaHandler *handler;
+  KmsSdpAgent *agent;
+  GstSDPMessage *offer;
+  const GstSDPMedia *media;
+  GError *err = NULL;
+  gint id;
+
+  agent = kms_sdp_agent_new ();
+  g_object_set (agent, "addr", OFFERER_ADDR, NULL);
+
+  handler = KMS_SDP_MEDIA_HANDLER (kms_sdp_rtp_avpf_media_handler_new ());
+  set_default_codecs (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), audio_codecs,
+      G_N_ELEMENTS (audio_codecs), video_codecs, G_N_ELEMENTS (video_codecs));
+  id = kms_sdp_agent_add_proto_handler (agent, "video", handler);
+  fail_if (id < 0);
+
+  offer = benchmark_create_offer (agent);
+  media = gst_sdp_message_get_media (offer, 0);
+  fail_unless (gst_sdp_media_get_attribute_val (media, "extmap") == NULL);
+  fail_unless (gst_sdp_media_bandwidths_len (media) == 0);
+  fail_unless (is_rtcp_fb_in_media (offer, "nack"));
+  fail_unless (is_rtcp_fb_in_media (offer, "goog-remb"));
+  gst_sdp_message_free (offer);
+
+  /* Configuration changes must show up in the next offer */
+  fail_unless (kms_sdp_rtp_avp_media_handler_add_extmap
+      (KMS_SDP_RTP_AVP_MEDIA_HANDLER (handler), 3,
+          "http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time", &err));
+  kms_sdp_media_handler_add_bandwidth (handler, "AS", 500);
+
+  offer = benchmark_create_offer (agent);
+  media = gst_sdp_message_get_media (offer, 0);
+  fail_if (gst_sdp_media_get_attribute_val (media, "extmap") == NULL);
+  fail_unless (gst_sdp_media_bandwidths_len (media) == 1);
+  gst_sdp_message_free (offer);
+
+  g_object_set (handler, "nack", FALSE, "goog-remb", FALSE, NULL);
+
+  /* Checks every rtcp-fb attribute, not only the first one */
+  offer = benchmark_create_offer (agent);
+  fail_if (is_rtcp_fb_in_media (offer, "nack"));
+  fail_if (is_rtcp_fb_in_media (offer, "goog-remb"));
+  gst_sdp_message_free (offer);
+
+  g_object_unref (agent);
+}
+
+GST_END_TEST;
+
+#define LATENCY_ITERATIONS 50
+
+static GstSDPMessage *
+create_test_answer (KmsSdpAgent * answerer, const GstSDPMessage * offer)
+{
+  GstSDPMessage *answer;
+  SdpMessageContext *ctx;
+  GError *err = NULL;
+
+  ctx = kms_sdp_agent_create_answer (answerer, offer, &err);
+  fail_if (err != NULL);
+  answer = kms_sdp_message_context_pack (ctx, &err);
+  fail_if (err != NULL);
+  kms_sdp_message_context_destroy (ctx);
+
+  return answer;
+}
+
+static void
+check_same_medias (const GstSDPMessage * expected, const GstSDPMessage * msg)
+{
+  guint i, len;
+
+  len = gst_sdp_message_medias_len (expected);
+  fail_unless (gst_sdp_message_medias_len (msg) == len);
+
+  for (i = 0; i < len; i++) {
+    gchar *e, *m;
+
+    e = gst_sdp_media_as_text (gst_sdp_message_get_media (expected, i));
+    m = gst_sdp_media_as_text (gst_sdp_message_get_media (msg, i));
+    fail_unless (g_strcmp0 (e, m) == 0, "m-line %u differs:\n%s\n%s", i, e,
+        m);
+    g_free (e);
+    g_free (m);
+  }
+}
+
+static void
+measure_answer_latency (KmsSdpAgent * offerer, KmsSdpAgent * answerer,
+    KmsSdpAgent * sequential, guint m_lines)
+{
+  GstSDPMessage *template, *offer, *answer, *expected;
+  gint64 start, elapsed;
+  gchar *sdp_str, *m_line;
+  guint i;
+
+  /* Keep session level lines, replicate the audio and video m-lines */
+  template = benchmark_create_offer (offerer);
+  sdp_str = gst_sdp_message_as_text (template);
+  m_line = g_strstr_len (sdp_str, -1, "m=");
+  fail_if (m_line == NULL);
+  *m_line = '\0';
+
+  fail_unless (gst_sdp_message_new (&offer) == GST_SDP_OK);
+  fail_unless (gst_sdp_message_parse_buffer ((const guint8 *) sdp_str, -1,
+          offer) == GST_SDP_OK);
+  g_free (sdp_str);
+
+  for (i = 0; i < m_lines; i++) {
+    gst_sdp_message_add_media (offer, gst_sdp_message_get_media (template,
+            i % gst_sdp_message_medias_len (template)));
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < LATENCY_ITERATIONS; i++) {
+    guint j;
+
+    answer = create_test_answer (answerer, offer);
+
+    /* Answers must keep the offered m-line order */
+    fail_unless (gst_sdp_message_medias_len (answer) == m_lines);
+    for (j = 0; j < m_lines; j++) {
+      const GstSDPMedia *o = gst_sdp_message_get_media (offer, j);
+      const GstSDPMedia *a = gst_sdp_message_get_media (answer, j);
+
+      fail_unless (g_strcmp0 (gst_sdp_media_get_media (o),
+              gst_sdp_media_get_media (a)) == 0);
+      fail_if (gst_sdp_media_get_port (a) == 0);
+    }
+
+    gst_sdp_message_free (answer);
+  }
+  elapsed = g_get_monotonic_time () - start;
+
+  GST_INFO ("Answer for %u m-lines: %.1f us", m_lines,
+      elapsed / (gdouble) LATENCY_ITERATIONS);
+
+  /* Answers built concurrently must equal the sequential ones */
+  expected = create_test_answer (sequential, offer);
+  answer = create_test_answer (answerer, offer);
+  check_same_medias (expected, answer);
+  gst_sdp_message_free (expected);
+  gst_sdp_message_free (answer);
+
+  gst_sdp_message_free (offer);
+  gst_sdp_message_free (template);
+}
+
+GST_START_TEST (sdp_agent_test_answer_latency)
+{
+  KmsSdpAgent *offerer, *answerer, *sequential;
+
+  offerer = create_benchmark_agent (OFFERER_ADDR);
+  answerer = create_benchmark_agent (ANSWERER_ADDR);
+  sequential = create_benchmark_agent (ANSWERER_ADDR);
+  g_object_set (sequential, "parallel-answers", FALSE, NULL);
+
+  measure_answer_latency (offerer, answerer, sequential, 2);
+  measure_answer_latency (offerer, answerer, sequential, 16);
+  measure_answer_latency (offerer, answerer, sequential, 64);
+
+  g_object_unref (offerer);
+  g_object_unref (answerer);
+  g_object_unref (sequential);
+}
+
+GST_END_TEST;
+
+static const gchar *sdp_indexed_media_str = "v=0\r\n"
+    "o=- 0 0 IN IP4 0.0.0.0\r\n"
+    "s=TestSession\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "t=0 0\r\n"
+    "m=video 1 RTP/AVPF 9 96 97\r\n"
+    "a=rtpmap:96 VP8/90000\r\n"
+    "a=rtpmap:97 H264/90000\r\n"
+    "a=fmtp:97 profile-level-id=42e01f\r\n"
+    "a=rtcp-fb:96 nack\r\n"
+    "a=rtcp-fb:96 nack pli\r\n"
+    "a=rtcp-fb:97 ccm fir\r\n" "a=sendrecv\r\n";
+
+GST_START_TEST (sdp_agent_test_media_index)
+{
+  const GstSDPMedia *media;
+  GstSDPAttribute attr;
+  SdpMediaIndex *index;
+  GstSDPMessage *sdp;
+
+  fail_unless (gst_sdp_message_new (&sdp) == GST_SDP_OK);
+  fail_unless (gst_sdp_message_parse_buffer ((const guint8 *)
+          sdp_indexed_media_str, -1, sdp) == GST_SDP_OK);
+  media = gst_sdp_message_get_media (sdp, 0);
+  index = sdp_utils_media_index_new (media);
+
+  /* Indexed lookups match the ones scanning the media */
+  fail_unless (g_strcmp0 (sdp_utils_media_index_get_attr_map_value (index,
+              "rtpmap", "97", 0), sdp_utils_get_attr_map_value (media,
+              "rtpmap", "97")) == 0);
+  fail_unless (g_strcmp0 (sdp_utils_media_index_get_attr_map_value (index,
+              "fmtp", "97", 0), "97 profile-level-id=42e01f") == 0);
+  fail_unless (sdp_utils_media_index_get_attr_map_value (index, "fmtp", "96",
+          0) == NULL);
+  fail_unless (g_strcmp0 (sdp_utils_media_index_get_attr_map_value (index,
+              "rtcp-fb", "96", 1), sdp_utils_get_attr_map_value_n (media,
+              "rtcp-fb", "96", 1)) == 0);
+  fail_unless (sdp_utils_media_index_get_attr_map_value (index, "rtcp-fb",
+          "96", 2) == NULL);
+  fail_unless (g_strcmp0 (sdp_utils_media_index_get_rtpmap (index, "96"),
+          sdp_utils_sdp_media_get_rtpmap (media, "96")) == 0);
+
+  /* Static payload types without rtpmap, and exact format matching */
+  fail_unless (g_strcmp0 (sdp_utils_media_index_get_rtpmap (index, "9"),
+          "G722/8000/1") == 0);
+  fail_unless (sdp_utils_media_index_get_rtpmap (index, "9x") == NULL);
+
+  gst_sdp_attribute_set (&attr, "rtcp-fb", "96 nack");
+  fail_unless (sdp_utils_media_index_has_attribute (index, &attr));
+  fail_unless (sdp_utils_is_attribute_in_media (media, &attr));
+  gst_sdp_attribute_clear (&attr);
+  gst_sdp_attribute_set (&attr, "rtcp-fb", "97 nack");
+  fail_if (sdp_utils_media_index_has_attribute (index, &attr));
+  fail_if (sdp_utils_is_attribute_in_media (media, &attr));
+  gst_sdp_attribute_clear (&attr);
+
+  sdp_utils_media_index_free (index);
+  gst_sdp_message_free (sdp);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (sdp_agent_test_codec_table)
+{
+  const KmsSdpCodecInfo *pcmu, *opus, *vp8;
+  KmsSdpRtpAvpMediaHandler *handler;
+  KmsSdpPayloadManager *ptmanager;
+  KmsSdpCodecSet set, copy;
+  GError *err = NULL;
+
+  pcmu = kms_sdp_codec_table_lookup ("PCMU/8000");
+  fail_if (pcmu == NULL);
+  fail_unless (pcmu->payload == 0);
+  fail_unless (pcmu->clock_rate == 8000);
+
+  /* Number of channels can be omitted if it is one */
+  fail_unless (kms_sdp_codec_table_lookup ("PCMU/8000/1") == pcmu);
+
+  /* Static payload types, unassigned ones have no entry */
+  fail_unless (kms_sdp_codec_table_lookup_static (0) == pcmu);
+  fail_unless (kms_sdp_codec_table_lookup_static (1) == NULL);
+  fail_unless (kms_sdp_codec_table_lookup_static (35) == NULL);
+  fail_unless (kms_sdp_codec_table_lookup_static (-1) == NULL);
+
+  /* Encoding names are case-insensitive */
+  opus = kms_sdp_codec_table_lookup ("OPUS/48000/2");
+  fail_if (opus == NULL);
+  fail_unless (opus->payload == -1);
+  fail_unless (opus->channels == 2);
+
+  vp8 = kms_sdp_codec_table_lookup ("VP8/90000");
+  fail_if (vp8 == NULL);
+  fail_unless (kms_sdp_codec_table_lookup ("vp8/90000") == vp8);
+  fail_unless (kms_sdp_codec_table_lookup ("VP8/8000") == NULL);
+
+  kms_sdp_codec_set_clear (&set);
+  kms_sdp_codec_set_add (&set, pcmu);
+  kms_sdp_codec_set_add (&set, vp8);
+
+  copy = set;
+  fail_unless (kms_sdp_codec_set_contains (&copy, pcmu));
+  fail_unless (kms_sdp_codec_set_contains (&copy, vp8));
+  fail_if (kms_sdp_codec_set_contains (&copy, opus));
+
+  handler = kms_sdp_rtp_avp_media_handler_new ();
+  ptmanager = kms_sdp_payload_manager_new ();
+  fail_unless (kms_sdp_rtp_avp_media_handler_use_payload_manager (handler,
+          KMS_I_SDP_PAYLOAD_MANAGER (ptmanager), &err));
+
+  fail_unless (kms_sdp_rtp_avp_media_handler_add_video_codec (handler,
+          "VP8/90000", &err));
+
+  /* Same codec with a different case is already used */
+  fail_if (kms_sdp_rtp_avp_media_handler_add_video_codec (handler,
+          "vp8/90000", &err));
+  GST_DEBUG ("Expected error: %s", err->message);
+  g_clear_error (&err);
+
+  /* Codecs not in the table are still checked */
+  fail_if (kms_sdp_rtp_avp_media_handler_add_generic_video_payload (handler,
+          "x-custom/90000", &err) < 0);
+  fail_unless (kms_sdp_rtp_avp_media_handler_add_generic_video_payload
+      (handler, "x-custom/90000", &err) < 0);
+  g_clear_error (&err);
+
+  g_object_unref (handler);
+}
+
 GST_END_TEST static Suite *
 sdp_agent_suite (void)
 {
@@ -2477,6 +2876,11 @@ sdp_agent_suite (void)
   tcase_add_test (tc_chain, sdp_agent_test_dynamic_pts);
   tcase_add_test (tc_chain, sdp_agent_test_optional_enc_parameters);
   tcase_add_test (tc_chain, sdp_agent_regression_tests);
+  tcase_add_test (tc_chain, sdp_agent_test_offer_answer_rate);
+  tcase_add_test (tc_chain, sdp_agent_test_offer_template_invalidation);
+  tcase_add_test (tc_chain, sdp_agent_test_media_index);
+  tcase_add_test (tc_chain, sdp_agent_test_answer_latency);
+  tcase_add_test (tc_chain, sdp_agent_test_codec_table);
 
   return s;
 }
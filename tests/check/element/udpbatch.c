@@ -0,0 +1,436 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <glib.h>
+
+#include "kmsudpbatchconnection.h"
+
+#define LOCALHOST "127.0.0.1"
+#define PACKET_SIZE 1200
+#define LIST_SIZE 32
+#define TOTAL_PACKETS (LIST_SIZE * 2000)
+/* Packets in flight before waiting for the receiver */
+#define MAX_IN_FLIGHT (LIST_SIZE * 8)
+#define WAIT_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+#define RTP_PAYLOAD_SIZE 1000
+#define RTP_PT 96
+#define RTP_SSRC 0x12345678
+#define RTP_PACKETS (LIST_SIZE * 20)
+
+typedef struct _ReceiverData
+{
+  gint received;
+  guint32 next_seq;
+  gint errors;
+} ReceiverData;
+
+/* Every packet carries its sequence number in the first 4 bytes and the */
+/* low byte of it repeated in the rest of the payload */
+static GstBuffer *
+create_packet (guint32 seq)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, PACKET_SIZE, NULL);
+  guint32 seq_be = GUINT32_TO_BE (seq);
+
+  gst_buffer_memset (buffer, 0, seq & 0xff, PACKET_SIZE);
+  gst_buffer_fill (buffer, 0, &seq_be, sizeof (seq_be));
+
+  return buffer;
+}
+
+static gboolean
+check_packet (GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+  ReceiverData *data = user_data;
+  GstMapInfo info;
+  guint32 seq;
+  gsize i;
+
+  gst_buffer_map (*buffer, &info, GST_MAP_READ);
+
+  if (info.size != PACKET_SIZE) {
+    data->errors++;
+    goto end;
+  }
+
+  memcpy (&seq, info.data, sizeof (seq));
+  seq = GUINT32_FROM_BE (seq);
+
+  if (seq != data->next_seq) {
+    GST_ERROR ("Expected packet %u, got %u", data->next_seq, seq);
+    data->errors++;
+  }
+  data->next_seq = seq + 1;
+
+  for (i = sizeof (seq); i < info.size; i++) {
+    if (info.data[i] != (seq & 0xff)) {
+      data->errors++;
+      break;
+    }
+  }
+
+end:
+  gst_buffer_unmap (*buffer, &info);
+  g_atomic_int_inc (&data->received);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+check_packets (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+        check_packet, user_data);
+  } else {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    check_packet (&buffer, 0, user_data);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstBufferList *
+create_packet_list (guint32 first_seq)
+{
+  GstBufferList *list = gst_buffer_list_new_sized (LIST_SIZE);
+  gint i;
+
+  for (i = 0; i < LIST_SIZE; i++) {
+    gst_buffer_list_add (list, create_packet (first_seq + i));
+  }
+
+  return list;
+}
+
+static void
+wait_for_receiver (ReceiverData * data, gint sent, gint max_in_flight)
+{
+  gint64 deadline = g_get_monotonic_time () + WAIT_TIMEOUT;
+
+  while (sent - g_atomic_int_get (&data->received) > max_in_flight &&
+      g_get_monotonic_time () < deadline) {
+    g_usleep (50);
+  }
+}
+
+typedef struct _Loopback
+{
+  GstElement *pipeline;
+  GstElement *udpsrc;
+  GstPad *srcpad;
+  ReceiverData receiver;
+} Loopback;
+
+static void
+loopback_setup (Loopback * loopback, const gchar * name)
+{
+  GstElement *fakesink, *udpsink;
+  GstPad *sinkpad;
+  GstSegment segment;
+  gint port;
+
+  memset (&loopback->receiver, 0, sizeof (ReceiverData));
+
+  loopback->pipeline = gst_pipeline_new (name);
+  loopback->udpsrc = gst_element_factory_make ("udpbatchsrc", NULL);
+  fakesink = gst_element_factory_make ("fakesink", NULL);
+  udpsink = gst_element_factory_make ("udpbatchsink", NULL);
+
+  g_object_set (loopback->udpsrc, "address", LOCALHOST, "buffer-size",
+      4 * 1024 * 1024, NULL);
+  g_object_set (fakesink, "sync", FALSE, "async", FALSE, NULL);
+
+  gst_bin_add_many (GST_BIN (loopback->pipeline), loopback->udpsrc, fakesink,
+      udpsink, NULL);
+  fail_unless (gst_element_link (loopback->udpsrc, fakesink));
+
+  sinkpad = gst_element_get_static_pad (fakesink, "sink");
+  gst_pad_add_probe (sinkpad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      check_packets, &loopback->receiver, NULL);
+  g_object_unref (sinkpad);
+
+  gst_element_set_state (loopback->pipeline, GST_STATE_PLAYING);
+
+  /* The source binds to a free port when going to READY */
+  g_object_get (loopback->udpsrc, "port", &port, NULL);
+  fail_if (port == 0);
+  g_object_set (udpsink, "host", LOCALHOST, "port", port, NULL);
+
+  loopback->srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad = gst_element_get_static_pad (udpsink, "sink");
+  fail_unless (gst_pad_link (loopback->srcpad, sinkpad) == GST_PAD_LINK_OK);
+  g_object_unref (sinkpad);
+  gst_pad_set_active (loopback->srcpad, TRUE);
+
+  gst_pad_push_event (loopback->srcpad, gst_event_new_stream_start (name));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (loopback->srcpad, gst_event_new_segment (&segment));
+}
+
+static void
+loopback_teardown (Loopback * loopback)
+{
+  gst_pad_set_active (loopback->srcpad, FALSE);
+  g_object_unref (loopback->srcpad);
+
+  gst_element_set_state (loopback->pipeline, GST_STATE_NULL);
+  g_object_unref (loopback->pipeline);
+}
+
+GST_START_TEST (loopback_packet_rate)
+{
+  Loopback loopback;
+  gint sent = 0;
+  guint64 batches;
+  gint64 start, elapsed;
+
+  loopback_setup (&loopback, __FUNCTION__);
+
+  start = g_get_monotonic_time ();
+
+  while (sent < TOTAL_PACKETS) {
+    fail_unless (gst_pad_push_list (loopback.srcpad,
+            create_packet_list (sent)) == GST_FLOW_OK);
+    sent += LIST_SIZE;
+
+    wait_for_receiver (&loopback.receiver, sent, MAX_IN_FLIGHT);
+  }
+
+  wait_for_receiver (&loopback.receiver, sent, 0);
+  elapsed = g_get_monotonic_time () - start;
+
+  g_object_get (loopback.udpsrc, "batches-received", &batches, NULL);
+
+  GST_INFO ("Received %d of %d packets in %" G_GINT64_FORMAT " us: %f pps, "
+      "%f packets per recvmmsg", loopback.receiver.received, sent, elapsed,
+      loopback.receiver.received * (gdouble) G_USEC_PER_SEC / MAX (elapsed, 1),
+      loopback.receiver.received / (gdouble) MAX (batches, 1));
+
+  /* Loopback does not drop while the receiver keeps up */
+  fail_unless (loopback.receiver.received == sent);
+  fail_unless (loopback.receiver.errors == 0);
+
+  loopback_teardown (&loopback);
+}
+
+GST_END_TEST
+GST_START_TEST (loopback_single_buffers)
+{
+  Loopback loopback;
+  gint sent;
+
+  loopback_setup (&loopback, __FUNCTION__);
+
+  /* Plain buffers go through the single datagram path */
+  for (sent = 0; sent < LIST_SIZE * 4;) {
+    fail_unless (gst_pad_push (loopback.srcpad,
+            create_packet (sent)) == GST_FLOW_OK);
+    sent++;
+
+    wait_for_receiver (&loopback.receiver, sent, MAX_IN_FLIGHT);
+  }
+
+  wait_for_receiver (&loopback.receiver, sent, 0);
+
+  fail_unless (loopback.receiver.received == sent);
+  fail_unless (loopback.receiver.errors == 0);
+  fail_unless (loopback.receiver.next_seq == (guint32) sent);
+
+  /* EOS is handled by the base sink */
+  fail_unless (gst_pad_push_event (loopback.srcpad, gst_event_new_eos ()));
+
+  loopback_teardown (&loopback);
+}
+
+GST_END_TEST
+static gboolean
+check_rtp_packet (GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  ReceiverData *data = user_data;
+
+  if (!gst_rtp_buffer_map (*buffer, GST_MAP_READ, &rtp)) {
+    data->errors++;
+    goto end;
+  }
+
+  if (gst_rtp_buffer_get_payload_type (&rtp) != RTP_PT ||
+      gst_rtp_buffer_get_ssrc (&rtp) != RTP_SSRC ||
+      gst_rtp_buffer_get_payload_len (&rtp) != RTP_PAYLOAD_SIZE ||
+      gst_rtp_buffer_get_seq (&rtp) != (guint16) data->next_seq) {
+    data->errors++;
+  }
+
+  data->next_seq = gst_rtp_buffer_get_seq (&rtp) + 1;
+  gst_rtp_buffer_unmap (&rtp);
+
+end:
+  g_atomic_int_inc (&data->received);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+check_rtp_packets (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+        check_rtp_packet, user_data);
+  } else {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    check_rtp_packet (&buffer, 0, user_data);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstBufferList *
+create_rtp_list (guint16 first_seq)
+{
+  GstBufferList *list = gst_buffer_list_new_sized (LIST_SIZE);
+  gint i;
+
+  for (i = 0; i < LIST_SIZE; i++) {
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    GstBuffer *buffer;
+
+    buffer = gst_rtp_buffer_new_allocate (RTP_PAYLOAD_SIZE, 0, 0);
+    gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp);
+    gst_rtp_buffer_set_payload_type (&rtp, RTP_PT);
+    gst_rtp_buffer_set_ssrc (&rtp, RTP_SSRC);
+    gst_rtp_buffer_set_seq (&rtp, first_seq + i);
+    gst_rtp_buffer_set_timestamp (&rtp, (first_seq + i) * 3000);
+    gst_rtp_buffer_unmap (&rtp);
+
+    gst_buffer_list_add (list, buffer);
+  }
+
+  return list;
+}
+
+GST_START_TEST (connection_rtp)
+{
+  KmsUdpBatchConnection *sender, *receiver;
+  GstElement *pipeline, *fakesink;
+  GstPad *srcpad, *sinkpad;
+  ReceiverData receiver_data;
+  GstSegment segment;
+  gboolean connected;
+  gint sent;
+
+  memset (&receiver_data, 0, sizeof (ReceiverData));
+
+  sender = kms_udp_batch_connection_new (LOCALHOST, 0, 0, FALSE);
+  receiver = kms_udp_batch_connection_new (LOCALHOST, 0, 0, FALSE);
+  fail_unless (sender != NULL);
+  fail_unless (receiver != NULL);
+
+  pipeline = gst_pipeline_new (__FUNCTION__);
+  kms_i_rtp_connection_add (KMS_I_RTP_CONNECTION (sender), GST_BIN (pipeline),
+      TRUE);
+  kms_i_rtp_connection_add (KMS_I_RTP_CONNECTION (receiver),
+      GST_BIN (pipeline), TRUE);
+
+  /* Each side sends to the ports the other one is bound to */
+  kms_udp_batch_connection_set_remote_info (sender, LOCALHOST,
+      kms_udp_batch_connection_get_rtp_port (receiver),
+      kms_udp_batch_connection_get_rtcp_port (receiver));
+  kms_udp_batch_connection_set_remote_info (receiver, LOCALHOST,
+      kms_udp_batch_connection_get_rtp_port (sender),
+      kms_udp_batch_connection_get_rtcp_port (sender));
+
+  g_object_get (sender, "connected", &connected, NULL);
+  fail_unless (connected);
+
+  fakesink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (fakesink, "sync", FALSE, "async", FALSE, NULL);
+  gst_bin_add (GST_BIN (pipeline), fakesink);
+
+  srcpad =
+      kms_i_rtp_connection_request_rtp_src (KMS_I_RTP_CONNECTION (receiver));
+  sinkpad = gst_element_get_static_pad (fakesink, "sink");
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_pad_add_probe (sinkpad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      check_rtp_packets, &receiver_data, NULL);
+  g_object_unref (srcpad);
+  g_object_unref (sinkpad);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  sinkpad =
+      kms_i_rtp_connection_request_rtp_sink (KMS_I_RTP_CONNECTION (sender));
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK);
+  g_object_unref (sinkpad);
+  gst_pad_set_active (srcpad, TRUE);
+
+  gst_pad_push_event (srcpad, gst_event_new_stream_start (__FUNCTION__));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (srcpad, gst_event_new_segment (&segment));
+
+  for (sent = 0; sent < RTP_PACKETS;) {
+    fail_unless (gst_pad_push_list (srcpad,
+            create_rtp_list (sent)) == GST_FLOW_OK);
+    sent += LIST_SIZE;
+
+    wait_for_receiver (&receiver_data, sent, MAX_IN_FLIGHT);
+  }
+
+  wait_for_receiver (&receiver_data, sent, 0);
+
+  fail_unless (receiver_data.received == sent);
+  fail_unless (receiver_data.errors == 0);
+
+  gst_pad_set_active (srcpad, FALSE);
+  g_object_unref (srcpad);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  g_object_unref (pipeline);
+  g_object_unref (sender);
+  g_object_unref (receiver);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+udpbatch_suite (void)
+{
+  Suite *s = suite_create ("udpbatch");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, loopback_packet_rate);
+  tcase_add_test (tc_chain, loopback_single_buffers);
+  tcase_add_test (tc_chain, connection_rtp);
+
+  return s;
+}
+
+GST_CHECK_MAIN (udpbatch);
@@ -0,0 +1,388 @@
+/*
+ * (C) Copyright 2015 Kurento (http://kurento.org/)
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the GNU Lesser General Public License
+ * (LGPL) version 2.1 which accompanies this distribution, and is available at
+ * http://www.gnu.org/licenses/lgpl-2.1.html
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <string.h>
+
+#include "kmsvp8.h"
+#include "kmsvp8layermeta.h"
+#include "kmsvp8layerfilter.h"
+#include "kmsutils.h"
+
+#define FRAME_DURATION (GST_SECOND / 30)
+#define FRAME_SIZE 1000
+
+#define VP8_PT 96
+
+static GstStaticPadTemplate rtp_src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp"));
+
+static GstStaticPadTemplate frame_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static guint remb_events;
+static guint received_frames;
+
+static gboolean
+src_event_function (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  guint bitrate, ssrc;
+
+  if (kms_utils_remb_event_upstream_parse (event, &bitrate, &ssrc)) {
+    remb_events++;
+  }
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+sink_chain_function (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  received_frames++;
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static void
+link_pads (GstPad ** src, GstPad ** sink)
+{
+  GstSegment segment;
+
+  remb_events = 0;
+  received_frames = 0;
+
+  *src = gst_pad_new ("src", GST_PAD_SRC);
+  *sink = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_event_function (*src, src_event_function);
+  gst_pad_set_chain_function (*sink, sink_chain_function);
+  fail_unless (gst_pad_link (*src, *sink) == GST_PAD_LINK_OK);
+  gst_pad_set_active (*src, TRUE);
+  gst_pad_set_active (*sink, TRUE);
+
+  gst_pad_push_event (*src, gst_event_new_stream_start ("test"));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (*src, gst_event_new_segment (&segment));
+}
+
+static void
+unlink_pads (GstPad * src, GstPad * sink)
+{
+  gst_pad_set_active (src, FALSE);
+  gst_pad_set_active (sink, FALSE);
+  g_object_unref (src);
+  g_object_unref (sink);
+}
+
+static void
+push_frame (GstPad * src, guint n, gint tid, gboolean layer_sync)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, FRAME_SIZE, NULL);
+
+  GST_BUFFER_PTS (buffer) = n * FRAME_DURATION;
+
+  if (n != 0) {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  }
+
+  if (tid >= 0) {
+    kms_buffer_add_vp8_layer_meta (buffer, tid, layer_sync, 0);
+  }
+
+  fail_unless (gst_pad_push (src, buffer) == GST_FLOW_OK);
+}
+
+static void
+send_remb (GstPad * sink, guint bitrate)
+{
+  gst_pad_push_event (sink, kms_utils_remb_event_upstream_new (bitrate, 1));
+}
+
+static void
+push_rtp_packet (GstPad * src, guint16 seq, guint32 ts, gboolean marker,
+    const guint8 * payload, guint size)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buffer;
+
+  buffer = gst_rtp_buffer_new_allocate (size, 0, 0);
+  fail_unless (gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp));
+  gst_rtp_buffer_set_payload_type (&rtp, VP8_PT);
+  gst_rtp_buffer_set_seq (&rtp, seq);
+  gst_rtp_buffer_set_timestamp (&rtp, ts);
+  gst_rtp_buffer_set_marker (&rtp, marker);
+  memcpy (gst_rtp_buffer_get_payload (&rtp), payload, size);
+  gst_rtp_buffer_unmap (&rtp);
+
+  fail_unless (gst_pad_push (src, buffer) == GST_FLOW_OK);
+}
+
+GST_START_TEST (frame_header)
+{
+  /* 640x480 key frame, first partition of 0x1234 bytes */
+  const guint8 key_frame[] = {
+    0x90, 0x46, 0x02, 0x9d, 0x01, 0x2a, 0x80, 0x02, 0xe0, 0x41
+  };
+  const guint8 delta_frame[] = { 0x31, 0x00, 0x00 };
+  const guint8 bad_start_code[] = {
+    0x90, 0x46, 0x02, 0x9d, 0x01, 0x2b, 0x80, 0x02, 0xe0, 0x01
+  };
+  KmsVp8FrameHeader header;
+
+  fail_unless (kms_vp8_parse_frame_header (key_frame, sizeof (key_frame),
+          &header));
+  fail_unless (header.key_frame);
+  fail_unless (header.version == 0);
+  fail_unless (header.show_frame);
+  fail_unless (header.first_part_size == 0x1234);
+  fail_unless (header.width == 640);
+  fail_unless (header.horiz_scale == 0);
+  fail_unless (header.height == 480);
+  fail_unless (header.vert_scale == 1);
+
+  fail_unless (kms_vp8_parse_frame_header (delta_frame, sizeof (delta_frame),
+          &header));
+  fail_if (header.key_frame);
+  fail_unless (header.show_frame);
+  fail_unless (header.width == 0 && header.height == 0);
+
+  fail_if (kms_vp8_parse_frame_header (bad_start_code,
+          sizeof (bad_start_code), &header));
+  fail_if (kms_vp8_parse_frame_header (key_frame, 6, &header));
+  fail_if (kms_vp8_parse_frame_header (key_frame, 2, &header));
+}
+
+GST_END_TEST
+GST_START_TEST (payload_descriptor)
+{
+  const guint8 minimal[] = { 0x10, 0xff };
+  /* X, S; I with long picture ID 0x1234, L, T with TID 2 and Y */
+  const guint8 full[] = { 0x90, 0xe0, 0x92, 0x34, 0x07, 0xa0, 0xff };
+  /* X, N; I with short picture ID 0x15, K with KEYIDX 3 */
+  const guint8 short_id[] = { 0xa1, 0x90, 0x15, 0x03, 0xff };
+  KmsVp8PayloadDescriptor desc;
+
+  fail_unless (kms_vp8_parse_payload_descriptor (minimal, sizeof (minimal),
+          &desc));
+  fail_unless (desc.start_of_partition);
+  fail_if (desc.has_picture_id || desc.has_tl0picidx || desc.has_tid);
+  fail_unless (desc.size == 1);
+
+  fail_unless (kms_vp8_parse_payload_descriptor (full, sizeof (full), &desc));
+  fail_unless (desc.start_of_partition);
+  fail_if (desc.non_reference);
+  fail_unless (desc.has_picture_id && desc.long_picture_id);
+  fail_unless (desc.picture_id == 0x1234);
+  fail_unless (desc.picture_id_offset == 2);
+  fail_unless (desc.has_tl0picidx);
+  fail_unless (desc.tl0picidx == 7);
+  fail_unless (desc.tl0picidx_offset == 4);
+  fail_unless (desc.has_tid);
+  fail_unless (desc.tid == 2);
+  fail_unless (desc.layer_sync);
+  fail_if (desc.has_keyidx);
+  fail_unless (desc.size == 6);
+
+  fail_unless (kms_vp8_parse_payload_descriptor (short_id, sizeof (short_id),
+          &desc));
+  fail_unless (desc.non_reference);
+  fail_unless (desc.partition_index == 1);
+  fail_unless (desc.has_picture_id);
+  fail_if (desc.long_picture_id);
+  fail_unless (desc.picture_id == 0x15);
+  fail_if (desc.has_tl0picidx || desc.has_tid);
+  fail_unless (desc.has_keyidx);
+  fail_unless (desc.keyidx == 3);
+  fail_unless (desc.size == 4);
+
+  /* Truncated descriptors */
+  fail_if (kms_vp8_parse_payload_descriptor (full, 3, &desc));
+  fail_if (kms_vp8_parse_payload_descriptor (full, 6, &desc));
+  fail_if (kms_vp8_parse_payload_descriptor (minimal, 1, &desc));
+}
+
+GST_END_TEST
+GST_START_TEST (layer_filter)
+{
+  KmsVp8LayerFilter *filter;
+  guint64 forwarded, dropped;
+  GstPad *src, *sink;
+  guint i;
+
+  link_pads (&src, &sink);
+
+  filter = kms_vp8_layer_filter_new (GST_SECOND);
+  kms_vp8_layer_filter_watch_pad (filter, src);
+
+  /* One second of two layers at about 120 kbps each */
+  for (i = 0; i <= 31; i++) {
+    push_frame (src, i, i % 2, FALSE);
+  }
+
+  fail_unless (received_frames == 32);
+
+  send_remb (sink, 150000);
+  fail_unless (kms_vp8_layer_filter_get_layer (filter) == 0);
+
+  push_frame (src, 32, 1, FALSE);
+  push_frame (src, 33, 0, FALSE);
+  fail_unless (received_frames == 33);
+
+  /* Going up waits for a layer sync frame */
+  send_remb (sink, 300000);
+  push_frame (src, 34, 1, FALSE);
+  fail_unless (received_frames == 33);
+  push_frame (src, 35, 1, TRUE);
+  push_frame (src, 36, 1, FALSE);
+  fail_unless (received_frames == 35);
+  fail_unless (kms_vp8_layer_filter_get_layer (filter) == 1);
+
+  kms_vp8_layer_filter_get_counters (filter, &forwarded, &dropped);
+  fail_unless (forwarded == 35);
+  fail_unless (dropped == 2);
+
+  /* Output adapts by itself, REMB is not propagated to the publisher */
+  fail_unless (remb_events == 0);
+
+  /* Not even the base layer fits, the publisher has to lower its rate */
+  send_remb (sink, 50000);
+  fail_unless (kms_vp8_layer_filter_get_layer (filter) == 0);
+  fail_unless (remb_events == 1);
+
+  kms_vp8_layer_filter_unref (filter);
+  unlink_pads (src, sink);
+}
+
+GST_END_TEST
+GST_START_TEST (layer_filter_no_layers)
+{
+  KmsVp8LayerFilter *filter;
+  GstPad *src, *sink;
+  guint i;
+
+  link_pads (&src, &sink);
+
+  filter = kms_vp8_layer_filter_new (GST_SECOND);
+  kms_vp8_layer_filter_watch_pad (filter, src);
+
+  for (i = 0; i <= 30; i++) {
+    push_frame (src, i, -1, FALSE);
+  }
+
+  send_remb (sink, 1000);
+
+  for (; i <= 40; i++) {
+    push_frame (src, i, -1, FALSE);
+  }
+
+  fail_unless (received_frames == 41);
+  fail_unless (remb_events == 1);
+
+  kms_vp8_layer_filter_unref (filter);
+  unlink_pads (src, sink);
+}
+
+GST_END_TEST
+GST_START_TEST (layer_meta_depayloader)
+{
+  /* X, S; T with TID 0 followed by a 640x480 key frame */
+  const guint8 key_frame[] = {
+    0x90, 0x20, 0x00,
+    0x90, 0x46, 0x02, 0x9d, 0x01, 0x2a, 0x80, 0x02, 0xe0, 0x41
+  };
+  /* Delta frame split in two packets, T with TID 2 and Y */
+  const guint8 delta_start[] = { 0x90, 0x20, 0xa0, 0x31, 0x00, 0x00, 0x00 };
+  const guint8 delta_end[] = { 0x80, 0x20, 0xa0, 0x00, 0x00, 0x00, 0x00 };
+  GstElement *depayloader;
+  GstPad *src, *sink;
+  KmsVp8LayerMeta *meta;
+  GstCaps *caps;
+
+  depayloader = gst_check_setup_element ("rtpvp8depay");
+  kms_vp8_layer_meta_watch_depayloader (depayloader);
+  src = gst_check_setup_src_pad (depayloader, &rtp_src_template);
+  sink = gst_check_setup_sink_pad (depayloader, &frame_sink_template);
+  gst_pad_set_active (src, TRUE);
+  gst_pad_set_active (sink, TRUE);
+
+  caps = gst_caps_new_simple ("application/x-rtp",
+      "media", G_TYPE_STRING, "video",
+      "clock-rate", G_TYPE_INT, 90000,
+      "encoding-name", G_TYPE_STRING, "VP8",
+      "payload", G_TYPE_INT, VP8_PT, NULL);
+  gst_check_setup_events (src, depayloader, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  fail_unless (gst_element_set_state (depayloader, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  push_rtp_packet (src, 1, 0, TRUE, key_frame, sizeof (key_frame));
+  push_rtp_packet (src, 2, 3000, FALSE, delta_start, sizeof (delta_start));
+  push_rtp_packet (src, 3, 3000, TRUE, delta_end, sizeof (delta_end));
+
+  fail_unless (g_list_length (buffers) == 2);
+
+  meta = kms_buffer_get_vp8_layer_meta (GST_BUFFER (buffers->data));
+  fail_unless (meta != NULL);
+  fail_unless (meta->tid == 0);
+
+  /* Frame aggregated from two packets keeps their layer */
+  meta = kms_buffer_get_vp8_layer_meta (GST_BUFFER (buffers->next->data));
+  fail_unless (meta != NULL);
+  fail_unless (meta->tid == 2);
+  fail_unless (meta->layer_sync);
+
+  gst_check_drop_buffers ();
+  gst_element_set_state (depayloader, GST_STATE_NULL);
+  gst_pad_set_active (src, FALSE);
+  gst_pad_set_active (sink, FALSE);
+  gst_check_teardown_src_pad (depayloader);
+  gst_check_teardown_sink_pad (depayloader);
+  gst_check_teardown_element (depayloader);
+}
+
+GST_END_TEST
+/*
+ * End of test cases
+ */
+static Suite *
+vp8_suite (void)
+{
+  Suite *s = suite_create ("vp8");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, frame_header);
+  tcase_add_test (tc_chain, payload_descriptor);
+  tcase_add_test (tc_chain, layer_filter);
+  tcase_add_test (tc_chain, layer_filter_no_layers);
+  tcase_add_test (tc_chain, layer_meta_depayloader);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vp8);
@@ -24,6 +24,7 @@
 #include <GstreamerDotDetails.hpp>
 #include <MediaSet.hpp>
 #include <ModuleManager.hpp>
+#include <future>
 
 using namespace kurento;
 
@@ -297,3 +298,40 @@ BOOST_AUTO_TEST_CASE (dot_test)
   src.reset();
   pipe.reset();
 }
+
+BOOST_AUTO_TEST_CASE (release_from_deferred_operation)
+{
+  std::shared_ptr <MediaPipelineImpl> pipe (new MediaPipelineImpl (config) );
+  std::shared_ptr <MediaElementImpl> element (new MediaElementImpl (config,
+      pipe, "dummysrc") );
+  GstElement *gate = gst_element_factory_make ("fakesink", NULL);
+  std::vector<GstElement *> elements;
+  std::promise<void> released;
+  std::future<void> releasedFuture = released.get_future ();
+
+  /* Synchronizing the state of the gate blocks the operations thread until
+   * its state lock is released, so the next operation is queued */
+  GST_STATE_LOCK (gate);
+  pipe->addElement (gate, true);
+
+  elements.push_back (gate);
+  elements.push_back (element->getGstreamerElement () );
+
+  pipe->postElementOperation (elements, [element, &released] () mutable {
+    /* The element holds the last reference to its pipeline */
+    element.reset ();
+    released.set_value ();
+  }, [] (const std::string & message) {
+    BOOST_ERROR ("Operation failed: " + message);
+  });
+
+  BOOST_CHECK (!pipe->areElementsReady (elements) );
+
+  element.reset ();
+  pipe.reset ();
+
+  GST_STATE_UNLOCK (gate);
+
+  BOOST_REQUIRE (releasedFuture.wait_for (std::chrono::seconds (5) ) ==
+                 std::future_status::ready);
+}